@@ -0,0 +1,126 @@
+// loads and unloads hair during "gameplay": the main thread records frames and creates / releases instances, assets
+// and shaders between them while a render thread flushes without pause, on the stub SDK and the null render device.
+// reports the churn rate and the SDK calls made with IDs of freed objects, which must stay 0.
+// also a stress test: configure with -DHW_SANITIZE=address to have ASan check the plugin's tables while this runs.
+// usage: hwChurnBench [seconds=5] [max_instances=2000]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+#include <random>
+#include <thread>
+
+static hwMatrix Identity()
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    return r;
+}
+
+struct Hair
+{
+    hwHAsset asset;
+    hwHInstance instance;
+};
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? std::max(std::atof(argv[1]), 0.1) : 5.0;
+    int max_instances = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 2000;
+    const int num_bones = 32;
+    const int num_paths = 8;
+    const char *shader_path = "hwChurnBench.cso";
+
+    {
+        // the null device takes any bytes as a pixel shader
+        std::ofstream f(shader_path, std::ios::binary);
+        f << "hwChurnBench";
+    }
+
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwChurnBench: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+
+    std::atomic<bool> quit { false };
+    std::atomic<int64_t> flushes { 0 };
+    std::thread render_thread([&]() {
+        while (!quit) {
+            ctx->flushView(0);
+            ++flushes;
+        }
+    });
+
+    std::mt19937 rng(1234);
+    std::vector<Hair> hairs;
+    std::vector<hwMatrix> palette(num_bones, Identity());
+    hwMatrix view = Identity(), proj = Identity();
+    hwHShader shader = hwShaderLoadFromFile(shader_path);
+    char path[64];
+
+    int64_t frames = 0, creates = 0, releases = 0, shader_reloads = 0;
+    auto begin = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(); };
+    while (elapsed() < seconds) {
+        // release about a tenth, then refill up to a size that moves around
+        for (size_t i = 0; i < hairs.size(); ) {
+            if (rng() % 10 == 0) {
+                hwInstanceRelease(hairs[i].instance);
+                hwAssetRelease(hairs[i].asset);
+                hairs[i] = hairs.back();
+                hairs.pop_back();
+                ++releases;
+            }
+            else {
+                ++i;
+            }
+        }
+        int target = (int)(rng() % max_instances) + 1;
+        while ((int)hairs.size() < target) {
+            // one asset reference per instance, as HairInstance does. assets are freed with their last instance
+            snprintf(path, sizeof(path), "hwChurnBench%d.apx", (int)(rng() % num_paths));
+            Hair h;
+            h.asset = hwAssetLoadFromFile(path);
+            h.instance = hwInstanceCreate(h.asset);
+            hairs.push_back(h);
+            ++creates;
+        }
+        if (frames % 16 == 0) {
+            hwShaderRelease(shader);
+            shader = hwShaderLoadFromFile(shader_path);
+            ++shader_reloads;
+        }
+
+        hwBeginScene(false);
+        for (auto &h : hairs) { hwInstanceUpdateSkinningMatricesAsync(h.instance, num_bones, palette.data(), false); }
+        hwStepSimulation(1.0f / 60.0f, false, false);
+        hwSetViewProjection(0, &view, &proj, 1.0f);
+        hwSetShader(shader, false);
+        for (auto &h : hairs) { hwRender(h.instance, false); }
+        hwEndScene(false);
+        ++frames;
+    }
+    double duration = elapsed();
+    quit = true;
+    render_thread.join();
+
+    for (auto &h : hairs) {
+        hwInstanceRelease(h.instance);
+        hwAssetRelease(h.asset);
+    }
+    hwShaderRelease(shader);
+
+    hwFinalize();
+    hwStubSDKCounters counters;
+    hwStubSDKGetCounters(hwContext::loadSDK(), counters);
+    remove(shader_path);
+
+    printf("%.1f s: %lld frames, %lld flushes, %.0f creates/s, %.0f releases/s, %lld shader reloads\n",
+        duration, (long long)frames, (long long)flushes.load(), creates / duration, releases / duration, (long long)shader_reloads);
+    printf("SDK calls with freed IDs: %lld\n", (long long)counters.stale_id_calls);
+    return counters.stale_id_calls == 0 ? 0 : 1;
+}
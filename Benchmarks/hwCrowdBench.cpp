@@ -0,0 +1,206 @@
+// end to end frames of a synthetic crowd on the stub SDK and the null render device.
+// the game thread records a frame (skinning batch, simulation step, view, lights, draws) and the render thread flushes it,
+// like Unity's render events. reports p50 / p99 CPU time per frame of both sides.
+// usage: hwCrowdBench [instances=10,100,1000,10000] [assets=4] [bones=32] [frames=300] [mono|vr|vr_single] [telemetry]
+// telemetry: publishes to the "hwTelemetry" block (Tools/hwTelemetryReader) to measure what it costs
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+#include <condition_variable>
+#include <thread>
+
+enum Mode { Mode_Mono, Mode_VR, Mode_VRSinglePass };
+static const char *g_mode_names[] = { "mono", "vr", "vr_single" };
+
+static hwStubSDKSettings g_stub_settings;
+static hwSDK* LoadCrowdSDK() { return hwCreateStubSDK(g_stub_settings); }
+
+static hwMatrix Translation(float x, float y, float z)
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    m[12] = x; m[13] = y; m[14] = z;
+    return r;
+}
+
+// left handed, row vectors (D3D)
+static hwMatrix Perspective(float fov_y, float aspect, float zn, float zf)
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    float ys = 1.0f / std::tan(fov_y * 0.5f);
+    m[0] = ys / aspect;
+    m[5] = ys;
+    m[10] = zf / (zf - zn);
+    m[11] = 1.0f;
+    m[14] = -zn * zf / (zf - zn);
+    return r;
+}
+
+struct Percentiles { double p50, p99, max; };
+
+static Percentiles Summarize(std::vector<double> us)
+{
+    std::sort(us.begin(), us.end());
+    auto at = [&](double p) { return us[std::min((size_t)(p * us.size()), us.size() - 1)]; };
+    return { at(0.5), at(0.99), us.back() };
+}
+
+// one frame in flight: the game thread records frame f + 1 only after the render thread flushed frame f,
+// the view segments and the skinning ring are not double buffered
+class FrameHandoff
+{
+public:
+    void submit() { std::unique_lock<std::mutex> l(m_mutex); m_pending = true; m_cond.notify_all(); }
+    void quit() { std::unique_lock<std::mutex> l(m_mutex); m_quit = true; m_cond.notify_all(); }
+    bool waitSubmit() { std::unique_lock<std::mutex> l(m_mutex); m_cond.wait(l, [&]() { return m_pending || m_quit; }); return m_pending; }
+    void done() { std::unique_lock<std::mutex> l(m_mutex); m_pending = false; m_cond.notify_all(); }
+    void waitDone() { std::unique_lock<std::mutex> l(m_mutex); m_cond.wait(l, [&]() { return !m_pending; }); }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_pending = false;
+    bool m_quit = false;
+};
+
+static void RunCrowd(int num_instances, int num_assets, int num_bones, int num_frames, Mode mode, bool telemetry)
+{
+    g_stub_settings.num_bones = num_bones;
+    hwContext::setSDKLoader(&LoadCrowdSDK);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwCrowdBench: failed to initialize.\n");
+        return;
+    }
+    hwContext *ctx = hwGetContext();
+    if (telemetry) { hwTelemetryOpen(nullptr, num_instances); }
+    bool vr = mode != Mode_Mono;
+    bool single_pass = mode == Mode_VRSinglePass;
+    hwEnableVRRendering(vr);
+
+    std::vector<hwHAsset> assets(num_assets);
+    char path[64];
+    for (int i = 0; i < num_assets; ++i) {
+        snprintf(path, sizeof(path), "crowd%d.apx", i);
+        assets[i] = hwAssetLoadFromFile(path);
+    }
+
+    // a grid in front of the camera, 1.5m apart. the far rows fall asleep, the outer columns get culled
+    int side = std::max((int)std::ceil(std::sqrt((float)num_instances)), 1);
+    std::vector<hwHInstance> instances(num_instances);
+    std::vector<hwSkinningBatchEntry> entries(num_instances);
+    std::vector<hwMatrix> world(num_instances * num_bones);
+    std::vector<hwFloat3> positions(num_instances);
+    for (int i = 0; i < num_instances; ++i) {
+        instances[i] = hwInstanceCreate(assets[i % num_assets]);
+        entries[i] = { instances[i], i * num_bones, num_bones, hwSkinningFlag_InvBindPose };
+        positions[i] = { (i % side - side * 0.5f) * 1.5f, 0.0f, 3.0f + (i / side) * 1.5f };
+    }
+
+    hwMatrix view = Translation(0.0f, -1.0f, 0.0f);
+    hwMatrix view2 = Translation(-0.064f, -1.0f, 0.0f);
+    hwMatrix proj = Perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    hwLightData lights[4];
+    for (int li = 0; li < 4; ++li) {
+        lights[li].type = li == 0 ? hwELightType_Directional : hwELightType_Point;
+        lights[li].direction = { 0.0f, -1.0f, 1.0f, 0.0f };
+        lights[li].position = { li * 4.0f - 6.0f, 3.0f, 8.0f, 20.0f };
+    }
+    const float dt = 1.0f / 60.0f;
+    const int warmup = std::min(num_frames / 10, 30);
+
+    std::vector<double> game_us, render_us;
+    FrameHandoff handoff;
+    std::thread render_thread([&]() {
+        int frame = 0;
+        while (handoff.waitSubmit()) {
+            auto begin = std::chrono::steady_clock::now();
+            if (mode == Mode_Mono) { ctx->flushView(0); }
+            else if (mode == Mode_VR) { ctx->flushVR(); ctx->flushVR(); } // one pass per eye
+            else { ctx->flushVRSinglePass(); }
+            auto end = std::chrono::steady_clock::now();
+            if (frame++ >= warmup) { render_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count()); }
+            handoff.done();
+        }
+    });
+
+    for (int frame = 0; frame < num_frames; ++frame) {
+        // animation, not part of the plugin's cost
+        float t = frame * dt;
+        for (int i = 0; i < num_instances; ++i) {
+            const auto &p = positions[i];
+            for (int bi = 0; bi < num_bones; ++bi) {
+                world[i * num_bones + bi] = Translation(p.x + 0.05f * std::sin(t * 3.0f + bi * 0.2f), p.y + bi * 0.05f, p.z);
+            }
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        hwBeginScene(vr);
+        hwUpdateSkinningBatch(num_instances, entries.data(), world.data(), vr);
+        hwStepSimulation(dt, vr, single_pass);
+        if (vr) { hwSetViewProjectionStereo(&view, &proj, &view2, &proj, 1.0f, single_pass); }
+        else { hwSetViewProjection(0, &view, &proj, 1.0f); }
+        hwSetLights(4, lights, vr);
+        for (auto hi : instances) { hwRender(hi, vr); }
+        hwEndScene(vr);
+        auto end = std::chrono::steady_clock::now();
+        if (frame >= warmup) { game_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count()); }
+
+        handoff.submit();
+        handoff.waitDone();
+    }
+    handoff.quit();
+    render_thread.join();
+
+    hwStats stats;
+    hwGetStats(&stats);
+    auto g = Summarize(game_us);
+    auto r = Summarize(render_us);
+    printf("%-9s %7d %6d %5d | game p50 %9.1f p99 %9.1f max %9.1f | render p50 %9.1f p99 %9.1f max %9.1f | culled %5.1f%% sleeping %d%s\n",
+        g_mode_names[mode], num_instances, num_assets, num_bones, g.p50, g.p99, g.max, r.p50, r.p99, r.max,
+        100.0 * stats.num_draws_culled / std::max<int64_t>((int64_t)num_instances * num_frames * (mode == Mode_VR ? 2 : 1), 1),
+        stats.num_sleeping_instances,
+        // hwContext::NUM_BUFFER_BONES_MATRIX. palettes beyond it are dropped for the frame
+        num_instances * num_bones > 16384 ? "  (skinning ring overflow)" : "");
+    fflush(stdout);
+
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+    for (auto ha : assets) { hwAssetRelease(ha); }
+    hwFinalize();
+    hwUnloadHairWorks();
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> counts;
+    {
+        const char *list = argc > 1 ? argv[1] : "10,100,1000,10000";
+        for (const char *p = list; *p; ) {
+            counts.push_back(std::max(std::atoi(p), 1));
+            p = std::strchr(p, ',');
+            if (!p) { break; }
+            ++p;
+        }
+    }
+    int num_assets = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 4;
+    int num_bones = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 32;
+    int num_frames = argc > 4 ? std::max(std::atoi(argv[4]), 10) : 300;
+    Mode mode = Mode_Mono;
+    if (argc > 5) {
+        for (int m = 0; m < 3; ++m) {
+            if (std::strcmp(argv[5], g_mode_names[m]) == 0) { mode = (Mode)m; }
+        }
+    }
+
+    bool telemetry = argc > 6 && std::strcmp(argv[6], "telemetry") == 0;
+
+    printf("times in microseconds per frame, %d frames\n", num_frames);
+    printf("mode      instances assets bones\n");
+    for (int n : counts) {
+        RunCrowd(n, num_assets, num_bones, num_frames, mode, telemetry);
+    }
+}
@@ -0,0 +1,370 @@
+// cost of one frame recorded as a frame packet (hwSubmitFrame()) against the same frame as individual calls, and of
+// hwFramePacketValidate() alone, at 1 to max_instances instances, on the stub SDK and the null render device.
+// prints JSON like hwHotPathBench.
+// fuzz mode mutates valid packets (bit flips, truncation, rewritten sizes and counts) and submits them: what is
+// rejected must be what hwFramePacketValidate() rejects, and what is accepted is flushed.
+// configure with -DHW_SANITIZE=address to have ASan check the parser and the dispatch while this runs.
+// usage: hwFramePacketBench [max_instances=10000] [repeat=5] [label]
+//        hwFramePacketBench fuzz [iterations=200000] [seed=1]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwFramePacket.h"
+#include <random>
+
+static hwMatrix Identity()
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    return r;
+}
+
+// packet in uint32_t so that it is 4 byte aligned
+class PacketWriter
+{
+public:
+    void begin(uint32_t flags)
+    {
+        m_data.assign(sizeof(hwFramePacketHeader) / 4, 0);
+        header().magic = hwFramePacketMagic;
+        header().version = hwFramePacketVersion;
+        header().flags = flags;
+    }
+
+    // payload of size bytes, to be filled by the caller
+    char* record(uint32_t type, size_t size)
+    {
+        size_t pos = m_data.size();
+        m_data.resize(pos + (sizeof(hwFramePacketRecord) + size + 3) / 4, 0);
+        hwFramePacketRecord r = { type, (uint32_t)size };
+        memcpy(&m_data[pos], &r, sizeof(r));
+        ++header().num_records;
+        return (char*)&m_data[pos] + sizeof(r);
+    }
+
+    template<class T>
+    char* record(uint32_t type, const T &fixed, size_t extra = 0)
+    {
+        char *p = record(type, sizeof(T) + extra);
+        memcpy(p, &fixed, sizeof(T));
+        return p + sizeof(T);
+    }
+
+    void end() { header().size = (uint32_t)size(); }
+
+    const void* data() const { return m_data.data(); }
+    size_t size() const { return m_data.size() * 4; }
+    std::vector<uint32_t>& words() { return m_data; }
+
+private:
+    hwFramePacketHeader& header() { return *(hwFramePacketHeader*)m_data.data(); }
+    std::vector<uint32_t> m_data;
+};
+
+// what HairInstance records: one skinning batch and a step, then the camera, lights, shader and draws
+struct Frame
+{
+    std::vector<hwSkinningBatchEntry> entries;
+    std::vector<hwMatrix> palette;
+    std::vector<hwHInstance> instances;
+    std::vector<hwLightData> lights;
+    hwMatrix view, proj;
+    hwHShader shader;
+
+    void write(PacketWriter &w) const
+    {
+        w.begin(0);
+        hwFPSkinning skinning = { (int)entries.size(), (int)palette.size() };
+        char *p = w.record(hwFPRecord_Skinning, skinning, sizeof(hwSkinningBatchEntry) * entries.size() + sizeof(hwMatrix) * palette.size());
+        memcpy(p, entries.data(), sizeof(hwSkinningBatchEntry) * entries.size());
+        memcpy(p + sizeof(hwSkinningBatchEntry) * entries.size(), palette.data(), sizeof(hwMatrix) * palette.size());
+        w.record(hwFPRecord_Step, hwFPStep { 1.0f / 60.0f });
+        w.record(hwFPRecord_ViewProjection, hwFPViewProjection { 0, 60.0f, view, proj });
+        hwFPLights l = { (int)lights.size(), {} };
+        memcpy(w.record(hwFPRecord_Lights, l, sizeof(hwLightData) * lights.size()), lights.data(), sizeof(hwLightData) * lights.size());
+        w.record(hwFPRecord_Shader, hwFPShader { shader });
+        hwFPDraws draws = { (int)instances.size(), 0 };
+        memcpy(w.record(hwFPRecord_Draws, draws, sizeof(hwHInstance) * instances.size()), instances.data(), sizeof(hwHInstance) * instances.size());
+        // a parameter tweak, as from OnValidate()
+        if (!instances.empty()) {
+            float stiffness = 0.5f;
+            hwFPDescriptorField f = { instances[0], (int)offsetof(hwHairDescriptor, m_stiffness), (int)sizeof(float) };
+            memcpy(w.record(hwFPRecord_DescriptorField, f, sizeof(float)), &stiffness, sizeof(float));
+        }
+        w.end();
+    }
+
+    void call() const
+    {
+        hwBeginScene(false);
+        hwUpdateSkinningBatch((int)entries.size(), entries.data(), palette.data(), false);
+        hwStepSimulation(1.0f / 60.0f, false, false);
+        hwSetViewProjection(0, &view, &proj, 60.0f);
+        hwSetLights((int)lights.size(), lights.data(), false);
+        hwSetShader(shader, false);
+        for (auto hi : instances) { hwRender(hi, false); }
+        if (!instances.empty()) {
+            float stiffness = 0.5f;
+            hwInstanceSetDescriptorField(instances[0], (int)offsetof(hwHairDescriptor, m_stiffness), (int)sizeof(float), &stiffness);
+        }
+        hwEndScene(false);
+    }
+};
+
+static Frame MakeFrame(const std::vector<hwHInstance> &instances, hwHShader shader, int num_bones)
+{
+    Frame f;
+    f.instances = instances;
+    f.palette.assign(instances.size() * num_bones, Identity());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        f.entries.push_back({ instances[i], (int)i * num_bones, num_bones, 0 });
+    }
+    f.lights.resize(hwMaxLights);
+    f.view = f.proj = Identity();
+    f.shader = shader;
+    return f;
+}
+
+
+struct Result
+{
+    const char *name;
+    const char *path;
+    int instances;
+    size_t bytes;       // of the packet
+    double best_ns;     // per frame
+    double median_ns;
+};
+
+template<class Setup, class F>
+static Result Measure(const char *name, const char *path, int instances, size_t bytes, int repeat, const Setup &setup, const F &f)
+{
+    std::vector<double> ns;
+    for (int r = 0; r < repeat; ++r) {
+        setup();
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        ns.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+    std::sort(ns.begin(), ns.end());
+    return { name, path, instances, bytes, ns.front(), ns[ns.size() / 2] };
+}
+
+static int Bench(int max_instances, int repeat, const char *label, hwHAsset asset, hwHShader shader)
+{
+    hwContext *ctx = hwGetContext();
+    const int num_bones = 32;
+    std::vector<Result> results;
+    for (int n = 1; n <= max_instances; n *= 10) {
+        std::vector<hwHInstance> instances(n);
+        for (auto &hi : instances) { hi = hwInstanceCreate(asset); }
+        Frame frame = MakeFrame(instances, shader, num_bones);
+        PacketWriter w;
+        frame.write(w);
+        auto noop = []() {};
+
+        results.push_back(Measure("validate", "hwFramePacketValidate", n, w.size(), repeat, noop,
+            [&]() { hwFramePacketValidate(w.data(), w.size()); }));
+        results.push_back(Measure("write_packet", "Frame::write (the caller's side)", n, w.size(), repeat, noop,
+            [&]() { frame.write(w); }));
+        results.push_back(Measure("submit_frame", "hwSubmitFrame -> validate + dispatch", n, w.size(), repeat,
+            [&]() { ctx->flush(); },
+            [&]() { hwSubmitFrame(w.data(), (int)w.size()); }));
+        results.push_back(Measure("individual_calls", "hwBeginScene .. hwEndScene", n, w.size(), repeat,
+            [&]() { ctx->flush(); },
+            [&]() { frame.call(); }));
+        ctx->flush();
+
+        for (auto hi : instances) { hwInstanceRelease(hi); }
+        fprintf(stderr, "%d instances done\n", n);
+    }
+
+    printf("{\n");
+    printf("  \"benchmark\": \"hwFramePacketBench\",\n");
+    printf("  \"label\": \"%s\",\n", label);
+    printf("  \"sdk_version\": %d,\n", hwGetSDKVersion());
+    printf("  \"repeat\": %d,\n", repeat);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        printf("    { \"name\": \"%s\", \"path\": \"%s\", \"instances\": %d, \"bytes\": %zu, \"best_ns\": %.1f, \"median_ns\": %.1f, \"best_mb_per_s\": %.1f }%s\n",
+            r.name, r.path, r.instances, r.bytes, r.best_ns, r.median_ns, r.bytes * 1000.0 / std::max(r.best_ns, 1.0),
+            i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+    return 0;
+}
+
+
+// a valid packet of every record type, some with stale handles, VR flags at random. the view record is the one the
+// flags allow
+static void WriteSeed(PacketWriter &w, std::mt19937 &rng, const std::vector<hwHInstance> &instances, hwHShader shader)
+{
+    const uint32_t flag_sets[] = { 0, hwFramePacketFlag_VR, hwFramePacketFlag_VR | hwFramePacketFlag_SinglePassVR };
+    uint32_t flags = flag_sets[rng() % 3];
+    w.begin(flags);
+    auto instance = [&]() { return rng() % 8 == 0 ? (hwHInstance)(rng() % 100000) : instances[rng() % instances.size()]; };
+    hwMatrix m = Identity();
+
+    int num_records = 1 + rng() % 12;
+    for (int i = 0; i < num_records; ++i) {
+        switch (1 + rng() % 8) {
+        case hwFPRecord_ViewProjection:
+        case hwFPRecord_ViewProjectionStereo:
+            if (flags & hwFramePacketFlag_VR) {
+                w.record(hwFPRecord_ViewProjectionStereo, hwFPViewProjectionStereo { 90.0f, (int)(rng() % 2), m, m, m, m });
+            }
+            else {
+                w.record(hwFPRecord_ViewProjection, hwFPViewProjection { (int)(rng() % hwMaxViews), 60.0f, m, m });
+            }
+            break;
+        case hwFPRecord_Lights: {
+            hwFPLights l = { (int)(rng() % (hwMaxLights + 1)), {} };
+            char *p = w.record(hwFPRecord_Lights, l, sizeof(hwLightData) * l.num_lights);
+            memset(p, 0, sizeof(hwLightData) * l.num_lights);
+            break;
+        }
+        case hwFPRecord_Shader:
+            w.record(hwFPRecord_Shader, hwFPShader { rng() % 4 ? shader : (hwHShader)(rng() % 100) });
+            break;
+        case hwFPRecord_Skinning: {
+            hwFPSkinning s = { (int)(rng() % 4), 0 };
+            std::vector<hwSkinningBatchEntry> entries(s.num_entries);
+            for (auto &e : entries) {
+                e = { instance(), s.num_matrices, (int)(rng() % 40), (int)(rng() % 2) };
+                s.num_matrices += e.num_bones;
+            }
+            char *p = w.record(hwFPRecord_Skinning, s, sizeof(hwSkinningBatchEntry) * s.num_entries + sizeof(hwMatrix) * s.num_matrices);
+            memcpy(p, entries.data(), sizeof(hwSkinningBatchEntry) * s.num_entries);
+            for (int b = 0; b < s.num_matrices; ++b) { memcpy(p + sizeof(hwSkinningBatchEntry) * s.num_entries + sizeof(hwMatrix) * b, &m, sizeof(m)); }
+            break;
+        }
+        case hwFPRecord_DescriptorField: {
+            int size = 1 + rng() % 16;
+            hwFPDescriptorField f = { instance(), (int)(rng() % (sizeof(hwHairDescriptor) - size + 1)), size };
+            memset(w.record(hwFPRecord_DescriptorField, f, size), 0, size);
+            break;
+        }
+        case hwFPRecord_Step:
+            w.record(hwFPRecord_Step, hwFPStep { 1.0f / 60.0f });
+            break;
+        case hwFPRecord_Draws: {
+            hwFPDraws d = { (int)(rng() % 8), (int)(rng() % 2) };
+            char *p = w.record(hwFPRecord_Draws, d, sizeof(hwHInstance) * d.num_instances);
+            for (int j = 0; j < d.num_instances; ++j) { hwHInstance hi = instance(); memcpy(p + sizeof(hi) * j, &hi, sizeof(hi)); }
+            break;
+        }
+        }
+    }
+    w.end();
+}
+
+static void Mutate(std::vector<char> &bytes, std::mt19937 &rng)
+{
+    auto word = [&]() -> uint32_t* { return (uint32_t*)bytes.data() + rng() % (bytes.size() / 4); };
+    const uint32_t interesting[] = { 0, 1, 3, 4, 0x7fffffff, 0x80000000, 0xffffffff, 0xfffffffc, hwMaxLights + 1, hwMaxViews };
+
+    int num_mutations = 1 + rng() % 4;
+    for (int i = 0; i < num_mutations; ++i) {
+        switch (rng() % 6) {
+        case 0: bytes[rng() % bytes.size()] ^= (char)(1 << (rng() % 8)); break;
+        case 1: *word() = interesting[rng() % (sizeof(interesting) / sizeof(interesting[0]))]; break;
+        case 2: *word() += (uint32_t)(rng() % 9) - 4; break;
+        // truncation, with and without the header size following it
+        case 3: bytes.resize(rng() % bytes.size() / 4 * 4 + 4); break;
+        case 4:
+            bytes.resize(rng() % bytes.size() / 4 * 4 + 4);
+            if (bytes.size() >= sizeof(hwFramePacketHeader)) { ((hwFramePacketHeader*)bytes.data())->size = (uint32_t)bytes.size(); }
+            break;
+        // trailing garbage
+        case 5: bytes.resize(bytes.size() + 4 * (1 + rng() % 8), (char)rng()); break;
+        }
+        if (bytes.size() < 4) { bytes.resize(4); }
+    }
+}
+
+static int Fuzz(int64_t iterations, uint32_t seed, hwHAsset asset, hwHShader shader)
+{
+    hwContext *ctx = hwGetContext();
+    std::mt19937 rng(seed);
+    std::vector<hwHInstance> instances(16);
+    for (auto &hi : instances) { hi = hwInstanceCreate(asset); }
+
+    PacketWriter w;
+    std::vector<uint32_t> words;
+    std::vector<char> bytes;
+    int64_t accepted = 0, rejected = 0, mismatches = 0;
+    for (int64_t i = 0; i < iterations; ++i) {
+        WriteSeed(w, rng, instances, shader);
+        bytes.assign((const char*)w.data(), (const char*)w.data() + w.size());
+        // a few go through unchanged so that the dispatch of every record type is covered too
+        if (rng() % 8 != 0) { Mutate(bytes, rng); }
+        words.assign((bytes.size() + 3) / 4, 0);
+        memcpy(words.data(), bytes.data(), bytes.size());
+
+        bool valid = hwFramePacketValidate(words.data(), bytes.size());
+        bool submitted = hwSubmitFrame(words.data(), (int)bytes.size());
+        if (valid != submitted) { ++mismatches; }
+        if (submitted) { ++accepted; } else { ++rejected; }
+
+        if (i % 64 == 63) {
+            ctx->flush();
+            ctx->flushVR();
+            ctx->flushVRSinglePass();
+        }
+    }
+    ctx->flush();
+    ctx->flushVR();
+    ctx->flushVRSinglePass();
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+
+    hwStats stats;
+    hwGetStats(&stats);
+    printf("{ \"benchmark\": \"hwFramePacketBench\", \"mode\": \"fuzz\", \"seed\": %u, \"iterations\": %lld, \"accepted\": %lld, "
+        "\"rejected\": %lld, \"mismatches\": %lld, \"num_frame_packets\": %d, \"num_frame_packets_rejected\": %d }\n",
+        seed, (long long)iterations, (long long)accepted, (long long)rejected, (long long)mismatches,
+        stats.num_frame_packets, stats.num_frame_packets_rejected);
+    return mismatches == 0 && stats.num_frame_packets == accepted && stats.num_frame_packets_rejected == rejected ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool fuzz = argc > 1 && std::strcmp(argv[1], "fuzz") == 0;
+    const char *shader_path = "hwFramePacketBench.cso";
+    {
+        // the null device takes any bytes as a pixel shader
+        std::ofstream f(shader_path, std::ios::binary);
+        f << "hwFramePacketBench";
+    }
+
+    // every rejected packet logs an error
+    if (fuzz) { hwSetLogLevel(hwLogLevel_Error + 1); }
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwFramePacketBench: failed to initialize.\n");
+        return 1;
+    }
+    hwHAsset asset = hwAssetLoadFromFile("hwFramePacketBench.apx");
+    hwHShader shader = hwShaderLoadFromFile(shader_path);
+
+    int r;
+    if (fuzz) {
+        int64_t iterations = argc > 2 ? std::max(std::atoll(argv[2]), 1LL) : 200000;
+        uint32_t seed = argc > 3 ? (uint32_t)std::strtoul(argv[3], nullptr, 10) : 1;
+        r = Fuzz(iterations, seed, asset, shader);
+    }
+    else {
+        int max_instances = argc > 1 ? std::atoi(argv[1]) : 10000;
+        int repeat = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 5;
+        const char *label = argc > 3 ? argv[3] : "";
+        r = Bench(max_instances, repeat, label, asset, shader);
+    }
+    hwShaderRelease(shader);
+    hwAssetRelease(asset);
+    hwFinalize();
+    return r;
+}
@@ -0,0 +1,201 @@
+// per call cost of the plugin's hot paths at 1 to max_instances instances, on the stub SDK and the null render device.
+// prints JSON so runs of different plugin versions can be diffed.
+// usage: hwHotPathBench [max_instances=10000] [repeat=5] [label]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwTrace.h"
+#include <cinttypes>
+
+struct Result
+{
+    const char *name;
+    const char *path;   // what it goes through
+    int instances;
+    int ops;            // calls per repeat
+    double best_ns;     // per call
+    double median_ns;   // per call
+};
+
+// setup() is not timed. f() makes ops calls
+template<class Setup, class F>
+static Result Measure(const char *name, const char *path, int instances, int ops, int repeat, const Setup &setup, const F &f)
+{
+    std::vector<double> ns;
+    for (int r = 0; r < repeat; ++r) {
+        setup();
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        ns.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / std::max(ops, 1));
+    }
+    std::sort(ns.begin(), ns.end());
+    return { name, path, instances, ops, ns.front(), ns[ns.size() / 2] };
+}
+
+static hwTexture* FakeTexture(int i)
+{
+    // the null device never dereferences textures
+    return reinterpret_cast<hwTexture*>((uintptr_t)(i + 1) * 64);
+}
+
+int main(int argc, char *argv[])
+{
+    int max_instances = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int repeat = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 5;
+    const char *label = argc > 3 ? argv[3] : "";
+    const int num_bones = 32;
+
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwHotPathBench: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwHAsset asset = hwAssetLoadFromFile("hwHotPathBench.apx");
+
+    hwLightData lights[hwMaxLights];
+    std::vector<hwMatrix> palette(num_bones);
+    for (auto &m : palette) { float *d = hwMatrixData(m); std::fill(d, d + 16, 0.0f); d[0] = d[5] = d[10] = d[15] = 1.0f; }
+    int frame = 0;
+
+    std::vector<Result> results;
+
+    // a hwTraceScoped() marker on a hot path while tracing is off (the shipping case), and on while capturing
+    {
+        const int ops = 1 << 22;
+        volatile int sink = 0;
+        auto markers = [&]() {
+            for (int i = 0; i < ops; ++i) {
+                hwTraceScoped("hwHotPathBench");
+                sink = sink + 1;
+            }
+        };
+        auto baseline = [&]() {
+            for (int i = 0; i < ops; ++i) { sink = sink + 1; }
+        };
+        results.push_back(Measure("trace_baseline", "loop without a marker", 0, ops, repeat, []() {}, baseline));
+        results.push_back(Measure("trace_disabled", "hwTraceScoped -> g_hw_trace_enabled", 0, ops, repeat, []() {}, markers));
+        hwTraceStart();
+        results.push_back(Measure("trace_enabled", "hwTraceScoped -> hwTraceRecord", 0, ops, repeat, []() {}, markers));
+        hwTraceStop();
+    }
+
+    for (int n = 1; n <= max_instances; n *= 10) {
+        std::vector<hwHInstance> instances(n);
+        for (auto &hi : instances) { hi = hwInstanceCreate(asset); }
+        auto noop = []() {};
+
+        // pushDeferredCall(): draws recorded into the frame segment, played back by flush()
+        results.push_back(Measure("record_render", "hwRender -> pushDeferredCall", n, n, repeat,
+            [&]() { ctx->flush(); },
+            [&]() {
+                hwBeginScene(false);
+                for (auto hi : instances) { hwRender(hi, false); }
+                hwEndScene(false);
+            }));
+        results.push_back(Measure("flush_render", "hwContext::flush -> renderImpl", n, n, repeat,
+            [&]() {
+                hwBeginScene(false);
+                for (auto hi : instances) { hwRender(hi, false); }
+                hwEndScene(false);
+            },
+            [&]() { ctx->flush(); }));
+
+        // addBoneMatricesToBuffer(): the palette changes every frame so the unchanged palette check never skips.
+        // at most what the bone matrix ring holds until the next flush (hwContext::NUM_BUFFER_BONES_MATRIX), past it they
+        // are dropped
+        const int num_skinned = std::min(n, 16384 / num_bones);
+        results.push_back(Measure("skinning_async", "hwInstanceUpdateSkinningMatricesAsync -> addBoneMatricesToBuffer", n, num_skinned, repeat,
+            [&]() { ctx->flush(); },
+            [&]() {
+                hwBeginScene(false);
+                for (int i = 0; i < num_skinned; ++i) {
+                    hwMatrixData(palette[0])[12] = (float)++frame;
+                    hwInstanceUpdateSkinningMatricesAsync(instances[i], num_bones, palette.data(), false);
+                }
+                hwEndScene(false);
+            }));
+        ctx->flush();
+
+        results.push_back(Measure("instance_lookup", "hwInstanceGetBounds -> m_instances", n, n, repeat, noop,
+            [&]() {
+                hwFloat3 bmin, bmax;
+                for (auto hi : instances) { hwInstanceGetBounds(hi, &bmin, &bmax); }
+            }));
+
+        // one light list per instance, as with per object light selection
+        results.push_back(Measure("set_lights", "hwSetLights -> pushDeferredCall", n, n, repeat,
+            [&]() { ctx->flush(); },
+            [&]() {
+                hwBeginScene(false);
+                for (int i = 0; i < n; ++i) { hwSetLights(hwMaxLights, lights, false); }
+                hwEndScene(false);
+            }));
+        ctx->flush();
+
+        // an unchanged descriptor every frame: the whole struct per instance through the setter (HairInstance before mapped
+        // blocks), against comparing it with the mapped block as HairInstance does, which leaves unchanged blocks alone so
+        // that hwBeginScene() only scans the dirty flags. the P/Invoke copy the mapped path also saves is not in either
+        hwHairDescriptor desc;
+        hwInstanceGetDescriptor(instances[0], &desc);
+        results.push_back(Measure("set_descriptor", "hwInstanceSetDescriptor -> memcmp", n, n, repeat, noop,
+            [&]() {
+                for (auto hi : instances) { hwInstanceSetDescriptor(hi, &desc); }
+            }));
+        std::vector<hwDescriptorBlock*> blocks(n);
+        for (int i = 0; i < n; ++i) { blocks[i] = hwInstanceMapDescriptor(instances[i]); }
+        results.push_back(Measure("mapped_descriptor", "hwInstanceMapDescriptor -> syncDescriptorBlocks", n, n, repeat, noop,
+            [&]() {
+                for (auto *b : blocks) {
+                    if (!hwDescriptorEqual(b->desc, desc)) { b->desc = desc; b->dirty = 1; }
+                }
+                hwBeginScene(false);
+                hwEndScene(false);
+            }));
+        ctx->flush();
+
+        // getSRV() cache hits: every instance has its own texture, all of them already have views
+        for (int i = 0; i < n; ++i) { hwInstanceSetTexture(instances[i], GFSDK_HAIR_TEXTURE_ROOT_COLOR, FakeTexture(i)); }
+        results.push_back(Measure("srv_cache_hit", "hwInstanceSetTexture -> getSRV", n, n, repeat, noop,
+            [&]() {
+                for (int i = 0; i < n; ++i) { hwInstanceSetTexture(instances[i], GFSDK_HAIR_TEXTURE_ROOT_COLOR, FakeTexture(i)); }
+            }));
+
+        // assetLoadFromFile() of already loaded paths with n assets in the table
+        std::vector<std::string> paths(n);
+        std::vector<hwHAsset> assets(n);
+        char buf[64];
+        for (int i = 0; i < n; ++i) {
+            snprintf(buf, sizeof(buf), "hwHotPathBench%d.apx", i);
+            paths[i] = buf;
+            assets[i] = hwAssetLoadFromFile(buf);
+        }
+        int loads = 0;
+        results.push_back(Measure("asset_dedupe", "hwAssetLoadFromFile -> m_assets", n, n, repeat, noop,
+            [&]() {
+                for (auto &p : paths) { hwAssetLoadFromFile(p.c_str()); ++loads; }
+            }));
+        for (auto ha : assets) {
+            for (int i = 0; i < 1 + loads / n; ++i) { hwAssetRelease(ha); }
+        }
+
+        for (auto hi : instances) { hwInstanceRelease(hi); }
+        fprintf(stderr, "%d instances done\n", n);
+    }
+    hwAssetRelease(asset);
+    hwFinalize();
+
+    printf("{\n");
+    printf("  \"benchmark\": \"hwHotPathBench\",\n");
+    printf("  \"label\": \"%s\",\n", label);
+    printf("  \"sdk_version\": %d,\n", hwGetSDKVersion());
+    printf("  \"repeat\": %d,\n", repeat);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        printf("    { \"name\": \"%s\", \"path\": \"%s\", \"instances\": %d, \"ops\": %d, \"best_ns\": %.1f, \"median_ns\": %.1f }%s\n",
+            r.name, r.path, r.instances, r.ops, r.best_ns, r.median_ns, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
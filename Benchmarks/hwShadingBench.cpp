@@ -0,0 +1,113 @@
+// throughput of hwShadeHairSSE() against the scalar reference, and the largest difference between the two.
+// usage: hwShadingBench [num_samples] [num_lights]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwShading.h"
+#include <random>
+
+struct SoA
+{
+    std::vector<float> data[15];
+
+    void resize(int n) { for (auto &d : data) { d.resize(n); } }
+    hwHairShadingSamples samples(int n) const
+    {
+        auto p = [&](int i) { return data[i].data(); };
+        return { n, p(0), p(1), p(2), p(3), p(4), p(5), p(6), p(7), p(8), p(9), p(10), p(11), p(12), p(13), p(14) };
+    }
+};
+
+static void RandomUnit(std::mt19937 &rng, float *x, float *y, float *z)
+{
+    std::normal_distribution<float> nd;
+    float a = nd(rng), b = nd(rng), c = nd(rng);
+    float l = std::sqrt(a * a + b * b + c * c);
+    *x = a / l; *y = b / l; *z = c / l;
+}
+
+template<class F>
+static double MeasureNS(int repeat, const F &f)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeat; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int num = argc > 1 ? std::atoi(argv[1]) : 1 << 18;
+    int num_lights = argc > 2 ? std::min(std::atoi(argv[2]), hwMaxLights) : 4;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> ud(0.0f, 1.0f);
+
+    SoA in;
+    in.resize(num);
+    for (int i = 0; i < num; ++i) {
+        in.data[0][i] = ud(rng) * 2.0f - 1.0f;
+        in.data[1][i] = ud(rng) * 2.0f;
+        in.data[2][i] = ud(rng) * 2.0f - 1.0f;
+        RandomUnit(rng, &in.data[3][i], &in.data[4][i], &in.data[5][i]);
+        RandomUnit(rng, &in.data[6][i], &in.data[7][i], &in.data[8][i]);
+        RandomUnit(rng, &in.data[9][i], &in.data[10][i], &in.data[11][i]);
+        for (int c = 12; c < 15; ++c) { in.data[c][i] = ud(rng); }
+    }
+
+    // half directional, half point lights around the samples
+    hwLightData lights[hwMaxLights];
+    for (int li = 0; li < num_lights; ++li) {
+        auto &l = lights[li];
+        if (li % 2 == 0) {
+            l.type = hwELightType_Directional;
+            RandomUnit(rng, &l.direction.x, &l.direction.y, &l.direction.z);
+        }
+        else {
+            l.type = hwELightType_Point;
+            l.position = { ud(rng) * 4.0f - 2.0f, ud(rng) * 4.0f, ud(rng) * 4.0f - 2.0f, 5.0f };
+        }
+        l.color = { ud(rng), ud(rng), ud(rng), 1.0f };
+    }
+
+    hwHairShadingMaterial mat;
+    mat.specular_color = { 0.9f, 0.85f, 0.8f };
+    mat.diffuse_blend = 0.5f;
+    mat.primary_scale = 0.1f;
+    mat.primary_power = 100.0f;
+    mat.secondary_scale = 0.05f;
+    mat.secondary_power = 20.0f;
+    mat.secondary_offset = 0.1f;
+
+    std::vector<float> ref[3], out[3];
+    for (int c = 0; c < 3; ++c) { ref[c].resize(num); out[c].resize(num); }
+    hwHairShadingOutput oref = { ref[0].data(), ref[1].data(), ref[2].data() };
+    hwHairShadingOutput oout = { out[0].data(), out[1].data(), out[2].data() };
+    auto s = in.samples(num);
+
+    const int repeat = 5;
+    double scalar_ns = MeasureNS(repeat, [&]() { hwShadeHairScalar(s, mat, lights, num_lights, oref); });
+    double sse_ns = MeasureNS(repeat, [&]() { hwShadeHairSSE(s, mat, lights, num_lights, oout); });
+
+    double max_abs = 0.0, max_rel = 0.0;
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < num; ++i) {
+            double d = std::abs((double)out[c][i] - ref[c][i]);
+            max_abs = std::max(max_abs, d);
+            max_rel = std::max(max_rel, d / std::max(std::abs((double)ref[c][i]), 1e-3));
+        }
+    }
+
+    double ref_samples = (double)num * std::max(num_lights, 1);
+    printf("samples: %d, lights: %d\n", num, num_lights);
+    printf("  scalar: %8.2f ns/sample/light  %8.1f Msamples/s\n", scalar_ns / ref_samples, num / scalar_ns * 1e3);
+    printf("  SSE   : %8.2f ns/sample/light  %8.1f Msamples/s  (x%.2f)\n", sse_ns / ref_samples, num / sse_ns * 1e3, scalar_ns / sse_ns);
+    printf("  max difference: abs %g, rel %g\n", max_abs, max_rel);
+
+    // the SSE path must stay usable as a reference
+    return max_rel < 1e-3 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// cost of per-thread command buffers (hwBeginThreadRecording()) with 1 to max_threads recording threads, on the stub
+// SDK and the null render device. each frame the main thread begins the scene and sets the view, the workers animate
+// their share of the instances, submit its skinning batch and draws, and hwEndScene() merges the buffers.
+// the threads only run in parallel up to the hardware threads printed first: beyond that the numbers show the
+// overhead of the buffers and the merge, not a speedup.
+// threads = 0 is the same work recorded by the main thread alone. reports p50 / p99 per frame of the recording (workers
+// started to all done), of the merge (hwEndScene()) and of the flush, plus the commands merged per frame.
+// usage: hwThreadRecordingBench [max_threads=16] [instances=2000] [bones=8] [frames=200]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include <condition_variable>
+#include <thread>
+
+static hwMatrix Translation(float x, float y, float z)
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    m[12] = x; m[13] = y; m[14] = z;
+    return r;
+}
+
+struct Percentiles { double p50, p99; };
+
+static Percentiles Summarize(std::vector<double> us)
+{
+    std::sort(us.begin(), us.end());
+    auto at = [&](double p) { return us[std::min((size_t)(p * us.size()), us.size() - 1)]; };
+    return { at(0.5), at(0.99) };
+}
+
+struct Scene
+{
+    std::vector<hwHInstance> instances;
+    int num_bones;
+};
+
+// what a job records for instances [begin, end): animation, one skinning batch, the draws
+static void RecordRange(const Scene &s, int begin, int end, int frame, std::vector<hwSkinningBatchEntry> &entries, std::vector<hwMatrix> &world)
+{
+    int n = end - begin;
+    entries.resize(n);
+    world.resize(n * s.num_bones);
+    float t = frame / 60.0f;
+    for (int i = 0; i < n; ++i) {
+        for (int bi = 0; bi < s.num_bones; ++bi) {
+            world[i * s.num_bones + bi] = Translation(0.05f * std::sin(t * 3.0f + bi * 0.2f), bi * 0.05f, (float)(begin + i));
+        }
+        entries[i] = { s.instances[begin + i], i * s.num_bones, s.num_bones, hwSkinningFlag_MirrorX };
+    }
+    hwUpdateSkinningBatch(n, entries.data(), world.data(), false);
+    for (int i = begin; i < end; ++i) { hwRender(s.instances[i], false); }
+}
+
+// persistent workers, started once per frame
+class Workers
+{
+public:
+    Workers(int n, const std::function<void(int)> &job) : m_job(job)
+    {
+        for (int i = 0; i < n; ++i) {
+            m_threads.emplace_back([this, i]() {
+                uint64_t seen = 0;
+                for (;;) {
+                    {
+                        std::unique_lock<std::mutex> l(m_mutex);
+                        m_cond.wait(l, [&]() { return m_generation != seen || m_quit; });
+                        if (m_quit) { return; }
+                        seen = m_generation;
+                    }
+                    m_job(i);
+                    std::unique_lock<std::mutex> l(m_mutex);
+                    if (--m_running == 0) { m_cond.notify_all(); }
+                }
+            });
+        }
+    }
+
+    ~Workers()
+    {
+        { std::unique_lock<std::mutex> l(m_mutex); m_quit = true; m_cond.notify_all(); }
+        for (auto &t : m_threads) { t.join(); }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_running = (int)m_threads.size();
+        ++m_generation;
+        m_cond.notify_all();
+        m_cond.wait(l, [&]() { return m_running == 0; });
+    }
+
+private:
+    std::function<void(int)> m_job;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    uint64_t m_generation = 0;
+    int m_running = 0;
+    bool m_quit = false;
+};
+
+int main(int argc, char *argv[])
+{
+    int max_threads = argc > 1 ? std::min(std::max(std::atoi(argv[1]), 1), hwMaxRecordingThreads) : 16;
+    int num_instances = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 2000;
+    int num_bones = argc > 3 ? std::max(std::atoi(argv[3]), 1) : 8;
+    int num_frames = argc > 4 ? std::max(std::atoi(argv[4]), 10) : 200;
+    const int warmup = std::min(num_frames / 10, 30);
+
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwThreadRecordingBench: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwHAsset asset = hwAssetLoadFromFile("hwThreadRecordingBench.apx");
+    Scene scene;
+    scene.num_bones = num_bones;
+    for (int i = 0; i < num_instances; ++i) { scene.instances.push_back(hwInstanceCreate(asset)); }
+    hwMatrix view = Translation(0.0f, -1.0f, 0.0f), proj = Translation(0.0f, 0.0f, 0.0f);
+
+    printf("hardware threads %u, %d instances, %d bones%s\n", std::thread::hardware_concurrency(), num_instances, num_bones,
+        // hwContext::NUM_BUFFER_BONES_MATRIX. palettes beyond it are dropped for the frame
+        num_instances * num_bones > 16384 ? "  (skinning ring overflow)" : "");
+    printf("%7s | %-22s | %-22s | %-22s | %s\n", "threads", "record p50 / p99 us", "merge p50 / p99 us", "flush p50 / p99 us", "commands merged");
+
+    std::vector<int> thread_counts = { 0 };
+    for (int n = 1; n <= max_threads; n *= 2) { thread_counts.push_back(n); }
+    if (thread_counts.back() != max_threads) { thread_counts.push_back(max_threads); }
+
+    for (int num_threads : thread_counts) {
+        int frame = 0;
+        std::vector<std::vector<hwSkinningBatchEntry>> entries(std::max(num_threads, 1));
+        std::vector<std::vector<hwMatrix>> world(std::max(num_threads, 1));
+        Workers workers(num_threads, [&](int ti) {
+            hwBeginThreadRecording(false);
+            RecordRange(scene, num_instances * ti / num_threads, num_instances * (ti + 1) / num_threads, frame, entries[ti], world[ti]);
+            hwEndThreadRecording();
+        });
+
+        hwStats before;
+        hwGetStats(&before);
+        std::vector<double> record_us, merge_us, flush_us;
+        for (frame = 0; frame < num_frames; ++frame) {
+            hwBeginScene(false);
+            hwSetViewProjection(0, &view, &proj, 1.0f);
+            auto t0 = std::chrono::steady_clock::now();
+            if (num_threads == 0) { RecordRange(scene, 0, num_instances, frame, entries[0], world[0]); }
+            else { workers.run(); }
+            auto t1 = std::chrono::steady_clock::now();
+            hwEndScene(false);
+            auto t2 = std::chrono::steady_clock::now();
+            ctx->flushView(0);
+            auto t3 = std::chrono::steady_clock::now();
+            if (frame >= warmup) {
+                record_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                merge_us.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+                flush_us.push_back(std::chrono::duration<double, std::micro>(t3 - t2).count());
+            }
+        }
+
+        hwStats after;
+        hwGetStats(&after);
+        auto r = Summarize(record_us), m = Summarize(merge_us), f = Summarize(flush_us);
+        printf("%7d | %9.1f / %9.1f  | %9.1f / %9.1f  | %9.1f / %9.1f  | %d\n", num_threads, r.p50, r.p99, m.p50, m.p99, f.p50, f.p99,
+            (after.num_thread_commands - before.num_thread_commands) / num_frames);
+        fflush(stdout);
+    }
+
+    for (auto hi : scene.instances) { hwInstanceRelease(hi); }
+    hwAssetRelease(asset);
+    hwFinalize();
+}
@@ -0,0 +1,72 @@
+// descriptor comparison: hwEachDescriptorField() lists every member of hwHairDescriptor, and descriptors that only
+// differ in their padding are equal, also for the redundant update check of hwInstanceSetDescriptor()
+#include "hwTest.h"
+#include "hwContext.h"
+
+// each member starts where the previous one ends, rounded up to its alignment. a member missing from the list leaves
+// a gap at least as large as its alignment
+static void TestFieldList(std::vector<bool> &o_padding)
+{
+    o_padding.assign(sizeof(hwHairDescriptor), true);
+    size_t end = 0;
+#define hwCheckField(m)\
+    {\
+        size_t offset = offsetof(hwHairDescriptor, m), align = alignof(decltype(hwHairDescriptor::m));\
+        hwTestCheckEqual(offset, (end + align - 1) / align * align);\
+        end = offset + sizeof(hwHairDescriptor::m);\
+        std::fill(o_padding.begin() + offset, o_padding.begin() + end, false);\
+    }
+    hwEachDescriptorField(hwCheckField)
+#undef hwCheckField
+    size_t align = alignof(hwHairDescriptor);
+    hwTestCheckEqual(sizeof(hwHairDescriptor), (end + align - 1) / align * align);
+}
+
+static void TestPadding(const std::vector<bool> &padding)
+{
+    hwHairDescriptor a, b;
+    memcpy(&b, &a, sizeof(a));
+    int num_padding = 0;
+    for (size_t i = 0; i < padding.size(); ++i) {
+        if (padding[i]) { ((char*)&b)[i] ^= 0x5a; ++num_padding; }
+    }
+    hwTestCheck(hwDescriptorEqual(a, b));
+    hwTestCheck(num_padding == 0 || memcmp(&a, &b, sizeof(a)) != 0);
+    b.m_stiffness += 0.5f;
+    hwTestCheck(!hwDescriptorEqual(a, b));
+
+    // through the redundant update check
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwDescriptorTest: failed to initialize.\n");
+        ++g_hw_test_failures;
+        return;
+    }
+    hwHAsset asset = hwAssetLoadFromFile("hwDescriptorTest.apx");
+    hwHInstance hi = hwInstanceCreate(asset);
+    hwHairDescriptor desc;
+    hwInstanceGetDescriptor(hi, &desc);
+    for (size_t i = 0; i < padding.size(); ++i) {
+        if (padding[i]) { ((char*)&desc)[i] ^= 0x5a; }
+    }
+    hwStats before, after;
+    hwGetStats(&before);
+    hwInstanceSetDescriptor(hi, &desc);
+    desc.m_stiffness += 0.5f;
+    hwInstanceSetDescriptor(hi, &desc);
+    hwGetStats(&after);
+    hwTestCheckEqual(after.num_descriptor_updates_skipped - before.num_descriptor_updates_skipped, 1);
+    hwTestCheckEqual(after.num_descriptor_updates - before.num_descriptor_updates, 1);
+
+    hwInstanceRelease(hi);
+    hwAssetRelease(asset);
+    hwFinalize();
+}
+
+int main()
+{
+    std::vector<bool> padding;
+    TestFieldList(padding);
+    TestPadding(padding);
+    return hwTestResult("hwDescriptorTest");
+}
@@ -0,0 +1,100 @@
+// frame packet validation: view records must match the packet's VR flag, and what hwFramePacketValidate() rejects
+// hwSubmitFrame() rejects before recording any of it.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwFramePacket.h"
+
+// one view record and a step. in uint32_t so that it is 4 byte aligned
+static std::vector<uint32_t> ViewPacket(uint32_t flags, uint32_t type)
+{
+    hwMatrix m;
+    float *f = hwMatrixData(m);
+    std::fill(f, f + 16, 0.0f);
+    f[0] = f[5] = f[10] = f[15] = 1.0f;
+
+    std::vector<char> bytes(sizeof(hwFramePacketHeader));
+    auto record = [&](uint32_t t, const void *payload, uint32_t size) {
+        hwFramePacketRecord r = { t, size };
+        bytes.insert(bytes.end(), (const char*)&r, (const char*)&r + sizeof(r));
+        bytes.insert(bytes.end(), (const char*)payload, (const char*)payload + size);
+        bytes.resize((bytes.size() + 3) & ~(size_t)3);
+    };
+    if (type == hwFPRecord_ViewProjection) {
+        hwFPViewProjection v = { 0, 60.0f, m, m };
+        record(type, &v, sizeof(v));
+    }
+    else {
+        hwFPViewProjectionStereo v = { 90.0f, 0, m, m, m, m };
+        record(type, &v, sizeof(v));
+    }
+    hwFPStep step = { 1.0f / 60.0f };
+    record(hwFPRecord_Step, &step, sizeof(step));
+
+    hwFramePacketHeader h = {};
+    h.magic = hwFramePacketMagic;
+    h.version = hwFramePacketVersion;
+    h.size = (uint32_t)bytes.size();
+    h.num_records = 2;
+    h.flags = flags;
+    memcpy(bytes.data(), &h, sizeof(h));
+
+    std::vector<uint32_t> words(bytes.size() / 4);
+    memcpy(words.data(), bytes.data(), bytes.size());
+    return words;
+}
+
+static bool Validate(const std::vector<uint32_t> &p, std::string *o_error = nullptr)
+{
+    return hwFramePacketValidate(p.data(), p.size() * 4, o_error);
+}
+
+static void TestViewRecords()
+{
+    const uint32_t vr = hwFramePacketFlag_VR, single_pass = hwFramePacketFlag_VR | hwFramePacketFlag_SinglePassVR;
+    hwTestCheck(Validate(ViewPacket(0, hwFPRecord_ViewProjection)));
+    hwTestCheck(Validate(ViewPacket(vr, hwFPRecord_ViewProjectionStereo)));
+    hwTestCheck(Validate(ViewPacket(single_pass, hwFPRecord_ViewProjectionStereo)));
+
+    std::string error;
+    hwTestCheck(!Validate(ViewPacket(vr, hwFPRecord_ViewProjection), &error));
+    hwTestCheck(error.find("mono view") != std::string::npos);
+    hwTestCheck(!Validate(ViewPacket(single_pass, hwFPRecord_ViewProjection)));
+    hwTestCheck(!Validate(ViewPacket(0, hwFPRecord_ViewProjectionStereo), &error));
+    hwTestCheck(error.find("stereo view") != std::string::npos);
+}
+
+static void TestSubmit()
+{
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwFramePacketTest: failed to initialize.\n");
+        ++g_hw_test_failures;
+        return;
+    }
+    hwContext *ctx = hwGetContext();
+    hwStats before, after;
+    hwGetStats(&before);
+
+    auto mismatched = ViewPacket(hwFramePacketFlag_VR, hwFPRecord_ViewProjection);
+    hwTestCheck(!hwSubmitFrame(mismatched.data(), (int)mismatched.size() * 4));
+    mismatched = ViewPacket(0, hwFPRecord_ViewProjectionStereo);
+    hwTestCheck(!hwSubmitFrame(mismatched.data(), (int)mismatched.size() * 4));
+    auto mono = ViewPacket(0, hwFPRecord_ViewProjection);
+    hwTestCheck(hwSubmitFrame(mono.data(), (int)mono.size() * 4));
+    auto stereo = ViewPacket(hwFramePacketFlag_VR, hwFPRecord_ViewProjectionStereo);
+    hwTestCheck(hwSubmitFrame(stereo.data(), (int)stereo.size() * 4));
+    ctx->flush();
+    ctx->flushVR();
+
+    hwGetStats(&after);
+    hwTestCheckEqual(after.num_frame_packets_rejected - before.num_frame_packets_rejected, 2);
+    hwTestCheckEqual(after.num_frame_packets - before.num_frame_packets, 2);
+    hwFinalize();
+}
+
+int main()
+{
+    TestViewRecords();
+    TestSubmit();
+    return hwTestResult("hwFramePacketTest");
+}
@@ -0,0 +1,87 @@
+// guide hair LOD levels on the stub SDK: the levels are cached in the user's cache directory and not next to the
+// source, and reloading the asset keeps the SDK assets live instances were created from until they are recreated.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+#include <dirent.h>
+#include <unistd.h>
+
+static int CountFiles(const std::string &dir)
+{
+    int n = 0;
+    if (DIR *d = opendir(dir.c_str())) {
+        while (auto *e = readdir(d)) {
+            if (e->d_name[0] != '.') { ++n; }
+        }
+        closedir(d);
+    }
+    return n;
+}
+
+static void Frame(hwContext *ctx)
+{
+    hwBeginScene(false);
+    hwEndScene(false);
+    ctx->flush();
+}
+
+int main()
+{
+    // read once by the first LOD build
+    char cwd[1024];
+    if (!getcwd(cwd, sizeof(cwd))) { return 1; }
+    std::string cache_home = std::string(cwd) + "/hwLODTest.cache";
+    std::string cache_dir = cache_home + "/hairworks/lod";
+    setenv("XDG_CACHE_HOME", cache_home.c_str(), 1);
+    for (int level = 1; level <= 2; ++level) {
+        char path[32];
+        snprintf(path, sizeof(path), "hwLODTest.lod%d.apx", level);
+        remove(path);
+    }
+
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwLODTest: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+
+    hwHAsset asset = hwAssetLoadFromFile("hwLODTest.apx");
+    hwTestCheckEqual(hwAssetBuildLODChain(asset, 2), 3);
+    struct stat st;
+    hwTestCheck(stat("hwLODTest.lod1.apx", &st) != 0);
+    hwTestCheck(stat("hwLODTest.lod2.apx", &st) != 0);
+    hwTestCheck(CountFiles(cache_dir) >= 2);
+
+    hwHInstance instances[] = { hwInstanceCreate(asset), hwInstanceCreate(asset) };
+    hwInstanceSetLOD(instances[1], 1);
+    Frame(ctx);
+    hwTestCheckEqual(hwInstanceGetLOD(instances[0]), 0);
+    hwTestCheckEqual(hwInstanceGetLOD(instances[1]), 1);
+
+    // the asset and its levels are replaced, the instances still use the old ones until the next flush.
+    // measuring the new assets creates no instance
+    hwStubSDKCounters before, after;
+    hwStubSDKGetCounters(sdk, before);
+    hwAssetReload(asset);
+    hwStubSDKGetCounters(sdk, after);
+    hwTestCheckEqual(after.assets_freed_in_use, (int64_t)0);
+    hwTestCheckEqual(after.instances_created, before.instances_created);
+
+    Frame(ctx);
+    hwStubSDKGetCounters(sdk, after);
+    hwTestCheckEqual(after.instances_created - before.instances_created, (int64_t)2);
+    hwTestCheckEqual(hwInstanceGetLOD(instances[1]), 1);
+    hwFloat3 bmin, bmax;
+    hwInstanceGetBounds(instances[1], &bmin, &bmax);
+
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+    hwAssetRelease(asset);
+    hwFinalize();
+
+    hwStubSDKGetCounters(sdk, after);
+    hwTestCheckEqual(after.assets_freed_in_use, (int64_t)0);
+    hwTestCheckEqual(after.stale_id_calls, (int64_t)0);
+    return hwTestResult("hwLODTest");
+}
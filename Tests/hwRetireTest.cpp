@@ -0,0 +1,75 @@
+// deferred destruction on the stub SDK: a released instance keeps its slot until the frame that recorded commands for
+// it has been flushed, so those commands never reach an instance created in the slot meanwhile. and hwStableVector
+// refusing to grow past its chunk table.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+
+static void TestRetire()
+{
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwRetireTest: failed to initialize.\n");
+        ++g_hw_test_failures;
+        return;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+    hwHAsset asset = hwAssetLoadFromFile("hwRetireTest.apx");
+
+    // recorded, then released before any flush
+    hwHInstance a = hwInstanceCreate(asset);
+    hwBeginScene(false);
+    hwRender(a, false);
+    hwEndScene(false);
+    hwInstanceRelease(a);
+
+    // no flush is running, but a's slot still has a command waiting
+    hwHInstance b = hwInstanceCreate(asset);
+    hwTestCheck(b != a);
+
+    hwStubSDKCounters before, after;
+    hwStubSDKGetCounters(sdk, before);
+    ctx->flush();
+    hwStubSDKGetCounters(sdk, after);
+    hwTestCheckEqual(after.render_calls - before.render_calls, (int64_t)0);
+
+    // flushed: the slot is free again
+    hwHInstance c = hwInstanceCreate(asset);
+    hwTestCheckEqual(c, a);
+
+    // released inside the scene that recorded it
+    hwBeginScene(false);
+    hwRender(b, false);
+    hwInstanceRelease(b);
+    hwEndScene(false);
+    hwHInstance d = hwInstanceCreate(asset);
+    hwTestCheck(d != b);
+    hwStubSDKGetCounters(sdk, before);
+    ctx->flush();
+    hwStubSDKGetCounters(sdk, after);
+    hwTestCheckEqual(after.render_calls - before.render_calls, (int64_t)0);
+    hwTestCheckEqual(after.stale_id_calls, (int64_t)0);
+
+    hwInstanceRelease(c);
+    hwInstanceRelease(d);
+    hwAssetRelease(asset);
+    hwFinalize();
+}
+
+static void TestStableVectorLimit()
+{
+    hwStableVector<int, 4, 2> v;
+    for (int i = 0; i < 8; ++i) { hwTestCheck(v.push_back(i)); }
+    hwTestCheck(!v.push_back(8));
+    hwTestCheckEqual(v.size(), (size_t)8);
+    hwTestCheckEqual(v[7], 7);
+    hwTestCheckEqual(v.max_size(), (size_t)8);
+}
+
+int main()
+{
+    TestRetire();
+    TestStableVectorLimit();
+    return hwTestResult("hwRetireTest");
+}
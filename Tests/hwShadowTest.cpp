@@ -0,0 +1,81 @@
+// shadow flushes on the stub SDK: a light renders the enabled shadow casters drawn since the last step only, and leaves
+// the view projection of the view being flushed in place for the view segment that follows.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+
+static hwMatrix Translation(float x)
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    m[12] = x;
+    return r;
+}
+
+static void SetShadow(hwHInstance hi, bool enable)
+{
+    hwHairDescriptor desc;
+    hwInstanceGetDescriptor(hi, &desc);
+    desc.m_castShadows = true;
+    desc.m_enable = enable;
+    hwInstanceSetDescriptor(hi, &desc);
+}
+
+// one frame drawing draws[], then the light's flush. returns the casters rendered
+static int Frame(hwContext *ctx, const hwHInstance *draws, int num_draws, const hwMatrix &view)
+{
+    hwMatrix identity = Translation(0.0f);
+    hwStats before, after;
+    hwGetStats(&before);
+
+    hwBeginScene(false);
+    hwStepSimulation(1.0f / 60.0f, false, false);
+    hwSetViewProjection(0, &view, &identity, 60.0f);
+    for (int i = 0; i < num_draws; ++i) { hwRender(draws[i], false); }
+    hwEndScene(false);
+    ctx->flushView(0);
+
+    hwSetShadowViewProjection(0, &identity, &identity, 90.0f);
+    ctx->flushShadow(0);
+    hwGetStats(&after);
+    return after.num_shadow_casters_rendered - before.num_shadow_casters_rendered;
+}
+
+int main()
+{
+    hwSetLogLevel(hwLogLevel_Error);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwShadowTest: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+    hwHAsset asset = hwAssetLoadFromFile("hwShadowTest.apx");
+    hwHInstance enabled = hwInstanceCreate(asset), disabled = hwInstanceCreate(asset), undrawn = hwInstanceCreate(asset);
+    SetShadow(enabled, true);
+    SetShadow(disabled, false);
+    SetShadow(undrawn, true);
+
+    // the undrawn one is not submitted, the disabled one is skipped
+    hwHInstance draws[] = { enabled, disabled };
+    hwMatrix view = Translation(5.0f);
+    hwTestCheckEqual(Frame(ctx, draws, 2, view), 1);
+
+    hwMatrix v, p;
+    hwTestCheck(hwStubSDKGetViewProjection(sdk, v, p));
+    hwTestCheckEqual(v._41, 5.0f);
+
+    // the next frame's draws replace them
+    hwTestCheckEqual(Frame(ctx, &undrawn, 1, Translation(7.0f)), 1);
+    hwTestCheck(hwStubSDKGetViewProjection(sdk, v, p));
+    hwTestCheckEqual(v._41, 7.0f);
+
+    hwInstanceRelease(enabled);
+    hwInstanceRelease(disabled);
+    hwInstanceRelease(undrawn);
+    hwAssetRelease(asset);
+    hwFinalize();
+    return hwTestResult("hwShadowTest");
+}
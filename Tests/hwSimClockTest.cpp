@@ -0,0 +1,128 @@
+// hwSimClock on its own (substep counts, the max_substeps cap, the remainder carried across frames of varying dt),
+// then the same frames through hwStepSimulation() with the stub SDK counting the StepSimulation() calls.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+#include <random>
+
+struct Frame
+{
+    float dt;
+    int steps;          // expected substeps
+    float dropped;      // expected time cut by the cap
+};
+
+// fixed_dt 0.25, max_substeps 3. all values are exact in binary so the expectations don't depend on rounding
+static const float FixedDt = 0.25f;
+static const int MaxSubsteps = 3;
+static const Frame Frames[] = {
+    { 0.125f,  0, 0.0f },   // accumulates, remainder 0.125
+    { 0.375f,  2, 0.0f },   // 0.5: two substeps, nothing left
+    { 1.0625f, 3, 0.25f },  // 4.25 substeps worth: 3 run, 1 dropped, remainder 0.0625
+    { 0.4375f, 2, 0.0f },   // 0.0625 + 0.4375 = 0.5
+    { 0.0f,    0, 0.0f },   // paused
+    { -1.0f,   0, 0.0f },   // rejected, the remainder is kept
+    { 0.1875f, 0, 0.0f },
+    { 0.0625f, 1, 0.0f },   // 0.1875 + 0.0625 = 0.25
+    { 0.25f,   1, 0.0f },
+    { 0.75f,   3, 0.0f },   // exactly at the cap
+    { 2.0f,    3, 1.25f },  // a hitch: 8 substeps worth, 3 run, 5 dropped
+};
+
+static void TestFixedSequence()
+{
+    hwSimClock clock;
+    clock.setTimestep(FixedDt, MaxSubsteps);
+    for (auto &f : Frames) {
+        float step_dt = -1.0f, dropped = -1.0f;
+        int n = clock.advance(f.dt, step_dt, dropped);
+        hwTestCheckEqual(n, f.steps);
+        hwTestCheckEqual(dropped, f.dropped);
+        hwTestCheckEqual(step_dt, f.dt > 0.0f ? FixedDt : 0.0f);
+    }
+
+    float step_dt, dropped;
+    hwTestCheckEqual(clock.advance(std::numeric_limits<float>::quiet_NaN(), step_dt, dropped), 0);
+    hwTestCheckEqual(clock.accumulator, 0.0);
+}
+
+// random frame times: every frame stays under the cap, never drops time it could have stepped, and whatever was
+// fed is accounted for as stepped + dropped + the remainder
+static void TestVariableFrames()
+{
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> frame_dt(0.0f, 0.1f);
+    hwSimClock clock;
+    clock.setTimestep(1.0f / 60.0f, 4);
+
+    double fed = 0.0, stepped = 0.0, cut = 0.0;
+    for (int i = 0; i < 100000; ++i) {
+        // mostly 30..120 fps with an occasional hitch
+        float dt = i % 997 == 0 ? 0.5f : frame_dt(rng);
+        float step_dt, dropped;
+        int n = clock.advance(dt, step_dt, dropped);
+        hwTestCheck(n >= 0 && n <= 4);
+        hwTestCheck(dropped == 0.0f || n == 4);
+        hwTestCheck(clock.accumulator >= -1e-9 && clock.accumulator < clock.fixed_dt);
+        fed += dt;
+        stepped += n * (double)step_dt;
+        cut += dropped;
+    }
+    hwTestCheckNear(fed, stepped + cut + clock.accumulator, 1e-3);
+
+    // changing the timestep starts over
+    clock.setTimestep(0.5f, 0);
+    hwTestCheckEqual(clock.max_substeps, 1);
+    hwTestCheckEqual(clock.accumulator, 0.0);
+
+    // fixed timestep off: one step of the frame's dt whatever it is
+    clock.setTimestep(0.0f, 4);
+    float step_dt, dropped;
+    hwTestCheckEqual(clock.advance(0.3f, step_dt, dropped), 1);
+    hwTestCheckEqual(step_dt, 0.3f);
+    hwTestCheckEqual(dropped, 0.0f);
+}
+
+// the same frames recorded and flushed by hwContext
+static void TestContext()
+{
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwSimClockTest: failed to initialize.\n");
+        ++g_hw_test_failures;
+        return;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSetSimulationTimestep(FixedDt, MaxSubsteps);
+
+    hwStubSDKCounters counters;
+    hwTestCheck(hwStubSDKGetCounters(hwContext::loadSDK(), counters));
+    int64_t steps = counters.simulation_steps;
+    float total_dropped = 0.0f;
+    for (auto &f : Frames) {
+        hwBeginScene(false);
+        hwStepSimulation(f.dt, false, false);
+        hwEndScene(false);
+        ctx->flush();
+
+        hwStubSDKGetCounters(hwContext::loadSDK(), counters);
+        hwTestCheckEqual(counters.simulation_steps - steps, (int64_t)f.steps);
+        steps = counters.simulation_steps;
+        total_dropped += f.dropped;
+    }
+
+    hwStats stats;
+    hwGetStats(&stats);
+    hwTestCheckEqual(stats.num_simulation_frames, (int)(sizeof(Frames) / sizeof(Frames[0])));
+    hwTestCheckEqual(stats.num_simulation_frames_dropped, 2);
+    hwTestCheckEqual(stats.simulation_time_dropped, total_dropped);
+    hwFinalize();
+}
+
+int main()
+{
+    TestFixedSequence();
+    TestVariableFrames();
+    TestContext();
+    return hwTestResult("hwSimClockTest");
+}
@@ -0,0 +1,88 @@
+// simulation budget on the stub SDK: with instances throttled, a frame steps each group of due instances with the
+// frame's substeps, an instance's descriptor is sent at most once per group and once more to be drawn simulated, and
+// throttled instances catch up: their simulated time is the wall time once the budget is lifted.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+
+int main()
+{
+    const int num_instances = 16;
+    const int num_frames = 64;
+
+    hwSetLogLevel(hwLogLevel_Warning);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwSimulationBudgetTest: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+
+    hwHAsset asset = hwAssetLoadFromFile("hwSimulationBudgetTest.apx");
+    std::vector<hwHInstance> instances;
+    for (int i = 0; i < num_instances; ++i) { instances.push_back(hwInstanceCreate(asset)); }
+
+    // 2 substeps per frame, room for a quarter of the instances per substep
+    hwSetSimulationTimestep(0.25f, 4);
+    hwSetSimulationBudget(num_instances / 4, false);
+
+    hwStubSDKCounters before, after;
+    hwStats stats_before, stats_after;
+    int throttled_frames = 0;
+    double wall_time = 0.0;
+    for (int frame = 0; frame < num_frames; ++frame) {
+        hwStubSDKGetCounters(sdk, before);
+        hwGetStats(&stats_before);
+
+        hwBeginScene(false);
+        hwStepSimulation(0.5f, false, false);
+        hwEndScene(false);
+        ctx->flush();
+        wall_time += 0.5;
+
+        hwStubSDKGetCounters(sdk, after);
+        hwGetStats(&stats_after);
+        // at most a group per divisor (1, 2, 4, 8) once the divisors are settled
+        int64_t steps = after.simulation_steps - before.simulation_steps;
+        int64_t groups = steps / 2;
+        hwTestCheck(steps % 2 == 0 && groups >= 1 && groups <= 4);
+        hwTestCheckEqual(stats_after.num_simulation_steps - stats_before.num_simulation_steps, 2);
+        hwTestCheck(after.descriptor_updates - before.descriptor_updates <= num_instances * (groups + 1));
+        if (stats_after.num_throttled_instances > 0) {
+            ++throttled_frames;
+            hwTestCheckEqual(stats_after.num_budget_group_steps - stats_before.num_budget_group_steps, (int)steps);
+        }
+        // nobody runs ahead, and nobody lags more than the frames an instance sits out at most
+        for (int i = 0; i < num_instances; ++i) {
+            double t = 0.0;
+            hwTestCheck(hwStubSDKSimulatedTime(sdk, (hwInstanceID)i, t));
+            hwTestCheck(t <= wall_time && t > wall_time - 16 * 0.5);
+        }
+    }
+    hwTestCheckEqual(throttled_frames, num_frames);
+
+    // lifting the budget gives back the frames still pending, then steps everything once per substep again
+    hwSetSimulationBudget(0, false);
+    for (int frame = 0; frame < 2; ++frame) {
+        hwStubSDKGetCounters(sdk, before);
+        hwBeginScene(false);
+        hwStepSimulation(0.5f, false, false);
+        hwEndScene(false);
+        ctx->flush();
+        wall_time += 0.5;
+        hwStubSDKGetCounters(sdk, after);
+        hwGetStats(&stats_after);
+        hwTestCheckEqual(stats_after.num_throttled_instances, 0);
+        for (int i = 0; i < num_instances; ++i) {
+            double t = 0.0;
+            hwTestCheck(hwStubSDKSimulatedTime(sdk, (hwInstanceID)i, t));
+            hwTestCheckEqual(t, wall_time);
+        }
+    }
+    hwTestCheckEqual(after.simulation_steps - before.simulation_steps, (int64_t)2);
+
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+    hwAssetRelease(asset);
+    hwFinalize();
+    return hwTestResult("hwSimulationBudgetTest");
+}
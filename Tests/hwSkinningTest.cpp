@@ -0,0 +1,171 @@
+// the SSE skinning paths against the scalar reference on random data, the dual quaternion conversion against
+// known rotations / translations, and dual quaternion against matrix skinning through hwUpdateSkinningBatch()
+#include "hwTest.h"
+#include "hwMath.h"
+#include "hwSkinning.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+
+static uint32_t g_seed = 12345;
+
+static float Random()
+{
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return float(g_seed >> 8) / float(1 << 24) * 2.0f - 1.0f;
+}
+
+static void TestMatrices()
+{
+    const int N = 64;
+    std::vector<hwMatrix> world(N), ibp(N), r1(N), r2(N);
+    for (int i = 0; i < N; ++i) {
+        float *w = hwMatrixData(world[i]);
+        float *b = hwMatrixData(ibp[i]);
+        for (int j = 0; j < 16; ++j) { w[j] = Random(); b[j] = Random(); }
+    }
+
+    for (int mode = 0; mode < 4; ++mode) {
+        bool mirror = (mode & 1) != 0;
+        const hwMatrix *ib = (mode & 2) ? ibp.data() : nullptr;
+        hwBuildSkinningMatricesScalar(r1.data(), world.data(), ib, N, mirror);
+        hwBuildSkinningMatricesSSE(r2.data(), world.data(), ib, N, mirror);
+        for (int i = 0; i < N; ++i) {
+            const float *a = hwMatrixData(r1[i]);
+            const float *b = hwMatrixData(r2[i]);
+            for (int j = 0; j < 16; ++j) { hwTestCheckNear(a[j], b[j], 1e-5); }
+        }
+    }
+}
+
+// known rotation + translation, with scale and an x reflection applied to some of them
+static void TestDualQuaternions()
+{
+    const int N = 64 + 3; // not a multiple of 4: the SSE path finishes with the scalar one
+    std::vector<hwMatrix> mats(N);
+    std::vector<hwDQuaternion> expected(N), dq1(N), dq2(N);
+    for (int i = 0; i < N; ++i) {
+        float x = Random(), y = Random(), z = Random(), w = Random();
+        if (i == 0) { x = y = z = 0.0f; w = 1.0f; }
+        if (i == 1) { x = 1.0f; y = z = w = 0.0f; } // 180 degrees, w = 0
+        float len = std::sqrt(x * x + y * y + z * z + w * w);
+        x /= len; y /= len; z /= len; w /= len;
+        if (w < 0.0f) { x = -x; y = -y; z = -z; w = -w; }
+        float tx = Random() * 10.0f, ty = Random() * 10.0f, tz = Random() * 10.0f;
+
+        // row-vector matrix: row i is the image of basis vector i
+        float *m = hwMatrixData(mats[i]);
+        m[0] = 1 - 2 * (y * y + z * z); m[1] = 2 * (x * y + w * z);     m[2] = 2 * (x * z - w * y);     m[3] = 0;
+        m[4] = 2 * (x * y - w * z);     m[5] = 1 - 2 * (x * x + z * z); m[6] = 2 * (y * z + w * x);     m[7] = 0;
+        m[8] = 2 * (x * z + w * y);     m[9] = 2 * (y * z - w * x);     m[10] = 1 - 2 * (x * x + y * y); m[11] = 0;
+        m[12] = tx; m[13] = ty; m[14] = tz; m[15] = 1;
+        float scale = (i % 3 == 2) ? 1.0f + (Random() + 1.0f) * 2.0f : 1.0f;
+        float mirror = (i % 4 == 3) ? -1.0f : 1.0f;
+        for (int j = 0; j < 3; ++j) { m[j] *= scale * mirror; m[4 + j] *= scale; m[8 + j] *= scale; }
+
+        auto &e = expected[i];
+        e.q0.x = x; e.q0.y = y; e.q0.z = z; e.q0.w = w;
+        e.q1.x = 0.5f * ( tx * w + ty * z - tz * y);
+        e.q1.y = 0.5f * (-tx * z + ty * w + tz * x);
+        e.q1.z = 0.5f * ( tx * y - ty * x + tz * w);
+        e.q1.w = -0.5f * (tx * x + ty * y + tz * z);
+    }
+    hwConvertMatricesToDQsScalar(dq1.data(), mats.data(), N);
+    hwConvertMatricesToDQsSSE(dq2.data(), mats.data(), N);
+    for (int i = 0; i < N; ++i) {
+        const float *e = &expected[i].q0.x;
+        const float *a = &dq1[i].q0.x;
+        const float *b = &dq2[i].q0.x;
+        for (int j = 0; j < 8; ++j) {
+            double tolerance = j < 4 ? 1e-5 : 1e-4;
+            hwTestCheckNear(a[j], e[j], tolerance);
+            hwTestCheckNear(b[j], e[j], tolerance);
+        }
+    }
+}
+
+static hwMatrix RandomRigid()
+{
+    float x = Random(), y = Random(), z = Random(), w = Random();
+    float len = std::sqrt(x * x + y * y + z * z + w * w);
+    x /= len; y /= len; z /= len; w /= len;
+
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    m[0] = 1 - 2 * (y * y + z * z); m[1] = 2 * (x * y + w * z);     m[2] = 2 * (x * z - w * y);     m[3] = 0;
+    m[4] = 2 * (x * y - w * z);     m[5] = 1 - 2 * (x * x + z * z); m[6] = 2 * (y * z + w * x);     m[7] = 0;
+    m[8] = 2 * (x * z + w * y);     m[9] = 2 * (y * z - w * x);     m[10] = 1 - 2 * (x * x + y * y); m[11] = 0;
+    m[12] = Random() * 10.0f; m[13] = Random() * 10.0f; m[14] = Random() * 10.0f; m[15] = 1;
+    return r;
+}
+
+// the same bone world matrices uploaded as matrices and as dual quaternions, with and without the x mirror, must move
+// points to the same place. the stub SDK skins the points with whatever was uploaded last
+static void TestSkinningModes()
+{
+    const int num_bones = 32; // hwStubSDKSettings::num_bones
+    enum { MatrixMirrored, DQMirrored, Matrix, DQ, NumModes };
+    const int flags[NumModes] = {
+        hwSkinningFlag_MirrorX,
+        hwSkinningFlag_MirrorX | hwSkinningFlag_DualQuaternion,
+        0,
+        hwSkinningFlag_DualQuaternion,
+    };
+
+    hwSetLogLevel(hwLogLevel_Error);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwSkinningTest: failed to initialize.\n");
+        ++g_hw_test_failures;
+        return;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+    hwHAsset asset = hwAssetLoadFromFile("hwSkinningTest.apx");
+    hwHInstance instances[NumModes];
+    for (auto &hi : instances) { hi = hwInstanceCreate(asset); }
+
+    std::vector<hwMatrix> world(num_bones * NumModes);
+    std::vector<hwSkinningBatchEntry> entries(NumModes);
+    for (int bi = 0; bi < num_bones; ++bi) {
+        hwMatrix m = RandomRigid();
+        for (int mode = 0; mode < NumModes; ++mode) { world[mode * num_bones + bi] = m; }
+    }
+    for (int mode = 0; mode < NumModes; ++mode) {
+        entries[mode] = { instances[mode], mode * num_bones, num_bones, flags[mode] };
+    }
+    hwBeginScene(false);
+    hwUpdateSkinningBatch(NumModes, entries.data(), world.data(), false);
+    hwEndScene(false);
+    ctx->flush();
+
+    for (int bi = 0; bi < num_bones; ++bi) {
+        for (int i = 0; i < 4; ++i) {
+            hwFloat3 p = { Random(), Random(), Random() };
+            hwFloat3 o[NumModes];
+            for (int mode = 0; mode < NumModes; ++mode) {
+                // instance IDs of the stub are creation order
+                hwTestCheck(hwStubSDKSkinPoint(sdk, (hwInstanceID)mode, bi, p, o[mode]));
+            }
+            hwTestCheckNear(o[DQMirrored].x, o[MatrixMirrored].x, 1e-3);
+            hwTestCheckNear(o[DQMirrored].y, o[MatrixMirrored].y, 1e-3);
+            hwTestCheckNear(o[DQMirrored].z, o[MatrixMirrored].z, 1e-3);
+            hwTestCheckNear(o[DQ].x, o[Matrix].x, 1e-3);
+            hwTestCheckNear(o[DQ].y, o[Matrix].y, 1e-3);
+            hwTestCheckNear(o[DQ].z, o[Matrix].z, 1e-3);
+            // the mirror does something
+            hwTestCheck(std::abs(o[MatrixMirrored].x - o[Matrix].x) + std::abs(o[MatrixMirrored].y - o[Matrix].y) +
+                std::abs(o[MatrixMirrored].z - o[Matrix].z) > 1e-3 || std::abs(p.x) < 1e-3);
+        }
+    }
+
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+    hwAssetRelease(asset);
+    hwFinalize();
+}
+
+int main()
+{
+    TestMatrices();
+    TestDualQuaternions();
+    TestSkinningModes();
+    return hwTestResult("hwSkinningTest");
+}
@@ -0,0 +1,42 @@
+// telemetry segment ownership: a second writer can not take the name of a running one, and the segment of a writer
+// that died without unmapping it is replaced.
+#include "hwTest.h"
+#include "hwTelemetry.h"
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main()
+{
+    hwSetLogLevel(hwLogLevel_Warning);
+    char name[64];
+    snprintf(name, sizeof(name), "hwTelemetryTest.%d", (int)getpid());
+
+    // in use by this process
+    hwTelemetryHeader *block = hwTelemetryCreate(name, 4);
+    hwTestCheck(block != nullptr);
+    hwTestCheck(hwTelemetryCreate(name, 4) == nullptr);
+    const hwTelemetryHeader *reader = hwTelemetryAttach(name);
+    hwTestCheck(reader != nullptr && reader->pid == (uint32_t)getpid());
+    hwTelemetryUnmap(reader);
+    hwTelemetryUnmap(block);
+
+    // a writer that exits without unmapping. reaped first: a zombie still counts as running
+    pid_t child = fork();
+    if (child == 0) {
+        _exit(hwTelemetryCreate(name, 4) ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    hwTestCheck(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    reader = hwTelemetryAttach(name);
+    hwTestCheck(reader != nullptr && reader->pid == (uint32_t)child);
+    hwTelemetryUnmap(reader);
+
+    block = hwTelemetryCreate(name, 4);
+    hwTestCheck(block != nullptr && block->pid == (uint32_t)getpid());
+    hwTelemetryUnmap(block);
+
+    // unmapping the writer's block removes the segment
+    hwTestCheck(hwTelemetryAttach(name) == nullptr);
+    return hwTestResult("hwTelemetryTest");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// checks shared by the tests under Tests/. a failed check prints where and what, and the test keeps going;
+// hwTestResult() at the end of main() turns the failures into the exit code ctest looks at.
+#include "pch.h"
+#include "hwInternal.h"
+
+static int g_hw_test_failures = 0;
+
+#define hwTestCheck(cond)\
+    do { if (!(cond)) { ++g_hw_test_failures; fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+#define hwTestCheckEqual(a, b)\
+    do { auto hw_a = (a); auto hw_b = (b); if (!(hw_a == hw_b)) { ++g_hw_test_failures;\
+        fprintf(stderr, "%s(%d): check failed: %s == %s (%g vs %g)\n", __FILE__, __LINE__, #a, #b, (double)hw_a, (double)hw_b); } } while (0)
+
+#define hwTestCheckNear(a, b, eps)\
+    do { double hw_a = (a), hw_b = (b); if (!(std::abs(hw_a - hw_b) <= (eps))) { ++g_hw_test_failures;\
+        fprintf(stderr, "%s(%d): check failed: %s ~= %s (%g vs %g)\n", __FILE__, __LINE__, #a, #b, hw_a, hw_b); } } while (0)
+
+inline int hwTestResult(const char *name)
+{
+    if (g_hw_test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, g_hw_test_failures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
@@ -0,0 +1,191 @@
+// per-thread command buffers on the stub SDK: one instance skinned from two threads ends up with the same palette every
+// frame whichever thread got the lower command buffer, and a frame submitting more bones than the skinning ring holds
+// drops the excess instead of overwriting the bones of instances submitted before, also when they were submitted by an
+// earlier scene that is not flushed yet.
+#include "hwTest.h"
+#include "hwContext.h"
+#include "hwStubSDK.h"
+#include <condition_variable>
+#include <thread>
+
+static const int g_num_bones = 32; // hwStubSDKSettings::num_bones
+
+static hwMatrix Translation(float x)
+{
+    hwMatrix r;
+    float *m = hwMatrixData(r);
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+    m[12] = x;
+    return r;
+}
+
+// a thread that runs one job at a time, so that it keeps its identity from frame to frame
+class Worker
+{
+public:
+    Worker() : m_thread([this]() { loop(); }) {}
+
+    ~Worker()
+    {
+        { std::unique_lock<std::mutex> l(m_mutex); m_quit = true; m_cond.notify_all(); }
+        m_thread.join();
+    }
+
+    void run(const std::function<void()> &job)
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_job = job;
+        m_cond.notify_all();
+        m_cond.wait(l, [&]() { return !m_job; });
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        for (;;) {
+            m_cond.wait(l, [&]() { return m_job || m_quit; });
+            if (m_quit) { return; }
+            m_job();
+            m_job = nullptr;
+            m_cond.notify_all();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::function<void()> m_job;
+    bool m_quit = false;
+    std::thread m_thread;
+};
+
+static void SkinAll(hwHInstance hi, float x)
+{
+    std::vector<hwMatrix> world(g_num_bones, Translation(x));
+    hwSkinningBatchEntry e = { hi, 0, g_num_bones, 0 };
+    hwUpdateSkinningBatch(1, &e, world.data(), false);
+}
+
+static float SkinnedX(hwSDK *sdk, hwInstanceID iid, int bone)
+{
+    hwFloat3 p = { 0.0f, 0.0f, 0.0f }, o = { 0.0f, 0.0f, 0.0f };
+    hwTestCheck(hwStubSDKSkinPoint(sdk, iid, bone, p, o));
+    return o.x;
+}
+
+static void TestMergeOrder(hwContext *ctx, hwSDK *sdk, hwHInstance hi, hwInstanceID iid)
+{
+    Worker a, b;
+    // a registers first
+    hwBeginScene(false);
+    a.run([]() { hwBeginThreadRecording(false); hwEndThreadRecording(); });
+    b.run([]() { hwBeginThreadRecording(false); hwEndThreadRecording(); });
+    hwEndScene(false);
+    ctx->flush();
+
+    for (int frame = 0; frame < 4; ++frame) {
+        // the thread that begins first gets the lower command buffer. new palettes every frame, unchanged ones are skipped
+        Worker *order[2] = { &a, &b };
+        if (frame % 2) { std::swap(order[0], order[1]); }
+        hwBeginScene(false);
+        for (auto *w : order) {
+            float x = frame * 10.0f + (w == &a ? 1.0f : 2.0f);
+            w->run([=]() {
+                hwBeginThreadRecording(false);
+                SkinAll(hi, x);
+                hwEndThreadRecording();
+            });
+        }
+        hwEndScene(false);
+        ctx->flush();
+        // b's upload goes last
+        hwTestCheckEqual(SkinnedX(sdk, iid, 0), frame * 10.0f + 2.0f);
+    }
+}
+
+static void TestRingOverrun(hwContext *ctx, hwSDK *sdk, hwHInstance first, hwInstanceID first_iid, hwHInstance other, hwInstanceID other_iid)
+{
+    // first's palette, then more palettes of other than fit in the rest of the ring
+    const int ring = 16384; // hwContext::NUM_BUFFER_BONES_MATRIX
+    const int num_entries = 1 + ring / g_num_bones + 64;
+    std::vector<hwMatrix> world(num_entries * g_num_bones);
+    std::vector<hwSkinningBatchEntry> entries(num_entries);
+    for (int i = 0; i < num_entries; ++i) {
+        entries[i] = { i == 0 ? first : other, i * g_num_bones, g_num_bones, 0 };
+        std::fill(world.begin() + i * g_num_bones, world.begin() + (i + 1) * g_num_bones, Translation(i == 0 ? -1.0f : 100.0f + i));
+    }
+    hwBeginScene(false);
+    hwUpdateSkinningBatch(num_entries, entries.data(), world.data(), false);
+    hwEndScene(false);
+    ctx->flush();
+
+    hwTestCheckEqual(SkinnedX(sdk, first_iid, 0), -1.0f);
+    hwTestCheckEqual(SkinnedX(sdk, first_iid, g_num_bones - 1), -1.0f);
+    // the last palette of other that fit
+    hwTestCheckEqual(SkinnedX(sdk, other_iid, 0), 100.0f + ring / g_num_bones - 1);
+
+    // the dropped palette is not marked as uploaded: the next frame sends it
+    hwBeginScene(false);
+    hwUpdateSkinningBatch(1, &entries[num_entries - 1], world.data(), false);
+    hwEndScene(false);
+    ctx->flush();
+    hwTestCheckEqual(SkinnedX(sdk, other_iid, 0), 100.0f + num_entries - 1);
+}
+
+static void TestTwoScenes(hwContext *ctx, hwSDK *sdk, hwHInstance first, hwInstanceID first_iid, hwHInstance other, hwInstanceID other_iid)
+{
+    // three quarters of the ring in the first scene, first's palette at its start. the second scene of the frame (a
+    // view packet, say) fills the rest and would wrap over it
+    const int ring = 16384; // hwContext::NUM_BUFFER_BONES_MATRIX
+    const int palettes = ring / g_num_bones;
+    auto submit = [&](int num_entries, float x0, bool with_first) {
+        std::vector<hwMatrix> world(num_entries * g_num_bones);
+        std::vector<hwSkinningBatchEntry> entries(num_entries);
+        for (int i = 0; i < num_entries; ++i) {
+            bool f = with_first && i == 0;
+            entries[i] = { f ? first : other, i * g_num_bones, g_num_bones, 0 };
+            std::fill(world.begin() + i * g_num_bones, world.begin() + (i + 1) * g_num_bones, Translation(f ? -2.0f : x0 + i));
+        }
+        hwBeginScene(false);
+        hwUpdateSkinningBatch(num_entries, entries.data(), world.data(), false);
+        hwEndScene(false);
+    };
+    // the ring is empty once the frames before are flushed, wherever its head is
+    submit(palettes * 3 / 4, 1000.0f, true);
+    submit(palettes / 2, 2000.0f, false);
+    ctx->flush();
+
+    hwTestCheckEqual(SkinnedX(sdk, first_iid, 0), -2.0f);
+    hwTestCheckEqual(SkinnedX(sdk, first_iid, g_num_bones - 1), -2.0f);
+    // the second scene got the quarter left
+    hwTestCheckEqual(SkinnedX(sdk, other_iid, 0), 2000.0f + palettes / 4 - 1);
+
+    // flushed: the next frame has the whole ring again
+    submit(palettes / 2, 3000.0f, false);
+    ctx->flush();
+    hwTestCheckEqual(SkinnedX(sdk, other_iid, 0), 3000.0f + palettes / 2 - 1);
+}
+
+int main()
+{
+    hwSetLogLevel(hwLogLevel_Error);
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwThreadRecordingTest: failed to initialize.\n");
+        return 1;
+    }
+    hwContext *ctx = hwGetContext();
+    hwSDK *sdk = hwContext::loadSDK();
+    hwHAsset asset = hwAssetLoadFromFile("hwThreadRecordingTest.apx");
+    // instance IDs of the stub are creation order
+    hwHInstance instances[] = { hwInstanceCreate(asset), hwInstanceCreate(asset) };
+
+    TestMergeOrder(ctx, sdk, instances[0], (hwInstanceID)0);
+    TestRingOverrun(ctx, sdk, instances[0], (hwInstanceID)0, instances[1], (hwInstanceID)1);
+    TestTwoScenes(ctx, sdk, instances[0], (hwInstanceID)0, instances[1], (hwInstanceID)1);
+
+    for (auto hi : instances) { hwInstanceRelease(hi); }
+    hwAssetRelease(asset);
+    hwFinalize();
+    return hwTestResult("hwThreadRecordingTest");
+}
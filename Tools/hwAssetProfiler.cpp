@@ -0,0 +1,271 @@
+// what hair assets cost before they ship: guide / control vertex counts, render hairs at the default density,
+// memory estimates, bones and the textures they use.
+// usage: hwAssetProfiler [--json] [--jobs N] <file.apx or directory>...
+// directories are searched recursively for *.apx. without the HairWorks DLL (Linux) assets go through the stub SDK.
+// the SDK and the context's asset table are single threaded, so --jobs N splits the assets over N child processes,
+// each with its own context.
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char *g_texture_names[GFSDK_HAIR_NUM_TEXTURES] = {
+    "density", "root_color", "tip_color", "width", "stiffness", "root_stiffness", "clump_scale",
+    "clump_roundness", "wave_scale", "wave_freq", "strand", "length", "specular", "weights",
+};
+
+struct AssetProfile
+{
+    std::string path;
+    int64_t file_size = 0;
+    bool loaded = false;
+    hwAssetInfo info;
+    hwAssetMemory memory = {};
+    std::vector<std::pair<int, std::string>> textures;  // texture type, file name
+};
+
+static bool EndsWithApx(const std::string &path)
+{
+    if (path.size() < 4) { return false; }
+    std::string ext = path.substr(path.size() - 4);
+    for (auto &c : ext) { c = (char)std::tolower((unsigned char)c); }
+    return ext == ".apx";
+}
+
+static void CollectAssets(const std::string &path, std::vector<std::string> &dst)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        dst.push_back(path); // reported as a load failure
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        dst.push_back(path);
+        return;
+    }
+
+    DIR *dir = opendir(path.c_str());
+    if (!dir) { return; }
+    std::vector<std::string> entries;
+    while (dirent *e = readdir(dir)) {
+        if (e->d_name[0] == '.') { continue; }
+        entries.push_back(path + "/" + e->d_name);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end());
+    for (auto &e : entries) {
+        if (stat(e.c_str(), &st) != 0) { continue; }
+        if (S_ISDIR(st.st_mode)) { CollectAssets(e, dst); }
+        else if (EndsWithApx(e)) { dst.push_back(e); }
+    }
+}
+
+static void Profile(AssetProfile &p)
+{
+    // the stub SDK accepts any name. missing files must still fail
+    struct stat st;
+    if (stat(p.path.c_str(), &st) != 0) { return; }
+    p.file_size = (int64_t)st.st_size;
+
+    hwHAsset ha = hwAssetLoadFromFile(p.path.c_str());
+    if (ha == hwNullHandle) { return; }
+    p.loaded = hwAssetGetInfo(ha, &p.info);
+    for (int t = 0; t < GFSDK_HAIR_NUM_TEXTURES; ++t) {
+        const char *name = hwAssetGetTextureName(ha, t);
+        if (name && name[0] != '\0') { p.textures.emplace_back(t, name); }
+    }
+    hwAssetRelease(ha);
+}
+
+// profiles of a child process, read back by the parent. both sides are the same binary, so the PODs go as raw bytes
+static void WriteProfile(FILE *f, int index, const AssetProfile &p)
+{
+    int num_textures = (int)p.textures.size();
+    fwrite(&index, sizeof(index), 1, f);
+    fwrite(&p.loaded, sizeof(p.loaded), 1, f);
+    fwrite(&p.file_size, sizeof(p.file_size), 1, f);
+    fwrite(&p.info, sizeof(p.info), 1, f);
+    fwrite(&num_textures, sizeof(num_textures), 1, f);
+    for (auto &t : p.textures) {
+        int len = (int)t.second.size();
+        fwrite(&t.first, sizeof(t.first), 1, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(t.second.data(), 1, len, f);
+    }
+}
+
+static bool ReadProfile(FILE *f, std::vector<AssetProfile> &profiles)
+{
+    int index, num_textures;
+    if (fread(&index, sizeof(index), 1, f) != 1 || index < 0 || index >= (int)profiles.size()) { return false; }
+    auto &p = profiles[index];
+    if (fread(&p.loaded, sizeof(p.loaded), 1, f) != 1 ||
+        fread(&p.file_size, sizeof(p.file_size), 1, f) != 1 ||
+        fread(&p.info, sizeof(p.info), 1, f) != 1 ||
+        fread(&num_textures, sizeof(num_textures), 1, f) != 1) { return false; }
+    for (int i = 0; i < num_textures; ++i) {
+        int type, len;
+        if (fread(&type, sizeof(type), 1, f) != 1 || fread(&len, sizeof(len), 1, f) != 1) { return false; }
+        if (type < 0 || type >= GFSDK_HAIR_NUM_TEXTURES || len < 0) { return false; }
+        std::string name(len, '\0');
+        if (len > 0 && fread(&name[0], 1, len, f) != (size_t)len) { return false; }
+        p.textures.emplace_back(type, name);
+    }
+    return true;
+}
+
+// profiles[i] for i = first, first + step, ... in this process
+static bool ProfileRange(std::vector<AssetProfile> &profiles, int first, int step, FILE *out)
+{
+    if (!hwInitialize()) {
+        fprintf(stderr, "hwAssetProfiler: failed to initialize HairWorks.\n");
+        return false;
+    }
+    for (int i = first; i < (int)profiles.size(); i += step) {
+        Profile(profiles[i]);
+        if (out) { WriteProfile(out, i, profiles[i]); }
+    }
+    hwFinalize();
+    return true;
+}
+
+static std::string JsonString(const std::string &s)
+{
+    std::string r = "\"";
+    for (char c : s) {
+        switch (c) {
+        case '"': r += "\\\""; break;
+        case '\\': r += "\\\\"; break;
+        case '\n': r += "\\n"; break;
+        case '\t': r += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                r += buf;
+            }
+            else {
+                r += c;
+            }
+        }
+    }
+    return r + "\"";
+}
+
+static void PrintJson(const std::vector<AssetProfile> &profiles)
+{
+    printf("[\n");
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        auto &p = profiles[i];
+        auto &info = p.info;
+        auto &mem = p.memory;
+        printf("  {\n");
+        printf("    \"path\": %s,\n", JsonString(p.path).c_str());
+        printf("    \"loaded\": %s,\n", p.loaded ? "true" : "false");
+        printf("    \"file_size\": %lld,\n", (long long)p.file_size);
+        printf("    \"guide_hairs\": %d,\n", info.num_guide_hairs);
+        printf("    \"guide_vertices\": %d,\n", info.num_guide_vertices);
+        printf("    \"faces\": %d,\n", info.num_faces);
+        printf("    \"bones\": %d,\n", info.num_bones);
+        printf("    \"render_hairs\": %d,\n", info.num_render_hairs);
+        printf("    \"average_cvs\": %g,\n", info.average_cvs);
+        printf("    \"average_density\": %g,\n", info.average_density);
+        printf("    \"average_hairs_per_face\": %g,\n", info.average_hairs_per_face);
+        printf("    \"memory\": { \"guide\": %lld, \"growth_mesh\": %lld, \"bones\": %lld, \"render\": %lld, \"total\": %lld },\n",
+            (long long)mem.guide, (long long)mem.growth_mesh, (long long)mem.bones, (long long)mem.render, (long long)mem.total());
+        printf("    \"textures\": {");
+        for (size_t t = 0; t < p.textures.size(); ++t) {
+            printf("%s %s: %s", t == 0 ? "" : ",", JsonString(g_texture_names[p.textures[t].first]).c_str(), JsonString(p.textures[t].second).c_str());
+        }
+        printf("%s}\n", p.textures.empty() ? "" : " ");
+        printf("  }%s\n", i + 1 < profiles.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+static void PrintText(const std::vector<AssetProfile> &profiles)
+{
+    for (auto &p : profiles) {
+        auto &info = p.info;
+        printf("%s\n", p.path.c_str());
+        if (!p.loaded) {
+            printf("  failed to load\n");
+            continue;
+        }
+        printf("  guide hairs: %d (%d vertices), faces: %d, bones: %d\n", info.num_guide_hairs, info.num_guide_vertices, info.num_faces, info.num_bones);
+        printf("  render hairs: %d at density %g (%g per face, %g CVs each)\n", info.num_render_hairs, info.average_density, info.average_hairs_per_face, info.average_cvs);
+        printf("  memory: %.1f KB (guide %.1f, growth mesh %.1f, bones %.1f, render %.1f)\n", p.memory.total() / 1024.0,
+            p.memory.guide / 1024.0, p.memory.growth_mesh / 1024.0, p.memory.bones / 1024.0, p.memory.render / 1024.0);
+        for (auto &t : p.textures) {
+            printf("  texture %s: %s\n", g_texture_names[t.first], t.second.c_str());
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    int jobs = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) { json = true; }
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) { jobs = std::max(std::atoi(argv[++i]), 1); }
+        else { CollectAssets(argv[i], paths); }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: hwAssetProfiler [--json] [--jobs N] <file.apx or directory>...\n");
+        return 2;
+    }
+
+    std::vector<AssetProfile> profiles(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) { profiles[i].path = paths[i]; }
+
+    jobs = std::min<int>(jobs, (int)profiles.size());
+    if (jobs <= 1) {
+        if (!ProfileRange(profiles, 0, 1, nullptr)) { return 1; }
+    }
+    else {
+        // each child writes to its own temporary file (the descriptor is shared across fork()), read after it exits
+        fflush(stdout);
+        fflush(stderr);
+        std::vector<std::pair<pid_t, FILE*>> children;
+        for (int j = 0; j < jobs; ++j) {
+            FILE *f = tmpfile();
+            pid_t pid = f ? fork() : -1;
+            if (pid == 0) {
+                bool ok = ProfileRange(profiles, j, jobs, f);
+                fflush(f);
+                _exit(ok ? 0 : 1);
+            }
+            if (pid < 0) {
+                fprintf(stderr, "hwAssetProfiler: failed to start job %d.\n", j);
+                if (f) { fclose(f); }
+                continue;
+            }
+            children.emplace_back(pid, f);
+        }
+
+        bool failed = children.size() != (size_t)jobs;
+        for (auto &c : children) {
+            int status = 0;
+            waitpid(c.first, &status, 0);
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            rewind(c.second);
+            while (ReadProfile(c.second, profiles)) {}
+            fclose(c.second);
+        }
+        if (failed) { return 1; }
+    }
+    for (auto &p : profiles) { p.memory = hwEstimateAssetMemory(p.info); }
+
+    if (json) { PrintJson(profiles); }
+    else { PrintText(profiles); }
+
+    bool all_loaded = std::all_of(profiles.begin(), profiles.end(), [](const AssetProfile &p) { return p.loaded; });
+    return all_loaded ? 0 : 1;
+}
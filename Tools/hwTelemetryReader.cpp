@@ -0,0 +1,125 @@
+// samples the telemetry block of a running session (hwTelemetryOpen()) and prints one line per sample, plus the
+// instances with --instances. read only: the session does not know it is being watched.
+// waits for the session to start and re-attaches when it restarts.
+// usage: hwTelemetryReader [--interval ms=1000] [--count N] [--instances] [--json] [name=hwTelemetry]
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwTelemetry.h"
+#include <thread>
+
+static const char *g_sleep_state_names[] = { "awake", "sleeping", "waking" };
+
+static void PrintText(const hwTelemetryHeader &h, bool instances)
+{
+    const auto &f = h.frame;
+    printf("pid %u frame %llu | frame %6.2f ms flush %6.2f ms sim %6.2f ms (%d substeps, %.1f ms dropped) | "
+        "instances %d sleeping %d throttled %d | commands frame %d view %d vr %d lod %d | views %d shadows %d\n",
+        h.pid, (unsigned long long)f.frame, f.frame_time, f.flush_time, f.simulation_time, f.num_substeps, f.simulation_time_dropped,
+        f.num_instances, f.num_sleeping_instances, f.num_throttled_instances,
+        f.frame_commands, f.view_commands, f.vr_commands, f.lod_requests, f.num_view_flushes, f.num_shadow_flushes);
+    if (!instances) { return; }
+
+    printf("  %8s %6s %4s %-9s %4s %4s %9s %8s %6s %6s %8s %8s\n",
+        "instance", "asset", "lod", "sleep", "sim", "div", "invisible", "hairs", "cvs", "dist", "distlod", "stats@");
+    for (uint32_t i = 0; i < h.num_instances; ++i) {
+        const auto &t = h.instances()[i];
+        printf("  %8d %6d %4d %-9s %4d %4d %9d %8d %6.1f %6.1f %8.2f %8llu\n",
+            t.handle, t.asset, t.lod, g_sleep_state_names[std::min(std::max(t.sleep_state, 0), 2)], t.simulating,
+            t.sim_divisor, t.invisible_frames, t.num_hairs, t.average_cvs, t.camera_distance, t.distance_lod_factor,
+            (unsigned long long)t.stats_frame);
+    }
+    if (h.num_instances < (uint32_t)f.num_instances) {
+        printf("  ... %d more (hwTelemetryOpen() max_instances)\n", f.num_instances - (int)h.num_instances);
+    }
+}
+
+// one object per line
+static void PrintJson(const hwTelemetryHeader &h, bool instances)
+{
+    const auto &f = h.frame;
+    printf("{\"pid\":%u,\"frame\":%llu,\"timestamp\":%llu,\"frame_time\":%.3f,\"flush_time\":%.3f,\"simulation_time\":%.3f,"
+        "\"simulation_time_dropped\":%.3f,\"num_substeps\":%d,\"num_view_flushes\":%d,\"num_shadow_flushes\":%d,"
+        "\"num_instances\":%d,\"num_sleeping_instances\":%d,\"num_throttled_instances\":%d,"
+        "\"frame_commands\":%d,\"view_commands\":%d,\"vr_commands\":%d,\"lod_requests\":%d",
+        h.pid, (unsigned long long)f.frame, (unsigned long long)f.timestamp, f.frame_time, f.flush_time, f.simulation_time,
+        f.simulation_time_dropped, f.num_substeps, f.num_view_flushes, f.num_shadow_flushes,
+        f.num_instances, f.num_sleeping_instances, f.num_throttled_instances,
+        f.frame_commands, f.view_commands, f.vr_commands, f.lod_requests);
+    if (instances) {
+        printf(",\"instances\":[");
+        for (uint32_t i = 0; i < h.num_instances; ++i) {
+            const auto &t = h.instances()[i];
+            printf("%s{\"handle\":%d,\"asset\":%d,\"lod\":%d,\"sleep_state\":%d,\"simulating\":%d,\"sim_divisor\":%d,"
+                "\"invisible_frames\":%d,\"num_hairs\":%d,\"average_cvs\":%.2f,\"distance_lod_factor\":%.3f,"
+                "\"detail_lod_factor\":%.3f,\"camera_distance\":%.2f,\"stats_frame\":%llu}",
+                i ? "," : "", t.handle, t.asset, t.lod, t.sleep_state, t.simulating, t.sim_divisor,
+                t.invisible_frames, t.num_hairs, t.average_cvs, t.distance_lod_factor,
+                t.detail_lod_factor, t.camera_distance, (unsigned long long)t.stats_frame);
+        }
+        printf("]");
+    }
+    printf("}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int interval = 1000;
+    int count = -1;
+    bool instances = false;
+    bool json = false;
+    const char *name = hwTelemetryDefaultName;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc) { interval = std::max(std::atoi(argv[++i]), 1); }
+        else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) { count = std::max(std::atoi(argv[++i]), 1); }
+        else if (std::strcmp(argv[i], "--instances") == 0) { instances = true; }
+        else if (std::strcmp(argv[i], "--json") == 0) { json = true; }
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: hwTelemetryReader [--interval ms=1000] [--count N] [--instances] [--json] [name=hwTelemetry]\n");
+            return 2;
+        }
+        else { name = argv[i]; }
+    }
+
+    const hwTelemetryHeader *block = nullptr;
+    std::vector<char> snapshot;
+    uint64_t last_frame = 0;
+    int stalled = 0;
+    bool waiting = false;
+    for (int n = 0; count < 0 || n < count; ) {
+        if (!block) {
+            block = hwTelemetryAttach(name);
+            if (!block && !waiting) {
+                fprintf(stderr, "hwTelemetryReader: waiting for %s...\n", name);
+                waiting = true;
+            }
+        }
+        if (block) {
+            snapshot.resize(block->size >= sizeof(hwTelemetryHeader) ? block->size : sizeof(hwTelemetryHeader));
+            if (hwTelemetryRead(block, snapshot.data(), snapshot.size())) {
+                const auto &h = *(const hwTelemetryHeader*)snapshot.data();
+                waiting = false;
+                if (h.frame.frame != last_frame) {
+                    last_frame = h.frame.frame;
+                    stalled = 0;
+                    if (json) { PrintJson(h, instances); }
+                    else { PrintText(h, instances); }
+                    fflush(stdout);
+                    ++n;
+                }
+                // a session that crashed leaves its block behind. the next one creates a new segment of the same name
+                else if (++stalled * interval >= 2000) {
+                    hwTelemetryUnmap(block);
+                    block = nullptr;
+                    stalled = 0;
+                }
+            }
+            else if (block->magic != hwTelemetryMagic) {
+                // closed, or not written yet
+                hwTelemetryUnmap(block);
+                block = nullptr;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+    hwTelemetryUnmap(block);
+}
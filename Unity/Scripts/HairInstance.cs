@@ -19,13 +19,17 @@ namespace UTJ
     {
         #region static
         static HashSet<HairInstance> s_instances;
-        static int s_nth_OnWillRenderObject;
+        static int s_simulated_frame = -1;
+        static Dictionary<Camera, int> s_recorded_frames = new Dictionary<Camera, int>();
 
-        static CommandBuffer s_command_buffer;
         static CommandBuffer s_command_bufferVR;
         static CommandBuffer s_command_bufferVR_singlePass;
         static HashSet<Camera> s_cameras = new HashSet<Camera>();
 
+        // native view slots. each non-VR camera owns one slot and a "Hair" command buffer that flushes it
+        static Camera[] s_view_cameras = new Camera[hwi.MaxViews];
+        static Dictionary<Camera, CommandBuffer> s_view_command_buffers = new Dictionary<Camera, CommandBuffer>();
+
         static public HashSet<HairInstance> GetInstances()
         {
             if (s_instances == null)
@@ -44,7 +48,13 @@ namespace UTJ
         public string m_hair_asset; 
         public string m_hair_shader         = "UTJ/HairWorksIntegration/DefaultHairShader.cso";
         public bool m_invert_bone_x         = true;
+        public bool m_apply_inv_bindpose    = false;
+        public hwi.SkinningMode m_skinning_mode = hwi.SkinningMode.Matrix;
         public bool use_default_parameters  = true;
+        // guide hair LOD levels built at load (hwAssetBuildLODChain()), each halving the control vertices. 0: off
+        public int m_guide_lod_levels       = 0;
+        // distance to the main camera at which each next level is used
+        public float m_guide_lod_distance   = 10.0f;
 
         private bool hairTexturesAssigned   = false;
 
@@ -54,13 +64,18 @@ namespace UTJ
         hwi.HShader m_hshader                   = hwi.HShader.NullHandle;
         hwi.HAsset m_hasset                     = hwi.HAsset.NullHandle;
         hwi.HInstance m_hinstance               = hwi.HInstance.NullHandle;
+        // m_params goes to the plugin through this block, written when they differ (WriteAllParams())
+        unsafe hwi.DescriptorBlock* m_descriptor = null;
 
         public Transform[] m_bones;
-        Matrix4x4[] m_inv_bindpose;
-        Matrix4x4[] m_skinning_matrices;
-        Matrix4x4[] m_bindpose;
-        IntPtr m_skinning_matrices_ptr;
-        Matrix4x4 m_conversion_matrix;
+
+        // bone world matrices of all instances, packed for hwUpdateSkinningBatch()
+        static hwi.SkinningBatchEntry[] s_skinning_entries = new hwi.SkinningBatchEntry[16];
+        static Matrix4x4[] s_bone_world = new Matrix4x4[256];
+
+        // skinning + simulation of the frame, and the view being recorded. each goes to the plugin in one hwSubmitFrame()
+        static hwi.FramePacket s_frame_packet = new hwi.FramePacket();
+        static hwi.FramePacket s_view_packet = new hwi.FramePacket();
 
         // texture used by this instance
         Texture2D [] m_hairTextures = new Texture2D[MAX_NUM_HAIR_TEXTURES];
@@ -123,6 +138,7 @@ namespace UTJ
             // release existing instance & asset
             if (m_hinstance)
             {
+                UnmapDescriptor();
                 hwi.hwInstanceRelease(m_hinstance);
                 m_hinstance = hwi.HInstance.NullHandle;
             }
@@ -141,7 +157,12 @@ namespace UTJ
             if (m_hasset)
             {
                 m_hair_asset = path_to_apx;
+                if (m_guide_lod_levels > 0)
+                {
+                    hwi.hwAssetBuildLODChain(m_hasset, m_guide_lod_levels);
+                }
                 m_hinstance = hwi.hwInstanceCreate(m_hasset);
+                MapDescriptor();
                 if (reset_params)
                 {
                     hwi.hwAssetGetDefaultDescriptor(m_hasset, ref m_params);
@@ -152,8 +173,6 @@ namespace UTJ
             if (reset_params)
             {
                 m_bones = null;
-                m_skinning_matrices = null;
-                m_skinning_matrices_ptr = IntPtr.Zero;
             }
 
             // update the bones
@@ -178,6 +197,74 @@ namespace UTJ
             RepaintWindow();
         }
 
+        unsafe void MapDescriptor()
+        {
+            m_descriptor = hwi.hwInstanceMapDescriptor(m_hinstance);
+        }
+
+        unsafe void UnmapDescriptor()
+        {
+            m_descriptor = null;
+        }
+
+        // the block is read by the plugin at the next hwBeginScene(). dirty is set only when m_params changed, whoever
+        // changed them (inspector, scripts). without a block, falls back to the copying setter
+        unsafe void WriteParams()
+        {
+            if (!m_hairSystemStarted || !m_hasset)
+                return;
+
+            if (m_saved_default_params == false)
+            {
+                hwi.hwInstanceGetDescriptor(m_hinstance, ref m_paramsProxy);
+                m_saved_default_params = true;
+            }
+
+            // force gravity down the Y axes
+            m_params.m_gravityDir.x = 0.0f;
+            m_params.m_gravityDir.y = -1.0f;
+            m_params.m_gravityDir.z = 0.0f;
+
+            if (m_descriptor != null)
+            {
+                if (ParamsChanged())
+                {
+                    m_descriptor->desc = m_params;
+                    m_descriptor->dirty = 1;
+                }
+            }
+            else
+            {
+                hwi.hwInstanceSetDescriptor(m_hinstance, ref m_params);
+            }
+        }
+
+        // m_params differs from the block. compares bytes: a difference in padding only costs one redundant dirty flag,
+        // the plugin compares member by member
+        unsafe bool ParamsChanged()
+        {
+            fixed (hwi.Descriptor* p = &m_params)
+            {
+                byte* a = (byte*)p;
+                byte* b = (byte*)&m_descriptor->desc;
+                for (int i = 0; i < sizeof(hwi.Descriptor); ++i)
+                {
+                    if (a[i] != b[i])
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        // every instance's descriptor goes before the frame packet, whose hwBeginScene() takes the blocks
+        static void WriteAllParams()
+        {
+            foreach (var a in GetInstances())
+            {
+                a.WriteParams();
+            }
+        }
+
         public void AssignTexture(hwi.TextureType type, Texture2D tex)
         {
             hwi.hwInstanceSetTexture(m_hinstance, type, tex.GetNativeTexturePtr());
@@ -205,58 +292,24 @@ namespace UTJ
                     m_root_bone = GetComponent<Transform>();
                 }
 
+                // first transform of each name wins, as GetComponentsInChildren() is depth first
                 var children = m_root_bone.GetComponentsInChildren<Transform>();
-                for (int i = 0; i < num_bones; ++i)
+                var by_name = new Dictionary<string, Transform>(children.Length);
+                foreach (var c in children)
                 {
-                    string name = hwi.hwAssetGetBoneNameString(m_hasset, i);
-                    m_bones[i] = Array.Find(children, (a) => { return a.name == name; });
-                    if (m_bones[i] == null) { m_bones[i] = m_root_bone; }
+                    if (!by_name.ContainsKey(c.name)) { by_name.Add(c.name, c); }
                 }
-            }
-
-            // prepare all the arrays with bones/matrices
-            if (m_skinning_matrices == null) 
-            {
-                m_inv_bindpose              = new Matrix4x4[num_bones];
-                m_skinning_matrices         = new Matrix4x4[num_bones];
-                m_bindpose                  = new Matrix4x4[num_bones];
 
-                m_skinning_matrices_ptr     = Marshal.UnsafeAddrOfPinnedArrayElement(m_skinning_matrices, 0);
+                var table = new hwi.BoneTableEntry[num_bones];
+                num_bones = Math.Min(hwi.hwAssetGetBoneTable(m_hasset, table, num_bones), num_bones);
                 for (int i = 0; i < num_bones; ++i)
                 {
-                    m_inv_bindpose[i] = Matrix4x4.identity;
-                    m_skinning_matrices[i] = Matrix4x4.identity;
-                    m_bindpose[i] = Matrix4x4.identity;
-                }
-
-                for (int i = 0; i < num_bones; ++i)
-                {
-                    hwi.hwAssetGetBindPose(m_hasset, i, ref m_bindpose[i]);
-                    m_inv_bindpose[i] = m_bindpose[i].inverse;
-                }
-                m_conversion_matrix = Matrix4x4.identity;
-                if (m_invert_bone_x)
-                {
-                    m_conversion_matrix *= Matrix4x4.Scale(new Vector3(-1.0f, 1.0f, 1.0f));
-                }
-            }
-
-            for (int i = 0; i < m_bones.Length; ++i)
-            {
-                var t = m_bones[i];
-                if (t != null)
-                {
-                    m_skinning_matrices[i] = t.localToWorldMatrix * m_conversion_matrix; 
-                    // original m_skinning_matrices[i] = t.localToWorldMatrix * m_conversion_matrix * m_inv_bindpose[i];
+                    Transform t;
+                    m_bones[i] = by_name.TryGetValue(table[i].GetName(), out t) ? t : m_root_bone;
                 }
             }
         }
 
-        public void FinishedRenderingHair()
-        {
-            s_nth_OnWillRenderObject = 0;
-        }
-
         /// <summary>
         /// Swap two values
         /// </summary>
@@ -307,6 +360,7 @@ namespace UTJ
 
         void OnDestroy()
         {
+            UnmapDescriptor();
             hwi.hwInstanceRelease(m_hinstance);
             hwi.hwAssetRelease(m_hasset);
         }
@@ -321,6 +375,7 @@ namespace UTJ
         void OnDisable()
         {
             m_params.m_enable = false;
+            WriteParams();
             GetInstances().Remove(this);
         }
 
@@ -331,59 +386,48 @@ namespace UTJ
             m_hairSystemStarted = true;
         }
 
+        void OnValidate()
+        {
+            if (m_skinning_mode == hwi.SkinningMode.DualQuaternion && m_invert_bone_x)
+            {
+                Debug.LogWarning("HairInstance: dual quaternions can't mirror the x axis. " + name + " uploads matrices while m_invert_bone_x is on.");
+            }
+        }
+
         void LateUpdate()
         {
+            UpdateGuideLOD();
             UpdateBones();
         }
 
-        public void HairRendering()
+        void UpdateGuideLOD()
         {
-            if (!m_hairSystemStarted)
+            if (!m_hinstance || m_guide_lod_levels <= 0 || m_guide_lod_distance <= 0.0f)
                 return;
 
-            if (!m_hasset)
+            var cam = Camera.main;
+            if (cam == null)
                 return;
 
-            if (m_saved_default_params == false)
+            float distance = Vector3.Distance(cam.transform.position, transform.position);
+            int level = Math.Min((int)(distance / m_guide_lod_distance), hwi.hwAssetGetNumLODs(m_hasset) - 1);
+            if (level != hwi.hwInstanceGetLOD(m_hinstance))
             {
-                hwi.hwInstanceGetDescriptor(m_hinstance, ref m_paramsProxy);
-                m_saved_default_params = true;
+                hwi.hwInstanceSetLOD(m_hinstance, level);
             }
+        }
 
-            // force gravity down the Y axes
-            m_params.m_gravityDir.x = 0.0f;
-            m_params.m_gravityDir.y = -1.0f;
-            m_params.m_gravityDir.z = 0.0f;
+        public void HairRendering()
+        {
+            if (!m_hairSystemStarted)
+                return;
 
-            if (m_saved_default_params == true)
-            {
-                hwi.hwInstanceSetDescriptor(m_hinstance, ref m_params);
-            }
+            if (!m_hasset)
+                return;
 
             RenderEntrypoint();
         }
 
-        // simulation
-        private void StepSimulation(Camera cam)
-        {
-            if (cam != null)
-            {
-                if (cam.stereoEnabled == true)
-                {
-                    bool singlePassVR = SinglePassVRRendering();
-                    hwi.hwStepSimulation(Time.deltaTime, true, singlePassVR);
-                }
-                else
-                {
-                    hwi.hwStepSimulation(Time.deltaTime, false, false);
-                }
-            }
-            else
-            {
-                hwi.hwStepSimulation(Time.deltaTime, false, false);
-            }
-        }
-
         // the main entrypoing for hair rendering
         public void RenderEntrypoint()
         {
@@ -398,29 +442,81 @@ namespace UTJ
             }
 
             // check if this is a stereo rendering camera
-            bool vrMode = Camera.current.stereoEnabled;
-             
-            if (s_nth_OnWillRenderObject++ == 0)
+            bool vrMode = cam.stereoEnabled;
+
+            // each camera records its view once per frame
+            int frame = Time.frameCount;
+            int recorded;
+            if (s_recorded_frames.TryGetValue(cam, out recorded) && recorded == frame)
+                return;
+
+            if (!vrMode && GetViewSlot(cam) < 0)
             {
-                BeginRender(vrMode);
+                Debug.LogWarning("Max cameras rendering hair is " + hwi.MaxViews + ". Hair is not rendered for " + cam.name);
+                return;
+            }
+            s_recorded_frames[cam] = frame;
+
+            // skinning and simulation are recorded once per frame. the plugin replays them with the first view flushed
+            if (s_simulated_frame != frame)
+            {
+                s_simulated_frame = frame;
+                WriteAllParams();
+                s_frame_packet.Begin(vrMode, vrMode && SinglePassVRRendering());
 
                 // submit bones/skinning to hairworks
-                foreach (var a in GetInstances())
-                {
-                    a.SetBonesMatrices(vrMode);
-                }
+                SubmitSkinning(s_frame_packet);
 
                 // submit simulation step to hairworks
-                StepSimulation(Camera.current);
+                s_frame_packet.Step(Time.deltaTime);
 
-                // submit actualt rendering
-                foreach (var b in GetInstances())
-                {
-                    b.Render(vrMode);
-                }
+                s_frame_packet.Submit();
+
+                // log records of the plugin's threads are passed to the log callback here
+                hwi.hwDrainLog();
+            }
 
-                EndRender(vrMode);
+            BeginRender(vrMode);
+
+            // submit actualt rendering
+            foreach (var b in GetInstances())
+            {
+                b.Render(vrMode);
             }
+
+            EndRender(vrMode);
+        }
+
+        // returns the native view slot of cam, or -1 if all slots are taken
+        static int GetViewSlot(Camera cam)
+        {
+            int free_slot = -1;
+            for (int i = 0; i < s_view_cameras.Length; ++i)
+            {
+                if (s_view_cameras[i] == cam)
+                    return i;
+
+                // destroyed cameras compare equal to null, so their slots are reused
+                if (free_slot < 0 && s_view_cameras[i] == null)
+                    free_slot = i;
+            }
+
+            if (free_slot >= 0)
+                s_view_cameras[free_slot] = cam;
+            return free_slot;
+        }
+
+        static CommandBuffer GetViewCommandBuffer(Camera cam)
+        {
+            CommandBuffer cb;
+            if (!s_view_command_buffers.TryGetValue(cam, out cb))
+            {
+                cb = new CommandBuffer();
+                cb.name = "Hair";
+                cb.IssuePluginEvent(hwi.hwGetRenderEventFunc(), hwi.hwGetViewEventID(GetViewSlot(cam)));
+                s_view_command_buffers.Add(cam, cb);
+            }
+            return cb;
         }
 
         // are we using deferred rendering
@@ -458,12 +554,17 @@ namespace UTJ
         {
             foreach (var c in s_cameras)
             {
-                if (c != null)
+                CommandBuffer cb;
+                if (c != null && s_view_command_buffers.TryGetValue(c, out cb))
                 {
-                    c.RemoveCommandBuffer(s_timing, s_command_buffer);
+                    c.RemoveCommandBuffer(s_timing, cb);
+                    c.RemoveCommandBuffer(s_timingSceneCamera, cb);
                 }
             }
             s_cameras.Clear();
+            s_view_command_buffers.Clear();
+            s_recorded_frames.Clear();
+            Array.Clear(s_view_cameras, 0, s_view_cameras.Length);
         }
 
         //
@@ -472,13 +573,6 @@ namespace UTJ
             if (!m_hairSystemStarted)
                 return;
 
-            if (s_command_buffer == null)
-            {
-                s_command_buffer = new CommandBuffer();
-                s_command_buffer.name = "Hair";
-                s_command_buffer.IssuePluginEvent(hwi.hwGetRenderEventFunc(), 0);
-            }
-
             if (s_command_bufferVR == null)
             {
                 s_command_bufferVR = new CommandBuffer();
@@ -493,11 +587,13 @@ namespace UTJ
                 s_command_bufferVR_singlePass.IssuePluginEvent(hwi.hwGetRenderEventFunc(), 2);
             }
 
+            s_view_packet.Begin(vrMode, false);
+
             Camera cam = Camera.current;
 
             if (cam != null)
             {
-                // set camera and projection matrix for hairworks
+                // set camera and projection matrix for hairworks. this also selects the view slot being recorded
                 SetCameraProjectionMatrix(cam);
 
                 // set light data
@@ -514,14 +610,46 @@ namespace UTJ
                 }
 
             }
-
-            hwi.hwBeginScene(vrMode);
         }
 
-        //
-        void SetBonesMatrices(bool vrMode)
+        // packs the bone transforms of all instances into one skinning record of packet.
+        // the plugin applies the x mirror and the inverse bind pose
+        static void SubmitSkinning(hwi.FramePacket packet)
         {
-            hwi.hwInstanceUpdateSkinningMatricesAsync(m_hinstance, m_skinning_matrices.Length, m_skinning_matrices_ptr, vrMode);
+            int num_entries = 0;
+            int num_bones = 0;
+            foreach (var a in GetInstances())
+            {
+                if (!a.m_hinstance || a.m_bones == null) { continue; }
+
+                if (num_entries == s_skinning_entries.Length)
+                {
+                    Array.Resize(ref s_skinning_entries, num_entries * 2);
+                }
+                if (num_bones + a.m_bones.Length > s_bone_world.Length)
+                {
+                    Array.Resize(ref s_bone_world, Math.Max(s_bone_world.Length * 2, num_bones + a.m_bones.Length));
+                }
+
+                s_skinning_entries[num_entries].instance    = a.m_hinstance;
+                s_skinning_entries[num_entries].first_bone  = num_bones;
+                s_skinning_entries[num_entries].num_bones   = a.m_bones.Length;
+                s_skinning_entries[num_entries].flags       =
+                    (a.m_invert_bone_x ? hwi.SkinningFlag_MirrorX : 0) |
+                    (a.m_apply_inv_bindpose ? hwi.SkinningFlag_InvBindPose : 0) |
+                    (a.m_skinning_mode == hwi.SkinningMode.DualQuaternion ? hwi.SkinningFlag_DualQuaternion : 0);
+                ++num_entries;
+
+                foreach (var t in a.m_bones)
+                {
+                    s_bone_world[num_bones++] = t != null ? t.localToWorldMatrix : Matrix4x4.identity;
+                }
+            }
+
+            if (num_entries > 0)
+            {
+                packet.UpdateSkinningBatch(num_entries, s_skinning_entries, s_bone_world);
+            }
         }
 
         //
@@ -533,7 +661,7 @@ namespace UTJ
             if (!m_hasset)
                 return; 
 
-            hwi.hwSetShader(m_hshader, vrMode);
+            s_view_packet.SetShader(m_hshader);
 
             if (hairTexturesAssigned == false)
             {
@@ -542,7 +670,7 @@ namespace UTJ
             }
 
             // render
-            hwi.hwRender(m_hinstance, vrMode);
+            s_view_packet.Draw(m_hinstance);
         }
 
         //
@@ -551,7 +679,7 @@ namespace UTJ
             if (!m_hairSystemStarted)
                 return;
 
-            hwi.hwEndScene(vrMode);
+            s_view_packet.Submit();
         }
 
         //
@@ -625,11 +753,11 @@ namespace UTJ
                 if (IsUnitySceneCamera(cam) && IsUnityVersion("5.6"))
                 {
                     // Unity's scene camera has to use different timing because don't do after effects
-                    cam.AddCommandBuffer(s_timingSceneCamera, s_command_buffer);
+                    cam.AddCommandBuffer(s_timingSceneCamera, GetViewCommandBuffer(cam));
                 }
                 else
                 {
-                    cam.AddCommandBuffer(s_timing, s_command_buffer);
+                    cam.AddCommandBuffer(s_timing, GetViewCommandBuffer(cam));
                 }
             }
         }
@@ -679,7 +807,7 @@ namespace UTJ
                 if (camBuffer[0].name != "Hair")
                 {
                     cam.RemoveAllCommandBuffers();
-                    cam.AddCommandBuffer(s_timing, s_command_buffer);
+                    cam.AddCommandBuffer(s_timing, GetViewCommandBuffer(cam));
                 }
             }
         }
@@ -731,14 +859,14 @@ namespace UTJ
                 Matrix4x4 Vr = cam.GetStereoViewMatrix(Camera.StereoscopicEye.Right);
                 Matrix4x4 Pr = GL.GetGPUProjectionMatrix(cam.GetStereoProjectionMatrix(Camera.StereoscopicEye.Right), DoesRenderToTexture(cam));
          
-                hwi.hwSetViewProjectionStereo(ref Vl, ref Pl, ref Vr, ref Pr, fov, singlePassStereoRender);
+                s_view_packet.SetViewProjectionStereo(ref Vl, ref Pl, ref Vr, ref Pr, fov, singlePassStereoRender);
                 
             }
             else
             {
                 Matrix4x4 V = cam.worldToCameraMatrix;
                 Matrix4x4 P = GL.GetGPUProjectionMatrix(cam.projectionMatrix, DoesRenderToTexture(cam));
-                hwi.hwSetViewProjection(ref V, ref P, fov);
+                s_view_packet.SetViewProjection(GetViewSlot(cam), ref V, ref P, fov);
             }
         }
 
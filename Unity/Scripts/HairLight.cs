@@ -14,8 +14,7 @@ namespace UTJ
     {
         #region static
         static HashSet<HairLight> s_instances;
-        static hwi.LightData[] s_light_data;
-        static IntPtr s_light_data_ptr;
+        static HairLight[] s_shadow_slots = new HairLight[hwi.LightData.MaxShadowLights];
 
         static public HashSet<HairLight> GetInstances()
         {
@@ -26,23 +25,15 @@ namespace UTJ
             return s_instances;
         }
 
+        // lights are registered in the plugin, which picks the most influential ones for each hair instance.
+        // unchanged lights are ignored by the plugin, so updating all of them every frame is cheap.
         static public void AssignLightData(bool vrMode)
         {
-            if (s_light_data == null)
+            foreach (var l in GetInstances())
             {
-                s_light_data = new hwi.LightData[hwi.LightData.MaxLights];
-                s_light_data_ptr = Marshal.UnsafeAddrOfPinnedArrayElement(s_light_data, 0);
+                l.UpdateLightData();
+                l.UpdateShadowViewProjection();
             }
-
-            var instances = GetInstances();
-            int n = Mathf.Min(instances.Count, hwi.LightData.MaxLights);
-            int i = 0;
-            foreach (var l in instances)
-            {
-                s_light_data[i] = l.GetLightData();
-                if (++i == n) { break; }
-            }
-            hwi.hwSetLights(n, s_light_data_ptr, vrMode);
         }
         #endregion
 
@@ -60,7 +51,12 @@ namespace UTJ
         public float m_range                = 10.0f;
         public Color m_color                = Color.white;
         public float m_intensity            = 1.0f;
+        public bool m_cast_hair_shadows     = true;
+        public float m_shadow_extent        = 10.0f;    // half size of the shadow volume for directional lights
+        public float m_shadow_near          = 0.1f;
         CommandBuffer m_cb;
+        int m_shadow_slot                   = -1;
+        hwi.HLight m_hlight                 = hwi.HLight.NullHandle;
 
         public CommandBuffer GetCommandBuffer()
         {
@@ -68,15 +64,82 @@ namespace UTJ
             {
                 m_cb = new CommandBuffer();
                 m_cb.name = "Hair Shadow";
+                if (m_shadow_slot >= 0)
+                {
+                    // renders all hair shadow casters for this light in one plugin event
+                    m_cb.IssuePluginEvent(hwi.hwGetRenderEventFunc(), hwi.hwGetShadowEventID(m_shadow_slot));
+                }
                 GetComponent<Light>().AddCommandBuffer(LightEvent.AfterShadowMap, m_cb);
             }
             return m_cb;
         }
 
+        void ReleaseCommandBuffer()
+        {
+            if (m_cb != null)
+            {
+                GetComponent<Light>().RemoveCommandBuffer(LightEvent.AfterShadowMap, m_cb);
+                m_cb.Release();
+                m_cb = null;
+            }
+        }
+
+        void AcquireShadowSlot()
+        {
+            for (int i = 0; i < s_shadow_slots.Length; ++i)
+            {
+                if (s_shadow_slots[i] == null)
+                {
+                    s_shadow_slots[i] = this;
+                    m_shadow_slot = i;
+                    return;
+                }
+            }
+            Debug.LogWarning("Max hair shadow casting HairLight is " + hwi.LightData.MaxShadowLights + ".");
+        }
+
+        void ReleaseShadowSlot()
+        {
+            if (m_shadow_slot >= 0)
+            {
+                s_shadow_slots[m_shadow_slot] = null;
+                m_shadow_slot = -1;
+            }
+        }
+
+        // view/projection used by the native shadow pass. same conventions as Camera.worldToCameraMatrix / GL.GetGPUProjectionMatrix()
+        void UpdateShadowViewProjection()
+        {
+            if (m_shadow_slot < 0) { return; }
+
+            var t = GetComponent<Transform>();
+            var l = GetComponent<Light>();
+            Matrix4x4 view = Matrix4x4.Scale(new Vector3(1.0f, 1.0f, -1.0f)) * Matrix4x4.TRS(t.position, t.rotation, Vector3.one).inverse;
+            Matrix4x4 proj;
+            float fov;
+            if (l.type == LightType.Spot)
+            {
+                proj = Matrix4x4.Perspective(l.spotAngle, 1.0f, m_shadow_near, l.range);
+                fov = l.spotAngle;
+            }
+            else if (l.type == LightType.Directional)
+            {
+                proj = Matrix4x4.Ortho(-m_shadow_extent, m_shadow_extent, -m_shadow_extent, m_shadow_extent, -m_shadow_extent, m_shadow_extent);
+                fov = 70.0f;
+            }
+            else
+            {
+                // point light shadows (cube maps) are not supported
+                return;
+            }
+            proj = GL.GetGPUProjectionMatrix(proj, true);
+            hwi.hwSetShadowViewProjection(m_shadow_slot, ref view, ref proj, fov);
+        }
+
         public hwi.LightData GetLightData()
         {
             var t = GetComponent<Transform>();
-            m_data.type = (int)m_type;
+            m_data.type = (int)(m_type == LightType.Directional ? Type.Directional : Type.Point); // spot lights are lit as point lights
             m_data.range = m_range;
             m_data.color = new Color(m_color.r * m_intensity, m_color.g * m_intensity, m_color.b * m_intensity, 0.0f);
             m_data.position = t.position;
@@ -84,19 +147,42 @@ namespace UTJ
             return m_data;
         }
 
+        void UpdateLightData()
+        {
+            var data = GetLightData();
+            if (m_hlight)
+            {
+                hwi.hwLightUpdate(m_hlight, ref data);
+            }
+            else
+            {
+                m_hlight = hwi.hwLightCreate(ref data);
+            }
+        }
+
 
         void OnEnable()
         {
             GetInstances().Add(this);
-            if (GetInstances().Count > hwi.LightData.MaxLights)
+            UpdateLightData();
+
+            if (m_cast_hair_shadows)
             {
-                Debug.LogWarning("Max HairLight is " + hwi.LightData.MaxLights + ". Current active HairLight is " + GetInstances().Count);
+                AcquireShadowSlot();
+                GetCommandBuffer();
             }
         }
 
         void OnDisable()
         {
             GetInstances().Remove(this);
+            if (m_hlight)
+            {
+                hwi.hwLightRelease(m_hlight);
+                m_hlight = hwi.HLight.NullHandle;
+            }
+            ReleaseCommandBuffer();
+            ReleaseShadowSlot();
         }
 
         void Update()
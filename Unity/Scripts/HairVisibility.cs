@@ -27,11 +27,6 @@ namespace UTJ
             RenderHairInstances();
         }
 
-        void OnRenderObject() 
-        {
-            EndRenderHairInstances();
-        }
-
         private void RenderHairInstances()
         {
             GetHairInstance();
@@ -39,13 +34,6 @@ namespace UTJ
                 hairInstance.HairRendering();
         }
 
-        private void EndRenderHairInstances()
-        {
-            GetHairInstance();
-            if (hairInstance)
-                hairInstance.FinishedRenderingHair();
-        }
-
         private void GetHairInstance()
         {
             if (hairInstance == null)
@@ -13,6 +13,8 @@ namespace UTJ
 
     public static class hwi
     {
+        public const int MaxViews = 8;     // must match hwMaxViews in C++
+        public const int MaxRecordingThreads = 64; // must match hwMaxRecordingThreads in C++
 
         [System.Serializable]
         public struct HShader
@@ -53,6 +55,19 @@ namespace UTJ
             public static implicit operator bool(HInstance v) { return v.id != 0xFFFFFFFF; }
         }
 
+        [System.Serializable]
+        public struct HLight
+        {
+            public static HLight NullHandle = new HLight(0xFFFFFFFF);
+
+            public uint id;
+
+            public HLight(uint v) { this.id = v; }
+            public static implicit operator HLight(uint v) { return new HLight(v); }
+            public static implicit operator uint(HLight v) { return v.id; }
+            public static implicit operator bool(HLight v) { return v.id != 0xFFFFFFFF; }
+        }
+
         // C# では bool は 1 byte なのに marshaling の際は 4 byte のデータに変換される。
         // (WinAPI の BOOL = 4 byte への変換を意図しているためらしい)
         // 一方 C++ の bool は、標準はサイズを規定していないものの、大抵 1 byte であり、VisualC++ でもそうなっている。
@@ -395,6 +410,15 @@ namespace UTJ
             }
         }
 
+        // the descriptor of an instance in plugin memory (hwInstanceMapDescriptor()). write desc in place, then set dirty.
+        // must match hwDescriptorBlock in C++
+        public struct DescriptorBlock
+        {
+            public Descriptor desc;
+            public int dirty;
+            public uint generation;    // bumped every time the plugin takes a change
+        }
+
         [System.Serializable]
         public struct ConversionSettings
         {
@@ -425,7 +449,8 @@ namespace UTJ
         [System.Serializable]
         public struct LightData
         {
-            public const int MaxLights = 8;
+            public const int MaxLights = 8;    // max lights per hair instance. the plugin picks the most influential ones
+            public const int MaxShadowLights = 8;
 
             public int type;
             int pad0, pad2, pad3;
@@ -437,6 +462,94 @@ namespace UTJ
         }
 
 
+        // one bone of hwAssetGetBoneTable(). must match hwBoneTableEntry in C++
+        [System.Serializable]
+        public unsafe struct BoneTableEntry
+        {
+            public const int MaxName = 128;
+
+            public Matrix4x4 bindpose;
+            public int index;
+            public int parent; // always -1 for now
+            public fixed byte name[MaxName];
+
+            public string GetName()
+            {
+                fixed (byte* p = name) { return Marshal.PtrToStringAnsi((IntPtr)p); }
+            }
+        }
+
+        // what an asset costs. filled by hwAssetGetInfo(). must match hwAssetInfo in C++
+        [System.Serializable]
+        public struct AssetInfo
+        {
+            public int num_guide_hairs;
+            public int num_guide_vertices;
+            public int num_faces;
+            public int num_bones;
+            public int num_render_hairs;
+            public float average_cvs;
+            public float average_density;
+            public float average_hairs_per_face;
+        }
+
+        // must match hwSkinningFlags in C++
+        public const int SkinningFlag_MirrorX        = 1;
+        public const int SkinningFlag_InvBindPose    = 2;
+        public const int SkinningFlag_DualQuaternion = 4;
+
+        public enum SkinningMode
+        {
+            Matrix,
+            DualQuaternion, // half the upload size, no candy-wrapper artifacts. scale is dropped. can't mirror x: instances with m_invert_bone_x upload matrices
+        }
+
+        // one instance of hwUpdateSkinningBatch(). must match hwSkinningBatchEntry in C++
+        [System.Serializable]
+        public struct SkinningBatchEntry
+        {
+            public HInstance instance;
+            public int first_bone;
+            public int num_bones;
+            public int flags;
+        }
+
+        // counters are accumulated since the plugin was initialized. must match hwStats in C++
+        [System.Serializable]
+        public struct Stats
+        {
+            public int num_descriptor_updates;
+            public int num_descriptor_updates_skipped;
+            public int num_shadow_casters_rendered;
+            public int num_shadow_casters_culled;
+            public int num_simulation_steps;
+            public int num_frame_segments;
+            public int num_view_flushes;
+            public int num_simulation_frames;
+            public int num_simulation_frames_dropped;
+            public float simulation_time_dropped;
+            public int num_sleeping_instances;
+            public int num_simulation_wakeups;
+            public int num_instance_steps_saved;
+            public int num_draws_culled;
+            public long num_vertex_steps_saved;
+            public int num_throttled_instances;
+            public int num_budget_group_steps;
+            public int num_skinning_uploads_skipped;
+            public long num_skinning_bytes_saved;
+            public int num_lod_switches;
+            public long asset_resident_bytes;
+            public int num_assets_cached;
+            public int num_asset_evictions;
+            public int num_asset_reloads;
+            public float asset_reload_time;
+            public int num_frame_packets;
+            public int num_frame_packets_rejected;
+            public int num_thread_recordings;
+            public int num_thread_commands;
+        }
+
+
         public enum UpAxis
         {
             Unknown,
@@ -501,6 +614,14 @@ namespace UTJ
 
         [DllImport("HairWorksIntegration")] public static extern IntPtr     hwGetRenderEventFunc();
         [DllImport("HairWorksIntegration")] public static extern void       hwSetLogCallback(hwLogCallback cb);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetLogLevel(int level);
+        [DllImport("HairWorksIntegration")] public static extern int        hwDrainLog();
+        [DllImport("HairWorksIntegration")] public static extern void       hwGetStats(ref Stats o_stats);
+        [DllImport("HairWorksIntegration")] public static extern void       hwTraceBegin();
+        [DllImport("HairWorksIntegration")] public static extern void       hwTraceEnd();
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwTraceDump(string path);
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwTelemetryOpen(string name, int max_instances);
+        [DllImport("HairWorksIntegration")] public static extern void       hwTelemetryClose();
 
         [DllImport("HairWorksIntegration")] public static extern HShader    hwShaderLoadFromFile(string path);
         [DllImport("HairWorksIntegration")] public static extern BoolUTJ hwShaderRelease(HShader sid);
@@ -512,6 +633,14 @@ namespace UTJ
         [DllImport("HairWorksIntegration")] public static extern int        hwAssetGetNumBones(HAsset aid);
         [DllImport("HairWorksIntegration")] private static extern IntPtr    hwAssetGetBoneName(HAsset aid, int nth);
         public static string hwAssetGetBoneNameString(HAsset aid, int nth) { return Marshal.PtrToStringAnsi(hwAssetGetBoneName(aid, nth)); }
+        [DllImport("HairWorksIntegration")] public static extern int        hwAssetGetBoneTable(HAsset aid, [Out] BoneTableEntry[] dst, int max_entries);
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwAssetSetBoneRemapping(HAsset aid, int num_bones, [MarshalAs(UnmanagedType.LPArray, ArraySubType = UnmanagedType.LPStr)] string[] bone_names);
+
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwAssetGetInfo(HAsset aid, ref AssetInfo o_info);
+        [DllImport("HairWorksIntegration")] public static extern int        hwAssetBuildLODChain(HAsset aid, int levels);
+        [DllImport("HairWorksIntegration")] public static extern int        hwAssetGetNumLODs(HAsset aid);
+        [DllImport("HairWorksIntegration")] public static extern long       hwAssetGetMemoryUsage(HAsset aid);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetAssetMemoryBudget(long bytes);
 
         [DllImport("HairWorksIntegration")] private static extern IntPtr hwAssetGetTextureName(HAsset aid, int textureType);
         public static string hwAssetGetTextureNameString(HAsset aid, int textureType) { return Marshal.PtrToStringAnsi(hwAssetGetTextureName(aid, textureType)); }
@@ -525,29 +654,248 @@ namespace UTJ
 
         [DllImport("HairWorksIntegration")] public static extern HInstance  hwInstanceCreate(HAsset aid);
         [DllImport("HairWorksIntegration")] public static extern BoolUTJ hwInstanceRelease(HInstance iid);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetLOD(HInstance iid, int level);
+        [DllImport("HairWorksIntegration")] public static extern int        hwInstanceGetLOD(HInstance iid);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceGetBounds(HInstance iid, ref Vector3 o_min, ref Vector3 o_max);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceGetDescriptor(HInstance iid, ref Descriptor desc);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptor(HInstance iid, ref Descriptor desc);
+        [DllImport("HairWorksIntegration")] public static extern unsafe DescriptorBlock* hwInstanceMapDescriptor(HInstance iid);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptorField(HInstance iid, int offset, int size, ref float data);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptorField(HInstance iid, int offset, int size, ref int data);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptorField(HInstance iid, int offset, int size, ref byte data);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptorField(HInstance iid, int offset, int size, ref Vector3 data);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetDescriptorField(HInstance iid, int offset, int size, ref Color data);
+        // field is the name of a Descriptor member. e.g. hwInstanceSetDescriptorField(iid, "m_width", 0.5f)
+        public static int hwDescriptorFieldOffset(string field) { return Marshal.OffsetOf(typeof(Descriptor), field).ToInt32(); }
+        public static void hwInstanceSetDescriptorField(HInstance iid, string field, float v) { hwInstanceSetDescriptorField(iid, hwDescriptorFieldOffset(field), 4, ref v); }
+        public static void hwInstanceSetDescriptorField(HInstance iid, string field, int v) { hwInstanceSetDescriptorField(iid, hwDescriptorFieldOffset(field), 4, ref v); }
+        public static void hwInstanceSetDescriptorField(HInstance iid, string field, bool v) { byte b = v ? (byte)1 : (byte)0; hwInstanceSetDescriptorField(iid, hwDescriptorFieldOffset(field), 1, ref b); }
+        public static void hwInstanceSetDescriptorField(HInstance iid, string field, Vector3 v) { hwInstanceSetDescriptorField(iid, hwDescriptorFieldOffset(field), 12, ref v); }
+        public static void hwInstanceSetDescriptorField(HInstance iid, string field, Color v) { hwInstanceSetDescriptorField(iid, hwDescriptorFieldOffset(field), 16, ref v); }
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetTexture(HInstance iid, TextureType type, IntPtr tex);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceSetTextureIntoDevice(HInstance iid, TextureType type);
 
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceUpdateSkinningMatrices(HInstance iid, int num_bones, IntPtr matrices);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceUpdateSkinningMatricesAsync(HInstance iid, int num_bones, IntPtr matrices, bool vrMode);
         [DllImport("HairWorksIntegration")] public static extern void       hwInstanceUpdateSkinningDQs(HInstance iid, int num_bones, IntPtr dqs);
+        [DllImport("HairWorksIntegration")] public static extern void       hwInstanceUpdateSkinningDQsAsync(HInstance iid, int num_bones, IntPtr dqs, bool vrMode);
+        [DllImport("HairWorksIntegration")] public static extern void       hwUpdateSkinningBatch(int num_entries, SkinningBatchEntry[] entries, Matrix4x4[] world, bool vrMode);
 
         [DllImport("HairWorksIntegration")] public static extern void       hwBeginScene(bool vrMode);
         [DllImport("HairWorksIntegration")] public static extern void       hwEndScene(bool vrMode);
-        [DllImport("HairWorksIntegration")] public static extern void       hwSetViewProjection(ref Matrix4x4 view, ref Matrix4x4 proj, float fov);
+        [DllImport("HairWorksIntegration")] public static extern unsafe BoolUTJ hwSubmitFrame(byte* packet, int size);
+        // from jobs: hwRender(), hwRenderShadow() and the skinning calls in between go to the thread's own command buffer
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwBeginThreadRecording(bool vrMode);
+        [DllImport("HairWorksIntegration")] public static extern BoolUTJ    hwEndThreadRecording();
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetViewProjection(int slot, ref Matrix4x4 view, ref Matrix4x4 proj, float fov);
+        [DllImport("HairWorksIntegration")] public static extern int        hwGetViewEventID(int slot);
         [DllImport("HairWorksIntegration")] public static extern void       hwSetViewProjectionStereo(ref Matrix4x4 view, ref Matrix4x4 proj, ref Matrix4x4 view2, ref Matrix4x4 proj2, float fov, bool singlePassStereo);
         [DllImport("HairWorksIntegration")] public static extern void       hwSetRenderTarget(IntPtr framebuffer, IntPtr depthbuffer, bool vrMode);
         [DllImport("HairWorksIntegration")] public static extern void       hwSetShader(HShader sid, bool vrMode);
         [DllImport("HairWorksIntegration")] public static extern void       hwSetLights(int num_lights, IntPtr lights, bool vrMode);
+        [DllImport("HairWorksIntegration")] public static extern HLight     hwLightCreate(ref LightData light);
+        [DllImport("HairWorksIntegration")] public static extern void       hwLightUpdate(HLight hl, ref LightData light);
+        [DllImport("HairWorksIntegration")] public static extern void       hwLightRelease(HLight hl);
         [DllImport("HairWorksIntegration")] public static extern void       hwRender(HInstance iid, bool vrMode);
         [DllImport("HairWorksIntegration")] public static extern void       hwRenderShadow(HInstance iid, bool vrMode);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetShadowViewProjection(int light, ref Matrix4x4 view, ref Matrix4x4 proj, float fov);
+        [DllImport("HairWorksIntegration")] public static extern int        hwGetShadowEventID(int light);
         [DllImport("HairWorksIntegration")] public static extern void       hwStepSimulation(float dt, bool vrMode, bool singlePassVR);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetSimulationTimestep(float fixed_dt, int max_substeps);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetSimulationBudget(int budget, bool cost_in_vertices);
+        [DllImport("HairWorksIntegration")] public static extern void       hwSetSimulationSleep(bool enabled, float sleep_distance, float wake_distance, int sleep_delay_frames, int warmup_substeps);
         [DllImport("HairWorksIntegration")] public static extern void       hwEnableVRRendering(bool enable);
         [DllImport("HairWorksIntegration")] public static extern void       hwSetShuttingDownFlag();
 
+        // builds the packet of hwSubmitFrame(): what a hwBeginScene() .. hwEndScene() bracket records, sent in one call.
+        // the buffer is reused from frame to frame. must match hwFramePacket.h in C++
+        public unsafe class FramePacket
+        {
+            const uint Magic            = 0x50465748; // "HWFP"
+            const uint Version          = 1;
+            const int HeaderSize        = 32;
+            const int RecordHeaderSize  = 8;
+            const uint Flag_VR              = 1;
+            const uint Flag_SinglePassVR    = 2;
+
+            const int Record_ViewProjection         = 1;
+            const int Record_ViewProjectionStereo   = 2;
+            const int Record_Lights                 = 3;
+            const int Record_Shader                 = 4;
+            const int Record_Skinning               = 5;
+            const int Record_DescriptorField        = 6;
+            const int Record_Step                   = 7;
+            const int Record_Draws                  = 8;
+
+            byte[] m_buffer = new byte[4096];
+            int m_size;
+            int m_num_records;
+            uint m_flags;
+            int m_draws = -1;           // offset of the last record if it is a Draws record, to append to it
+            bool m_draws_shadow;
+            HShader m_shader;
+
+            public int size { get { return m_size; } }
+
+            public void Begin(bool vrMode, bool singlePassVR)
+            {
+                m_size = HeaderSize;
+                m_num_records = 0;
+                m_flags = (vrMode ? Flag_VR : 0) | (vrMode && singlePassVR ? Flag_SinglePassVR : 0);
+                m_draws = -1;
+                m_shader = HShader.NullHandle;
+            }
+
+            public void SetViewProjection(int slot, ref Matrix4x4 view, ref Matrix4x4 proj, float fov)
+            {
+                byte* p = stackalloc byte[136];
+                *(int*)p = slot;
+                *(float*)(p + 4) = fov;
+                *(Matrix4x4*)(p + 8) = view;
+                *(Matrix4x4*)(p + 72) = proj;
+                AddRecord(Record_ViewProjection, p, 136);
+            }
+
+            public void SetViewProjectionStereo(ref Matrix4x4 view, ref Matrix4x4 proj, ref Matrix4x4 view2, ref Matrix4x4 proj2, float fov, bool singlePassStereo)
+            {
+                byte* p = stackalloc byte[264];
+                *(float*)p = fov;
+                *(int*)(p + 4) = singlePassStereo ? 1 : 0;
+                *(Matrix4x4*)(p + 8) = view;
+                *(Matrix4x4*)(p + 72) = proj;
+                *(Matrix4x4*)(p + 136) = view2;
+                *(Matrix4x4*)(p + 200) = proj2;
+                AddRecord(Record_ViewProjectionStereo, p, 264);
+            }
+
+            public void SetLights(int num_lights, LightData[] lights)
+            {
+                int o = AddRecord(Record_Lights, null, 16 + sizeof(LightData) * num_lights);
+                fixed (byte* b = m_buffer)
+                {
+                    *(int*)(b + o) = num_lights;
+                    var dst = (LightData*)(b + o + 16);
+                    for (int i = 0; i < num_lights; ++i) { dst[i] = lights[i]; }
+                }
+            }
+
+            // consecutive calls with the same shader are recorded once
+            public void SetShader(HShader sid)
+            {
+                if (m_shader.id == sid.id) { return; }
+                m_shader = sid;
+                AddRecord(Record_Shader, (byte*)&sid, 4);
+            }
+
+            // the bone ranges of entries index world, as with hwUpdateSkinningBatch()
+            public void UpdateSkinningBatch(int num_entries, SkinningBatchEntry[] entries, Matrix4x4[] world)
+            {
+                int num_matrices = 0;
+                for (int i = 0; i < num_entries; ++i) { num_matrices = Math.Max(num_matrices, entries[i].first_bone + entries[i].num_bones); }
+
+                int o = AddRecord(Record_Skinning, null, 8 + sizeof(SkinningBatchEntry) * num_entries + sizeof(Matrix4x4) * num_matrices);
+                fixed (byte* b = m_buffer)
+                {
+                    *(int*)(b + o) = num_entries;
+                    *(int*)(b + o + 4) = num_matrices;
+                    var e = (SkinningBatchEntry*)(b + o + 8);
+                    for (int i = 0; i < num_entries; ++i) { e[i] = entries[i]; }
+                    var m = (Matrix4x4*)(e + num_entries);
+                    for (int i = 0; i < num_matrices; ++i) { m[i] = world[i]; }
+                }
+            }
+
+            public void SetDescriptorField(HInstance iid, int offset, int size, byte* data)
+            {
+                int o = AddRecord(Record_DescriptorField, null, 12 + size);
+                fixed (byte* b = m_buffer)
+                {
+                    *(HInstance*)(b + o) = iid;
+                    *(int*)(b + o + 4) = offset;
+                    *(int*)(b + o + 8) = size;
+                    for (int i = 0; i < size; ++i) { b[o + 12 + i] = data[i]; }
+                }
+            }
+            // field is the name of a Descriptor member, as with hwInstanceSetDescriptorField()
+            public void SetDescriptorField(HInstance iid, string field, float v) { SetDescriptorField(iid, hwDescriptorFieldOffset(field), 4, (byte*)&v); }
+            public void SetDescriptorField(HInstance iid, string field, int v) { SetDescriptorField(iid, hwDescriptorFieldOffset(field), 4, (byte*)&v); }
+            public void SetDescriptorField(HInstance iid, string field, bool v) { byte b = v ? (byte)1 : (byte)0; SetDescriptorField(iid, hwDescriptorFieldOffset(field), 1, &b); }
+            public void SetDescriptorField(HInstance iid, string field, Vector3 v) { SetDescriptorField(iid, hwDescriptorFieldOffset(field), 12, (byte*)&v); }
+            public void SetDescriptorField(HInstance iid, string field, Color v) { SetDescriptorField(iid, hwDescriptorFieldOffset(field), 16, (byte*)&v); }
+
+            // vrMode and singlePassVR of hwStepSimulation() come from Begin()
+            public void Step(float dt)
+            {
+                AddRecord(Record_Step, (byte*)&dt, 4);
+            }
+
+            // consecutive draws go in one record
+            public void Draw(HInstance iid, bool shadow = false)
+            {
+                if (m_draws < 0 || m_draws_shadow != shadow)
+                {
+                    int o = AddRecord(Record_Draws, null, 8);
+                    fixed (byte* b = m_buffer)
+                    {
+                        *(int*)(b + o) = 0;
+                        *(int*)(b + o + 4) = shadow ? 1 : 0;
+                    }
+                    m_draws = o - RecordHeaderSize;
+                    m_draws_shadow = shadow;
+                }
+                Reserve(4);
+                fixed (byte* b = m_buffer)
+                {
+                    *(HInstance*)(b + m_size) = iid;
+                    *(int*)(b + m_draws + 4) += 4;                      // record size
+                    *(int*)(b + m_draws + RecordHeaderSize) += 1;       // num_instances
+                }
+                m_size += 4;
+            }
+
+            public bool Submit()
+            {
+                fixed (byte* b = m_buffer)
+                {
+                    var h = (uint*)b;
+                    h[0] = Magic;
+                    h[1] = Version;
+                    h[2] = (uint)m_size;
+                    h[3] = (uint)m_num_records;
+                    h[4] = m_flags;
+                    h[5] = h[6] = h[7] = 0;
+                    return hwSubmitFrame(b, m_size);
+                }
+            }
+
+            void Reserve(int size)
+            {
+                if (m_size + size > m_buffer.Length)
+                {
+                    Array.Resize(ref m_buffer, Math.Max(m_buffer.Length * 2, m_size + size));
+                }
+            }
+
+            // returns the offset of the payload. data may be null to fill it in place
+            int AddRecord(int type, byte* data, int size)
+            {
+                int padded = (size + 3) & ~3;
+                Reserve(RecordHeaderSize + padded);
+                int o = m_size + RecordHeaderSize;
+                fixed (byte* b = m_buffer)
+                {
+                    *(int*)(b + m_size) = type;
+                    *(int*)(b + m_size + 4) = size;
+                    for (int i = 0; i < size && data != null; ++i) { b[o + i] = data[i]; }
+                    for (int i = size; i < padded; ++i) { b[o + i] = 0; }
+                }
+                m_size += RecordHeaderSize + padded;
+                ++m_num_records;
+                m_draws = -1;
+                return o;
+            }
+        }
+
         static void LogCallback(System.IntPtr cstr)
         {
             Debug.Log(Marshal.PtrToStringAnsi(cstr));
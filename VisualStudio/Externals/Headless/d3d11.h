@@ -0,0 +1,36 @@
+#pragma once
+// Stand-in for the Windows SDK d3d11.h on non-Windows builds (see CMakeLists.txt).
+// GFSDK_HairWorks.h and the plugin headers only pass D3D11 objects around by pointer,
+// so opaque types are enough. Everything that actually talks to D3D11 lives in hwRenderDeviceD3D11.cpp.
+// The loader stubs make GFSDK_LoadHairSDK() fail cleanly; hwContext falls back to hwStubSDK.
+
+#ifdef _WIN32
+    #error "Externals/Headless must not be in the include path of Windows builds"
+#endif
+
+#include <cstddef>
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Resource;
+struct ID3D11Texture2D;
+struct ID3D11Buffer;
+struct ID3D11ShaderResourceView;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11PixelShader;
+struct ID3D11SamplerState;
+struct ID3D11DepthStencilState;
+struct ID3D11RasterizerState;
+
+#ifndef __cdecl
+    #define __cdecl
+#endif
+#ifndef __stdcall
+    #define __stdcall
+#endif
+
+typedef void* HMODULE;
+inline HMODULE LoadLibraryA(const char*) { return nullptr; }
+inline void* GetProcAddress(HMODULE, const char*) { return nullptr; }
+inline int FreeLibrary(HMODULE) { return 0; }
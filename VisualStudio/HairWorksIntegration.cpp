@@ -1,24 +1,28 @@
 ﻿#include "pch.h"
 #include "hwInternal.h"
 #include "hwContext.h"
+#include "hwTrace.h"
+#include "hwRenderDevice.h"
 #include "IUnityGraphics.h"
 
 struct hwPluginContext
 {
     IUnityInterfaces    *unity_interface;
     IUnityGraphics      *unity_graphics;
+#ifdef hwWindows
     IUnityGraphicsD3D11 *unity_graphics_d3d11;
+#endif // hwWindows
     ID3D11Device        *d3d11_device;
     hwContext           *hw_ctx;
-    hwLogCallback       log_callback;
 
     hwPluginContext()
         : unity_interface(nullptr)
         , unity_graphics(nullptr)
+#ifdef hwWindows
         , unity_graphics_d3d11(nullptr)
+#endif // hwWindows
         , d3d11_device(nullptr)
         , hw_ctx(nullptr)
-        , log_callback(nullptr)
     {}
 };
 hwPluginContext g_ctx;
@@ -28,7 +32,6 @@ hwPluginContext g_ctx;
 #define g_unity_graphics_d3d11  g_ctx.unity_graphics_d3d11
 #define g_d3d11_device          g_ctx.d3d11_device
 #define g_hw_ctx                g_ctx.hw_ctx
-#define g_log_callback          g_ctx.log_callback
 
 
 static void UNITY_INTERFACE_API UnityOnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType)
@@ -40,23 +43,35 @@ static void UNITY_INTERFACE_API UnityOnGraphicsDeviceEvent(UnityGfxDeviceEventTy
 
 static void UNITY_INTERFACE_API UnityRenderEvent(int eventID)
 {
-    if (eventID == 0) {
+    if (eventID == hwFlushEventID) {
         if (auto ctx = hwGetContext()) {
             ctx->flush();
         }
     }
-	else if (eventID == 1)
+	else if (eventID == hwFlushVREventID)
 	{
 		if (auto ctx = hwGetContext()) {
 			ctx->flushVR();
 		}
 	}
-	else if (eventID == 2)
+	else if (eventID == hwFlushVRSinglePassEventID)
 	{
 		if (auto ctx = hwGetContext()) {
 			ctx->flushVRSinglePass();
 		}
 	}
+	else if (eventID >= hwViewEventIDBase && eventID < hwViewEventIDBase + hwMaxViews)
+	{
+		if (auto ctx = hwGetContext()) {
+			ctx->flushView(eventID - hwViewEventIDBase);
+		}
+	}
+	else if (eventID >= hwShadowEventIDBase && eventID < hwShadowEventIDBase + hwMaxShadowLights)
+	{
+		if (auto ctx = hwGetContext()) {
+			ctx->flushShadow(eventID - hwShadowEventIDBase);
+		}
+	}
 }
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
@@ -64,6 +79,7 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces)
 {
     g_unity_interface = unityInterfaces;
     g_unity_graphics = g_unity_interface->Get<IUnityGraphics>();
+#ifdef hwWindows
     if (g_unity_graphics->GetRenderer() == kUnityGfxRendererD3D11) {
         g_unity_graphics_d3d11 = g_unity_interface->Get<IUnityGraphicsD3D11>();
         g_d3d11_device = g_unity_graphics_d3d11->GetDevice();
@@ -73,6 +89,7 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces)
         // to not miss the event in case the graphics device is already initialized
         UnityOnGraphicsDeviceEvent(kUnityGfxDeviceEventInitialize);
     }
+#endif // hwWindows
 }
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
@@ -96,6 +113,7 @@ hwExport hwPluginContext* hwGetPluginContext()
 }
 typedef hwPluginContext* (*hwGetPluginContextT)();
 
+#ifdef hwWindows
 // PatchLibrary で突っ込まれたモジュールは UnityPluginLoad() が呼ばれないので、
 // DLL_PROCESS_ATTACH のタイミングで先にロードされているモジュールからコンテキストを移管して同等の処理を行う。
 BOOL WINAPI DllMain(HINSTANCE module_handle, DWORD reason_for_call, LPVOID reserved)
@@ -131,30 +149,13 @@ extern "C" { int __afxForceUSRDLL; }
 #elif defined(_M_X64)
 extern "C" { int _afxForceUSRDLL; }
 #endif
+#endif // hwWindows
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
 
 
-void hwLogImpl(const char* fmt, ...)
-{
-    va_list vl;
-    va_start(vl, fmt);
-
-    char buf[2048];
-    vsprintf(buf, fmt, vl);
-#ifdef hwWindows
-    ::OutputDebugStringA(buf);
-#else // hwWindows
-    printf(buf);
-#endif // hwWindows
-    if (g_log_callback) { g_log_callback(buf); }
-
-    va_end(vl);
-}
-
-
 extern "C" {
 
 hwExport int hwGetSDKVersion()
@@ -182,7 +183,7 @@ hwExport bool hwInitialize()
     }
 
     g_hw_ctx = new hwContext();
-    if (g_hw_ctx->initialize(g_d3d11_device)) {
+    if (g_hw_ctx->initialize(hwCreateRenderDevice(g_d3d11_device))) {
         return true;
     }
     else {
@@ -207,7 +208,56 @@ hwExport hwContext* hwGetContext()
 
 hwExport void hwSetLogCallback(hwLogCallback cb)
 {
-    g_log_callback = cb;
+    hwLogSetCallback(cb);
+}
+
+hwExport void hwSetLogLevel(int level)
+{
+    hwLogSetLevel((hwLogLevel)level);
+}
+
+hwExport int hwDrainLog()
+{
+    return hwLogDrain();
+}
+
+hwExport void hwGetStats(hwStats *o_stats)
+{
+    if (o_stats == nullptr) { return; }
+    if (auto ctx = hwGetContext()) {
+        ctx->getStats(*o_stats);
+    }
+}
+
+hwExport void hwTraceBegin()
+{
+    hwTraceStart();
+}
+
+hwExport void hwTraceEnd()
+{
+    hwTraceStop();
+}
+
+hwExport bool hwTraceDump(const char *path)
+{
+    if (path == nullptr || path[0] == '\0') { return false; }
+    return hwTraceWriteJSON(path);
+}
+
+hwExport bool hwTelemetryOpen(const char *name, int max_instances)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->telemetryOpen(name, max_instances);
+    }
+    return false;
+}
+
+hwExport void hwTelemetryClose()
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->telemetryClose();
+    }
 }
 
 hwExport hwHShader hwShaderLoadFromFile(const char *path)
@@ -286,6 +336,22 @@ hwExport const char* hwAssetGetBoneName(hwHAsset aid, int nth)
     return nullptr;
 }
 
+hwExport int hwAssetGetBoneTable(hwHAsset aid, hwBoneTableEntry *dst, int max_entries)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetGetBoneTable(aid, dst, max_entries);
+    }
+    return 0;
+}
+
+hwExport bool hwAssetSetBoneRemapping(hwHAsset aid, int num_bones, const char **bone_names)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetSetBoneRemapping(aid, num_bones, bone_names);
+    }
+    return false;
+}
+
 hwExport void hwAssetGetBoneIndices(hwHAsset aid, hwFloat4 &o_indices)
 {
     if (auto ctx = hwGetContext()) {
@@ -314,6 +380,46 @@ hwExport void hwAssetGetDefaultDescriptor(hwHAsset aid, hwHairDescriptor &o_desc
     }
 }
 
+hwExport bool hwAssetGetInfo(hwHAsset aid, hwAssetInfo *o_info)
+{
+    if (o_info == nullptr) { return false; }
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetGetInfo(aid, *o_info);
+    }
+    return false;
+}
+
+hwExport int hwAssetBuildLODChain(hwHAsset aid, int levels)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetBuildLODChain(aid, levels);
+    }
+    return 0;
+}
+
+hwExport int hwAssetGetNumLODs(hwHAsset aid)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetGetNumLODs(aid);
+    }
+    return 0;
+}
+
+hwExport int64_t hwAssetGetMemoryUsage(hwHAsset aid)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->assetGetMemoryUsage(aid);
+    }
+    return 0;
+}
+
+hwExport void hwSetAssetMemoryBudget(int64_t bytes)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->setAssetMemoryBudget(bytes);
+    }
+}
+
 
 hwExport hwHInstance hwInstanceCreate(hwHAsset aid)
 {
@@ -328,6 +434,19 @@ hwExport void hwInstanceRelease(hwHInstance iid)
         ctx->instanceRelease(iid);
     }
 }
+hwExport void hwInstanceSetLOD(hwHInstance iid, int level)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->instanceSetLOD(iid, level);
+    }
+}
+hwExport int hwInstanceGetLOD(hwHInstance iid)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->instanceGetLOD(iid);
+    }
+    return 0;
+}
 hwExport void hwInstanceGetBounds(hwHInstance iid, hwFloat3 *o_min, hwFloat3 *o_max)
 {
     if (auto ctx = hwGetContext()) {
@@ -346,6 +465,19 @@ hwExport void hwInstanceSetDescriptor(hwHInstance iid, const hwHairDescriptor *d
         ctx->instanceSetDescriptor(iid, *desc);
     }
 }
+hwExport void hwInstanceSetDescriptorField(hwHInstance iid, int offset, int size, const void *data)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->instanceSetDescriptorField(iid, offset, size, data);
+    }
+}
+hwExport hwDescriptorBlock* hwInstanceMapDescriptor(hwHInstance iid)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->instanceMapDescriptor(iid);
+    }
+    return nullptr;
+}
 hwExport void hwInstanceSetTexture(hwHInstance iid, hwTextureType type, hwTexture *tex)
 {
     if (auto ctx = hwGetContext()) {
@@ -380,6 +512,20 @@ hwExport void hwInstanceUpdateSkinningDQs(hwHInstance iid, int num_bones, hwDQua
     }
 }
 
+hwExport void hwInstanceUpdateSkinningDQsAsync(hwHInstance iid, int num_bones, hwDQuaternion *dqs, bool vrMode)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->instanceUpdateSkinningDQsAsync(iid, num_bones, dqs, vrMode);
+    }
+}
+
+hwExport void hwUpdateSkinningBatch(int num_entries, const hwSkinningBatchEntry *entries, const hwMatrix *world, bool vrMode)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->updateSkinningBatch(num_entries, entries, world, vrMode);
+    }
+}
+
 
 hwExport void hwBeginScene(bool vrMode)
 {
@@ -393,14 +539,41 @@ hwExport void hwEndScene(bool vrMode)
         ctx->endScene(vrMode);
     }
 }
+hwExport bool hwSubmitFrame(const void *packet, int size)
+{
+    if (size < 0) { return false; }
+    if (auto ctx = hwGetContext()) {
+        return ctx->submitFrame(packet, (size_t)size);
+    }
+    return false;
+}
+hwExport bool hwBeginThreadRecording(bool vrMode)
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->beginThreadRecording(vrMode);
+    }
+    return false;
+}
+hwExport bool hwEndThreadRecording()
+{
+    if (auto ctx = hwGetContext()) {
+        return ctx->endThreadRecording();
+    }
+    return false;
+}
 
-hwExport void hwSetViewProjection(const hwMatrix *view, const hwMatrix *proj, float fov)
+hwExport void hwSetViewProjection(int slot, const hwMatrix *view, const hwMatrix *proj, float fov)
 {
     if (auto ctx = hwGetContext()) {
-        ctx->setViewProjection(*view, *proj, fov);
+        ctx->setViewProjection(slot, *view, *proj, fov);
     }
 }
 
+hwExport int hwGetViewEventID(int slot)
+{
+    return hwViewEventIDBase + slot;
+}
+
 hwExport void hwSetViewProjectionStereo(const hwMatrix *view, const hwMatrix *proj, const hwMatrix *view2, const hwMatrix *proj2, float fov, bool singlePassStereo)
 {
 	if (auto ctx = hwGetContext()) {
@@ -429,6 +602,30 @@ hwExport void hwSetLights(int num_lights, const hwLightData *lights, bool vrMode
     }
 }
 
+hwExport hwHLight hwLightCreate(const hwLightData *light)
+{
+    if (light == nullptr) { return hwNullHandle; }
+    if (auto ctx = hwGetContext()) {
+        return ctx->lightCreate(*light);
+    }
+    return hwNullHandle;
+}
+
+hwExport void hwLightUpdate(hwHLight hl, const hwLightData *light)
+{
+    if (light == nullptr) { return; }
+    if (auto ctx = hwGetContext()) {
+        ctx->lightUpdate(hl, *light);
+    }
+}
+
+hwExport void hwLightRelease(hwHLight hl)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->lightRelease(hl);
+    }
+}
+
 hwExport void hwRender(hwHInstance iid, bool vrMode)
 {
     if (auto ctx = hwGetContext()) {
@@ -443,6 +640,19 @@ hwExport void hwRenderShadow(hwHInstance iid, bool vrMode)
     }
 }
 
+hwExport void hwSetShadowViewProjection(int light, const hwMatrix *view, const hwMatrix *proj, float fov)
+{
+    if (view == nullptr || proj == nullptr) { return; }
+    if (auto ctx = hwGetContext()) {
+        ctx->setShadowViewProjection(light, *view, *proj, fov);
+    }
+}
+
+hwExport int hwGetShadowEventID(int light)
+{
+    return hwShadowEventIDBase + light;
+}
+
 hwExport void hwStepSimulation(float dt, bool vrMode, bool singlePassVR)
 {
     if (auto ctx = hwGetContext()) {
@@ -450,6 +660,37 @@ hwExport void hwStepSimulation(float dt, bool vrMode, bool singlePassVR)
     }
 }
 
+hwExport void hwSetSimulationTimestep(float fixed_dt, int max_substeps)
+{
+    if (auto ctx = hwGetContext()) {
+        ctx->setSimulationTimestep(fixed_dt, max_substeps);
+    }
+}
+
+// budget <= 0: no limit
+hwExport void hwSetSimulationBudget(int budget, bool cost_in_vertices)
+{
+    if (auto ctx = hwGetContext()) {
+        hwBudgetSettings s;
+        s.budget = budget;
+        s.cost_in_vertices = cost_in_vertices;
+        ctx->setSimulationBudget(s);
+    }
+}
+
+hwExport void hwSetSimulationSleep(bool enabled, float sleep_distance, float wake_distance, int sleep_delay_frames, int warmup_substeps)
+{
+    if (auto ctx = hwGetContext()) {
+        hwSleepSettings s;
+        s.enabled = enabled;
+        s.sleep_distance = sleep_distance;
+        s.wake_distance = std::min<float>(wake_distance, sleep_distance);
+        s.sleep_delay_frames = std::max<int>(sleep_delay_frames, 0);
+        s.warmup_substeps = std::max<int>(warmup_substeps, 0);
+        ctx->setSimulationSleep(s);
+    }
+}
+
 hwExport void hwSetShuttingDownFlag()
 {
 	if (auto ctx = hwGetContext()) {
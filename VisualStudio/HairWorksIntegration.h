@@ -6,6 +6,8 @@
     #else
         #define hwExport __declspec(dllimport)
     #endif
+#else
+    #define hwExport __attribute__((visibility("default")))
 #endif
 
 typedef GFSDK_HairSDK                   hwSDK;
@@ -22,6 +24,7 @@ typedef gfsdk_float4x4          hwMatrix;
 typedef uint32_t                hwHShader;      // H stands for Handle
 typedef uint32_t                hwHAsset;       // 
 typedef uint32_t                hwHInstance;    // 
+typedef uint32_t                hwHLight;       // 
 
 typedef ID3D11Device                    hwDevice;
 typedef ID3D11Texture2D                 hwTexture;
@@ -33,12 +36,27 @@ typedef void(__stdcall *hwLogCallback)(const char *);
 #define hwNullInstanceID    GFSDK_HairInstanceID_NULL
 #define hwNullHandle        0xFFFFFFFF
 #define hwMaxLights         8
+#define hwMaxShadowLights   8
+#define hwMaxViews          8
+#define hwMaxRecordingThreads   64
+
+// plugin event IDs for the render event function (hwGetRenderEventFunc())
+#define hwFlushEventID              0
+#define hwFlushVREventID            1
+#define hwFlushVRSinglePassEventID  2
+#define hwViewEventIDBase           8   // + view slot. [hwViewEventIDBase, hwViewEventIDBase + hwMaxViews)
+#define hwShadowEventIDBase         16  // + light slot. [hwShadowEventIDBase, hwShadowEventIDBase + hwMaxShadowLights)
 
 
 struct  hwShaderData;
 struct  hwAssetData;
 struct  hwInstanceData;
 struct  hwLightData;
+struct  hwStats;
+struct  hwSkinningBatchEntry;
+struct  hwBoneTableEntry;
+struct  hwDescriptorBlock;
+struct  hwAssetInfo;
 class   hwContext;
 
 
@@ -52,7 +70,20 @@ hwExport bool           hwInitialize();
 hwExport void           hwFinalize();
 hwExport hwContext*     hwGetContext();
 hwExport int            hwGetFlushEventID();
+// the callback is called from hwDrainLog(), never from the render thread
 hwExport void           hwSetLogCallback(hwLogCallback cb);
+// records below level are discarded. 0: debug, 1: info (default), 2: warning, 3: error
+hwExport void           hwSetLogLevel(int level);
+// passes the records logged since the last call to the log callback. call once per frame from the main thread
+hwExport int            hwDrainLog();
+hwExport void           hwGetStats(hwStats *o_stats);
+hwExport void           hwTraceBegin();
+hwExport void           hwTraceEnd();
+hwExport bool           hwTraceDump(const char *path);
+// publishes per-frame timings, queue depths and per-instance stats in a shared memory segment for external profilers
+// (layout in hwTelemetry.h, reader in Tools/hwTelemetryReader). name: null for "hwTelemetry"
+hwExport bool           hwTelemetryOpen(const char *name, int max_instances);
+hwExport void           hwTelemetryClose();
 
 hwExport hwHShader      hwShaderLoadFromFile(const char *path);
 hwExport void           hwShaderRelease(hwHShader sid);
@@ -60,13 +91,30 @@ hwExport void           hwShaderReload(hwHShader sid);
 
 hwExport hwHAsset       hwAssetLoadFromFile(const char *path);
 hwExport void           hwAssetRelease(hwHAsset aid);
+// instances are recreated from the reloaded asset at the next flush
 hwExport void           hwAssetReload(hwHAsset aid);
 hwExport int            hwAssetGetNumBones(hwHAsset aid);
 hwExport const char*    hwAssetGetBoneName(hwHAsset aid, int nth);
+// names, bind poses and indices of all bones in one call. returns the number of bones, fills up to max_entries
+hwExport int            hwAssetGetBoneTable(hwHAsset aid, hwBoneTableEntry *dst, int max_entries);
+hwExport bool           hwAssetSetBoneRemapping(hwHAsset aid, int num_bones, const char **bone_names);
 hwExport void           hwAssetGetBoneIndices(hwHAsset aid, hwFloat4 &o_indices);
 hwExport void           hwAssetGetBoneWeights(hwHAsset aid, hwFloat4 &o_weight);
 hwExport void           hwAssetGetBindPose(hwHAsset aid, int nth, hwMatrix &o_mat);
 hwExport void           hwAssetGetDefaultDescriptor(hwHAsset aid, hwHairDescriptor &o_desc);
+// counts and render hair stats of the asset (see hwAssetInfo). for profiling, creates and frees a temporary instance
+hwExport bool           hwAssetGetInfo(hwHAsset aid, hwAssetInfo *o_info);
+// builds levels 1..levels: copies of the asset with the guide hairs resampled to half the control vertices per level,
+// cached in the user's cache directory (%LOCALAPPDATA%\HairWorks\LOD, ~/.cache/hairworks/lod). returns the number of
+// levels including level 0 (the asset itself)
+hwExport int            hwAssetBuildLODChain(hwHAsset aid, int levels);
+hwExport int            hwAssetGetNumLODs(hwHAsset aid);
+// estimated GPU memory of the asset, its LOD levels and its instances in bytes
+hwExport int64_t        hwAssetGetMemoryUsage(hwHAsset aid);
+// 0 (default): assets are freed at their last hwAssetRelease(). otherwise released assets stay resident and are reused
+// by hwAssetLoadFromFile() of the same path until the estimated memory of all assets goes over bytes, then the least
+// recently released are evicted
+hwExport void           hwSetAssetMemoryBudget(int64_t bytes);
 
 // WayGate 
 hwExport const char*    hwAssetGetTextureName(hwHAsset aid, int textureType);
@@ -76,24 +124,56 @@ hwExport void hwSetShuttingDownFlag();
 
 hwExport hwHInstance    hwInstanceCreate(hwHAsset aid);
 hwExport void           hwInstanceRelease(hwHInstance iid);
+// switches the instance to a level of hwAssetBuildLODChain(), keeping its descriptor. applied at the next flush
+hwExport void           hwInstanceSetLOD(hwHInstance iid, int level);
+hwExport int            hwInstanceGetLOD(hwHInstance iid);
 hwExport void           hwInstanceGetAssetID(hwHInstance iid);
 hwExport void           hwInstanceGetBounds(hwHInstance iid, hwFloat3 *o_min, hwFloat3 *o_max);
 hwExport void           hwInstanceGetDescriptor(hwHInstance iid, hwHairDescriptor *o_desc);
 hwExport void           hwInstanceSetDescriptor(hwHInstance iid, const hwHairDescriptor *desc);
+hwExport void           hwInstanceSetDescriptorField(hwHInstance iid, int offset, int size, const void *data);
+// the instance's descriptor in plugin memory, to be written in place instead of calling hwInstanceSetDescriptor() every
+// frame: set dirty after writing and hwBeginScene() forwards the changed descriptors only. generation is bumped every
+// time the plugin takes a change, also from the setters above. valid until the instance is released. main thread only
+hwExport hwDescriptorBlock* hwInstanceMapDescriptor(hwHInstance iid);
 hwExport void           hwInstanceSetTexture(hwHInstance iid, hwTextureType type, hwTexture *tex);
 hwExport void			hwInstanceSetTextureIntoDevice(hwHInstance hi, hwTextureType type);
 hwExport void           hwInstanceUpdateSkinningMatrices(hwHInstance iid, int num_bones, hwMatrix *matrices);
 hwExport void			hwInstanceUpdateSkinningMatricesAsync(hwHInstance iid, int num_bones, hwMatrix *matrices, bool vrMode);
 hwExport void           hwInstanceUpdateSkinningDQs(hwHInstance iid, int num_bones, hwDQuaternion *dqs);
+hwExport void           hwInstanceUpdateSkinningDQsAsync(hwHInstance iid, int num_bones, hwDQuaternion *dqs, bool vrMode);
+// world: bone localToWorld matrices of all entries packed back to back. entries index into it with first_bone
+hwExport void           hwUpdateSkinningBatch(int num_entries, const hwSkinningBatchEntry *entries, const hwMatrix *world, bool vrMode);
 
 hwExport void           hwBeginScene(bool vrMode);
 hwExport void           hwEndScene(bool vrMode);
-hwExport void           hwSetViewProjection(const hwMatrix *view, const hwMatrix *proj, float fov);
+// a whole hwBeginScene() .. hwEndScene() bracket in one call: view, lights, shader, skinning, descriptor fields,
+// simulation step and draws packed as described in hwFramePacket.h. returns false if the packet is malformed
+hwExport bool           hwSubmitFrame(const void *packet, int size);
+// per-thread command buffers for recording from worker threads. between these two, hwRender(), hwRenderShadow() and the
+// skinning calls of the thread are recorded into its own buffer without locking (vrMode of those calls is the one given
+// here, other calls are not allowed). begin inside a hwBeginScene() .. hwEndScene() bracket, after hwSetViewProjection()
+// of the view being recorded. ended buffers are merged in front of the next call of the thread that began the scene,
+// or at hwEndScene(), ordered by instance. calls of one thread keep their order, calls for the same instance from several
+// threads go in the order the threads first began recording
+hwExport bool           hwBeginThreadRecording(bool vrMode);
+hwExport bool           hwEndThreadRecording();
+hwExport void           hwSetViewProjection(int slot, const hwMatrix *view, const hwMatrix *proj, float fov);
+hwExport int            hwGetViewEventID(int slot);
 hwExport void           hwSetViewProjectionStereo(const hwMatrix *view, const hwMatrix *proj, const hwMatrix *view2, const hwMatrix *proj2, float fov, bool singlePassStereo);
 hwExport void           hwSetRenderTarget(hwTexture *framebuffer, hwTexture *depthbuffer, bool vrMode);
 hwExport void           hwSetShader(hwHShader sid, bool vrMode);
 hwExport void           hwSetLights(int num_lights, const hwLightData *lights, bool vrMode);
+hwExport hwHLight       hwLightCreate(const hwLightData *light);
+hwExport void           hwLightUpdate(hwHLight hl, const hwLightData *light);
+hwExport void           hwLightRelease(hwHLight hl);
 hwExport void           hwRender(hwHInstance iid, bool vrMode);
 hwExport void           hwRenderShadow(hwHInstance iid, bool vrMode);
+hwExport void           hwSetShadowViewProjection(int light, const hwMatrix *view, const hwMatrix *proj, float fov);
+// the light's event renders the shadow casting, enabled instances drawn (hwRender() / hwRenderShadow()) since the last hwStepSimulation()
+hwExport int            hwGetShadowEventID(int light);
 hwExport void           hwStepSimulation(float dt, bool vrMode, bool singlePassVR);
+hwExport void           hwSetSimulationTimestep(float fixed_dt, int max_substeps);
+hwExport void           hwSetSimulationBudget(int budget, bool cost_in_vertices);
+hwExport void           hwSetSimulationSleep(bool enabled, float sleep_distance, float wake_distance, int sleep_delay_frames, int warmup_substeps);
 } // extern "C"
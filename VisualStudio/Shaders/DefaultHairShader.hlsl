@@ -2,9 +2,9 @@
 
 #define MaxLights               8
 
-#define LightType_Spot          0
-#define LightType_Directional   1
-#define LightType_Point         2
+// must match hwELightType (hwContext.h). spot lights are sent as point lights
+#define LightType_Directional   0
+#define LightType_Point         1
 
 struct LightData
 {
@@ -0,0 +1,51 @@
+#pragma once
+
+// what an asset costs. filled by hwAssetGetInfo(). must match hwi.AssetInfo in C#
+struct hwAssetInfo
+{
+    int num_guide_hairs;
+    int num_guide_vertices;     // control vertices of all guide hairs
+    int num_faces;              // growth mesh triangles
+    int num_bones;
+    // below are render hair stats with the asset's default descriptor. hwAssetGetInfo() takes them from ComputeStats()
+    // of a temporary instance, the asset memory budget estimates them without one (see hwEstimateRenderHairs())
+    int num_render_hairs;
+    float average_cvs;          // control vertices per render hair
+    float average_density;
+    float average_hairs_per_face;
+
+    hwAssetInfo() { memset(this, 0, sizeof(*this)); }
+};
+
+// rough GPU memory of an asset in bytes. the SDK does not report its allocations, these follow its data layout.
+// used by the asset memory budget (hwContext::measureAsset()) and Tools/hwAssetProfiler
+struct hwAssetMemory
+{
+    int64_t guide;          // simulated guide vertices: position, previous position, rest position and rest frame (4 x float4)
+    int64_t growth_mesh;    // triangle indices, root position and uv per guide hair
+    int64_t bones;          // bind pose, skinning matrix and dual quaternion per bone
+    int64_t render;         // interpolated render hair vertices (position + tangent), regenerated every frame. per instance
+
+    int64_t asset() const { return guide + growth_mesh + bones; }
+    int64_t total() const { return asset() + render; }
+};
+
+inline hwAssetMemory hwEstimateAssetMemory(const hwAssetInfo &info)
+{
+    hwAssetMemory r;
+    r.guide = (int64_t)info.num_guide_vertices * 64;
+    r.growth_mesh = (int64_t)info.num_faces * 3 * 4 + (int64_t)info.num_guide_hairs * (16 + 8);
+    r.bones = (int64_t)info.num_bones * (64 + 64 + 32);
+    r.render = (int64_t)((double)info.num_render_hairs * info.average_cvs * 32.0);
+    return r;
+}
+
+// the render hair stats of info from the counts and a descriptor, without an instance: the SDK grows 64 hairs per
+// growth mesh triangle at density 1, each interpolated from the guide hairs' control vertices
+inline void hwEstimateRenderHairs(hwAssetInfo &info, float density)
+{
+    info.average_density = density;
+    info.average_hairs_per_face = 64.0f * density;
+    info.num_render_hairs = (int)(info.num_faces * info.average_hairs_per_face);
+    info.average_cvs = info.num_guide_hairs > 0 ? (float)info.num_guide_vertices / info.num_guide_hairs : 0.0f;
+}
@@ -1,7 +1,20 @@
-﻿#include "pch.h"
+#include "pch.h"
 #include "hwInternal.h"
 #include "hwContext.h"
-#include "DXUT.h"
+#include "hwTrace.h"
+#include "hwFramePacket.h"
+#include "hwStubSDK.h"
+#ifdef hwWindows
+#include <direct.h> // _mkdir
+#include <stdlib.h> // _fullpath
+#endif
+
+// command buffer of the calling thread between hwBeginThreadRecording() and hwEndThreadRecording()
+static thread_local hwThreadRecording *g_thread_recording = nullptr;
+// given to a thread by its first hwBeginThreadRecording() and kept for its lifetime. orders the merge of one instance's
+// commands recorded on several threads the same way every frame, whichever command buffers they got
+static thread_local uint32_t g_thread_recording_index = 0;
+static std::atomic<uint32_t> g_num_recording_threads { 0 };
 
 #if defined(_M_IX86)
     #define hwSDKDLL "GFSDK_HairWorks.win32.dll"
@@ -27,55 +40,19 @@ bool hwFileToString(std::string &o_buf, const char *path)
     return true;
 }
 
-// Prepare the render target for HairWorks rendering
-void PrepareHairWorksRenderTarget(ID3D11DeviceContext* pd3dContext, ID3D11Device *DirectXDvice)
+hwRenderDevice* hwCreateRenderDevice(hwDevice *dev)
 {
-	bool setRenderTargetZFunc	= false;
-	bool clearZBuffer			= false;
-
-	if (setRenderTargetZFunc == true)
-	{
-		unsigned int depthRef;
-		D3D11_DEPTH_STENCIL_DESC descriptor;
-		ID3D11DepthStencilState *depthState;
-
-		pd3dContext->OMGetDepthStencilState(&depthState, &depthRef);
-		if (depthState == nullptr)
-		{
-			descriptor.DepthEnable = true;
-			descriptor.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-			descriptor.DepthFunc = D3D11_COMPARISON_GREATER;
-			descriptor.StencilEnable = false;
-			DirectXDvice->CreateDepthStencilState(&descriptor, &depthState);
-			pd3dContext->OMSetDepthStencilState(depthState, depthRef);
-		}
-		else
-		{
-			depthState->GetDesc(&descriptor);
-			descriptor.DepthFunc = D3D11_COMPARISON_GREATER;
-			DirectXDvice->CreateDepthStencilState(&descriptor, &depthState);
-			pd3dContext->OMSetDepthStencilState(depthState, depthRef);
-		}
-	}
-
-	if (clearZBuffer == true)
-	{
-		// Get the depth stencil and render target
-		ID3D11RenderTargetView* pRTV;
-		ID3D11DepthStencilView* pDSV;
-		pd3dContext->OMGetRenderTargets(1, &pRTV, &pDSV);
-		pd3dContext->OMSetRenderTargets(1, &pRTV, pDSV);
-		pd3dContext->ClearDepthStencilView(pDSV, D3D11_CLEAR_DEPTH, 1.0, 0);
-	}
+#ifdef hwWindows
+    return hwCreateRenderDeviceD3D11(dev);
+#else // hwWindows
+    (void)dev;
+    return hwCreateRenderDeviceNull();
+#endif // hwWindows
 }
 
-hwSDK *g_hw_sdk = nullptr;
-hwSDK* hwContext::loadSDK()
+#ifdef hwWindows
+static hwSDK* hwLoadDefaultSDK()
 {
-    if (g_hw_sdk) {
-        return g_hw_sdk;
-    }
-
     char path[MAX_PATH] = {0};
     if(path[0] == 0) {
         // get path to this module
@@ -90,8 +67,33 @@ hwSDK* hwContext::loadSDK()
             }
         }
     }
-    g_hw_sdk = GFSDK_LoadHairSDK(path, GFSDK_HAIRWORKS_VERSION);
-    hwLog("hwContext::loadSDK(): %s (%s)\n", g_hw_sdk ? "succeeded" : "failed", path);
+    hwSDK *ret = GFSDK_LoadHairSDK(path, GFSDK_HAIRWORKS_VERSION);
+    hwLog("hwContext::loadSDK(): %s (%s)\n", ret ? "succeeded" : "failed", path);
+    return ret;
+}
+#else // hwWindows
+static hwSDK* hwLoadDefaultSDK()
+{
+    hwLog("hwContext::loadSDK(): no HairWorks runtime on this platform, using the stub SDK\n");
+    return hwCreateStubSDK();
+}
+#endif // hwWindows
+
+hwSDK *g_hw_sdk = nullptr;
+static hwSDKLoader g_hw_sdk_loader = nullptr;
+
+void hwContext::setSDKLoader(hwSDKLoader loader)
+{
+    g_hw_sdk_loader = loader;
+}
+
+hwSDK* hwContext::loadSDK()
+{
+    if (g_hw_sdk) {
+        return g_hw_sdk;
+    }
+
+    g_hw_sdk = g_hw_sdk_loader ? g_hw_sdk_loader() : hwLoadDefaultSDK();
     return g_hw_sdk;
 }
 
@@ -122,6 +124,7 @@ void hwContext::EnableVRRendering(bool enabled)
 void hwContext::InitVRVariables()
 {
 	m_shuttingDown  = 0;
+	m_shuttingDownVR = 0;
 	m_currentVRPass = 0;
 	m_VRRendering   = false;
 }
@@ -144,13 +147,20 @@ void hwContext::StoreMatrixLocally(const hwMatrix &view, const hwMatrix &proj, f
 
 bool hwContext::valid() const
 {
-    return m_d3ddev!=nullptr && m_d3dctx!=nullptr && g_hw_sdk!=nullptr;
+    return m_device!=nullptr && g_hw_sdk!=nullptr;
 }
 
-bool hwContext::initialize(hwDevice *d3d_device)
+hwRenderDevice* hwContext::getRenderDevice() const
 {
-    if (d3d_device == nullptr)
+    return m_device;
+}
+
+bool hwContext::initialize(hwRenderDevice *device)
+{
+    if (device == nullptr)
 		return false;
+    m_device = device;
+    hwLog("hwContext::initialize(): %s device\n", m_device->getName());
 
     g_hw_sdk = loadSDK();
     
@@ -160,124 +170,107 @@ bool hwContext::initialize(hwDevice *d3d_device)
     }
     else
 	{
-        hwLog("GFSDK_LoadHairSDK() failed.\n");
+        hwLogError("GFSDK_LoadHairSDK() failed.\n");
         return false;
     }
 
-    if (g_hw_sdk->InitRenderResources((ID3D11Device*)d3d_device) == GFSDK_HAIR_RETURN_OK)
+    if (g_hw_sdk->InitRenderResources(m_device->getNativeDevice()) == GFSDK_HAIR_RETURN_OK)
 	{
         hwLog("GFSDK_HairSDK::InitRenderResources() succeeded.\n");
     }
     else
 	{
-        hwLog("GFSDK_HairSDK::InitRenderResources() failed.\n");
+        hwLogError("GFSDK_HairSDK::InitRenderResources() failed.\n");
         finalize();
         return false;
     }
 
-    m_d3ddev = (ID3D11Device*)d3d_device;
-	m_d3ddev->GetImmediateContext(&m_d3dctx);
-
-	if (g_hw_sdk->SetCurrentContext(m_d3dctx) == GFSDK_HAIR_RETURN_OK) 
+	if (g_hw_sdk->SetCurrentContext(m_device->getNativeContext()) == GFSDK_HAIR_RETURN_OK) 
 	{
 		hwLog("GFSDK_HairSDK::SetCurrentContext() succeeded.\n");
 	}
 	else
 	{
-		hwLog("GFSDK_HairSDK::SetCurrentContext() failed.\n");
+		hwLogError("GFSDK_HairSDK::SetCurrentContext() failed.\n");
 		finalize();
 		return false;
 	}
 
-	// set the Z mode here
-	CD3D11_DEPTH_STENCIL_DESC depthDesc;
-	depthDesc.DepthEnable		= true;
-	depthDesc.DepthWriteMask	= D3D11_DEPTH_WRITE_MASK_ALL;
-	depthDesc.DepthFunc			= D3D11_COMPARISON_GREATER_EQUAL;
-	depthDesc.StencilEnable		= false;
-	m_d3ddev->CreateDepthStencilState(&depthDesc, &m_rs_enable_depth);
-
-	// create constant buffer for hair rendering pixel shader
-	D3D11_BUFFER_DESC bufferDesc;
-	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	bufferDesc.ByteWidth = sizeof(hwConstantBuffer);
-	bufferDesc.StructureByteStride = 0;
-	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	m_d3ddev->CreateBuffer(&bufferDesc, 0, &m_rs_constant_buffer);
-
-	// rasterized mode
-	D3D11_RASTERIZER_DESC rsdesc;
-	memset(&rsdesc, 0, sizeof(rsdesc));
-	rsdesc.FillMode = D3D11_FILL_SOLID;
-	rsdesc.CullMode = D3D11_CULL_NONE;
-	m_d3ddev->CreateRasterizerState(&rsdesc, &m_RasterState);
-
-	// sampler is null at the beginning
-	m_HairShaderSampler = nullptr;
-
-	// 
     return true;
 }
 
 void hwContext::finalize()
 {
-    for (auto &i : m_instances) { instanceRelease(i.handle); }
+    // the render thread is idle from here
+    telemetryClose();
+    for (auto &i : m_instances) { if (i) { instanceRelease(i.handle); } }
+    collectRetired(true);
     m_instances.clear();
+    m_descBlocks.clear();
+    m_numMappedDescs = 0;
 
-    for (auto &i : m_assets) { assetRelease(i.handle); }
+    // including the ones kept under the memory budget
+    for (auto &i : m_assets) { if (i) { freeAsset(i.handle); } }
+    collectRetired(true);
     m_assets.clear();
+    m_evictedPaths.clear();
 
     for (auto &i : m_shaders) { shaderRelease(i.handle); }
+    collectRetired(true);
     m_shaders.clear();
 
-    for (auto &i : m_srvtable) { i.second->Release(); }
-    m_srvtable.clear();
-
-    for (auto &i : m_rtvtable) { i.second->Release(); }
-    m_rtvtable.clear();
-
-    if (m_rs_enable_depth) {
-        m_rs_enable_depth->Release();
-        m_rs_enable_depth = nullptr;
-    }
-
-    if (m_d3dctx)
+    if (m_device)
     {
-        m_d3dctx->Release();
-        m_d3dctx = nullptr;
+        for (auto &i : m_srvtable) { m_device->releaseSRV(i.second); }
+        for (auto &i : m_rtvtable) { m_device->releaseRTV(i.second); }
+        delete m_device;
+        m_device = nullptr;
     }
+    m_srvtable.clear();
+    m_rtvtable.clear();
 }
 
 void hwContext::move(hwContext &from)
 {
-#define mov(V) V=from.V; from.V=decltype(V)();
-    mov(m_d3dctx);
-    mov(m_d3ddev);
+#define mov(V) V=std::move(from.V); from.V=decltype(V)();
     mov(m_shaders);
     mov(m_assets);
     mov(m_instances);
+    mov(m_descBlocks);
+    mov(m_numMappedDescs);
     mov(m_srvtable);
     mov(m_rtvtable);
-    mov(m_rs_enable_depth);
-    mov(m_rs_constant_buffer);
 #undef mov
+
+    // the device object's code lives in the module being replaced. rebuild it on this side around the same native device
+    if (from.m_device)
+    {
+        auto *native = from.m_device->getNativeDevice();
+        delete from.m_device;
+        from.m_device = nullptr;
+        m_device = hwCreateRenderDevice(native);
+    }
 }
 
-hwShaderData& hwContext::newShaderData()
+// nullptr if the table is full
+hwShaderData* hwContext::newShaderData()
 {
-    auto i = std::find_if(m_shaders.begin(), m_shaders.end(), [](const hwShaderData &v) { return !v; });
-    if (i != m_shaders.end()) { return *i; }
+    // retired slots are taken until collectRetired() frees them
+    auto i = std::find_if(m_shaders.begin(), m_shaders.end(), [](const hwShaderData &v) { return v.shader == nullptr; });
+    if (i != m_shaders.end()) { return &*i; }
 
     hwShaderData tmp;
     tmp.handle = m_shaders.size();
-    m_shaders.push_back(tmp);
-    return m_shaders.back();
+    if (!m_shaders.push_back(tmp)) {
+        hwLogError("hwContext::newShaderData(): too many shaders (%d).\n", (int)m_shaders.max_size());
+        return nullptr;
+    }
+    return &m_shaders.back();
 }
 
 hwHShader hwContext::shaderLoadFromFile(const std::string &path)
 {
+    collectRetired();
     {
         auto i = std::find_if(m_shaders.begin(), m_shaders.end(), [&](const hwShaderData &v) { return v.path == path; });
         if (i != m_shaders.end() && i->ref_count > 0) {
@@ -288,19 +281,22 @@ hwHShader hwContext::shaderLoadFromFile(const std::string &path)
 
     std::string bin;
     if (!hwFileToString(bin, path.c_str())) {
-        hwLog("failed to load shader (%s)\n", path.c_str());
+        hwLogError("failed to load shader (%s)\n", path.c_str());
         return hwNullHandle;
     }
 
-    hwShaderData& v = newShaderData();
+    hwShaderData *s = newShaderData();
+    if (!s) { return hwNullHandle; }
+    hwShaderData &v = *s;
     v.path = path;
-    if (SUCCEEDED(m_d3ddev->CreatePixelShader(&bin[0], bin.size(), nullptr, &v.shader))) {
+    v.shader = m_device->createPixelShader(&bin[0], bin.size());
+    if (v.shader) {
         v.ref_count = 1;
         hwLog("CreatePixelShader(%s) : %d succeeded.\n", path.c_str(), v.handle);
         return v.handle;
     }
     else {
-        hwLog("CreatePixelShader(%s) failed.\n", path.c_str());
+        hwLogError("CreatePixelShader(%s) failed.\n", path.c_str());
     }
     return hwNullHandle;
 }
@@ -311,9 +307,9 @@ void hwContext::shaderRelease(hwHShader hs)
 
     auto &v = m_shaders[hs];
     if (v.ref_count > 0 && --v.ref_count == 0) {
-        v.shader->Release();
-        v.invalidate();
-        hwLog("shaderRelease(%d)\n", hs);
+        retire(v.retire);
+        m_retiredShaders.push_back(hs);
+        collectRetired();
     }
 }
 
@@ -324,78 +320,121 @@ void hwContext::shaderReload(hwHShader hs)
     auto &v = m_shaders[hs];
     // release existing shader
     if (v.shader) {
-        v.shader->Release();
+        m_device->releasePixelShader(v.shader);
         v.shader = nullptr;
     }
 
     // reload
     std::string bin;
     if (!hwFileToString(bin, v.path.c_str())) {
-        hwLog("failed to reload shader (%s)\n", v.path.c_str());
+        hwLogError("failed to reload shader (%s)\n", v.path.c_str());
         return;
     }
-    if (SUCCEEDED(m_d3ddev->CreatePixelShader(&bin[0], bin.size(), nullptr, &v.shader))) {
+    v.shader = m_device->createPixelShader(&bin[0], bin.size());
+    if (v.shader) {
         hwLog("CreatePixelShader(%s) : %d reloaded.\n", v.path.c_str(), v.handle);
     }
     else {
-        hwLog("CreatePixelShader(%s) failed to reload.\n", v.path.c_str());
+        hwLogError("CreatePixelShader(%s) failed to reload.\n", v.path.c_str());
     }
 }
 
-hwAssetData& hwContext::newAssetData()
+// nullptr if the table is full
+hwAssetData* hwContext::newAssetData()
 {
-    auto i = std::find_if(m_assets.begin(), m_assets.end(), [](const hwAssetData &v) { return !v; });
-    if (i != m_assets.end()) { return *i; }
+    auto i = std::find_if(m_assets.begin(), m_assets.end(), [](const hwAssetData &v) { return v.aid == hwNullAssetID; });
+    if (i != m_assets.end()) { return &*i; }
 
 
     hwAssetData tmp;
     tmp.handle = m_assets.size();
-    m_assets.push_back(tmp);
-    return m_assets.back();
+    if (!m_assets.push_back(tmp)) {
+        hwLogError("hwContext::newAssetData(): too many assets (%d).\n", (int)m_assets.max_size());
+        return nullptr;
+    }
+    return &m_assets.back();
+}
+
+void hwContext::cacheBindPose(hwAssetData &v)
+{
+    // palettes built with the old bind pose must not be taken as unchanged
+    for (auto &inst : m_instances) {
+        if (inst && inst.hasset == v.handle) { inst.palette_valid = false; }
+    }
+
+    v.inv_bindpose.clear();
+    uint32_t num_bones = 0;
+    if (g_hw_sdk->GetNumBones(v.aid, &num_bones) != GFSDK_HAIR_RETURN_OK) { return; }
+
+    v.inv_bindpose.resize(num_bones);
+    for (uint32_t bi = 0; bi < num_bones; ++bi) {
+        hwMatrix bindpose;
+        if (g_hw_sdk->GetBindPose(v.aid, bi, &bindpose) != GFSDK_HAIR_RETURN_OK ||
+            !hwMatrixInverse(v.inv_bindpose[bi], bindpose))
+        {
+            hwLogWarning("hwContext::cacheBindPose(): bind pose %d of asset %d is not invertible.\n", bi, v.handle);
+            v.inv_bindpose[bi] = hwMatrix();
+            float *m = hwMatrixData(v.inv_bindpose[bi]);
+            m[0] = m[5] = m[10] = m[15] = 1.0f;
+        }
+    }
+}
+
+// assets are always converted to Unity's space, whatever settings were given
+static GFSDK_HAIR_RETURNCODES hwLoadHairAsset(const std::string &path, hwAssetID *aid)
+{
+	GFSDK_HairConversionSettings settings;
+	settings.m_targetHandednessHint	= GFSDK_HAIR_LEFT_HANDED;
+	settings.m_targetUpAxisHint		= GFSDK_HAIR_Y_UP;
+	return g_hw_sdk->LoadHairAssetFromFile(path.c_str(), aid, nullptr, &settings);
 }
 
 hwHAsset hwContext::assetLoadFromFile(const std::string &path, const hwConversionSettings *_settings)
 {
-	bool forceUnityConversion = true;
+	hwTraceScoped("hwContext::assetLoadFromFile");
+	collectRetired();
 
 	hwConversionSettings settings;
 	if (_settings != nullptr) { settings = *_settings; }
 
 	{
 		auto i = std::find_if(m_assets.begin(), m_assets.end(),
-			[&](const hwAssetData &v) { return v.path == path && v.settings == settings; });
-		if (i != m_assets.end() && i->ref_count > 0) {
+			[&](const hwAssetData &v) { return v.path == path && v.settings == settings && v.lod_base == hwNullHandle; });
+		// ref_count 0: released but still resident under the memory budget
+		if (i != m_assets.end() && *i) {
 			++i->ref_count;
-			return i->aid;
+			return i->handle;
 		}
 	}
 
-	hwAssetData& v = newAssetData();
+	auto evicted = m_evictedPaths.find(path);
+	auto begin = std::chrono::steady_clock::now();
+
+	hwAssetData *a = newAssetData();
+	if (!a) { return hwNullHandle; }
+	hwAssetData &v = *a;
 	v.settings		= settings;
 	v.path			= path;
-																										// force import settings in Unity
-	GFSDK_HairConversionSettings *conversionSettings = new GFSDK_HairConversionSettings;
-	{
-		conversionSettings->m_targetHandednessHint	= GFSDK_HAIR_LEFT_HANDED;
-		conversionSettings->m_targetUpAxisHint		= GFSDK_HAIR_Y_UP;
-		//conversionSettings->m_targetSceneUnit		= 1.0f; // centimeter
-		//conversionSettings->m_pConversionMatrix = s_scaleMatrix;
-	}
-	
-	GFSDK_HairConversionSettings *pSettings = nullptr;
-	if (forceUnityConversion == true)
-		pSettings = conversionSettings;
 
-	if (g_hw_sdk->LoadHairAssetFromFile(path.c_str(), &v.aid, nullptr, pSettings) == GFSDK_HAIR_RETURN_OK)
+	if (hwLoadHairAsset(path, &v.aid) == GFSDK_HAIR_RETURN_OK)
 	{
 		v.ref_count = 1;
+		cacheBindPose(v);
+		measureAsset(v);
 
 		hwLog("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") : %d succeeded.\n", path.c_str(), v.handle);
-		return v.handle;
+		if (evicted != m_evictedPaths.end()) {
+			m_evictedPaths.erase(evicted);
+			++m_stats.num_asset_reloads;
+			m_stats.asset_reload_time += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		hwHAsset ha = v.handle;
+		evictAssets();
+		return ha;
 	}
 	else
 	{
-		hwLog("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") failed.\n", path.c_str());
+		hwLogError("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") failed.\n", path.c_str());
 	}
 	return hwNullHandle;
 }
@@ -406,32 +445,199 @@ void hwContext::assetRelease(hwHAsset ha)
 
     auto &v = m_assets[ha];
     if (v.ref_count > 0 && --v.ref_count==0) {
-        if (g_hw_sdk->FreeHairAsset(v.aid) == GFSDK_HAIR_RETURN_OK) {
-            hwLog("GFSDK_HairSDK::FreeHairAsset(%d) succeeded.\n", ha);
+        if (m_assetBudget > 0) {
+            v.last_used = ++m_assetClock;
+            evictAssets();
         }
         else {
-            hwLog("GFSDK_HairSDK::FreeHairAsset(%d) failed.\n", ha);
+            retireAsset(ha);
         }
-        v.invalidate();
+        collectRetired();
     }
 }
 
-void hwContext::assetReload(hwHAsset ha)
+void hwContext::retireAsset(hwHAsset ha)
 {
-    if (ha >= m_assets.size()) { return; }
+    retire(m_assets[ha].retire);
+    m_retiredAssets.push_back(ha);
+}
 
+void hwContext::freeAsset(hwHAsset ha)
+{
     auto &v = m_assets[ha];
-    // release existing asset
-    if (g_hw_sdk->FreeHairAsset(v.aid)) {
-        v.aid = hwNullAssetID;
+    releaseLODChain(ha);
+    releaseAssetID(v.aid);
+    v.invalidate();
+}
+
+// the SDK asset is freed by collectAssetIDs() once no instance created from it is left
+void hwContext::releaseAssetID(hwAssetID aid)
+{
+    if (aid == hwNullAssetID) { return; }
+    m_releasedAssetIDs.push_back(aid);
+}
+
+// main thread. instances are recreated from another asset on the render thread (instanceSetLODImpl()), which swaps
+// hwInstanceData::aid under m_mutexDesc
+void hwContext::collectAssetIDs()
+{
+    if (m_releasedAssetIDs.empty()) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutexDesc);
+    m_releasedAssetIDs.erase(std::remove_if(m_releasedAssetIDs.begin(), m_releasedAssetIDs.end(), [&](hwAssetID aid) {
+        for (auto &i : m_instances) {
+            if (i.iid != hwNullInstanceID && i.aid == aid) { return false; }
+        }
+        if (g_hw_sdk->FreeHairAsset(aid) == GFSDK_HAIR_RETURN_OK) {
+            hwLog("GFSDK_HairSDK::FreeHairAsset(%d) succeeded.\n", aid);
+        }
+        else {
+            hwLogError("GFSDK_HairSDK::FreeHairAsset(%d) failed.\n", aid);
+        }
+        return true;
+    }), m_releasedAssetIDs.end());
+}
+
+static bool hwGetAssetCounts(hwAssetID aid, hwAssetInfo &o_info)
+{
+    gfsdk_U32 num_guide_hairs = 0, num_vertices = 0, num_faces = 0, num_bones = 0;
+    if (g_hw_sdk->GetNumGuideHairs(aid, &num_guide_hairs) != GFSDK_HAIR_RETURN_OK ||
+        g_hw_sdk->GetNumHairVertices(aid, &num_vertices) != GFSDK_HAIR_RETURN_OK ||
+        g_hw_sdk->GetNumFaces(aid, &num_faces) != GFSDK_HAIR_RETURN_OK ||
+        g_hw_sdk->GetNumBones(aid, &num_bones) != GFSDK_HAIR_RETURN_OK)
+    {
+        return false;
+    }
+    o_info.num_guide_hairs = (int)num_guide_hairs;
+    o_info.num_guide_vertices = (int)num_vertices;
+    o_info.num_faces = (int)num_faces;
+    o_info.num_bones = (int)num_bones;
+    return true;
+}
+
+// see hwEstimateAssetMemory(). runs at every load and LOD build, so the render hairs come from the default descriptor
+// instead of a temporary instance
+void hwContext::measureAsset(hwAssetData &v)
+{
+    hwAssetInfo info;
+    hwHairDescriptor desc;
+    if (!hwGetAssetCounts(v.aid, info)) {
+        hwLogError("hwContext::measureAsset(%d): failed to get asset counts.\n", v.handle);
+    }
+    else if (g_hw_sdk->CopyInstanceDescriptorFromAsset(v.aid, desc) == GFSDK_HAIR_RETURN_OK) {
+        hwEstimateRenderHairs(info, desc.m_density);
     }
+    auto mem = hwEstimateAssetMemory(info);
+    v.bytes = mem.asset();
+    v.instance_bytes = mem.render;
+}
 
-    // reload
-    if (g_hw_sdk->LoadHairAssetFromFile(v.path.c_str(), &v.aid, nullptr, &v.settings) == GFSDK_HAIR_RETURN_OK) {
+// counted at the level the instance renders (see instanceSetLODImpl()) with the default descriptor's density
+int64_t hwContext::getInstanceBytes(const hwInstanceData &i) const
+{
+    if (!i || i.hasset >= m_assets.size()) { return 0; }
+    auto &a = m_assets[i.hasset];
+    int lod = i.lod;
+    return lod > 0 && lod <= (int)a.lods.size() ? m_assets[a.lods[lod - 1]].instance_bytes : a.instance_bytes;
+}
+
+int64_t hwContext::getResidentBytes() const
+{
+    int64_t r = 0;
+    for (auto &a : m_assets) {
+        if (a) { r += a.bytes; }
+    }
+    for (auto &i : m_instances) { r += getInstanceBytes(i); }
+    return r;
+}
+
+// frees released assets, least recently released first, until the estimate fits the budget. assets still referenced
+// are never evicted: the estimate can stay over the budget
+void hwContext::evictAssets()
+{
+    if (m_assetBudget <= 0) { return; }
+
+    int64_t resident = getResidentBytes();
+    while (resident > m_assetBudget) {
+        hwAssetData *lru = nullptr;
+        for (auto &a : m_assets) {
+            if (!a || a.ref_count > 0 || a.lod_base != hwNullHandle) { continue; }
+            // instances outliving the release of their asset keep it
+            bool used = std::any_of(m_instances.begin(), m_instances.end(),
+                [&](const hwInstanceData &i) { return i && i.hasset == a.handle; });
+            if (!used && (!lru || a.last_used < lru->last_used)) { lru = &a; }
+        }
+        if (!lru) { break; }
+
+        resident -= lru->bytes;
+        for (auto lh : lru->lods) { resident -= m_assets[lh].bytes; }
+        hwLog("hwContext::evictAssets(): evicting \"%s\" (%lld bytes).\n", lru->path.c_str(), (long long)lru->bytes);
+        m_evictedPaths.insert(lru->path);
+        retireAsset(lru->handle);
+        ++m_stats.num_asset_evictions;
+    }
+}
+
+void hwContext::setAssetMemoryBudget(int64_t bytes)
+{
+    m_assetBudget = std::max<int64_t>(bytes, 0);
+    if (m_assetBudget > 0) {
+        evictAssets();
+    }
+    else {
+        // no budget: nothing is kept after its last release
+        for (auto &a : m_assets) {
+            if (a && a.ref_count == 0 && a.lod_base == hwNullHandle) { retireAsset(a.handle); }
+        }
+        collectRetired();
+    }
+}
+
+// the asset, its LOD levels and its instances
+int64_t hwContext::assetGetMemoryUsage(hwHAsset ha) const
+{
+    if (ha >= m_assets.size() || !m_assets[ha]) { return 0; }
+    auto &a = m_assets[ha];
+
+    int64_t r = a.bytes;
+    for (auto lh : a.lods) { r += m_assets[lh].bytes; }
+    for (auto &i : m_instances) {
+        if (i.hasset == ha) { r += getInstanceBytes(i); }
+    }
+    return r;
+}
+
+void hwContext::assetReload(hwHAsset ha)
+{
+    hwTraceScoped("hwContext::assetReload");
+    if (ha >= m_assets.size()) { return; }
+
+    auto &v = m_assets[ha];
+    hwAssetID aid = hwNullAssetID;
+    if (hwLoadHairAsset(v.path, &aid) == GFSDK_HAIR_RETURN_OK) {
+        {
+            // the old one stays alive for the instances created from it until they are recreated below
+            std::unique_lock<std::mutex> lock(m_mutexDesc);
+            releaseAssetID(v.aid);
+            v.aid = aid;
+        }
+        cacheBindPose(v);
+        measureAsset(v);
         hwLog("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") : %d reloaded.\n", v.path.c_str(), v.handle);
+
+        // the source changed, so do the cached levels
+        for (size_t li = 0; li < m_assets[ha].lods.size(); ++li) {
+            buildLODLevel(ha, m_assets[ha].lods[li], (int)li + 1);
+        }
+
+        // recreated at their level at the next flush (see instanceSetLODImpl())
+        std::unique_lock<std::mutex> lock(m_mutexLOD);
+        for (auto &i : m_instances) {
+            if (i && i.hasset == ha) { m_lodRequests.emplace_back(i.handle, i.lod); }
+        }
     }
     else {
-        hwLog("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") failed to reload.\n", v.path.c_str());
+        hwLogError("GFSDK_HairSDK::LoadHairAssetFromFile(\"%s\") failed to reload.\n", v.path.c_str());
     }
 }
 
@@ -441,22 +647,75 @@ int hwContext::assetGetNumBones(hwHAsset ha) const
     if (ha >= m_assets.size()) { return r; }
 
     if (g_hw_sdk->GetNumBones(m_assets[ha].aid, &r) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::GetNumBones(%d) failed.\n", ha);
+        hwLogError("GFSDK_HairSDK::GetNumBones(%d) failed.\n", ha);
     }
     return r;
 }
 
 const char* hwContext::assetGetBoneName(hwHAsset ha, int nth) const
 {
-    static char tmp[256];
+    thread_local char tmp[GFSDK_HAIR_MAX_STRING];
     if (ha >= m_assets.size()) { tmp[0] = '\0'; return tmp; }
 
     if (g_hw_sdk->GetBoneName(m_assets[ha].aid, nth, tmp) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::GetBoneName(%d) failed.\n", ha);
+        hwLogError("GFSDK_HairSDK::GetBoneName(%d) failed.\n", ha);
     }
     return tmp;
 }
 
+// returns the number of bones. fills up to max_entries of dst
+int hwContext::assetGetBoneTable(hwHAsset ha, hwBoneTableEntry *dst, int max_entries) const
+{
+    if (ha >= m_assets.size()) { return 0; }
+    auto &v = m_assets[ha];
+
+    uint32_t num_bones = 0;
+    if (g_hw_sdk->GetNumBones(v.aid, &num_bones) != GFSDK_HAIR_RETURN_OK) {
+        hwLogError("GFSDK_HairSDK::GetNumBones(%d) failed.\n", ha);
+        return 0;
+    }
+    if (dst == nullptr) { return num_bones; }
+
+    int n = std::min<int>(num_bones, max_entries);
+    for (int bi = 0; bi < n; ++bi) {
+        auto &e = dst[bi];
+        e.index = bi;
+        e.parent = -1;
+        e.name[0] = '\0';
+        if (g_hw_sdk->GetBoneName(v.aid, bi, e.name) != GFSDK_HAIR_RETURN_OK) {
+            hwLogError("GFSDK_HairSDK::GetBoneName(%d) failed.\n", ha);
+        }
+        if (g_hw_sdk->GetBindPose(v.aid, bi, &e.bindpose) != GFSDK_HAIR_RETURN_OK) {
+            hwLogError("GFSDK_HairSDK::GetBindPose(%d, %d) failed.\n", ha, bi);
+        }
+    }
+    return num_bones;
+}
+
+// reorders the bones of the asset to bone_names (e.g. the engine skeleton order).
+// instances created from the asset before remapping keep the old order, so this should be called before creating them.
+bool hwContext::assetSetBoneRemapping(hwHAsset ha, int num_bones, const char **bone_names)
+{
+    if (ha >= m_assets.size() || bone_names == nullptr || num_bones <= 0) { return false; }
+    auto &v = m_assets[ha];
+
+    if (g_hw_sdk->SetBoneRemapping(v.aid, bone_names, num_bones) != GFSDK_HAIR_RETURN_OK) {
+        hwLogError("GFSDK_HairSDK::SetBoneRemapping(%d) failed.\n", ha);
+        return false;
+    }
+    cacheBindPose(v);
+
+    // instances switched to a LOD level take the same palettes
+    for (auto lh : v.lods) {
+        auto &l = m_assets[lh];
+        if (g_hw_sdk->SetBoneRemapping(l.aid, bone_names, num_bones) != GFSDK_HAIR_RETURN_OK) {
+            hwLogError("GFSDK_HairSDK::SetBoneRemapping(%d) failed for LOD level %d.\n", ha, lh);
+        }
+        cacheBindPose(l);
+    }
+    return true;
+}
+
 const char* hwContext::assetGetTextureName(hwHAsset ha, int textureType) const
 {
 	static char textureFileName[1024];
@@ -471,7 +730,7 @@ void hwContext::assetGetBoneIndices(hwHAsset ha, hwFloat4 &o_indices) const
     if (ha >= m_assets.size()) { return; }
 
     if (g_hw_sdk->GetBoneIndices(m_assets[ha].aid, &o_indices) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::GetBoneIndices(%d) failed.\n", ha);
+        hwLogError("GFSDK_HairSDK::GetBoneIndices(%d) failed.\n", ha);
     }
 }
 
@@ -480,7 +739,7 @@ void hwContext::assetGetBoneWeights(hwHAsset ha, hwFloat4 &o_weight) const
     if (ha >= m_assets.size()) { return; }
 
     if (g_hw_sdk->GetBoneWeights(m_assets[ha].aid, &o_weight) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::GetBoneWeights(%d) failed.\n", ha);
+        hwLogError("GFSDK_HairSDK::GetBoneWeights(%d) failed.\n", ha);
     }
 }
 
@@ -489,7 +748,7 @@ void hwContext::assetGetBindPose(hwHAsset ha, int nth, hwMatrix &o_mat)
     if (ha >= m_assets.size()) { return; }
 
     if (g_hw_sdk->GetBindPose(m_assets[ha].aid, nth, &o_mat) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::GetBindPose(%d, %d) failed.\n", ha, nth);
+        hwLogError("GFSDK_HairSDK::GetBindPose(%d, %d) failed.\n", ha, nth);
     }
 }
 
@@ -498,160 +757,690 @@ void hwContext::assetGetDefaultDescriptor(hwHAsset ha, hwHairDescriptor &o_desc)
     if (ha >= m_assets.size()) { return; }
 
     if (g_hw_sdk->CopyInstanceDescriptorFromAsset(m_assets[ha].aid, o_desc) != GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::CopyInstanceDescriptorFromAsset(%d) failed.\n", ha);
+        hwLogError("GFSDK_HairSDK::CopyInstanceDescriptorFromAsset(%d) failed.\n", ha);
+    }
+}
+
+// counts come from the asset. render hair stats need an instance: one is created with the default descriptor and freed
+// right away, it never enters m_instances
+bool hwContext::assetGetInfo(hwHAsset ha, hwAssetInfo &o_info) const
+{
+    o_info = hwAssetInfo();
+    if (ha >= m_assets.size() || !m_assets[ha]) { return false; }
+    auto &v = m_assets[ha];
+
+    if (!hwGetAssetCounts(v.aid, o_info)) {
+        hwLogError("hwContext::assetGetInfo(%d): failed to get asset counts.\n", ha);
+        return false;
+    }
+
+    hwInstanceID iid = hwNullInstanceID;
+    if (g_hw_sdk->CreateHairInstance(v.aid, &iid) != GFSDK_HAIR_RETURN_OK) {
+        hwLogError("GFSDK_HairSDK::CreateHairInstance(%d) failed.\n", ha);
+        return false;
+    }
+    GFSDK_HairStats stats;
+    bool ok = g_hw_sdk->ComputeStats(iid, &stats) == GFSDK_HAIR_RETURN_OK;
+    if (ok) {
+        o_info.num_render_hairs = stats.m_numHairs;
+        o_info.average_cvs = stats.m_averageCV;
+        o_info.average_density = stats.m_averageDensity;
+        o_info.average_hairs_per_face = stats.m_averageHairsPerFace;
+    }
+    else {
+        hwLogError("GFSDK_HairSDK::ComputeStats(%d) failed.\n", ha);
+    }
+    g_hw_sdk->FreeHairInstance(iid);
+    return ok;
+}
+
+// %LOCALAPPDATA%\HairWorks\LOD, $XDG_CACHE_HOME/hairworks/lod or ~/.cache/hairworks/lod, created if missing. empty if
+// there is none: the levels are then only kept in memory
+static std::string hwLODCacheDir()
+{
+    std::string dir;
+#ifdef hwWindows
+    if (const char *e = getenv("LOCALAPPDATA")) { if (*e) { dir = std::string(e) + "\\HairWorks\\LOD"; } }
+#else // hwWindows
+    if (const char *e = getenv("XDG_CACHE_HOME")) { if (*e) { dir = std::string(e) + "/hairworks/lod"; } }
+    if (dir.empty()) {
+        if (const char *e = getenv("HOME")) { if (*e) { dir = std::string(e) + "/.cache/hairworks/lod"; } }
+    }
+#endif // hwWindows
+    if (dir.empty()) { return dir; }
+
+    // one level at a time. the ones that exist fail harmlessly
+    for (size_t i = 1; i <= dir.size(); ++i) {
+        if (i < dir.size() && dir[i] != '/' && dir[i] != '\\') { continue; }
+#ifdef hwWindows
+        _mkdir(dir.substr(0, i).c_str());
+#else // hwWindows
+        mkdir(dir.substr(0, i).c_str(), 0755);
+#endif // hwWindows
+    }
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || (st.st_mode & S_IFDIR) == 0) {
+        hwLogWarning("hwLODCacheDir(): can not create \"%s\". LOD levels will not be cached.\n", dir.c_str());
+        return std::string();
+    }
+    return dir;
+}
+
+// "assets/hair.apx" -> "<cache dir>/hair.<hash of the absolute path>.lod1.apx". never next to the source, which may be
+// shipped read-only. empty if there is no cache directory
+static std::string hwLODCachePath(const std::string &path, int level)
+{
+    static const std::string dir = hwLODCacheDir();
+    if (dir.empty()) { return dir; }
+
+#ifdef hwWindows
+    char *full = _fullpath(nullptr, path.c_str(), 0);
+#else // hwWindows
+    char *full = realpath(path.c_str(), nullptr);
+#endif // hwWindows
+    std::string key = full ? full : path;
+    free(full);
+    uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a
+    for (char c : key) { hash = (hash ^ (uint8_t)c) * 0x100000001b3ull; }
+
+    size_t sep = path.find_last_of("/\\");
+    std::string name = sep == std::string::npos ? path : path.substr(sep + 1);
+    size_t dot = name.find_last_of('.');
+    std::string ext = dot == std::string::npos ? ".apx" : name.substr(dot);
+    if (dot != std::string::npos) { name.resize(dot); }
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%016llx.lod%d", (unsigned long long)hash, level);
+    return dir + "/" + name + suffix + ext;
+}
+
+// true if cache exists and was written after source
+static bool hwIsCacheFresh(const std::string &cache, const std::string &source)
+{
+    struct stat cs, ss;
+    if (stat(cache.c_str(), &cs) != 0) { return false; }
+    if (stat(source.c_str(), &ss) != 0) { return true; }
+    return cs.st_mtime >= ss.st_mtime;
+}
+
+static int hwGetControlVerticesPerHair(hwAssetID aid)
+{
+    gfsdk_U32 num_guide_hairs = 0, num_vertices = 0;
+    if (g_hw_sdk->GetNumGuideHairs(aid, &num_guide_hairs) != GFSDK_HAIR_RETURN_OK || num_guide_hairs == 0 ||
+        g_hw_sdk->GetNumHairVertices(aid, &num_vertices) != GFSDK_HAIR_RETURN_OK)
+    {
+        return 0;
     }
+    return (int)(num_vertices / num_guide_hairs);
 }
 
-hwInstanceData& hwContext::newInstanceData()
+// level n has the control vertices of base halved n times (at least 2 per hair). it is loaded from its cache file if
+// that is newer than the source. otherwise the source is copied, resampled and the cache written.
+// rebuilding a level (assetReload()) keeps its previous SDK asset alive for the instances still using it
+bool hwContext::buildLODLevel(hwHAsset base, hwHAsset ha, int level)
 {
-    auto i = std::find_if(m_instances.begin(), m_instances.end(), [](const hwInstanceData &v) { return !v; });
-    if (i != m_instances.end()) { return *i; }
+    hwTraceScoped("hwContext::buildLODLevel");
+    auto &b = m_assets[base];
+    auto &v = m_assets[ha];
+
+    int cvs = std::max(hwGetControlVerticesPerHair(b.aid) >> level, 2);
+    std::string cache = hwLODCachePath(b.path, level);
+    v.settings = b.settings;
+    v.lod_base = base;
+
+    hwAssetID aid = hwNullAssetID;
+    bool cached = false;
+    if (!cache.empty() && hwIsCacheFresh(cache, b.path) && hwLoadHairAsset(cache, &aid) == GFSDK_HAIR_RETURN_OK) {
+        cached = hwGetControlVerticesPerHair(aid) == cvs;
+        if (!cached) {
+            g_hw_sdk->FreeHairAsset(aid);
+            aid = hwNullAssetID;
+        }
+    }
+
+    // CopyAsset() needs an existing destination. copying over a fresh load carries runtime changes (bone remapping)
+    GFSDK_HairAssetCopySettings copy_settings;
+    copy_settings.m_copyAll = true;
+    if (!cached && (
+        hwLoadHairAsset(b.path, &aid) != GFSDK_HAIR_RETURN_OK ||
+        g_hw_sdk->CopyAsset(b.aid, aid, copy_settings) != GFSDK_HAIR_RETURN_OK ||
+        g_hw_sdk->ResampleGuideHairs(aid, (gfsdk_U16)cvs) != GFSDK_HAIR_RETURN_OK))
+    {
+        hwLogError("hwContext::buildLODLevel(%d, %d): failed to resample \"%s\".\n", base, level, b.path.c_str());
+        if (aid != hwNullAssetID) { g_hw_sdk->FreeHairAsset(aid); }
+        // a rebuild keeps the previous level
+        if (v.aid == hwNullAssetID) { v.invalidate(); }
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutexDesc);
+        releaseAssetID(v.aid);
+        v.aid = aid;
+    }
+    v.path = cache;
+    v.ref_count = 1;
+    cacheBindPose(v);
+    measureAsset(v);
+
+    if (cached) {
+        hwLog("hwContext::buildLODLevel(%d, %d): loaded \"%s\".\n", base, level, cache.c_str());
+        return true;
+    }
+    // an unwritable cache only costs the resampling at the next load
+    if (!cache.empty() && g_hw_sdk->SaveHairAssetToFile(cache.c_str(), aid) != GFSDK_HAIR_RETURN_OK) {
+        hwLogWarning("GFSDK_HairSDK::SaveHairAssetToFile(\"%s\") failed.\n", cache.c_str());
+    }
+    hwLog("hwContext::buildLODLevel(%d, %d): resampled to %d control vertices per hair.\n", base, level, cvs);
+    return true;
+}
+
+// builds levels 1..levels of ha. levels already built are kept. returns the number of levels including level 0
+int hwContext::assetBuildLODChain(hwHAsset ha, int levels)
+{
+    hwTraceScoped("hwContext::assetBuildLODChain");
+    if (ha >= m_assets.size() || !m_assets[ha] || m_assets[ha].lod_base != hwNullHandle) { return 0; }
+
+    levels = std::min(levels, 8);
+    int base_cvs = hwGetControlVerticesPerHair(m_assets[ha].aid);
+    for (int level = (int)m_assets[ha].lods.size() + 1; level <= levels; ++level) {
+        // same rule as buildLODLevel(). stop when there is nothing left to remove
+        if (std::max(base_cvs >> level, 2) >= std::max(base_cvs >> (level - 1), 2)) { break; }
+
+        hwAssetData *l = newAssetData();
+        if (!l) { break; }
+        hwHAsset lh = l->handle;
+        m_assets[lh].lod_base = ha;
+        if (!buildLODLevel(ha, lh, level)) { break; }
+        m_assets[ha].lods.push_back(lh);
+    }
+    evictAssets();
+    return (int)m_assets[ha].lods.size() + 1;
+}
+
+int hwContext::assetGetNumLODs(hwHAsset ha) const
+{
+    if (ha >= m_assets.size() || !m_assets[ha]) { return 0; }
+    return (int)m_assets[ha].lods.size() + 1;
+}
+
+void hwContext::releaseLODChain(hwHAsset ha)
+{
+    for (auto lh : m_assets[ha].lods) {
+        auto &l = m_assets[lh];
+        if (l && l.lod_base == ha) {
+            releaseAssetID(l.aid);
+            l.invalidate();
+        }
+    }
+    m_assets[ha].lods.clear();
+}
+
+// nullptr if the table is full
+hwInstanceData* hwContext::newInstanceData()
+{
+    auto i = std::find_if(m_instances.begin(), m_instances.end(), [](const hwInstanceData &v) { return v.iid == hwNullInstanceID; });
+    if (i != m_instances.end()) { return &*i; }
 
     hwInstanceData tmp;
     tmp.handle = m_instances.size();
-    m_instances.push_back(tmp);
-    return m_instances.back();
+    if (!m_instances.push_back(tmp)) {
+        hwLogError("hwContext::newInstanceData(): too many instances (%d).\n", (int)m_instances.max_size());
+        return nullptr;
+    }
+    return &m_instances.back();
 }
 
 hwHInstance hwContext::instanceCreate(hwHAsset ha)
 {
 	if (ha >= m_assets.size()) { return hwNullHandle; }
-	hwInstanceData& v = newInstanceData();
+	collectRetired();
+	hwInstanceData *i = newInstanceData();
+	if (!i) { return hwNullHandle; }
+	hwInstanceData &v = *i;
 	v.hasset = ha;
 	if (g_hw_sdk->CreateHairInstance(m_assets[ha].aid, &v.iid) == GFSDK_HAIR_RETURN_OK) {
 		hwLog("GFSDK_HairSDK::CreateHairInstance(%d) : %d succeeded.\n", ha, v.handle);
+		v.aid = m_assets[ha].aid;
+
+		// initialize shadow descriptor. instanceSetDescriptor() compares against this and skips redundant updates
+		v.desc = hwHairDescriptor();
+		v.desc_valid = g_hw_sdk->CopyCurrentInstanceDescriptor(v.iid, v.desc) == GFSDK_HAIR_RETURN_OK;
+		v.cast_shadow = v.desc_valid && v.desc.m_castShadows;
+		v.receive_shadow = v.desc_valid && v.desc.m_receiveShadows;
+		v.sim_applied = v.desc_valid && v.desc.m_simulate;
+
+		gfsdk_U32 num_vertices = 0;
+		g_hw_sdk->GetNumHairVertices(m_assets[ha].aid, &num_vertices);
+		v.num_vertices = (int)num_vertices;
 	}
 	else
 	{
-		hwLog("GFSDK_HairSDK::CreateHairInstance(%d) failed.\n", ha);
+		hwLogError("GFSDK_HairSDK::CreateHairInstance(%d) failed.\n", ha);
 	}
 	return v.handle;
 }
 
 void hwContext::instanceRelease(hwHInstance hi)
 {
-    if (hi >= m_instances.size()) { return; }
-    auto &v = m_instances[hi];
+    if (hi >= m_instances.size() || !m_instances[hi]) { return; }
 
-    if (g_hw_sdk->FreeHairInstance(v.iid) == GFSDK_HAIR_RETURN_OK) {
-        hwLog("GFSDK_HairSDK::FreeHairInstance(%d) succeeded.\n", hi);
+    // commands already recorded for it are skipped from here. the SDK instance is freed once no flush can be using it
+    retire(m_instances[hi].retire);
+    m_retiredInstances.push_back(hi);
+    if (m_instances[hi].desc_mapped) {
+        // the block stays allocated for the slot. a caller writing to it after the release is ignored until remapped
+        m_instances[hi].desc_mapped = false;
+        --m_numMappedDescs;
     }
-    else {
-        hwLog("GFSDK_HairSDK::FreeHairInstance(%d) failed.\n", hi);
+    {
+        // a pending switch must not reach the next instance created in this slot
+        std::unique_lock<std::mutex> lock(m_mutexLOD);
+        m_lodRequests.erase(std::remove_if(m_lodRequests.begin(), m_lodRequests.end(),
+            [hi](const std::pair<hwHInstance, int> &r) { return r.first == hi; }), m_lodRequests.end());
     }
-    v.invalidate();
+    collectRetired();
 }
 
-void hwContext::instanceGetBounds(hwHInstance hi, hwFloat3 &o_min, hwFloat3 &o_max) const
+// seq_cst on both sides: either the render thread's next flush sees the flag, or the epoch read here shows it inside
+// a flush and the entry waits for it to leave.
+// commands recorded for it wait in the frames ended so far, and in the open one when released inside a scene. main
+// thread, the only writer of m_recordedFrames and m_inScene
+void hwContext::retire(hwRetireState &s)
 {
-    if (hi >= m_instances.size()) { return; }
-    auto &v = m_instances[hi];
-
-    if (g_hw_sdk->GetBounds(v.iid, &o_min, &o_max) != GFSDK_HAIR_RETURN_OK)
-    {
-        hwLog("GFSDK_HairSDK::GetBounds(%d) failed.\n", hi);
+    s.retired.store(true);
+    s.epoch = m_renderEpoch.load();
+    for (int k = 0; k < 2; ++k) {
+        s.frames[k] = m_recordedFrames[k] + (m_inScene[k] ? 1 : 0);
     }
 }
 
-void hwContext::instanceGetDescriptor(hwHInstance hi, hwHairDescriptor &desc) const
+bool hwContext::isRetireSafe(const hwRetireState &s) const
 {
-	if (hi >= m_instances.size()) { return; }
-	auto &v = m_instances[hi];
-
-	if (g_hw_sdk->CopyCurrentInstanceDescriptor(v.iid, desc) != GFSDK_HAIR_RETURN_OK)
-	{
-		hwLog("GFSDK_HairSDK::CopyCurrentInstanceDescriptor(%d) failed.\n", hi);
-	}	
+    return ((s.epoch & 1) == 0 || m_renderEpoch.load() != s.epoch) &&
+        m_flushedFrames[0].load() >= s.frames[0] && m_flushedFrames[1].load() >= s.frames[1];
 }
 
-void hwContext::instanceSetDescriptor(hwHInstance hi, const hwHairDescriptor &desc)
+// removes the handles free() took care of
+template<class Free>
+static void hwCollect(std::vector<uint32_t> &handles, const Free &free)
 {
-	if (hi >= m_instances.size()) { return; }
-	auto &v = m_instances[hi];
+    if (handles.empty()) { return; }
+    handles.erase(std::remove_if(handles.begin(), handles.end(), free), handles.end());
+}
 
-	if (g_hw_sdk->UpdateInstanceDescriptor(v.iid, desc) != GFSDK_HAIR_RETURN_OK)
-	{
-		hwLog("GFSDK_HairSDK::UpdateInstanceDescriptor(%d) failed.\n", hi);
-	}	
+// main thread. frees the retired entries no flush can be using anymore, instances before the assets they were created
+// from. force: the render thread is known to be idle (finalize())
+void hwContext::collectRetired(bool force)
+{
+    hwCollect(m_retiredInstances, [&](hwHInstance hi) {
+        auto &v = m_instances[hi];
+        if (!force && !isRetireSafe(v.retire)) { return false; }
+        if (g_hw_sdk->FreeHairInstance(v.iid) == GFSDK_HAIR_RETURN_OK) {
+            hwLog("GFSDK_HairSDK::FreeHairInstance(%d) succeeded.\n", hi);
+        }
+        else {
+            hwLogError("GFSDK_HairSDK::FreeHairInstance(%d) failed.\n", hi);
+        }
+        v.invalidate();
+        return true;
+    });
+    hwCollect(m_retiredAssets, [&](hwHAsset ha) {
+        if (!force && !isRetireSafe(m_assets[ha].retire)) { return false; }
+        freeAsset(ha);
+        return true;
+    });
+    hwCollect(m_retiredShaders, [&](hwHShader hs) {
+        auto &v = m_shaders[hs];
+        if (!force && !isRetireSafe(v.retire)) { return false; }
+        m_device->releasePixelShader(v.shader);
+        v.invalidate();
+        hwLog("shaderRelease(%d)\n", hs);
+        return true;
+    });
+    collectAssetIDs();
 }
 
-void hwContext::instanceSetTexture(hwHInstance hi, hwTextureType type, hwTexture *tex)
+// switches the instance to guide hair LOD level of its asset (see assetBuildLODChain()), keeping its descriptor and
+// textures. takes effect at the next flush, before the skinning and simulation recorded for that frame
+void hwContext::instanceSetLOD(hwHInstance hi, int level)
 {
-	if (m_d3dctx != nullptr && g_hw_sdk != nullptr)
-	{
+    if (hi >= m_instances.size() || !m_instances[hi]) { return; }
+    level = std::max(std::min(level, assetGetNumLODs(m_instances[hi].hasset) - 1), 0);
+
+    std::unique_lock<std::mutex> lock(m_mutexLOD);
+    m_lodRequests.emplace_back(hi, level);
+}
+
+// the level in use. lags instanceSetLOD() until the next flush
+int hwContext::instanceGetLOD(hwHInstance hi) const
+{
+    if (hi >= m_instances.size()) { return 0; }
+    return m_instances[hi].lod;
+}
+
+void hwContext::applyLODRequests()
+{
+    std::vector<std::pair<hwHInstance, int>> requests;
+    {
+        std::unique_lock<std::mutex> lock(m_mutexLOD);
+        if (m_lodRequests.empty()) { return; }
+        requests.swap(m_lodRequests);
+    }
+    m_telemetryFrame.lod_requests += (int)requests.size();
+    for (auto &r : requests) {
+        instanceSetLODImpl(r.first, r.second);
+    }
+}
+
+// the SDK can not change the asset of an instance: a new one is created from the level's asset and given the old one's
+// descriptor and textures. it starts from its skinned pose at the next skinning upload.
+// also recreates an instance at its own level when the level's asset was reloaded (assetReload()).
+// the swap is done under m_mutexDesc, which the main thread calls using iid outside a flush hold
+void hwContext::instanceSetLODImpl(hwHInstance hi, int level)
+{
+    hwTraceScoped("hwContext::instanceSetLODImpl");
+    if (hi >= m_instances.size()) { return; }
+    auto &v = m_instances[hi];
+    if (!v || v.hasset >= m_assets.size()) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutexDesc);
+    auto &a = m_assets[v.hasset];
+    if (!a || level < 0 || level > (int)a.lods.size()) { return; }
+    hwAssetID aid = level == 0 ? a.aid : m_assets[a.lods[level - 1]].aid;
+    if (v.lod == level && v.aid == aid) { return; }
+
+    hwInstanceID iid = hwNullInstanceID;
+    if (g_hw_sdk->CreateHairInstance(aid, &iid) != GFSDK_HAIR_RETURN_OK) {
+        hwLogError("GFSDK_HairSDK::CreateHairInstance(%d) failed for LOD level %d.\n", v.hasset, level);
+        return;
+    }
+    hwInstanceID old = v.iid;
+    v.iid = iid;
+    v.aid = aid;
+    if (v.desc_valid) {
+        uploadDescriptor(v);
+    }
+    for (int t = 0; t < GFSDK_HAIR_NUM_TEXTURES; ++t) {
+        if (v.textures[t]) { g_hw_sdk->SetTextureSRV(iid, (GFSDK_HAIR_TEXTURE_TYPE)t, v.textures[t]); }
+    }
+    g_hw_sdk->FreeHairInstance(old);
+
+    gfsdk_U32 num_vertices = 0;
+    g_hw_sdk->GetNumHairVertices(aid, &num_vertices);
+    v.num_vertices = (int)num_vertices;
+    if (v.lod != level) { ++m_stats.num_lod_switches; }
+    v.lod = level;
+    v.palette_valid = false;
+    v.teleport_pending = true;
+}
+
+void hwContext::instanceGetBounds(hwHInstance hi, hwFloat3 &o_min, hwFloat3 &o_max) const
+{
+    if (hi >= m_instances.size()) { return; }
+    auto &v = m_instances[hi];
+
+    std::unique_lock<std::mutex> lock(m_mutexDesc);
+    if (g_hw_sdk->GetBounds(v.iid, &o_min, &o_max) != GFSDK_HAIR_RETURN_OK)
+    {
+        hwLogError("GFSDK_HairSDK::GetBounds(%d) failed.\n", hi);
+    }
+}
+
+void hwContext::instanceGetDescriptor(hwHInstance hi, hwHairDescriptor &desc) const
+{
+	if (hi >= m_instances.size()) { return; }
+	auto &v = m_instances[hi];
+
+	// the SDK's copy may have m_simulate overridden by sleep. return what the user set
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+	if (v.desc_valid)
+	{
+		desc = v.desc;
+		return;
+	}
+	if (g_hw_sdk->CopyCurrentInstanceDescriptor(v.iid, desc) != GFSDK_HAIR_RETURN_OK)
+	{
+		hwLogError("GFSDK_HairSDK::CopyCurrentInstanceDescriptor(%d) failed.\n", hi);
+	}	
+}
+
+void hwContext::instanceSetDescriptor(hwHInstance hi, const hwHairDescriptor &desc)
+{
+	if (hi >= m_instances.size()) { return; }
+	auto &v = m_instances[hi];
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+
+	// Unity sends the whole descriptor every frame. forward it only if something actually changed
+	if (v.desc_valid && hwDescriptorEqual(v.desc, desc))
+	{
+		++m_stats.num_descriptor_updates_skipped;
+		return;
+	}
+
+	v.desc = desc;
+	v.desc_valid = true;
+	updateDescriptorBlock(v);
+	if (uploadDescriptor(v))
+	{
+		++m_stats.num_descriptor_updates;
+	}
+}
+
+// returns true if data hashes the same as the last palette uploaded for v (the upload can be dropped).
+// an instance waiting for its wake-up teleport always gets its upload. upload_size is only used for stats
+bool hwContext::skipUnchangedPalette(hwInstanceData &v, const void *data, size_t size, uint64_t seed, size_t upload_size)
+{
+	uint64_t hash = hwHashPalette(data, size, seed);
+	if (v.palette_valid && v.palette_hash == hash && !v.teleport_pending)
+	{
+		if (auto *r = g_thread_recording)
+		{
+			++r->num_skinning_uploads_skipped;
+			r->num_skinning_bytes_saved += upload_size;
+		}
+		else
+		{
+			++m_stats.num_skinning_uploads_skipped;
+			m_stats.num_skinning_bytes_saved += upload_size;
+		}
+		return true;
+	}
+	v.palette_hash = hash;
+	v.palette_valid = true;
+	return false;
+}
+
+// sends v.desc to the SDK, with m_simulate cleared while the instance sleeps, is parked or throttled by the budget. m_mutexDesc must be held
+bool hwContext::uploadDescriptor(hwInstanceData &v)
+{
+	hwHairDescriptor desc = v.desc;
+	desc.m_simulate = v.desc.m_simulate && v.sleep_state == hwSleepState_Awake && !v.parked && !v.throttled;
+
+	if (g_hw_sdk->UpdateInstanceDescriptor(v.iid, desc) == GFSDK_HAIR_RETURN_OK)
+	{
+		v.sim_applied = desc.m_simulate != 0;
+		v.cast_shadow = desc.m_castShadows;
+		v.receive_shadow = desc.m_receiveShadows;
+		return true;
+	}
+	else
+	{
+		v.desc_valid = false;
+		hwLogError("GFSDK_HairSDK::UpdateInstanceDescriptor(%d) failed.\n", v.handle);
+		return false;
+	}
+}
+
+// re-uploads the descriptor if sleep / parking / budget changed the effective m_simulate
+void hwContext::applySimulate(hwInstanceData &v)
+{
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+	if (!v.desc_valid) { return; }
+
+	bool sim = v.desc.m_simulate && v.sleep_state == hwSleepState_Awake && !v.parked && !v.throttled;
+	if (sim != v.sim_applied)
+	{
+		uploadDescriptor(v);
+	}
+}
+
+void hwContext::instanceSetDescriptorField(hwHInstance hi, int offset, int size, const void *data)
+{
+	if (hi >= m_instances.size() || data == nullptr) { return; }
+	if (offset < 0 || size <= 0 || offset + size > (int)sizeof(hwHairDescriptor))
+	{
+		hwLog("hwContext::instanceSetDescriptorField(%d): invalid range (offset %d, size %d).\n", hi, offset, size);
+		return;
+	}
+	auto &v = m_instances[hi];
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+
+	if (!v.desc_valid)
+	{
+		if (g_hw_sdk->CopyCurrentInstanceDescriptor(v.iid, v.desc) != GFSDK_HAIR_RETURN_OK)
+		{
+			hwLogError("GFSDK_HairSDK::CopyCurrentInstanceDescriptor(%d) failed.\n", hi);
+			return;
+		}
+		v.desc_valid = true;
+	}
+
+	char *dst = (char*)&v.desc + offset;
+	if (memcmp(dst, data, size) == 0)
+	{
+		++m_stats.num_descriptor_updates_skipped;
+		return;
+	}
+	memcpy(dst, data, size);
+	updateDescriptorBlock(v);
+
+	if (uploadDescriptor(v))
+	{
+		++m_stats.num_descriptor_updates;
+	}
+}
+
+hwDescriptorBlock* hwContext::instanceMapDescriptor(hwHInstance hi)
+{
+	if (hi >= m_instances.size() || !m_instances[hi]) { return nullptr; }
+	auto &v = m_instances[hi];
+	while (m_descBlocks.size() <= hi) {
+		if (!m_descBlocks.push_back(hwDescriptorBlock())) { return nullptr; }
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+	if (!v.desc_mapped)
+	{
+		if (!v.desc_valid)
+		{
+			if (g_hw_sdk->CopyCurrentInstanceDescriptor(v.iid, v.desc) != GFSDK_HAIR_RETURN_OK)
+			{
+				hwLogError("GFSDK_HairSDK::CopyCurrentInstanceDescriptor(%d) failed.\n", hi);
+				return nullptr;
+			}
+			v.desc_valid = true;
+		}
+		v.desc_mapped = true;
+		++m_numMappedDescs;
+		updateDescriptorBlock(v);
+	}
+	return &m_descBlocks[hi];
+}
+
+// keeps the mapped block in step with a descriptor set through the other setters. m_mutexDesc must be held
+void hwContext::updateDescriptorBlock(hwInstanceData &v)
+{
+	if (!v.desc_mapped) { return; }
+	auto &b = m_descBlocks[v.handle];
+	b.desc = v.desc;
+	b.dirty = 0;
+	++b.generation;
+}
+
+// forwards the mapped descriptors written since the last frame. unchanged ones cost a flag test
+void hwContext::syncDescriptorBlocks()
+{
+	if (m_numMappedDescs == 0) { return; }
+	hwTraceScoped("hwContext::syncDescriptorBlocks");
+
+	std::unique_lock<std::mutex> lock(m_mutexDesc);
+	size_t n = std::min(m_descBlocks.size(), m_instances.size());
+	for (size_t i = 0; i < n; ++i)
+	{
+		auto &b = m_descBlocks[i];
+		if (!b.dirty) { continue; }
+		b.dirty = 0;
+
+		auto &v = m_instances[i];
+		if (!v || !v.desc_mapped) { continue; }
+		if (v.desc_valid && hwDescriptorEqual(v.desc, b.desc))
+		{
+			++m_stats.num_descriptor_updates_skipped;
+			continue;
+		}
+		v.desc = b.desc;
+		v.desc_valid = true;
+		++b.generation;
+		if (uploadDescriptor(v))
+		{
+			++m_stats.num_descriptor_updates;
+		}
+	}
+}
+
+void hwContext::instanceSetTexture(hwHInstance hi, hwTextureType type, hwTexture *tex)
+{
+	if (m_device != nullptr && g_hw_sdk != nullptr)
+	{
 		if (hi >= m_instances.size()) { return; }
 		auto &v = m_instances[hi];
 
 		auto *srv = getSRV(tex);
+		std::unique_lock<std::mutex> lock(m_mutexDesc);
 		if (!srv || g_hw_sdk->SetTextureSRV(v.iid, type, srv) != GFSDK_HAIR_RETURN_OK)
 		{
-			hwLog("GFSDK_HairSDK::SetTextureSRV(%d, %d) failed.\n", hi, type);
+			hwLogError("GFSDK_HairSDK::SetTextureSRV(%d, %d) failed.\n", hi, type);
+		}
+		else if (type >= 0 && type < GFSDK_HAIR_NUM_TEXTURES)
+		{
+			v.textures[type] = srv;
 		}
 	}
 }
 
 void hwContext::instanceSetTextureIntoDevice(hwHInstance hi, hwTextureType type)
 {
-	if (m_d3dctx != nullptr && g_hw_sdk != nullptr)
+	if (m_device != nullptr && g_hw_sdk != nullptr)
 	{
 		// set texture sampler for texture color in hair shader
-		ID3D11SamplerState **states = new  ID3D11SamplerState*[1];
-		ID3D11SamplerState *localSampler;
-		getSamplerLinear(m_d3ddev, &localSampler);
-		states[0] = localSampler;
-		m_d3dctx->PSSetSamplers(0, 1, states);
+		m_device->setLinearClampSampler(0);
 
 		if (hi >= m_instances.size()) { return; }
 		auto &v = m_instances[hi];
 
 		// set textures
-		ID3D11ShaderResourceView* ppTextureSRVs[2];
+		hwSRV* ppTextureSRVs[2];
 		g_hw_sdk->GetTextureSRV(v.iid, GFSDK_HAIR_TEXTURE_ROOT_COLOR, &ppTextureSRVs[0]);
 		g_hw_sdk->GetTextureSRV(v.iid, GFSDK_HAIR_TEXTURE_TIP_COLOR, &ppTextureSRVs[1]);
 
 		// set to resource slot for our shader
-		m_d3dctx->PSSetShaderResources(GFSDK_HAIR_NUM_SHADER_RESOUCES, 2, ppTextureSRVs);
-	}
-}
-
-void hwContext::getSamplerLinear(ID3D11Device* pd3dDevice, ID3D11SamplerState** ppTexSampler)
-{
-	if (m_d3dctx != nullptr)
-	{
-		if (m_HairShaderSampler == nullptr)
-		{
-			D3D11_SAMPLER_DESC samplerDesc[1] = {
-				D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT,
-				D3D11_TEXTURE_ADDRESS_CLAMP,
-				D3D11_TEXTURE_ADDRESS_CLAMP,
-				D3D11_TEXTURE_ADDRESS_CLAMP,
-				0.0, 0, D3D11_COMPARISON_NEVER, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, D3D11_FLOAT32_MAX,
-			};
-
-			pd3dDevice->CreateSamplerState(samplerDesc, ppTexSampler);
-			m_HairShaderSampler = *ppTexSampler;
-		}
-		else
-		{
-			*ppTexSampler = m_HairShaderSampler;
-		}
-	}
-	else
-	{
-		*ppTexSampler = nullptr;
+		m_device->setShaderResources(GFSDK_HAIR_NUM_SHADER_RESOUCES, 2, ppTextureSRVs);
 	}
 }
 
 //
 void hwContext::instanceUpdateSkinningMatrices(hwHInstance hi, int num_bones, hwMatrix *matrices)
 {
+    hwTraceScoped("hwContext::instanceUpdateSkinningMatrices");
     if (matrices == nullptr) { return; }
     if (hi >= m_instances.size()) { return; }
     auto &v = m_instances[hi];
 
+    v.palette_valid = false;
+    std::unique_lock<std::mutex> lock(m_mutexDesc);
     if (g_hw_sdk->UpdateSkinningMatrices(v.iid, num_bones, matrices) != GFSDK_HAIR_RETURN_OK)
     {
-        hwLog("GFSDK_HairSDK::UpdateSkinningMatrices(%d) failed.\n", hi);
+        hwLogError("GFSDK_HairSDK::UpdateSkinningMatrices(%d) failed.\n", hi);
     }
 }
 
@@ -661,39 +1450,176 @@ void hwContext::instanceUpdateSkinningMatricesAsync(hwHInstance hi, int num_bone
 	if (matrices == nullptr) { return; }
 	if (hi >= m_instances.size()) { return; }
 	auto &v = m_instances[hi];
+	if (skipUnchangedPalette(v, matrices, sizeof(hwMatrix) * num_bones, 0, sizeof(hwMatrix) * num_bones)) { return; }
 
 	// store matrix locally
 	int startIndex = 0;
-	addBoneMatricesToBuffer(matrices, num_bones, startIndex);
+	if (!addBoneMatricesToBuffer(matrices, num_bones, startIndex))
+	{
+		v.palette_valid = false;
+		return;
+	}
 	
-	pushDeferredCall([=]() {
-		instanceUpdateSkinningMatricesAsyncImpl(v.iid, startIndex, num_bones);
-	}, vrMode);
+	auto c = [=]() {
+		instanceUpdateSkinningMatricesAsyncImpl(hi, startIndex, num_bones);
+	};
+	if (vrMode)
+		pushDeferredCall(c, true, hi);
+	else
+		pushFrameCall(c, hi);
 }
 
 //
-void hwContext::instanceUpdateSkinningMatricesAsyncImpl(hwInstanceID instance, int matrixIndex, int numMatrix)
+void hwContext::instanceUpdateSkinningMatricesAsyncImpl(hwHInstance hi, int matrixIndex, int numMatrix)
 {
-	if (g_hw_sdk->UpdateSkinningMatrices(instance, numMatrix, m_bonesMatrixBuffer + matrixIndex) != GFSDK_HAIR_RETURN_OK)
+	hwTraceScoped("hwContext::instanceUpdateSkinningMatricesAsyncImpl");
+	if (hi >= m_instances.size() || !m_instances[hi]) { return; }
+	auto &v = m_instances[hi];
+
+	// an instance waking up from sleep restarts from its skinned pose
+	auto teleport = v.teleport_pending ? GFSDK_HAIR_TELEPORT_MODE_TELEPORT_WITH_SKINNED_POSITION : GFSDK_HAIR_TELEPORT_MODE_NONE;
+	v.teleport_pending = false;
+
+	if (g_hw_sdk->UpdateSkinningMatrices(v.iid, numMatrix, m_bonesMatrixBuffer + matrixIndex, teleport) != GFSDK_HAIR_RETURN_OK)
 	{
-		hwLog("GFSDK_HairSDK::UpdateSkinningMatrices(%d) failed.\n", instance);
+		hwLogError("GFSDK_HairSDK::UpdateSkinningMatrices(%d) failed.\n", hi);
 	}
 }
 
+// builds the skinning matrices of all entries straight into the bone matrix ring and defers the uploads as one call
+void hwContext::updateSkinningBatch(int num_entries, const hwSkinningBatchEntry *entries, const hwMatrix *world, bool vrMode)
+{
+	hwTraceScoped("hwContext::updateSkinningBatch");
+	if (entries == nullptr || world == nullptr) { return; }
+
+	struct Upload { hwHInstance hi; int start; int num; bool dq; };
+	std::vector<Upload> uploads;
+	uploads.reserve(num_entries);
+
+	for (int ei = 0; ei < num_entries; ++ei) {
+		const auto &e = entries[ei];
+		if (e.instance >= m_instances.size() || !m_instances[e.instance]) { continue; }
+		if (e.num_bones <= 0) { continue; }
+
+		// a mirrored palette has a reflection, which a dual quaternion can't hold: those instances stay on matrices
+		bool mirror_x = (e.flags & hwSkinningFlag_MirrorX) != 0;
+		bool dq = (e.flags & hwSkinningFlag_DualQuaternion) != 0 && !mirror_x;
+		if ((e.flags & hwSkinningFlag_DualQuaternion) && mirror_x && !m_dqMirrorWarned.exchange(true))
+		{
+			hwLogWarning("hwContext::updateSkinningBatch(): dual quaternion skinning can't mirror x. instances with both flags upload matrices.\n");
+		}
+
+		// the palette is a function of the bone world matrices and the flags, so those are hashed before building it
+		size_t upload_size = dq ? sizeof(hwDQuaternion) * e.num_bones : sizeof(hwMatrix) * e.num_bones;
+		if (skipUnchangedPalette(m_instances[e.instance], world + e.first_bone, sizeof(hwMatrix) * e.num_bones, e.flags, upload_size)) { continue; }
+
+		const hwMatrix *inv_bindpose = nullptr;
+		if (e.flags & hwSkinningFlag_InvBindPose) {
+			auto ha = m_instances[e.instance].hasset;
+			if (ha < m_assets.size() && (int)m_assets[ha].inv_bindpose.size() == e.num_bones) {
+				inv_bindpose = m_assets[ha].inv_bindpose.data();
+			}
+		}
+
+		int start = 0;
+		if (dq) {
+			hwDQuaternion *dst = reserveBoneDQs(e.num_bones, start);
+			if (dst == nullptr) { m_instances[e.instance].palette_valid = false; continue; }
+			// palette before conversion. per thread, batches are built on recording threads too
+			thread_local std::vector<hwMatrix> scratch;
+			if ((int)scratch.size() < e.num_bones) { scratch.resize(e.num_bones); }
+			hwBuildSkinningMatrices(scratch.data(), world + e.first_bone, inv_bindpose, e.num_bones, mirror_x);
+			hwConvertMatricesToDQs(dst, scratch.data(), e.num_bones);
+		}
+		else {
+			hwMatrix *dst = reserveBoneMatrices(e.num_bones, start);
+			if (dst == nullptr) { m_instances[e.instance].palette_valid = false; continue; }
+			hwBuildSkinningMatrices(dst, world + e.first_bone, inv_bindpose, e.num_bones, mirror_x);
+		}
+		uploads.push_back({ e.instance, start, e.num_bones, dq });
+	}
+	if (uploads.empty()) { return; }
+
+	auto c = [this, uploads]() {
+		for (auto &u : uploads) {
+			if (u.dq)
+				instanceUpdateSkinningDQsAsyncImpl(u.hi, u.start, u.num);
+			else
+				instanceUpdateSkinningMatricesAsyncImpl(u.hi, u.start, u.num);
+		}
+	};
+	// merged by the first instance of the batch when recorded on a worker thread
+	hwHInstance key = uploads.front().hi;
+	if (vrMode)
+		pushDeferredCall(c, true, key);
+	else
+		pushFrameCall(c, key);
+}
+
 void hwContext::instanceUpdateSkinningDQs(hwHInstance hi, int num_bones, hwDQuaternion *dqs)
 {
+    hwTraceScoped("hwContext::instanceUpdateSkinningDQs");
     if (dqs == nullptr) { return; }
     if (hi >= m_instances.size()) { return; }
     auto &v = m_instances[hi];
 
+    v.palette_valid = false;
+    std::unique_lock<std::mutex> lock(m_mutexDesc);
     if (g_hw_sdk->UpdateSkinningDQs(v.iid, num_bones, dqs) != GFSDK_HAIR_RETURN_OK)
     {
-        hwLog("GFSDK_HairSDK::UpdateSkinningDQs(%d) failed.\n", hi);
+        hwLogError("GFSDK_HairSDK::UpdateSkinningDQs(%d) failed.\n", hi);
     }
 }
 
+//
+void hwContext::instanceUpdateSkinningDQsAsync(hwHInstance hi, int num_bones, hwDQuaternion *dqs, bool vrMode)
+{
+	if (dqs == nullptr) { return; }
+	if (hi >= m_instances.size()) { return; }
+	auto &v = m_instances[hi];
+	if (skipUnchangedPalette(v, dqs, sizeof(hwDQuaternion) * num_bones, hwSkinningFlag_DualQuaternion, sizeof(hwDQuaternion) * num_bones)) { return; }
+
+	int startIndex = 0;
+	hwDQuaternion *dst = reserveBoneDQs(num_bones, startIndex);
+	if (dst == nullptr)
+	{
+		v.palette_valid = false;
+		return;
+	}
+	memcpy(dst, dqs, sizeof(hwDQuaternion) * num_bones);
+
+	auto c = [=]() {
+		instanceUpdateSkinningDQsAsyncImpl(hi, startIndex, num_bones);
+	};
+	if (vrMode)
+		pushDeferredCall(c, true, hi);
+	else
+		pushFrameCall(c, hi);
+}
+
+//
+void hwContext::instanceUpdateSkinningDQsAsyncImpl(hwHInstance hi, int dqIndex, int numDQ)
+{
+	hwTraceScoped("hwContext::instanceUpdateSkinningDQsAsyncImpl");
+	if (hi >= m_instances.size() || !m_instances[hi]) { return; }
+	auto &v = m_instances[hi];
+
+	auto teleport = v.teleport_pending ? GFSDK_HAIR_TELEPORT_MODE_TELEPORT_WITH_SKINNED_POSITION : GFSDK_HAIR_TELEPORT_MODE_NONE;
+	v.teleport_pending = false;
+
+	if (g_hw_sdk->UpdateSkinningDQs(v.iid, numDQ, m_bonesDQBuffer + dqIndex, teleport) != GFSDK_HAIR_RETURN_OK)
+	{
+		hwLogError("GFSDK_HairSDK::UpdateSkinningDQs(%d) failed.\n", hi);
+	}
+}
+
 void hwContext::beginScene(bool vrMode)
 {
+	// releases made while the render thread was flushing
+	collectRetired();
+	updateRingConsumed();
+	syncDescriptorBlocks();
+
 	if (vrMode == true)
 	{
 		m_mutexVR.lock();
@@ -702,32 +1628,271 @@ void hwContext::beginScene(bool vrMode)
 	{
 		m_mutex.lock();
 	}
+	m_inScene[vrMode ? 1 : 0] = true;
+}
+
+// one beginScene() .. endScene() bracket from a hwFramePacket.h packet
+bool hwContext::submitFrame(const void *packet, size_t size)
+{
+	hwTraceScoped("hwContext::submitFrame");
+	std::string error;
+	if (!hwFramePacketValidate(packet, size, &error))
+	{
+		++m_stats.num_frame_packets_rejected;
+		hwLogError("hwContext::submitFrame(): packet rejected, %s.\n", error.c_str());
+		return false;
+	}
+
+	hwFramePacketReader reader(packet);
+	bool vr = (reader.header().flags & hwFramePacketFlag_VR) != 0;
+	bool single_pass = (reader.header().flags & hwFramePacketFlag_SinglePassVR) != 0;
+
+	beginScene(vr);
+	uint32_t type, n;
+	const char *p;
+	while (reader.next(type, p, n))
+	{
+		// fixed parts are copied out, the packet has no alignment beyond 4 bytes. arrays are used in place
+		switch (type)
+		{
+		case hwFPRecord_ViewProjection: {
+			hwFPViewProjection r;
+			memcpy(&r, p, sizeof(r));
+			setViewProjection(r.slot, r.view, r.proj, r.fov);
+			break;
+		}
+		case hwFPRecord_ViewProjectionStereo: {
+			hwFPViewProjectionStereo r;
+			memcpy(&r, p, sizeof(r));
+			setViewProjectionStereo(r.view, r.proj, r.view2, r.proj2, r.fov, r.single_pass != 0);
+			break;
+		}
+		case hwFPRecord_Lights: {
+			hwFPLights r;
+			memcpy(&r, p, sizeof(r));
+			setLights(r.num_lights, (const hwLightData*)(p + sizeof(r)), vr);
+			break;
+		}
+		case hwFPRecord_Shader: {
+			hwFPShader r;
+			memcpy(&r, p, sizeof(r));
+			setShader(r.shader, vr);
+			break;
+		}
+		case hwFPRecord_Skinning: {
+			hwFPSkinning r;
+			memcpy(&r, p, sizeof(r));
+			auto *entries = (const hwSkinningBatchEntry*)(p + sizeof(r));
+			updateSkinningBatch(r.num_entries, entries, (const hwMatrix*)(entries + r.num_entries), vr);
+			break;
+		}
+		case hwFPRecord_DescriptorField: {
+			hwFPDescriptorField r;
+			memcpy(&r, p, sizeof(r));
+			if (r.instance < m_instances.size() && m_instances[r.instance])
+			{
+				instanceSetDescriptorField(r.instance, r.offset, r.size, p + sizeof(r));
+			}
+			break;
+		}
+		case hwFPRecord_Step: {
+			hwFPStep r;
+			memcpy(&r, p, sizeof(r));
+			stepSimulation(r.dt, vr, single_pass);
+			break;
+		}
+		case hwFPRecord_Draws: {
+			hwFPDraws r;
+			memcpy(&r, p, sizeof(r));
+			auto *instances = (const hwHInstance*)(p + sizeof(r));
+			for (int i = 0; i < r.num_instances; ++i)
+			{
+				if (r.shadow) { renderShadow(instances[i], vr); }
+				else { render(instances[i], vr); }
+			}
+			break;
+		}
+		}
+	}
+	endScene(vr);
+	++m_stats.num_frame_packets;
+	return true;
 }
 
 void hwContext::endScene(bool vrMode)
 {
+	mergeThreadRecordings(vrMode);
+	if (int open = m_numOpenRecordings[vrMode ? 1 : 0].load(std::memory_order_relaxed))
+	{
+		hwLogWarning("hwContext::endScene(): %d thread recordings still open. they go to the next scene.\n", open);
+	}
+	++m_recordedFrames[vrMode ? 1 : 0];
+	m_inScene[vrMode ? 1 : 0] = false;
+
+	// the bones reserved so far are read by the frames recorded up to here, of either kind. while nothing is flushed the
+	// last mark moves on instead of piling up, which frees its bones later, never earlier
+	RingMark mark = { { m_recordedFrames[0] + (m_inScene[0] ? 1 : 0), m_recordedFrames[1] + (m_inScene[1] ? 1 : 0) },
+		boneMatrixHead.load(std::memory_order_relaxed), boneDQHead.load(std::memory_order_relaxed) };
+	if (m_ringMarks.size() < 64) { m_ringMarks.push_back(mark); }
+	else { m_ringMarks.back() = mark; }
+
+	// every view scene adds its draws, each instance once
+	if (m_frameDrawsChanged)
+	{
+		std::sort(m_frameDraws.begin(), m_frameDraws.end());
+		m_frameDraws.erase(std::unique(m_frameDraws.begin(), m_frameDraws.end()), m_frameDraws.end());
+		std::unique_lock<std::mutex> lock(m_mutexShadow);
+		m_shadowCasters = m_frameDraws;
+		m_frameDrawsChanged = false;
+	}
+
 	if (vrMode == true)
 	{
 		m_mutexVR.unlock();
 	}
 	else
 	{
+		m_recordingView = -1;
 		m_mutex.unlock();
 	}
 }
 
-void hwContext::pushDeferredCall(const DeferredCall &c, bool useVRQueue)
+bool hwContext::beginThreadRecording(bool vrMode)
+{
+	if (g_thread_recording)
+	{
+		hwLogWarning("hwContext::beginThreadRecording(): the thread is recording already.\n");
+		return false;
+	}
+	for (auto &r : m_threadRecordings)
+	{
+		int expected = hwThreadRecording_Free;
+		if (r.state.compare_exchange_strong(expected, hwThreadRecording_Recording, std::memory_order_acquire))
+		{
+			// m_recordingView was set by the thread that began the scene before it started this one
+			r.vr = vrMode;
+			r.view = vrMode ? -1 : m_recordingView;
+			if (g_thread_recording_index == 0) { g_thread_recording_index = ++g_num_recording_threads; }
+			r.thread_index = g_thread_recording_index;
+			r.sequence = m_recordingSequence.fetch_add(1, std::memory_order_relaxed);
+			m_numOpenRecordings[vrMode ? 1 : 0].fetch_add(1, std::memory_order_relaxed);
+			g_thread_recording = &r;
+			return true;
+		}
+	}
+	hwLogWarning("hwContext::beginThreadRecording(): all %d command buffers are in use.\n", hwMaxRecordingThreads);
+	return false;
+}
+
+bool hwContext::endThreadRecording()
+{
+	auto *r = g_thread_recording;
+	if (!r) { return false; }
+	g_thread_recording = nullptr;
+
+	int kind = r->vr ? 1 : 0;
+	r->state.store(hwThreadRecording_Ended, std::memory_order_release);
+	m_numOpenRecordings[kind].fetch_sub(1, std::memory_order_relaxed);
+	m_numEndedRecordings[kind].fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+// appends the ended recordings of the kind to their segments, ordered by key. the scene mutex of the kind must be held
+void hwContext::mergeThreadRecordings(bool vrMode)
 {
+	auto &num_ended = m_numEndedRecordings[vrMode ? 1 : 0];
+	if (num_ended.load(std::memory_order_acquire) == 0) { return; }
+	hwTraceScoped("hwContext::mergeThreadRecordings");
+
+	// the ones ending meanwhile wait for the next merge
+	hwThreadRecording *merged[hwMaxRecordingThreads];
+	int num_merged = 0;
+	m_mergeScratch.clear();
+	for (auto &r : m_threadRecordings)
+	{
+		if (r.state.load(std::memory_order_acquire) != hwThreadRecording_Ended || r.vr != vrMode) { continue; }
+		merged[num_merged++] = &r;
+	}
+	// a thread that recorded twice may have got a lower slot the second time
+	std::sort(merged, merged + num_merged, [](const hwThreadRecording *a, const hwThreadRecording *b) { return a->sequence < b->sequence; });
+	for (int i = 0; i < num_merged; ++i)
+	{
+		for (auto &c : merged[i]->commands) { m_mergeScratch.push_back(&c); }
+	}
+
+	// ties are the same instance recorded on several threads, they go by the threads' registration. stable: the commands
+	// of one thread keep their order
+	std::stable_sort(m_mergeScratch.begin(), m_mergeScratch.end(),
+		[](const hwThreadCommand *a, const hwThreadCommand *b) { return a->key < b->key; });
+	for (auto *c : m_mergeScratch) { c->queue->push_back(std::move(c->call)); }
+	m_stats.num_thread_commands += (int)m_mergeScratch.size();
+	m_stats.num_thread_recordings += num_merged;
+
+	for (int i = 0; i < num_merged; ++i)
+	{
+		auto &r = *merged[i];
+		m_stats.num_skinning_uploads_skipped += r.num_skinning_uploads_skipped;
+		m_stats.num_skinning_bytes_saved += r.num_skinning_bytes_saved;
+		r.num_skinning_uploads_skipped = 0;
+		r.num_skinning_bytes_saved = 0;
+		r.commands.clear();
+		if (!r.draws.empty())
+		{
+			m_frameDraws.insert(m_frameDraws.end(), r.draws.begin(), r.draws.end());
+			m_frameDrawsChanged = true;
+			r.draws.clear();
+		}
+		r.state.store(hwThreadRecording_Free, std::memory_order_release);
+	}
+	num_ended.fetch_sub(num_merged, std::memory_order_relaxed);
+}
+
+void hwContext::pushThreadCall(hwThreadRecording &r, DeferredCalls &queue, const DeferredCall &c, hwHInstance key)
+{
+	if (key == hwNullHandle)
+	{
+		hwLogWarning("hwContext::pushThreadCall(): only draws and skinning can be recorded on worker threads.\n");
+		return;
+	}
+	r.commands.push_back({ (uint64_t)key << 32 | r.thread_index, &queue, c });
+}
+
+void hwContext::pushDeferredCall(const DeferredCall &c, bool useVRQueue, hwHInstance key)
+{
+	if (auto *r = g_thread_recording)
+	{
+		pushThreadCall(*r, r->vr ? m_commandsVR : r->view >= 0 ? m_viewCommands[r->view] : m_commands, c, key);
+		return;
+	}
+	// what recording threads ended goes before this call
+	mergeThreadRecordings(useVRQueue);
+
 	if (useVRQueue == true)
 	{
 		m_commandsVR.push_back(c);
 	}
+	else if (m_recordingView >= 0)
+	{
+		m_viewCommands[m_recordingView].push_back(c);
+	}
 	else
 	{
 		m_commands.push_back(c);
 	}
 }
 
+// skinning and simulation must run once per frame no matter how many views replay it
+void hwContext::pushFrameCall(const DeferredCall &c, hwHInstance key)
+{
+	if (auto *r = g_thread_recording)
+	{
+		pushThreadCall(*r, r->vr ? m_commandsVR : m_commands, c, key);
+		return;
+	}
+	mergeThreadRecordings(false);
+	m_commands.push_back(c);
+}
+
 void hwContext::setRenderTarget(hwTexture *framebuffer, hwTexture *depthbuffer, bool vrMode)
 {
     pushDeferredCall([=]() {
@@ -752,25 +1917,106 @@ void hwContext::setLights(int num_lights, const hwLightData *lights_, bool vrMod
     }, vrMode);
 }
 
+hwHLight hwContext::lightCreate(const hwLightData &light)
+{
+    std::unique_lock<std::mutex> lock(m_mutexLights);
+    auto i = std::find_if(m_lights.begin(), m_lights.end(), [](const hwLightEntry &v) { return !v; });
+    if (i == m_lights.end()) {
+        hwLightEntry tmp;
+        tmp.handle = (hwHLight)m_lights.size();
+        m_lights.push_back(tmp);
+        i = m_lights.end() - 1;
+    }
+    i->alive = true;
+    i->data = light;
+    m_lightsDirty = true;
+    return i->handle;
+}
+
+void hwContext::lightUpdate(hwHLight hl, const hwLightData &light)
+{
+    std::unique_lock<std::mutex> lock(m_mutexLights);
+    if (hl >= m_lights.size() || !m_lights[hl]) { return; }
+    auto &v = m_lights[hl];
+    if (memcmp(&v.data, &light, sizeof(light)) != 0) {
+        v.data = light;
+        m_lightsDirty = true;
+    }
+}
+
+void hwContext::lightRelease(hwHLight hl)
+{
+    std::unique_lock<std::mutex> lock(m_mutexLights);
+    if (hl >= m_lights.size() || !m_lights[hl]) { return; }
+    m_lights[hl].invalidate();
+    m_lightsDirty = true;
+}
+
+// draws of the frame so far, for the shadow casters (see endScene())
+void hwContext::noteDraw(hwHInstance hi)
+{
+    if (auto *r = g_thread_recording) { r->draws.push_back(hi); }
+    else { m_frameDraws.push_back(hi); m_frameDrawsChanged = true; }
+}
+
 void hwContext::render(hwHInstance hi, bool vrMode)
 {
+    noteDraw(hi);
     pushDeferredCall([=]() {
         renderImpl(hi);
-    }, vrMode);
+    }, vrMode, hi);
 }
 
 void hwContext::renderShadow(hwHInstance hi, bool vrMode)
 {
+    noteDraw(hi);
     pushDeferredCall([=]() {
         renderShadowImpl(hi);
-    }, vrMode);
+    }, vrMode, hi);
 }
 
 void hwContext::stepSimulation(float dt, bool vrMode, bool singlePassVR)
 {
-    pushDeferredCall([=]() {
+    // a new frame. the casters published so far stay until one of its scenes draws
+    m_frameDraws.clear();
+    auto c = [=]() {
         stepSimulationImpl(dt, vrMode, singlePassVR);
-    }, vrMode);
+    };
+    if (vrMode)
+        pushDeferredCall(c, true);
+    else
+        pushFrameCall(c);
+}
+
+// fixed_dt <= 0 disables the fixed timestep (one step of the frame's dt per frame)
+void hwContext::setSimulationTimestep(float fixed_dt, int max_substeps)
+{
+    m_simTimestep.store(fixed_dt, std::memory_order_relaxed);
+    m_simMaxSubsteps.store(std::max<int>(max_substeps, 1), std::memory_order_relaxed);
+}
+
+void hwContext::setSimulationSleep(const hwSleepSettings &settings)
+{
+    std::unique_lock<std::mutex> lock(m_mutexSettings);
+    m_sleepSettings = settings;
+}
+
+void hwContext::setSimulationBudget(const hwBudgetSettings &settings)
+{
+    std::unique_lock<std::mutex> lock(m_mutexSettings);
+    m_budgetSettings = settings;
+}
+
+void hwContext::setShadowViewProjection(int light, const hwMatrix &view, const hwMatrix &proj, float fov)
+{
+    if (light < 0 || light >= hwMaxShadowLights) { return; }
+
+    std::unique_lock<std::mutex> lock(m_mutexShadow);
+    auto &sl = m_shadowLights[light];
+    sl.view = view;
+    sl.proj = proj;
+    sl.fov = fov;
+    sl.valid = true;
 }
 
 hwSRV* hwContext::getSRV(hwTexture *tex)
@@ -783,8 +2029,8 @@ hwSRV* hwContext::getSRV(hwTexture *tex)
         }
     }
 
-    hwSRV *ret = nullptr;
-    if (SUCCEEDED(m_d3ddev->CreateShaderResourceView(tex, nullptr, &ret))) 
+    hwSRV *ret = m_device->createSRV(tex);
+    if (ret) 
 	{
         m_srvtable[tex] = ret;
     }
@@ -801,8 +2047,8 @@ hwRTV* hwContext::getRTV(hwTexture *tex)
         }
     }
 
-    hwRTV *ret = nullptr;
-    if (SUCCEEDED(m_d3ddev->CreateRenderTargetView(tex, nullptr, &ret))) 
+    hwRTV *ret = m_device->createRTV(tex);
+    if (ret) 
 	{
         m_rtvtable[tex] = ret;
     }
@@ -823,21 +2069,18 @@ void hwContext::setViewProjectionStereo(const hwMatrix &view, const hwMatrix &pr
 
 void hwContext::setViewProjectionStereoImpl(const hwMatrix &view, const hwMatrix &proj, const hwMatrix &view2, const hwMatrix &proj2, float fov, bool singlePassStereo)
 {
+	bool right = singlePassStereo ? singlePassStereoRenderPass != 0 : m_currentVRPass != 0;
+	setCullingView(right ? view2 : view, right ? proj2 : proj);
+
 	if (singlePassStereo == true)
 	{
 		if (singlePassStereoRenderPass == 0)
 		{
-			if (g_hw_sdk->SetViewProjection((const gfsdk_float4x4*)&view, (const gfsdk_float4x4*)&proj, GFSDK_HAIR_LEFT_HANDED, fov) != GFSDK_HAIR_RETURN_OK)
-			{
-				hwLog("GFSDK_HairSDK::SetViewProjection() failed.\n");
-			}
+			setSDKViewProjection(view, proj, fov);
 		}
 		else
 		{
-			if (g_hw_sdk->SetViewProjection((const gfsdk_float4x4*)&view2, (const gfsdk_float4x4*)&proj2, GFSDK_HAIR_LEFT_HANDED, fov) != GFSDK_HAIR_RETURN_OK)
-			{
-				hwLog("GFSDK_HairSDK::SetViewProjection() failed.\n");
-			}
+			setSDKViewProjection(view2, proj2, fov);
 		}
 	}
 	else
@@ -845,37 +2088,56 @@ void hwContext::setViewProjectionStereoImpl(const hwMatrix &view, const hwMatrix
 		// prepare view and projection matrices based on render pass
 		if (m_currentVRPass == 0)
 		{
-			if (g_hw_sdk->SetViewProjection((const gfsdk_float4x4*)&view, (const gfsdk_float4x4*)&proj, GFSDK_HAIR_LEFT_HANDED, fov) != GFSDK_HAIR_RETURN_OK)
-			{
-				hwLog("GFSDK_HairSDK::SetViewProjection() failed.\n");
-			}
+			setSDKViewProjection(view, proj, fov);
 		}
 		else
 		{
-			if (g_hw_sdk->SetViewProjection((const gfsdk_float4x4*)&view2, (const gfsdk_float4x4*)&proj2, GFSDK_HAIR_LEFT_HANDED, fov) != GFSDK_HAIR_RETURN_OK)
-			{
-				hwLog("GFSDK_HairSDK::SetViewProjection() failed.\n");
-			}
+			setSDKViewProjection(view2, proj2, fov);
 		}
 	}
 }
 
-//
-void hwContext::setViewProjection(const hwMatrix &view, const hwMatrix &proj, float fov)
+// starts (re)recording the render segment of view slot. calls up to endScene() go to that slot.
+void hwContext::setViewProjection(int slot, const hwMatrix &view, const hwMatrix &proj, float fov)
 {
-	// store the matrix locally
+	if (slot < 0 || slot >= hwMaxViews) { return; }
+
+	m_recordingView = slot;
+	m_viewCommands[slot].clear();
 	pushDeferredCall([=]() {
 		setViewProjectionImpl(view, proj, fov);
 	}, false);
 }
 
+void hwContext::setCullingView(const hwMatrix &view, const hwMatrix &proj)
+{
+	hwFrustumFromViewProj(m_viewFrustum, view, proj);
+	m_viewPosition = hwViewPosition(view);
+	m_viewValid = true;
+	m_viewSeen = true;
+}
+
 void hwContext::setViewProjectionImpl(const hwMatrix &view, const hwMatrix &proj, float fov)
 {
+	setCullingView(view, proj);
+
 	// set the view/projection matrix 
+	setSDKViewProjection(view, proj, fov);
+}
+
+// remembered for flushShadow(), which sets the light's in between
+bool hwContext::setSDKViewProjection(const hwMatrix &view, const hwMatrix &proj, float fov)
+{
+	m_sdkView = view;
+	m_sdkProj = proj;
+	m_sdkFov = fov;
+	m_sdkViewValid = true;
 	if (g_hw_sdk->SetViewProjection((const gfsdk_float4x4*)&view, (const gfsdk_float4x4*)&proj, GFSDK_HAIR_LEFT_HANDED, fov) != GFSDK_HAIR_RETURN_OK)
 	{
-		hwLog("GFSDK_HairSDK::SetViewProjection() failed.\n");
+		hwLogError("GFSDK_HairSDK::SetViewProjection() failed.\n");
+		return false;
 	}
+	return true;
 }
 
 void hwContext::setShaderImpl(hwHShader hs)
@@ -883,8 +2145,8 @@ void hwContext::setShaderImpl(hwHShader hs)
 	if (hs >= m_shaders.size()) { return; }
 
 	auto &v = m_shaders[hs];
-	if (v.shader) 
-		m_d3dctx->PSSetShader(v.shader, nullptr, 0);
+	if (v) 
+		m_device->setPixelShader(v.shader);
 }
 
 void hwContext::setLightsImpl(int num_lights, const hwLightData *lights)
@@ -893,31 +2155,117 @@ void hwContext::setLightsImpl(int num_lights, const hwLightData *lights)
     std::copy(lights, lights + num_lights, m_cb.lights);
 }
 
+// called on the render thread at the beginning of each flush
+void hwContext::syncLights()
+{
+    std::unique_lock<std::mutex> lock(m_mutexLights);
+    if (!m_lightsDirty) { return; }
+
+    m_lightsRender.clear();
+    for (auto &l : m_lights) {
+        if (l) { m_lightsRender.push_back(l.data); }
+    }
+    m_lightsDirty = false;
+}
+
+// how much a light contributes to a box. same attenuation as the hair shader. 0 means no contribution
+static float hwLightInfluence(const hwLightData &l, const hwFloat3 &bmin, const hwFloat3 &bmax)
+{
+    float lum = l.color.x * 0.2126f + l.color.y * 0.7152f + l.color.z * 0.0722f;
+    if (l.type == hwELightType_Directional) { return lum; }
+
+    // squared distance from the light to the closest point of the box
+    float range = l.position.w;
+    hwFloat3 pos;
+    pos.x = l.position.x; pos.y = l.position.y; pos.z = l.position.z;
+    float d2 = hwDistanceSqToAABB(pos, bmin, bmax);
+    if (range <= 0.0f || d2 >= range * range) { return 0.0f; }
+    return lum * (1.0f - d2 / (range * range));
+}
+
+// picks up to hwMaxLights registered lights that contribute most to the given bounds. returns the number of lights written to dst
+int hwContext::selectLights(const hwFloat3 *pbmin, const hwFloat3 *pbmax, hwLightData *dst)
+{
+    if (!pbmin || !pbmax) {
+        // no bounds to rank against. just take the first ones
+        int n = std::min<int>((int)m_lightsRender.size(), hwMaxLights);
+        std::copy(m_lightsRender.begin(), m_lightsRender.begin() + n, dst);
+        return n;
+    }
+
+    // keep the best hwMaxLights sorted by descending influence
+    const hwFloat3 &bmin = *pbmin, &bmax = *pbmax;
+    float scores[hwMaxLights];
+    int indices[hwMaxLights];
+    int n = 0;
+    for (int li = 0; li < (int)m_lightsRender.size(); ++li) {
+        float s = hwLightInfluence(m_lightsRender[li], bmin, bmax);
+        if (s <= 0.0f) { continue; }
+        if (n == hwMaxLights && s <= scores[n - 1]) { continue; }
+
+        int i = n < hwMaxLights ? n++ : n - 1;
+        for (; i > 0 && scores[i - 1] < s; --i) {
+            scores[i] = scores[i - 1];
+            indices[i] = indices[i - 1];
+        }
+        scores[i] = s;
+        indices[i] = li;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        dst[i] = m_lightsRender[indices[i]];
+    }
+    return n;
+}
+
 // main rendering function
 void hwContext::renderImpl(hwHInstance hi)
 {
-	if (hi >= m_instances.size()) { return; }
+	hwTraceScoped("hwContext::renderImpl");
+	if (hi >= m_instances.size() || !m_instances[hi]) { return; }
 	auto &v = m_instances[hi];
 
-	// not needed for now PrepareHairWorksRenderTarget(m_d3dctx, m_d3ddev);
+	hwFloat3 bmin, bmax;
+	bool has_bounds = g_hw_sdk->GetBounds(v.iid, &bmin, &bmax) == GFSDK_HAIR_RETURN_OK;
+	if (has_bounds && m_viewValid)
+	{
+		if (!hwFrustumIntersectAABB(m_viewFrustum, bmin, bmax))
+		{
+			++m_stats.num_draws_culled;
+			return;
+		}
+
+		// visibility and distance for simulation sleep
+		float distance = std::sqrt(hwDistanceSqToAABB(m_viewPosition, bmin, bmax));
+		if (v.visible_frame != m_simFrame || distance < v.view_distance)
+		{
+			v.view_distance = distance;
+		}
+		v.visible_frame = m_simFrame;
+	}
 
 	// update constant buffer
 	{
 		g_hw_sdk->PrepareShaderConstantBuffer(v.iid, &m_cb.hw);
 
-		D3D11_MAPPED_SUBRESOURCE MappedResource;
-		m_d3dctx->Map(m_rs_constant_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource);
-		*((hwConstantBuffer*)MappedResource.pData) = m_cb;
-		m_d3dctx->Unmap(m_rs_constant_buffer, 0);
-
-		m_d3dctx->PSSetConstantBuffers(0, 1, &m_rs_constant_buffer);
+		auto *cb = (hwConstantBuffer*)m_device->mapConstantBuffer(sizeof(hwConstantBuffer));
+		if (cb)
+		{
+			*cb = m_cb;
+			// lights from the registry override the ones given by setLights()
+			if (!m_lightsRender.empty())
+			{
+				cb->num_lights = has_bounds ? selectLights(&bmin, &bmax, cb->lights) : selectLights(nullptr, nullptr, cb->lights);
+			}
+			m_device->unmapConstantBuffer(0);
+		}
 	}
 
 	// set shader resource views
 	{
-		ID3D11ShaderResourceView* SRVs[GFSDK_HAIR_NUM_SHADER_RESOUCES];
+		hwSRV* SRVs[GFSDK_HAIR_NUM_SHADER_RESOUCES];
 		g_hw_sdk->GetShaderResources(v.iid, SRVs);
-		m_d3dctx->PSSetShaderResources(0, GFSDK_HAIR_NUM_SHADER_RESOUCES, SRVs);
+		m_device->setShaderResources(0, GFSDK_HAIR_NUM_SHADER_RESOUCES, SRVs);
 	}
 
 	// set texture 
@@ -927,7 +2275,7 @@ void hwContext::renderImpl(hwHInstance hi)
 	auto settings = GFSDK_HairShaderSettings(true, false);
 	if (g_hw_sdk->RenderHairs(v.iid, &settings) != GFSDK_HAIR_RETURN_OK)
 	{
-		hwLog("GFSDK_HairSDK::RenderHairs(%d) failed.\n", hi);
+		hwLogError("GFSDK_HairSDK::RenderHairs(%d) failed.\n", hi);
 	}
 
 	// render indicators
@@ -936,54 +2284,343 @@ void hwContext::renderImpl(hwHInstance hi)
 
 void hwContext::renderShadowImpl(hwHInstance hi)
 {
-	if (hi >= m_instances.size()) { return; }
+	hwTraceScoped("hwContext::renderShadowImpl");
+	if (hi >= m_instances.size() || !m_instances[hi]) { return; }
 	auto &v = m_instances[hi];
 
 	// set shader resource views
 	{
-		ID3D11ShaderResourceView* SRVs[GFSDK_HAIR_NUM_SHADER_RESOUCES];
+		hwSRV* SRVs[GFSDK_HAIR_NUM_SHADER_RESOUCES];
 		g_hw_sdk->GetShaderResources(v.iid, SRVs);
-		m_d3dctx->PSSetShaderResources(0, GFSDK_HAIR_NUM_SHADER_RESOUCES, SRVs);
+		m_device->setShaderResources(0, GFSDK_HAIR_NUM_SHADER_RESOUCES, SRVs);
 	}
 
 	auto settings = GFSDK_HairShaderSettings(false, true);
 	if (g_hw_sdk->RenderHairs(v.iid, &settings) != GFSDK_HAIR_RETURN_OK)
 	{
-		hwLog("GFSDK_HairSDK::RenderHairs(%d) failed.\n", hi);
+		hwLogError("GFSDK_HairSDK::RenderHairs(%d) failed.\n", hi);
 	}	
 }
 
+// adds the time of a flush or step to the telemetry frame. one relaxed load while telemetry is off
+class hwTelemetryTimer
+{
+public:
+    hwTelemetryTimer(const std::atomic<bool> &enabled, float &dst)
+        : m_dst(enabled.load(std::memory_order_relaxed) ? &dst : nullptr), m_begin(m_dst ? hwTraceNow() : 0) {}
+    ~hwTelemetryTimer() { if (m_dst) { *m_dst += (float)((hwTraceNow() - m_begin) / 1000000.0); } }
+
+private:
+    float *m_dst;
+    uint64_t m_begin;
+};
+
 void hwContext::stepSimulationImpl(float dt, bool vrMode, bool singlePassVR)
 {
+	hwTraceScoped("hwContext::stepSimulationImpl");
+
 	// step the simulation only once in VR
 	if (vrMode)
 	{
-		if (singlePassVR)
+		if (singlePassVR ? singlePassStereoRenderPass != 0 : m_currentVRPass != 0)
+			return;
+	}
+
+	float fixed_dt = m_simTimestep.load(std::memory_order_relaxed);
+	int max_substeps = m_simMaxSubsteps.load(std::memory_order_relaxed);
+	if (fixed_dt != m_simClock.fixed_dt || max_substeps != m_simClock.max_substeps)
+	{
+		m_simClock.setTimestep(fixed_dt, max_substeps);
+	}
+
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.simulation_time);
+	float step_dt, dropped;
+	int num_steps = m_simClock.advance(dt, step_dt, dropped);
+	m_telemetryFrame.num_substeps += num_steps;
+	m_telemetryFrame.simulation_time_dropped += dropped * 1000.0f;
+	updateSimulationSleep(step_dt > 0.0f ? step_dt : m_simClock.fixed_dt);
+	updateSimulationBudget();
+	++m_simFrame;
+
+	++m_stats.num_simulation_frames;
+	if (dropped > 0.0f)
+	{
+		++m_stats.num_simulation_frames_dropped;
+		m_stats.simulation_time_dropped += dropped;
+	}
+
+	int num_sleeping = 0;
+	int64_t sleeping_vertices = 0;
+	for (auto &v : m_instances)
+	{
+		if (v && v.sleep_state != hwSleepState_Awake)
+		{
+			++num_sleeping;
+			sleeping_vertices += v.num_vertices;
+		}
+	}
+	m_stats.num_sleeping_instances = num_sleeping;
+	m_stats.num_instance_steps_saved += num_sleeping * num_steps;
+	m_stats.num_vertex_steps_saved += sleeping_vertices * num_steps;
+
+	// throttling is decided once per frame. the instances due are grouped by the frames they sat out and each group gets
+	// the frame's substeps with the time it missed, while the others have m_simulate off. one more such frame after
+	// leaving budgeted mode gives back what is still pending
+	uint32_t groups = 0;
+	if ((m_budgetActive || m_simPending) && num_steps > 0)
+	{
+		groups = updateSimulationThrottle(num_steps * step_dt);
+	}
+	m_stats.num_simulation_steps += num_steps;
+	if (groups == 0)
+	{
+		for (int i = 0; i < num_steps; ++i)
+		{
+			if (g_hw_sdk->StepSimulation(step_dt) != GFSDK_HAIR_RETURN_OK)
+			{
+				hwLogError("GFSDK_HairSDK::StepSimulation(%f) failed.\n", step_dt);
+			}
+		}
+		return;
+	}
+
+	// longest sat out first: the every frame group, usually the largest, ends with m_simulate on already
+	for (int g = SIM_TICK_HISTORY - 1; g >= 0; --g)
+	{
+		if ((groups & (1u << g)) == 0) { continue; }
+
+		float group_dt = 0.0f;
+		for (int i = 0; i <= g; ++i)
+		{
+			group_dt += m_simTickTimes[(m_simTick - i) % SIM_TICK_HISTORY];
+		}
+		for (auto &v : m_instances)
+		{
+			if (!v || v.sim_group == hwSimGroup_None) { continue; }
+			bool out = v.sim_group != g;
+			if (out != v.throttled)
+			{
+				v.throttled = out;
+				applySimulate(v);
+			}
+		}
+		for (int i = 0; i < num_steps; ++i)
 		{
-			if (singlePassStereoRenderPass == 0)
+			++m_stats.num_budget_group_steps;
+			if (g_hw_sdk->StepSimulation(group_dt / num_steps) != GFSDK_HAIR_RETURN_OK)
 			{
-				if (g_hw_sdk->StepSimulation(dt) != GFSDK_HAIR_RETURN_OK)
-				{
-					hwLog("GFSDK_HairSDK::StepSimulation(%f) failed.\n", dt);
-				}
+				hwLogError("GFSDK_HairSDK::StepSimulation(%f) failed.\n", group_dt / num_steps);
 			}
 		}
+	}
+
+	// the ones that sat out are drawn with their last simulated state, not the skinned pose
+	for (auto &v : m_instances)
+	{
+		if (v && v.throttled)
+		{
+			v.throttled = false;
+			applySimulate(v);
+		}
+	}
+}
+
+// assigns each simulating instance a rate divisor (1, 2, 4 or 8) so that the cost per substep fits the budget.
+// visible and near instances are served first. called once per frame after updateSimulationSleep().
+void hwContext::updateSimulationBudget()
+{
+	static const int MaxDivisor = 8;
+
+	hwBudgetSettings settings;
+	{
+		std::unique_lock<std::mutex> lock(m_mutexSettings);
+		settings = m_budgetSettings;
+	}
+
+	std::vector<hwInstanceData*> candidates;
+	for (auto &v : m_instances)
+	{
+		if (v && v.sleep_state == hwSleepState_Awake && v.desc_valid && v.desc.m_simulate)
+			candidates.push_back(&v);
+		else if (v)
+			v.sim_divisor = 1;
+	}
+
+	m_budgetActive = false;
+	m_stats.num_throttled_instances = 0;
+	if (settings.budget <= 0)
+	{
+		for (auto *v : candidates)
+		{
+			v->sim_divisor = 1;
+		}
+		return;
+	}
+
+	// visible first, then by distance. invisible ones by how long they have been invisible
+	int frame = m_simFrame;
+	std::stable_sort(candidates.begin(), candidates.end(), [frame](const hwInstanceData *a, const hwInstanceData *b) {
+		bool va = a->visible_frame == frame, vb = b->visible_frame == frame;
+		if (va != vb) { return va; }
+		if (va) { return a->view_distance < b->view_distance; }
+		return a->invisible_frames < b->invisible_frames;
+	});
+
+	double remaining = settings.budget;
+	for (auto *v : candidates)
+	{
+		double cost = settings.cost_in_vertices ? std::max<int>(v->num_vertices, 1) : 1;
+		int divisor = 1;
+		while (divisor < MaxDivisor && cost / divisor > remaining)
+		{
+			divisor *= 2;
+		}
+		remaining = std::max<double>(remaining - cost / divisor, 0.0);
+
+		v->sim_divisor = divisor;
+		if (divisor > 1)
+		{
+			++m_stats.num_throttled_instances;
+			m_budgetActive = true;
+		}
+	}
+}
+
+// picks the instances stepped this frame in budgeted mode, once per frame that has substeps. an instance is simulated
+// every sim_divisor frames, offset by its handle so reduced-rate instances don't all land on the same frame, and at the
+// latest after sitting out 2 * sim_divisor - 1 frames (e.g. when its divisor just changed). a due instance catches up:
+// its group is the number of frames it sat out, stepped with their time (m_simTickTimes).
+// returns the groups stepped this frame, a bit per group
+uint32_t hwContext::updateSimulationThrottle(float tick_dt)
+{
+	++m_simTick;
+	m_simTickTimes[m_simTick % SIM_TICK_HISTORY] = tick_dt;
+
+	uint32_t groups = 0;
+	m_simPending = false;
+	for (auto &v : m_instances)
+	{
+		if (!v) { continue; }
+
+		if (v.sleep_state != hwSleepState_Awake || !v.desc_valid || !v.desc.m_simulate)
+		{
+			v.sim_group = hwSimGroup_None;
+			v.pending_frames = 0;
+			continue;
+		}
+		bool due = (m_simTick + (int)v.handle) % v.sim_divisor == 0 || v.pending_frames >= std::min(v.sim_divisor * 2, SIM_TICK_HISTORY) - 1;
+		if (due)
+		{
+			v.sim_group = v.pending_frames;
+			v.pending_frames = 0;
+			groups |= 1u << v.sim_group;
+		}
 		else
 		{
-			if (m_currentVRPass == 0)
+			v.sim_group = hwSimGroup_SitOut;
+			++v.pending_frames;
+			m_simPending = true;
+		}
+	}
+	return groups;
+}
+
+// puts instances that were invisible for a while or far from every view to sleep (m_simulate off) and wakes them
+// up when they come back. called once per frame before stepping, with visibility gathered by renderImpl() in the last frame.
+void hwContext::updateSimulationSleep(float warmup_dt)
+{
+	hwSleepSettings settings;
+	{
+		std::unique_lock<std::mutex> lock(m_mutexSettings);
+		settings = m_sleepSettings;
+	}
+
+	// no view was rendered (e.g. nothing on screen yet): nothing is known about visibility
+	bool has_views = m_viewSeen;
+	m_viewSeen = false;
+	m_viewValid = false;
+
+	std::vector<hwInstanceData*> warming;
+	for (auto &v : m_instances)
+	{
+		if (!v) { continue; }
+
+		if (!settings.enabled)
+		{
+			if (v.sleep_state != hwSleepState_Awake)
+			{
+				v.sleep_state = hwSleepState_Awake;
+				applySimulate(v);
+			}
+			continue;
+		}
+		if (!has_views) { continue; }
+
+		bool visible = v.visible_frame == m_simFrame;
+		v.invisible_frames = visible ? 0 : v.invisible_frames + 1;
+
+		switch (v.sleep_state)
+		{
+		case hwSleepState_Awake:
+			if (v.invisible_frames > settings.sleep_delay_frames || (visible && v.view_distance > settings.sleep_distance))
+			{
+				v.sleep_state = hwSleepState_Sleeping;
+				applySimulate(v);
+			}
+			break;
+
+		case hwSleepState_Sleeping:
+			if (visible && v.view_distance < settings.wake_distance)
 			{
-				if (g_hw_sdk->StepSimulation(dt) != GFSDK_HAIR_RETURN_OK)
-				{
-					hwLog("GFSDK_HairSDK::StepSimulation(%f) failed.\n", dt);
-				}
+				// wait for the next skinning update to teleport to the current pose
+				v.sleep_state = hwSleepState_Waking;
+				v.teleport_pending = true;
+				v.wake_frames = 0;
 			}
+			break;
+
+		case hwSleepState_Waking:
+			// proceed even if no skinning update came (e.g. the instance is not skinned)
+			if (!v.teleport_pending || ++v.wake_frames > 1)
+			{
+				v.teleport_pending = false;
+				warming.push_back(&v);
+			}
+			break;
 		}
 	}
-	else
-	{ 
-		if (g_hw_sdk->StepSimulation(dt) != GFSDK_HAIR_RETURN_OK)
+	if (warming.empty()) { return; }
+
+	// warm up the woken instances alone. everything else is parked during the extra substeps
+	for (auto &v : m_instances)
+	{
+		if (v && v.sleep_state == hwSleepState_Awake && v.sim_applied)
+		{
+			v.parked = true;
+			applySimulate(v);
+		}
+	}
+	for (auto *v : warming)
+	{
+		v->sleep_state = hwSleepState_Awake;
+		v->throttled = false;
+		applySimulate(*v);
+		++m_stats.num_simulation_wakeups;
+	}
+	for (int i = 0; i < settings.warmup_substeps; ++i)
+	{
+		++m_stats.num_simulation_steps;
+		if (g_hw_sdk->StepSimulation(warmup_dt) != GFSDK_HAIR_RETURN_OK)
 		{
-			hwLog("GFSDK_HairSDK::StepSimulation(%f) failed.\n", dt);
+			hwLogError("GFSDK_HairSDK::StepSimulation(%f) failed.\n", warmup_dt);
+		}
+	}
+	for (auto &v : m_instances)
+	{
+		if (v && v.parked)
+		{
+			v.parked = false;
+			applySimulate(v);
 		}
 	}
 }
@@ -993,15 +2630,95 @@ bool hwContext::IsVREnabled()
 	return m_VRRendering;
 }
 
+// a flush in progress, for deferred destruction (see hwContext::retire())
+class hwRenderEpochScope
+{
+public:
+    hwRenderEpochScope(std::atomic<uint64_t> &epoch) : m_epoch(epoch) { ++m_epoch; }
+    ~hwRenderEpochScope() { ++m_epoch; }
+
+private:
+    std::atomic<uint64_t> &m_epoch;
+};
+
+void hwContext::runFrameSegment()
+{
+	if (m_commands_back.empty()) { return; }
+	publishTelemetry();
+	m_telemetryFrame.frame_commands = (int)m_commands_back.size();
+	applyLODRequests();
+
+	for (auto& c : m_commands_back)
+	{
+		c();
+	}
+	m_commands_back.clear();
+	++m_stats.num_frame_segments;
+}
+
+// the first view flushed after a frame was recorded also replays the frame segment (skinning + simulation).
+// the view's own segment is kept, so a view rendered again without re-recording (editor repaint) still draws.
+void hwContext::flushView(int slot)
+{
+	hwTraceScoped("hwContext::flushView");
+	hwRenderEpochScope epoch(m_renderEpoch);
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.flush_time);
+	syncLights();
+
+	if (slot < 0 || slot >= hwMaxViews) { return; }
+
+	uint64_t frame;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_commands.empty())
+		{
+			m_commands_back.insert(m_commands_back.end(), m_commands.begin(), m_commands.end());
+			m_commands.clear();
+		}
+		m_viewCommands_back = m_viewCommands[slot];
+		frame = m_recordedFrames[0];
+	}
+
+	m_device->setDepthTest();
+
+	// do not do any rendering if we're shutting down
+	if (m_shuttingDown > 0)
+	{
+		--m_shuttingDown;
+		m_commands_back.clear();
+	}
+	else
+	{
+		runFrameSegment();
+		for (auto& c : m_viewCommands_back)
+		{
+			c();
+		}
+		++m_stats.num_view_flushes;
+		++m_telemetryFrame.num_view_flushes;
+		m_telemetryFrame.view_commands += (int)m_viewCommands_back.size();
+	}
+
+	m_viewCommands_back.clear();
+	m_flushedFrames[0].store(frame);
+}
+
 void hwContext::flush()
 {
+	hwTraceScoped("hwContext::flush");
+	hwRenderEpochScope epoch(m_renderEpoch);
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.flush_time);
+	syncLights();
+
+	uint64_t frame;
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
 		m_commands_back = m_commands;
 		m_commands.clear();
+		frame = m_recordedFrames[0];
 	}
 
-	m_d3dctx->OMSetDepthStencilState(m_rs_enable_depth, 0);
+	m_device->setDepthTest();
 
 	// do not do any rendering if we're shutting down
 	if (m_shuttingDown > 0 )
@@ -1010,6 +2727,9 @@ void hwContext::flush()
 	}
 	else
 	{
+		publishTelemetry();
+		m_telemetryFrame.frame_commands = (int)m_commands_back.size();
+		applyLODRequests();
 		for (auto& c : m_commands_back)
 		{
 			c();
@@ -1017,18 +2737,90 @@ void hwContext::flush()
 	}
 
 	m_commands_back.clear();
+	m_flushedFrames[0].store(frame);
+}
+
+// renders all shadow casters that intersect the light's frustum in one go.
+// called from the light's "Hair Shadow" command buffer (LightEvent.AfterShadowMap).
+void hwContext::flushShadow(int light)
+{
+	hwTraceScoped("hwContext::flushShadow");
+	hwRenderEpochScope epoch(m_renderEpoch);
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.flush_time);
+	if (light < 0 || light >= hwMaxShadowLights) { return; }
+	if (m_shuttingDown > 0) { return; }
+	++m_telemetryFrame.num_shadow_flushes;
+
+	hwShadowLightData sl;
+	{
+		std::unique_lock<std::mutex> lock(m_mutexShadow);
+		sl = m_shadowLights[light];
+		m_shadowCastersFlush = m_shadowCasters;
+	}
+	if (!sl.valid) { return; }
+
+	// not through setSDKViewProjection(): the view's is put back below
+	if (g_hw_sdk->SetViewProjection(&sl.view, &sl.proj, GFSDK_HAIR_LEFT_HANDED, sl.fov) != GFSDK_HAIR_RETURN_OK)
+	{
+		hwLogError("GFSDK_HairSDK::SetViewProjection() failed.\n");
+		return;
+	}
+
+	hwFrustum frustum;
+	hwFrustumFromViewProj(frustum, sl.view, sl.proj);
+
+	// depth only
+	m_device->setDepthTest();
+	m_device->setPixelShader(nullptr);
+
+	{
+		// cast_shadow and desc are written by the main thread
+		std::unique_lock<std::mutex> lock(m_mutexDesc);
+		for (hwHInstance hi : m_shadowCastersFlush)
+		{
+			if (hi >= m_instances.size()) { continue; }
+			auto &v = m_instances[hi];
+			if (!v || !v.cast_shadow || (v.desc_valid && !v.desc.m_enable)) { continue; }
+
+			hwFloat3 bmin, bmax;
+			if (g_hw_sdk->GetBounds(v.iid, &bmin, &bmax) == GFSDK_HAIR_RETURN_OK && !hwFrustumIntersectAABB(frustum, bmin, bmax))
+			{
+				++m_stats.num_shadow_casters_culled;
+				continue;
+			}
+			renderShadowImpl(v.handle);
+			++m_stats.num_shadow_casters_rendered;
+		}
+	}
+
+	// the next view segment runs skinning and simulation before its own view projection
+	if (m_sdkViewValid)
+	{
+		setSDKViewProjection(m_sdkView, m_sdkProj, m_sdkFov);
+	}
 }
 
 void hwContext::flushVR()
 {
+	hwTraceScoped("hwContext::flushVR");
+	hwRenderEpochScope epoch(m_renderEpoch);
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.flush_time);
+	syncLights();
+
 	if (m_currentVRPass == 0)
 	{
-		std::unique_lock<std::mutex> lock(m_mutexVR);
-		m_commands_backVR = m_commandsVR;
-		m_commandsVR.clear();
+		{
+			std::unique_lock<std::mutex> lock(m_mutexVR);
+			m_commands_backVR = m_commandsVR;
+			m_commandsVR.clear();
+			m_flushingFrameVR = m_recordedFrames[1];
+		}
+		publishTelemetry();
+		m_telemetryFrame.vr_commands = (int)m_commands_backVR.size();
+		applyLODRequests(); // not between the eyes
 	}
 
-	m_d3dctx->OMSetDepthStencilState(m_rs_enable_depth, 0);
+	m_device->setDepthTest();
 
 	if (m_shuttingDownVR > 0)
 	{
@@ -1045,6 +2837,7 @@ void hwContext::flushVR()
 	if (m_currentVRPass == 1)
 	{
 		m_commands_backVR.clear();
+		m_flushedFrames[1].store(m_flushingFrameVR);
 	}
 	++m_currentVRPass;
 
@@ -1054,13 +2847,23 @@ void hwContext::flushVR()
 
 void hwContext::flushVRSinglePass()
 {
+	hwTraceScoped("hwContext::flushVRSinglePass");
+	hwRenderEpochScope epoch(m_renderEpoch);
+	hwTelemetryTimer timer(m_telemetryEnabled, m_telemetryFrame.flush_time);
+	syncLights();
+
+	uint64_t frame;
 	{
 		std::unique_lock<std::mutex> lock(m_mutexVR);
 		m_commands_backVR = m_commandsVR;
 		m_commandsVR.clear();
+		frame = m_recordedFrames[1];
 	}
+	publishTelemetry();
+	m_telemetryFrame.vr_commands = (int)m_commands_backVR.size();
+	applyLODRequests();
 
-	m_d3dctx->OMSetDepthStencilState(m_rs_enable_depth, 0);
+	m_device->setDepthTest();
 
 	// do not do any rendering if we're shutting down
 	if (m_shuttingDown > 0)
@@ -1087,26 +2890,75 @@ void hwContext::flushVRSinglePass()
 	}
 
 	m_commands_backVR.clear();
+	m_flushedFrames[1].store(frame);
 }
 
 //
 bool hwContext::addBoneMatricesToBuffer(hwMatrix *matrix, int numMatrix, int &outStartIndex)
 {
-	// check if this can ever fit in the buffer
-	if (numMatrix > NUM_BUFFER_BONES_MATRIX || numMatrix<=0)
+	hwMatrix *dst = reserveBoneMatrices(numMatrix, outStartIndex);
+	if (dst == nullptr)
 		return false;
 
-	//
-	if ((boneMatrixStartIndex + numMatrix) > NUM_BUFFER_BONES_MATRIX)
-		boneMatrixStartIndex = 0;
-
-	memcpy(m_bonesMatrixBuffer + boneMatrixStartIndex, matrix, sizeof(hwMatrix) * numMatrix);
-	outStartIndex = boneMatrixStartIndex;
-	boneMatrixStartIndex += numMatrix;
-	
+	memcpy(dst, matrix, sizeof(hwMatrix) * numMatrix);
 	return true;
 }
 
+// start of num entries in a ring of capacity, -1 if they do not fit or would overwrite entries the render thread has not
+// consumed yet. wraps to the start when the rest does not fit. head counts every entry reserved, skipped tails included.
+// a compare and swap, recording threads reserve concurrently
+static int hwReserveRing(std::atomic<uint64_t> &head, const std::atomic<uint64_t> &consumed, int capacity, int num, const char *what)
+{
+	// check if this can ever fit in the buffer
+	if (num > capacity || num <= 0)
+		return -1;
+
+	uint64_t limit = consumed.load(std::memory_order_acquire) + capacity;
+	uint64_t cur = head.load(std::memory_order_relaxed);
+	uint64_t start = 0;
+	do {
+		uint64_t pos = cur % capacity;
+		start = pos + num > (uint64_t)capacity ? cur + (capacity - pos) : cur;
+		if (start + num > limit)
+		{
+			hwLogWarning("hwContext: the %s ring is full (%d of %d entries not flushed yet). the instance keeps its last palette.\n",
+				what, (int)(cur - (limit - capacity)), capacity);
+			return -1;
+		}
+	} while (!head.compare_exchange_weak(cur, start + num, std::memory_order_relaxed));
+	return (int)(start % capacity);
+}
+
+// moves the consumed heads up to the last mark whose frames the render thread has flushed, of both scene kinds
+void hwContext::updateRingConsumed()
+{
+	size_t n = 0;
+	while (n < m_ringMarks.size() &&
+		m_flushedFrames[0].load() >= m_ringMarks[n].frames[0] && m_flushedFrames[1].load() >= m_ringMarks[n].frames[1])
+	{
+		++n;
+	}
+	if (n == 0) { return; }
+
+	boneMatrixConsumed.store(m_ringMarks[n - 1].matrices, std::memory_order_release);
+	boneDQConsumed.store(m_ringMarks[n - 1].dqs, std::memory_order_release);
+	m_ringMarks.erase(m_ringMarks.begin(), m_ringMarks.begin() + n);
+}
+
+//
+hwMatrix* hwContext::reserveBoneMatrices(int numMatrix, int &outStartIndex)
+{
+	outStartIndex = hwReserveRing(boneMatrixHead, boneMatrixConsumed, NUM_BUFFER_BONES_MATRIX, numMatrix, "skinning matrix");
+	return outStartIndex < 0 ? nullptr : m_bonesMatrixBuffer + outStartIndex;
+}
+
+//
+hwDQuaternion* hwContext::reserveBoneDQs(int numDQ, int &outStartIndex)
+{
+	outStartIndex = hwReserveRing(boneDQHead, boneDQConsumed, NUM_BUFFER_BONES_DQ, numDQ, "dual quaternion");
+	return outStartIndex < 0 ? nullptr : m_bonesDQBuffer + outStartIndex;
+}
+
 //
 void hwContext::SetViewportLeftEye()
 {
@@ -1115,17 +2967,12 @@ void hwContext::SetViewportLeftEye()
 
 void hwContext::SetViewportRightEye()
 {
-	unsigned int numViewports = 1;
-	D3D11_VIEWPORT *pVieports = new D3D11_VIEWPORT[1];
-	m_d3dctx->RSGetViewports(&numViewports, pVieports);
-	D3D11_VIEWPORT finalViewport;
-	finalViewport.Height = pVieports[0].Height;
-	finalViewport.Width = pVieports[0].Width;
-	finalViewport.MaxDepth = pVieports[0].MaxDepth;
-	finalViewport.MinDepth = pVieports[0].MinDepth;
-	finalViewport.TopLeftX = pVieports[0].Width;
-	finalViewport.TopLeftY = pVieports[0].TopLeftY;
-	m_d3dctx->RSSetViewports(1, &finalViewport);
+	hwViewport vp;
+	if (m_device->getViewport(vp))
+	{
+		vp.x = vp.width;
+		m_device->setViewport(vp);
+	}
 }
 
 void hwContext::SetShuttingDownFlag()
@@ -1151,5 +2998,108 @@ void hwContext::ResetVRPass()
 	m_currentVRPass = 0;
 }
 
+void hwContext::getStats(hwStats &o_stats) const
+{
+	o_stats = m_stats;
+	o_stats.asset_resident_bytes = getResidentBytes();
+	o_stats.num_assets_cached = (int)std::count_if(m_assets.begin(), m_assets.end(),
+		[](const hwAssetData &a) { return a && a.ref_count == 0 && a.lod_base == hwNullHandle; });
+}
+
+bool hwContext::telemetryOpen(const char *name, int max_instances)
+{
+	telemetryClose();
+	auto *block = hwTelemetryCreate(name, max_instances);
+	if (!block) { return false; }
+
+	std::unique_lock<std::mutex> lock(m_mutexTelemetry);
+	m_telemetry = block;
+	m_telemetryEnabled.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+void hwContext::telemetryClose()
+{
+	hwTelemetryHeader *block;
+	{
+		std::unique_lock<std::mutex> lock(m_mutexTelemetry);
+		block = m_telemetry;
+		m_telemetry = nullptr;
+		m_telemetryEnabled.store(false, std::memory_order_relaxed);
+	}
+	hwTelemetryUnmap(block);
+}
+
+// ComputeStats() of this many instances per frame, round robin
+static const int hwTelemetryStatsPerFrame = 32;
+
+// writes the frame that just ended into the telemetry block. called on the render thread when a new frame starts
+void hwContext::publishTelemetry()
+{
+	if (!m_telemetryEnabled.load(std::memory_order_relaxed))
+	{
+		// frame numbers restart at the next hwTelemetryOpen()
+		m_telemetryFrame = hwTelemetryFrame();
+		m_telemetryLast = 0;
+		return;
+	}
+	// never waits: the frame is dropped while the main thread opens or closes the block
+	std::unique_lock<std::mutex> lock(m_mutexTelemetry, std::try_to_lock);
+	if (!lock.owns_lock() || !m_telemetry) { return; }
+	hwTraceScoped("hwContext::publishTelemetry");
+
+	auto &f = m_telemetryFrame;
+	uint64_t now = hwTraceNow();
+	++f.frame;
+	f.timestamp = now;
+	f.frame_time = m_telemetryLast ? (float)((now - m_telemetryLast) / 1000000.0) : 0.0f;
+	m_telemetryLast = now;
+
+	size_t num_slots = m_instances.size();
+	for (int i = 0; i < hwTelemetryStatsPerFrame && num_slots > 0; ++i)
+	{
+		auto &v = m_instances[m_telemetryCursor++ % num_slots];
+		if (v && g_hw_sdk->ComputeStats(v.iid, &v.telemetry_stats) == GFSDK_HAIR_RETURN_OK)
+		{
+			v.telemetry_frame = f.frame;
+		}
+	}
+
+	auto *block = m_telemetry;
+	auto *dst = block->instances();
+	uint32_t n = 0;
+	hwTelemetryBeginWrite(block);
+	for (auto &v : m_instances)
+	{
+		if (!v) { continue; }
+		++f.num_instances;
+		if (v.sleep_state != hwSleepState_Awake) { ++f.num_sleeping_instances; }
+		if (v.sim_divisor > 1) { ++f.num_throttled_instances; }
+		if (n == block->max_instances) { continue; }
+
+		auto &t = dst[n++];
+		t.handle = v.handle;
+		t.asset = v.hasset;
+		t.lod = v.lod;
+		t.sleep_state = v.sleep_state;
+		t.simulating = v.sim_applied;
+		t.sim_divisor = v.sim_divisor;
+		t.invisible_frames = v.invisible_frames;
+		t.num_hairs = v.telemetry_stats.m_numHairs;
+		t.average_cvs = v.telemetry_stats.m_averageCV;
+		t.distance_lod_factor = v.telemetry_stats.m_distanceLODFactor;
+		t.detail_lod_factor = v.telemetry_stats.m_detailLODFactor;
+		t.camera_distance = v.telemetry_stats.m_camDistance;
+		t.stats_frame = v.telemetry_frame;
+	}
+	block->num_instances = n;
+	block->frame = f;
+	hwTelemetryEndWrite(block);
+
+	uint64_t frame = f.frame;
+	f = hwTelemetryFrame();
+	f.frame = frame;
+}
+
 
 
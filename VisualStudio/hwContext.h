@@ -1,15 +1,37 @@
 ﻿#pragma once
+#include "hwSimClock.h"
+#include "hwMath.h"
+#include "hwSkinning.h"
+#include "hwRenderDevice.h"
+#include "hwStableVector.h"
+#include "hwTelemetry.h"
+#include "hwAssetMemory.h"
+#include "hwDescriptor.h"
+
+// a released shader / asset / instance keeps its slot and its objects until the render thread can no longer be using
+// them (see hwContext::collectRetired()). retired entries test false on both threads and their slots are not reused
+struct hwRetireState
+{
+    std::atomic<bool> retired;
+    uint64_t epoch;             // hwContext::m_renderEpoch at the release
+    uint64_t frames[2];         // last frame that may have recorded commands for it, scene / VR scene (hwContext::m_recordedFrames)
+
+    hwRetireState() : retired(false), epoch(0), frames() {}
+    hwRetireState(const hwRetireState &o) : retired(o.retired.load()), epoch(o.epoch) { frames[0] = o.frames[0]; frames[1] = o.frames[1]; }
+    hwRetireState& operator=(const hwRetireState &o) { retired.store(o.retired.load()); epoch = o.epoch; frames[0] = o.frames[0]; frames[1] = o.frames[1]; return *this; }
+};
 
 struct hwShaderData
 {
     hwHShader handle;
     int ref_count;
-    ID3D11PixelShader *shader;
+    hwPixelShader *shader;
     std::string path;
+    hwRetireState retire;
 
     hwShaderData() : handle(hwNullHandle), ref_count(0), shader(nullptr) {}
-    void invalidate() { ref_count = 0; shader = nullptr; path.clear(); }
-    operator bool() const { return shader != nullptr; }
+    void invalidate() { ref_count = 0; shader = nullptr; path.clear(); retire = hwRetireState(); }
+    operator bool() const { return shader != nullptr && !retire.retired; }
 };
 
 struct hwAssetData
@@ -19,23 +41,96 @@ struct hwAssetData
     hwAssetID aid;
     std::string path;
     hwConversionSettings settings;
+    std::vector<hwMatrix> inv_bindpose; // cached at load for hwUpdateSkinningBatch()
+    hwHAsset lod_base;              // the full resolution asset if this is a guide hair LOD level. hwNullHandle otherwise
+    std::vector<hwHAsset> lods;     // levels 1..n built by assetBuildLODChain(). level 0 is the asset itself
+    int64_t bytes;                  // estimated GPU memory of the asset: guide hairs, growth mesh and bones
+    int64_t instance_bytes;         // estimated render hair buffers of an instance with the default descriptor
+    uint64_t last_used;             // released assets kept under the memory budget are evicted in this order
+    hwRetireState retire;
+
+    hwAssetData() : handle(hwNullHandle), aid(hwNullAssetID), ref_count(0), lod_base(hwNullHandle), bytes(0), instance_bytes(0), last_used(0) {}
+    void invalidate() { ref_count = 0; aid = hwNullAssetID; path.clear(); inv_bindpose.clear(); lod_base = hwNullHandle; lods.clear(); bytes = instance_bytes = 0; last_used = 0; retire = hwRetireState(); }
+    operator bool() const { return aid != hwNullAssetID && !retire.retired; }
+};
+
+enum hwSleepState
+{
+    hwSleepState_Awake,
+    hwSleepState_Sleeping,
+    hwSleepState_Waking,    // waits for a teleported skinning update, then runs the warm-up substeps
+};
 
-    hwAssetData() : handle(hwNullHandle), aid(hwNullAssetID), ref_count(0) {}
-    void invalidate() { ref_count = 0; aid = hwNullAssetID; path.clear(); }
-    operator bool() const { return aid != hwNullAssetID; }
+// hwInstanceData::sim_group values other than a number of frames
+enum hwSimGroup
+{
+    hwSimGroup_None = -2,   // not budgeted (asleep, parked, not simulated)
+    hwSimGroup_SitOut = -1,
 };
 
 struct hwInstanceData
 {
     hwHInstance handle;
     hwInstanceID iid;
-    hwHAsset hasset;
+    hwHAsset hasset;       // always the full resolution asset. the SDK instance is created from its level lod
+    hwAssetID aid;         // the SDK asset iid was created from. kept alive until no instance uses it (see hwContext::releaseAssetID())
+    int lod;
+    hwSRV *textures[GFSDK_HAIR_NUM_TEXTURES]; // kept to restore them when the SDK instance is recreated for another lod
     bool cast_shadow;
     bool receive_shadow;
+    bool desc_valid;
+    bool desc_mapped;      // hwContext::m_descBlocks[handle] is in use (hwInstanceMapDescriptor())
+    hwHairDescriptor desc; // descriptor given by the user. m_simulate may be overridden by sleep (see hwContext::uploadDescriptor())
+    bool sim_applied;      // m_simulate last sent to the SDK
+    bool parked;           // simulation temporarily disabled (e.g. others' warm-up)
+    bool throttled;        // m_simulate held off while another group steps (simulation budget)
+    int sim_divisor;       // simulated every sim_divisor frames (simulation budget)
+    int pending_frames;    // frames sat out since it was last simulated
+    int sim_group;         // this frame's step group: frames sat out before, or hwSimGroup_*
+    int num_vertices;      // simulation cost estimate
+
+    hwSleepState sleep_state;
+    int invisible_frames;
+    int wake_frames;
+    bool teleport_pending;
+    bool palette_valid;     // palette_hash holds the last uploaded skinning palette
+    uint64_t palette_hash;
+    int visible_frame;     // last frame the bounds were inside a view frustum
+    float view_distance;   // distance to the nearest view in visible_frame
+    GFSDK_HairStats telemetry_stats;    // last ComputeStats() for the telemetry block (render thread)
+    uint64_t telemetry_frame;           // hwTelemetryFrame::frame of telemetry_stats. 0: none yet
+    hwRetireState retire;
+
+    hwInstanceData() : handle(hwNullHandle), iid(hwNullInstanceID), hasset(hwNullHandle) { invalidate(); }
+    void invalidate()
+    {
+        iid = hwNullInstanceID; hasset = hwNullAssetID; aid = hwNullAssetID; lod = 0; memset(textures, 0, sizeof(textures)); cast_shadow = false; receive_shadow = false; desc_valid = false; desc_mapped = false;
+        sim_applied = false; parked = false; num_vertices = 0;
+        throttled = false; sim_divisor = 1; pending_frames = 0; sim_group = hwSimGroup_None;
+        sleep_state = hwSleepState_Awake; invisible_frames = 0; wake_frames = 0; teleport_pending = false; palette_valid = false; palette_hash = 0; visible_frame = -1; view_distance = 0.0f;
+        telemetry_stats = GFSDK_HairStats(); telemetry_frame = 0;
+        retire = hwRetireState();
+    }
+    operator bool() const { return iid != hwNullInstanceID && !retire.retired; }
+};
 
-    hwInstanceData() : handle(hwNullHandle), iid(hwNullInstanceID), hasset(hwNullHandle), cast_shadow(false), receive_shadow(false) {}
-    void invalidate() { iid = hwNullInstanceID; hasset = hwNullAssetID; cast_shadow = false; receive_shadow = false; }
-    operator bool() const { return iid != hwNullInstanceID; }
+struct hwBudgetSettings
+{
+    int budget;             // cost units per substep. <= 0: no limit
+    bool cost_in_vertices;  // cost of an instance: its hair vertex count if true, 1 otherwise
+
+    hwBudgetSettings() : budget(0), cost_in_vertices(false) {}
+};
+
+struct hwSleepSettings
+{
+    bool enabled;
+    float sleep_distance;       // fall asleep beyond this distance from every view
+    float wake_distance;        // wake up within this distance. <= sleep_distance, the gap is the hysteresis window
+    int sleep_delay_frames;     // fall asleep after being invisible this many frames
+    int warmup_substeps;        // substeps run on wake up (with the others parked) to hide the pop
+
+    hwSleepSettings() : enabled(true), sleep_distance(30.0f), wake_distance(25.0f), sleep_delay_frames(30), warmup_substeps(4) {}
 };
 
 enum hwELightType
@@ -59,6 +154,115 @@ struct hwLightData
     {}
 };
 
+// one bone of hwAssetGetBoneTable(). must match hwi.BoneTableEntry in C#
+struct hwBoneTableEntry
+{
+    hwMatrix bindpose;
+    int index;
+    int parent;     // the SDK does not expose the hierarchy of loaded assets. always -1 for now
+    char name[GFSDK_HAIR_MAX_STRING];
+};
+
+// descriptor of an instance in plugin memory (hwInstanceMapDescriptor()). the caller writes desc in place and sets
+// dirty, beginScene() forwards the changed ones. main thread only. must match hwi.DescriptorBlock in C#
+struct hwDescriptorBlock
+{
+    hwHairDescriptor desc;
+    int dirty;              // set by the caller after writing desc, cleared when the plugin takes it
+    uint32_t generation;    // bumped every time the plugin's descriptor of the instance changes
+
+    hwDescriptorBlock() : dirty(0), generation(0) {}
+};
+
+// one command recorded on a worker thread (hwBeginThreadRecording())
+struct hwThreadCommand
+{
+    uint64_t key;       // instance handle << 32 | registration index of the recording thread
+    std::vector<std::function<void()>> *queue;  // the segment it is merged into
+    std::function<void()> call;
+};
+
+enum hwThreadRecordingState
+{
+    hwThreadRecording_Free,
+    hwThreadRecording_Recording,
+    hwThreadRecording_Ended,
+};
+
+// command buffer of one recording thread. only that thread touches it until state is Ended, then only the merging
+// thread until it is Free again
+struct hwThreadRecording
+{
+    std::atomic<int> state { hwThreadRecording_Free };
+    bool vr = false;
+    int view = -1;      // view segment being recorded when the recording began. -1: frame segment
+    uint32_t thread_index = 0;  // registration index of the recording thread
+    uint64_t sequence = 0;      // order of hwBeginThreadRecording() calls. a thread's recordings merge in this order
+    std::vector<hwThreadCommand> commands;
+    std::vector<hwHInstance> draws;     // render() / renderShadow() targets, added to hwContext::m_frameDraws at the merge
+    // stats, added to hwStats at the merge
+    int num_skinning_uploads_skipped = 0;
+    int64_t num_skinning_bytes_saved = 0;
+};
+
+// entry of the light registry (hwLightCreate() etc.)
+struct hwLightEntry
+{
+    hwHLight handle;
+    bool alive;
+    hwLightData data;
+
+    hwLightEntry() : handle(hwNullHandle), alive(false) {}
+    void invalidate() { alive = false; }
+    operator bool() const { return alive; }
+};
+
+// counters are accumulated since hwInitialize(). must match hwi.Stats in C#
+struct hwStats
+{
+    int num_descriptor_updates;
+    int num_descriptor_updates_skipped;
+    int num_shadow_casters_rendered;
+    int num_shadow_casters_culled;
+    int num_simulation_steps;
+    int num_frame_segments;     // recorded skinning + simulation segments replayed
+    int num_view_flushes;
+    int num_simulation_frames;          // frames that advanced the simulation clock. num_simulation_steps counts substeps
+    int num_simulation_frames_dropped;  // frames that hit the max substeps cap
+    float simulation_time_dropped;      // in seconds
+    int num_sleeping_instances;         // current, not accumulated
+    int num_simulation_wakeups;
+    int num_instance_steps_saved;       // substeps x sleeping instances
+    int num_draws_culled;
+    int64_t num_vertex_steps_saved;     // same as above weighted by hair vertices
+    int num_throttled_instances;        // current. instances stepped at a reduced rate by the simulation budget
+    int num_budget_group_steps;         // StepSimulation() calls of the budget's step groups (a group per frames sat out)
+    int num_skinning_uploads_skipped;   // palettes identical to the last upload of the instance
+    int64_t num_skinning_bytes_saved;   // ring buffer copies + SDK uploads avoided by the above
+    int num_lod_switches;               // instances moved to another guide hair LOD level
+    int64_t asset_resident_bytes;       // current. estimated GPU memory of the loaded assets and their instances
+    int num_assets_cached;              // current. released assets kept resident under the memory budget
+    int num_asset_evictions;
+    int num_asset_reloads;              // loads of paths evicted before
+    float asset_reload_time;            // in milliseconds, all reloads
+    int num_frame_packets;              // hwSubmitFrame() calls applied
+    int num_frame_packets_rejected;     // malformed packets, nothing of them recorded
+    int num_thread_recordings;          // worker thread command buffers merged
+    int num_thread_commands;            // commands merged from them
+
+    hwStats() { memset(this, 0, sizeof(*this)); }
+};
+
+struct hwShadowLightData
+{
+    hwMatrix view;
+    hwMatrix proj;
+    float fov;
+    bool valid;
+
+    hwShadowLightData() : fov(0.0f), valid(false) {}
+};
+
 struct hwConstantBuffer
 {
     int num_lights; int pad0[3];
@@ -70,11 +274,16 @@ struct hwConstantBuffer
 
 
 
+typedef hwSDK* (*hwSDKLoader)();
+
 class hwContext
 {
 public:
     static hwSDK* loadSDK();
     static void   unloadSDK();
+    // replaces how loadSDK() gets the SDK (e.g. hwCreateStubSDK() for benchmarks). null restores the default:
+    // GFSDK_HairWorks.win*.dll next to this module on Windows, the stub SDK elsewhere. takes effect on the next load
+    static void   setSDKLoader(hwSDKLoader loader);
 
 
 public:
@@ -82,7 +291,8 @@ public:
     ~hwContext();
     bool valid() const;
 
-    bool initialize(hwDevice *d3d_device);
+    bool initialize(hwRenderDevice *device); // takes ownership of device
+    hwRenderDevice* getRenderDevice() const;
     void finalize();
     void move(hwContext &from);
 
@@ -95,10 +305,17 @@ public:
     void            assetReload(hwHAsset ha);
     int             assetGetNumBones(hwHAsset ha) const;
     const char*     assetGetBoneName(hwHAsset ha, int nth) const;
+    int             assetGetBoneTable(hwHAsset ha, hwBoneTableEntry *dst, int max_entries) const;
+    bool            assetSetBoneRemapping(hwHAsset ha, int num_bones, const char **bone_names);
     void            assetGetBoneIndices(hwHAsset ha, hwFloat4 &o_indices) const;
     void            assetGetBoneWeights(hwHAsset ha, hwFloat4 &o_weight) const;
     void            assetGetBindPose(hwHAsset ha, int nth, hwMatrix &o_mat);
     void            assetGetDefaultDescriptor(hwHAsset ha, hwHairDescriptor &o_desc) const;
+    bool            assetGetInfo(hwHAsset ha, hwAssetInfo &o_info) const;
+    int             assetBuildLODChain(hwHAsset ha, int levels);
+    int             assetGetNumLODs(hwHAsset ha) const;
+    int64_t         assetGetMemoryUsage(hwHAsset ha) const;
+    void            setAssetMemoryBudget(int64_t bytes);
 
 
 	// New - WayGate
@@ -109,47 +326,102 @@ public:
 
     hwHInstance     instanceCreate(hwHAsset ha);
     void            instanceRelease(hwHInstance hi);
+    void            instanceSetLOD(hwHInstance hi, int level);
+    int             instanceGetLOD(hwHInstance hi) const;
     void            instanceGetBounds(hwHInstance hi, hwFloat3 &o_min, hwFloat3 &o_max) const;
     void            instanceGetDescriptor(hwHInstance hi, hwHairDescriptor &desc) const;
     void            instanceSetDescriptor(hwHInstance hi, const hwHairDescriptor &desc);
+    void            instanceSetDescriptorField(hwHInstance hi, int offset, int size, const void *data);
+    hwDescriptorBlock* instanceMapDescriptor(hwHInstance hi);
     void            instanceSetTexture(hwHInstance hi, hwTextureType type, hwTexture *tex);
 	void			instanceSetTextureIntoDevice(hwHInstance hi, hwTextureType type);
     void            instanceUpdateSkinningMatrices(hwHInstance hi, int num_bones, hwMatrix *matrices);
 	void			instanceUpdateSkinningMatricesAsync(hwHInstance hi, int num_bones, hwMatrix *matrices, bool vrMode);
+    void            updateSkinningBatch(int num_entries, const hwSkinningBatchEntry *entries, const hwMatrix *world, bool vrMode);
     void            instanceUpdateSkinningDQs(hwHInstance hi, int num_bones, hwDQuaternion *dqs);
+    void            instanceUpdateSkinningDQsAsync(hwHInstance hi, int num_bones, hwDQuaternion *dqs, bool vrMode);
 	
 
     void beginScene(bool vrMode);
     void endScene(bool vrMode);
-    void setViewProjection(const hwMatrix &view, const hwMatrix &proj, float fov);
+    bool submitFrame(const void *packet, size_t size);
+    bool beginThreadRecording(bool vrMode);
+    bool endThreadRecording();
+    void setViewProjection(int slot, const hwMatrix &view, const hwMatrix &proj, float fov);
 	void setViewProjectionStereo(const hwMatrix &view, const hwMatrix &proj, const hwMatrix &view2, const hwMatrix &proj2, float fov, bool singlePassStereo);
     void setRenderTarget(hwTexture *framebuffer, hwTexture *depthbuffer, bool vrMode);
     void setShader(hwHShader hs, bool vrMode);
     void setLights(int num_lights, const hwLightData *lights, bool vrMode);
+    hwHLight lightCreate(const hwLightData &light);
+    void lightUpdate(hwHLight hl, const hwLightData &light);
+    void lightRelease(hwHLight hl);
 	void render(hwHInstance hi, bool vrMode);
     void renderShadow(hwHInstance hi, bool vrMode);
     void stepSimulation(float dt, bool vrMode, bool singlePassVR);
+    void setSimulationTimestep(float fixed_dt, int max_substeps);
+    void setSimulationSleep(const hwSleepSettings &settings);
+    void setSimulationBudget(const hwBudgetSettings &settings);
+    void setShadowViewProjection(int light, const hwMatrix &view, const hwMatrix &proj, float fov);
     void flush();
+	void flushView(int slot);
+	void flushShadow(int light);
 	void flushVR();
 	void flushVRSinglePass();
 	void ResetVRPass();
+    void getStats(hwStats &o_stats) const;
+    bool telemetryOpen(const char *name, int max_instances);
+    void telemetryClose();
 
 private:
-    hwShaderData&   newShaderData();
-    hwAssetData&    newAssetData();
-    hwInstanceData& newInstanceData();
+    hwShaderData*   newShaderData();
+    hwAssetData*    newAssetData();
+    void            cacheBindPose(hwAssetData &v);
+    bool            buildLODLevel(hwHAsset base, hwHAsset ha, int level);
+    void            releaseLODChain(hwHAsset ha);
+    void            freeAsset(hwHAsset ha);
+    void            releaseAssetID(hwAssetID aid);
+    void            collectAssetIDs();
+    void            retireAsset(hwHAsset ha);
+    void            retire(hwRetireState &s);
+    bool            isRetireSafe(const hwRetireState &s) const;
+    void            collectRetired(bool force = false);
+    void            updateRingConsumed();
+    void            measureAsset(hwAssetData &v);
+    int64_t         getInstanceBytes(const hwInstanceData &i) const;
+    int64_t         getResidentBytes() const;
+    void            evictAssets();
+    void            instanceSetLODImpl(hwHInstance hi, int level);
+    void            applyLODRequests();
+    void            publishTelemetry();
+    hwInstanceData* newInstanceData();
 
     typedef std::function<void()> DeferredCall;
-	void pushDeferredCall(const DeferredCall &c, bool useVRQueue = false);
+	void pushDeferredCall(const DeferredCall &c, bool useVRQueue = false, hwHInstance key = hwNullHandle);
+	void pushFrameCall(const DeferredCall &c, hwHInstance key = hwNullHandle);
+	void pushThreadCall(hwThreadRecording &r, std::vector<DeferredCall> &queue, const DeferredCall &c, hwHInstance key);
+	void mergeThreadRecordings(bool vrMode);
+	void runFrameSegment();
     void setViewProjectionImpl(const hwMatrix &view, const hwMatrix &proj, float fov);
 	void setViewProjectionStereoImpl(const hwMatrix &view, const hwMatrix &proj, const hwMatrix &view2, const hwMatrix &proj2, float fov, bool singlePassStereo);
     void setRenderTargetImpl(hwTexture *framebuffer, hwTexture *depthbuffer);
     void setShaderImpl(hwHShader hs);
     void setLightsImpl(int num_lights, const hwLightData *lights);
+    void syncLights();
+    int  selectLights(const hwFloat3 *bmin, const hwFloat3 *bmax, hwLightData *dst);
+    bool uploadDescriptor(hwInstanceData &v);
+    void updateDescriptorBlock(hwInstanceData &v);
+    void syncDescriptorBlocks();
+    bool skipUnchangedPalette(hwInstanceData &v, const void *data, size_t size, uint64_t seed, size_t upload_size);
+    void applySimulate(hwInstanceData &v);
+    void updateSimulationSleep(float warmup_dt);
+    void updateSimulationBudget();
+    uint32_t updateSimulationThrottle(float tick_dt);
+    void setCullingView(const hwMatrix &view, const hwMatrix &proj);
+    bool setSDKViewProjection(const hwMatrix &view, const hwMatrix &proj, float fov);
+    void noteDraw(hwHInstance hi);
     void renderImpl(hwHInstance hi);
     void renderShadowImpl(hwHInstance hi);
     void stepSimulationImpl(float dt, bool vrMode, bool singlePassVR);
-	void getSamplerLinear(ID3D11Device* pd3dDevice , ID3D11SamplerState** ppTexSampler);
     hwSRV* getSRV(hwTexture *tex);
     hwRTV* getRTV(hwTexture *tex);
 
@@ -163,7 +435,10 @@ private:
 	void SetViewportRightEye();
 	void ResetRenderingPipeline();
 	bool addBoneMatricesToBuffer(hwMatrix *matrix, int numMatrix, int &outStartIndex);
-	void instanceUpdateSkinningMatricesAsyncImpl(hwInstanceID instance, int matrixIndex, int numMatrix);
+	hwMatrix* reserveBoneMatrices(int numMatrix, int &outStartIndex);
+	hwDQuaternion* reserveBoneDQs(int numDQ, int &outStartIndex);
+	void instanceUpdateSkinningMatricesAsyncImpl(hwHInstance hi, int matrixIndex, int numMatrix);
+	void instanceUpdateSkinningDQsAsyncImpl(hwHInstance hi, int dqIndex, int numDQ);
 
 	int  m_currentVRPass;
 	bool m_VRRendering;
@@ -182,25 +457,37 @@ private:
 	int singlePassStereoRenderPass;
 
 	// skinning matrix ring buffer
-	static const  int NUM_BUFFER_BONES_MATRIX = 1000;
+	// must hold all the bones submitted and not flushed yet (hwUpdateSkinningBatch() submits every instance at once).
+	// reservations that would overwrite bones the render thread has not uploaded fail, the instance keeps its last palette
+	static const  int NUM_BUFFER_BONES_MATRIX = 16384;
 	hwMatrix m_bonesMatrixBuffer[NUM_BUFFER_BONES_MATRIX];
-	int boneMatrixStartIndex	= 0;
+	std::atomic<uint64_t> boneMatrixHead { 0 };	// entries reserved so far, tails skipped by a wrap included. reserved from recording threads too
+	std::atomic<uint64_t> boneMatrixConsumed { 0 };	// head at the end of the last flushed scene (updateRingConsumed())
+
+	// dual quaternion skinning ring buffer. same rules as the matrix one
+	static const  int NUM_BUFFER_BONES_DQ = 16384;
+	hwDQuaternion m_bonesDQBuffer[NUM_BUFFER_BONES_DQ];
+	std::atomic<uint64_t> boneDQHead { 0 };
+	std::atomic<uint64_t> boneDQConsumed { 0 };
+	std::atomic<bool> m_dqMirrorWarned { false };	// hwSkinningFlag_DualQuaternion with hwSkinningFlag_MirrorX was logged
 
 	// End new stuff from WayGate 
 
 private:
-    typedef std::vector<hwShaderData>       ShaderCont;
-    typedef std::vector<hwAssetData>        AssetCont;
-    typedef std::vector<hwInstanceData>     InstanceCont;
+    // stable storage: the render thread reads them while the main thread creates
+    typedef hwStableVector<hwShaderData>    ShaderCont;
+    typedef hwStableVector<hwAssetData>     AssetCont;
+    typedef hwStableVector<hwInstanceData>  InstanceCont;
+    typedef hwStableVector<hwDescriptorBlock> DescriptorBlockCont;
     typedef std::map<hwTexture*, hwSRV*>    SRVTable;
     typedef std::map<hwTexture*, hwRTV*>    RTVTable;
     typedef std::vector<DeferredCall>       DeferredCalls;
+    typedef std::vector<hwLightEntry>       LightCont;
 
     std::mutex              m_mutex;
 	std::mutex              m_mutexVR;
 
-    ID3D11Device            *m_d3ddev = nullptr;
-    ID3D11DeviceContext     *m_d3dctx = nullptr;
+    hwRenderDevice          *m_device = nullptr;
     ShaderCont              m_shaders;
     AssetCont               m_assets;
     InstanceCont            m_instances;
@@ -212,21 +499,108 @@ private:
 	DeferredCalls           m_commandsVR;
 	DeferredCalls           m_commands_backVR;
 
-    ID3D11DepthStencilState *m_rs_enable_depth = nullptr;
-    ID3D11Buffer            *m_rs_constant_buffer = nullptr;
+    // per view render segments. m_commands holds the frame segment (skinning + simulation) shared by all views.
+    DeferredCalls           m_viewCommands[hwMaxViews];
+    DeferredCalls           m_viewCommands_back;
+    int                     m_recordingView = -1;
+
+    // worker thread command buffers. claimed and handed back with atomics, merged by the thread holding the scene
+    // mutex. the counters ([1]: VR) let the merge check skip the scan when nothing ended
+    hwThreadRecording       m_threadRecordings[hwMaxRecordingThreads];
+    std::atomic<int>        m_numOpenRecordings[2] {};
+    std::atomic<int>        m_numEndedRecordings[2] {};
+    std::atomic<uint64_t>   m_recordingSequence { 0 };
+    std::vector<hwThreadCommand*> m_mergeScratch;
+
+    // light registry. written by the main thread, copied to m_lightsRender by the render thread when dirty
+    std::mutex              m_mutexLights;
+    LightCont               m_lights;
+    bool                    m_lightsDirty = false;
+    std::vector<hwLightData> m_lightsRender;
+
+    std::mutex              m_mutexShadow;
+    hwShadowLightData       m_shadowLights[hwMaxShadowLights];
+    // instances drawn since the last stepSimulation() (main thread). endScene() publishes them in m_shadowCasters
+    // (under m_mutexShadow), flushShadow() renders those that cast shadows and are enabled
+    std::vector<hwHInstance> m_frameDraws;
+    bool                    m_frameDrawsChanged = false;
+    std::vector<hwHInstance> m_shadowCasters;
+    std::vector<hwHInstance> m_shadowCastersFlush;  // render thread copy
+
+    // last view projection given to the SDK (render thread). flushShadow() puts it back after the light's
+    hwMatrix                m_sdkView;
+    hwMatrix                m_sdkProj;
+    float                   m_sdkFov = 0.0f;
+    bool                    m_sdkViewValid = false;
+
+    // simulation clock. only touched on the render thread, settings are picked up at the next step
+    hwSimClock              m_simClock;
+    std::atomic<float>      m_simTimestep { 1.0f / 60.0f };
+    std::atomic<int>        m_simMaxSubsteps { 4 };
+    int                     m_simFrame = 0;
+    int                     m_simTick = 0;          // frames stepped in budgeted mode
+    bool                    m_budgetActive = false;
+    bool                    m_simPending = false;   // instances have frames to catch up on
+    // simulated time of the last budgeted frames, by m_simTick. covers the frames an instance sits out at most
+    static const int        SIM_TICK_HISTORY = 16;
+    float                   m_simTickTimes[SIM_TICK_HISTORY] = {};
+
+    // culling view of the draws being flushed (render thread). visibility and distances feed simulation sleep
+    hwFrustum               m_viewFrustum;
+    hwFloat3                m_viewPosition;
+    bool                    m_viewValid = false;
+    bool                    m_viewSeen = false;     // any view flushed since the last step
+
+    std::mutex              m_mutexSettings;
+    hwSleepSettings         m_sleepSettings;
+    hwBudgetSettings        m_budgetSettings;
+
+    // guards hwInstanceData::desc and UpdateInstanceDescriptor(). descriptors are set from the main thread, sleep toggles m_simulate on the render thread.
+    // also held wherever the render thread swaps an instance's iid / aid / textures (instanceSetLODImpl()) or the main
+    // thread replaces an asset's aid, and by the main thread calls that use iid outside a flush
+    mutable std::mutex      m_mutexDesc;
+    // indexed by instance handle, grown on demand. the blocks never move: the caller keeps pointers to them
+    DescriptorBlockCont     m_descBlocks;
+    int                     m_numMappedDescs = 0;
+
+    // instanceSetLOD() requests. the SDK instances are swapped on the render thread before the frame's skinning
+    std::mutex              m_mutexLOD;
+    std::vector<std::pair<hwHInstance, int>> m_lodRequests;
+
+    // asset memory budget. 0: released assets are freed right away. otherwise they stay resident until the estimate
+    // goes over the budget and are evicted least recently released first. main thread only
+    int64_t                 m_assetBudget = 0;
+    uint64_t                m_assetClock = 0;
+    std::set<std::string>   m_evictedPaths;     // next loads of these count as reloads
+
+    // deferred destruction. the render thread increments m_renderEpoch when it enters and leaves a flush (odd while
+    // inside, one render thread). released entries are freed by the main thread once that flush is over and the frames
+    // that may have recorded commands for them have been flushed.
+    // [0]: scene, [1]: VR scene. m_recordedFrames counts endScene() (main thread, under the scene's mutex), a flush
+    // takes the ended frames under the same mutex and publishes the last one in m_flushedFrames once their commands ran
+    std::atomic<uint64_t>   m_renderEpoch { 0 };
+    uint64_t                m_recordedFrames[2] = {};
+    bool                    m_inScene[2] = {};
+    std::atomic<uint64_t>   m_flushedFrames[2] {};
+    uint64_t                m_flushingFrameVR = 0;  // taken by the first pass of flushVR(), flushed after the second
+    // skinning ring heads at each endScene(), consumed once the frames recorded up to then are flushed (main thread)
+    struct RingMark { uint64_t frames[2]; uint64_t matrices; uint64_t dqs; };
+    std::vector<RingMark>   m_ringMarks;
+    std::vector<hwHShader>  m_retiredShaders;
+    std::vector<hwHAsset>   m_retiredAssets;
+    std::vector<hwHInstance> m_retiredInstances;
+    // SDK assets replaced by a reload or released while instances created from them are still alive (hwInstanceData::aid)
+    std::vector<hwAssetID>  m_releasedAssetIDs;
+
+    // shared memory telemetry (see hwTelemetry.h). the block is swapped by the main thread under m_mutexTelemetry,
+    // which the render thread only try-locks. the rest is render thread only
+    std::mutex              m_mutexTelemetry;
+    hwTelemetryHeader       *m_telemetry = nullptr;
+    std::atomic<bool>       m_telemetryEnabled { false };
+    hwTelemetryFrame        m_telemetryFrame = hwTelemetryFrame();     // accumulated since the last publication
+    uint64_t                m_telemetryLast = 0;    // timestamp of the last publication
+    size_t                  m_telemetryCursor = 0;  // next instance to refresh the stats of
 
     hwConstantBuffer        m_cb;
-
-	// New Stuff from Carlo
-	ID3D11Buffer* m_VB; 
-	ID3D11Buffer* m_CB; 
-	ID3D11VertexShader* m_VertexShader;
-	ID3D11PixelShader* m_PixelShader;
-	ID3D11InputLayout* m_InputLayout;
-	ID3D11RasterizerState* m_RasterState;
-	ID3D11BlendState* m_BlendState;
-	ID3D11DepthStencilState* m_DepthState;
-	ID3D11SamplerState *m_HairShaderSampler;
-	// End new stuff from Carlo 
-
+    hwStats                 m_stats;
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+// every member of hwHairDescriptor (GFSDK_HairInstanceDescriptor) in declaration order. the padding between them is
+// whatever the last member-wise copy left there, so descriptors are compared member by member and never with memcmp.
+// must be updated with the SDK header (hwDescriptorTest checks that no member is missing)
+#define hwEachDescriptorField(X)\
+    X(m_enable) X(m_width) X(m_widthNoise) X(m_widthRootScale) X(m_widthTipScale) X(m_clumpNoise)\
+    X(m_clumpRoundness) X(m_clumpScale) X(m_density) X(m_usePixelDensity) X(m_lengthNoise) X(m_lengthScale)\
+    X(m_waveScale) X(m_waveScaleNoise) X(m_waveScaleClump) X(m_waveScaleStrand) X(m_waveFreq) X(m_waveFreqNoise)\
+    X(m_waveRootStraighten) X(m_rootAlphaFalloff) X(m_rootColor) X(m_tipColor) X(m_rootTipColorWeight)\
+    X(m_rootTipColorFalloff) X(m_diffuseBlend) X(m_hairNormalWeight) X(m_hairNormalBoneIndex) X(m_specularColor)\
+    X(m_specularNoiseScale) X(m_specularEnvScale) X(m_specularPrimary) X(m_specularPowerPrimary)\
+    X(m_specularPrimaryBreakup) X(m_specularSecondary) X(m_specularSecondaryOffset) X(m_specularPowerSecondary)\
+    X(m_glintStrength) X(m_glintCount) X(m_glintExponent) X(m_castShadows) X(m_receiveShadows) X(m_shadowSigma)\
+    X(m_strandBlendMode) X(m_strandBlendScale) X(m_backStopRadius) X(m_bendStiffness) X(m_damping) X(m_gravityDir)\
+    X(m_friction) X(m_massScale) X(m_inertiaScale) X(m_inertiaLimit) X(m_interactionStiffness) X(m_rootStiffness)\
+    X(m_pinStiffness) X(m_simulate) X(m_stiffness) X(m_stiffnessStrength) X(m_stiffnessDamping) X(m_tipStiffness)\
+    X(m_useCollision) X(m_wind) X(m_windNoise) X(m_stiffnessCurve) X(m_stiffnessStrengthCurve)\
+    X(m_stiffnessDampingCurve) X(m_bendStiffnessCurve) X(m_interactionStiffnessCurve) X(m_enableLOD)\
+    X(m_enableDistanceLOD) X(m_distanceLODStart) X(m_distanceLODEnd) X(m_distanceLODFadeStart)\
+    X(m_distanceLODDensity) X(m_distanceLODWidth) X(m_enableDetailLOD) X(m_detailLODStart) X(m_detailLODEnd)\
+    X(m_detailLODDensity) X(m_detailLODWidth) X(m_shadowDensityScale) X(m_useViewfrustrumCulling)\
+    X(m_useBackfaceCulling) X(m_backfaceCullingThreshold) X(m_useCullSphere) X(m_cullSphereInvTransform)\
+    X(m_splineMultiplier) X(m_drawRenderHairs) X(m_visualizeBones) X(m_visualizeBoundingBox) X(m_visualizeCapsules)\
+    X(m_visualizeControlVertices) X(m_visualizeCullSphere) X(m_visualizeFrames) X(m_visualizeGrowthMesh)\
+    X(m_visualizeGuideHairs) X(m_visualizeHairInteractions) X(m_visualizeHairSkips) X(m_visualizeLocalPos)\
+    X(m_visualizePinConstraints) X(m_visualizeShadingNormals) X(m_visualizeShadingNormalBone)\
+    X(m_visualizeSkinnedGuideHairs) X(m_colorizeMode) X(m_textureChannels) X(m_modelToWorld)
+
+// true if all members are bitwise equal
+inline bool hwDescriptorEqual(const hwHairDescriptor &a, const hwHairDescriptor &b)
+{
+#define hwCompareField(m) if (memcmp(&a.m, &b.m, sizeof(a.m)) != 0) { return false; }
+    hwEachDescriptorField(hwCompareField)
+#undef hwCompareField
+    return true;
+}
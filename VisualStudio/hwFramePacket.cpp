@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwFramePacket.h"
+
+// arrays of these are used in place
+static_assert(alignof(hwMatrix) <= 4 && alignof(hwLightData) <= 4 && alignof(hwSkinningBatchEntry) <= 4, "frame packet payloads are only 4 byte aligned");
+
+namespace {
+
+uint64_t hwFPPadded(uint64_t size) { return (size + 3) & ~(uint64_t)3; }
+
+bool hwFPFail(std::string *o_error, const char *fmt, ...)
+{
+    if (o_error) {
+        char buf[256];
+        va_list vl;
+        va_start(vl, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, vl);
+        va_end(vl);
+        *o_error = buf;
+    }
+    return false;
+}
+
+// payload checks of one record. sizes are computed in 64 bit so that no count can wrap them
+bool hwFPValidateRecord(uint32_t index, uint32_t type, const char *p, uint32_t size, uint32_t flags, std::string *o_error)
+{
+    bool vr = (flags & hwFramePacketFlag_VR) != 0;
+    auto expect = [&](uint64_t expected) {
+        return size == expected || hwFPFail(o_error, "record %u (type %u): %u bytes, expected %llu", index, type, size, (unsigned long long)expected);
+    };
+    auto fixed = [&](size_t s) { return size >= s || hwFPFail(o_error, "record %u (type %u): %u bytes, too short", index, type, size); };
+
+    switch (type) {
+    case hwFPRecord_ViewProjection: {
+        if (!expect(sizeof(hwFPViewProjection))) { return false; }
+        if (vr) { return hwFPFail(o_error, "record %u: mono view in a VR packet", index); }
+        hwFPViewProjection r;
+        memcpy(&r, p, sizeof(r));
+        if (r.slot < 0 || r.slot >= hwMaxViews) { return hwFPFail(o_error, "record %u: view slot %d out of range", index, r.slot); }
+        return true;
+    }
+    case hwFPRecord_ViewProjectionStereo:
+        if (!expect(sizeof(hwFPViewProjectionStereo))) { return false; }
+        if (!vr) { return hwFPFail(o_error, "record %u: stereo view in a mono packet", index); }
+        return true;
+    case hwFPRecord_Lights: {
+        if (!fixed(sizeof(hwFPLights))) { return false; }
+        hwFPLights r;
+        memcpy(&r, p, sizeof(r));
+        if (r.num_lights < 0 || r.num_lights > hwMaxLights) { return hwFPFail(o_error, "record %u: %d lights", index, r.num_lights); }
+        return expect(sizeof(hwFPLights) + (uint64_t)sizeof(hwLightData) * r.num_lights);
+    }
+    case hwFPRecord_Shader:
+        return expect(sizeof(hwFPShader));
+    case hwFPRecord_Skinning: {
+        if (!fixed(sizeof(hwFPSkinning))) { return false; }
+        hwFPSkinning r;
+        memcpy(&r, p, sizeof(r));
+        if (r.num_entries < 0 || r.num_matrices < 0) { return hwFPFail(o_error, "record %u: negative skinning counts", index); }
+        if (!expect(sizeof(hwFPSkinning) + (uint64_t)sizeof(hwSkinningBatchEntry) * r.num_entries + (uint64_t)sizeof(hwMatrix) * r.num_matrices)) { return false; }
+        // updateSkinningBatch() trusts the ranges
+        const char *entries = p + sizeof(hwFPSkinning);
+        for (int i = 0; i < r.num_entries; ++i) {
+            hwSkinningBatchEntry e;
+            memcpy(&e, entries + sizeof(e) * i, sizeof(e));
+            if (e.first_bone < 0 || e.num_bones < 0 || (int64_t)e.first_bone + e.num_bones > r.num_matrices) {
+                return hwFPFail(o_error, "record %u: skinning entry %d reads bones [%d, %lld) of %d", index, i,
+                    e.first_bone, (long long)e.first_bone + e.num_bones, r.num_matrices);
+            }
+        }
+        return true;
+    }
+    case hwFPRecord_DescriptorField: {
+        if (!fixed(sizeof(hwFPDescriptorField))) { return false; }
+        hwFPDescriptorField r;
+        memcpy(&r, p, sizeof(r));
+        if (r.offset < 0 || r.size <= 0 || (int64_t)r.offset + r.size > (int64_t)sizeof(hwHairDescriptor)) {
+            return hwFPFail(o_error, "record %u: descriptor range (offset %d, size %d) out of the descriptor", index, r.offset, r.size);
+        }
+        return expect(sizeof(hwFPDescriptorField) + (uint64_t)r.size);
+    }
+    case hwFPRecord_Step:
+        return expect(sizeof(hwFPStep));
+    case hwFPRecord_Draws: {
+        if (!fixed(sizeof(hwFPDraws))) { return false; }
+        hwFPDraws r;
+        memcpy(&r, p, sizeof(r));
+        if (r.num_instances < 0) { return hwFPFail(o_error, "record %u: %d draws", index, r.num_instances); }
+        return expect(sizeof(hwFPDraws) + (uint64_t)sizeof(hwHInstance) * r.num_instances);
+    }
+    default:
+        return hwFPFail(o_error, "record %u: unknown type %u", index, type);
+    }
+}
+
+} // namespace
+
+
+bool hwFramePacketValidate(const void *data, size_t size, std::string *o_error)
+{
+    if (data == nullptr) { return hwFPFail(o_error, "null packet"); }
+    if ((uintptr_t)data % 4 != 0) { return hwFPFail(o_error, "packet not 4 byte aligned"); }
+    if (size < sizeof(hwFramePacketHeader)) { return hwFPFail(o_error, "%llu bytes, shorter than the header", (unsigned long long)size); }
+
+    hwFramePacketHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (h.magic != hwFramePacketMagic) { return hwFPFail(o_error, "bad magic 0x%08x", h.magic); }
+    if (h.version != hwFramePacketVersion) { return hwFPFail(o_error, "version %u, expected %u", h.version, hwFramePacketVersion); }
+    if (h.size != size) { return hwFPFail(o_error, "header says %u bytes, got %llu", h.size, (unsigned long long)size); }
+    if (h.num_records > hwFramePacketMaxRecords) { return hwFPFail(o_error, "%u records", h.num_records); }
+    if (h.flags & ~(uint32_t)(hwFramePacketFlag_VR | hwFramePacketFlag_SinglePassVR)) { return hwFPFail(o_error, "unknown flags 0x%x", h.flags); }
+
+    const char *p = (const char*)data + sizeof(h);
+    const char *end = (const char*)data + size;
+    for (uint32_t i = 0; i < h.num_records; ++i) {
+        if ((size_t)(end - p) < sizeof(hwFramePacketRecord)) { return hwFPFail(o_error, "record %u: truncated header", i); }
+        hwFramePacketRecord r;
+        memcpy(&r, p, sizeof(r));
+        p += sizeof(r);
+        if (hwFPPadded(r.size) > (uint64_t)(end - p)) { return hwFPFail(o_error, "record %u: %u bytes past the end of the packet", i, r.size); }
+        if (!hwFPValidateRecord(i, r.type, p, r.size, h.flags, o_error)) { return false; }
+        p += hwFPPadded(r.size);
+    }
+    if (p != end) { return hwFPFail(o_error, "%llu bytes after the last record", (unsigned long long)(end - p)); }
+    return true;
+}
+
+
+hwFramePacketReader::hwFramePacketReader(const void *data)
+    : m_header((const hwFramePacketHeader*)data)
+    , m_pos((const char*)data + sizeof(hwFramePacketHeader))
+    , m_index(0)
+{
+}
+
+bool hwFramePacketReader::next(uint32_t &o_type, const char *&o_payload, uint32_t &o_size)
+{
+    if (m_index == m_header->num_records) { return false; }
+    hwFramePacketRecord r;
+    memcpy(&r, m_pos, sizeof(r));
+    o_type = r.type;
+    o_size = r.size;
+    o_payload = m_pos + sizeof(r);
+    m_pos = o_payload + hwFPPadded(r.size);
+    ++m_index;
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// binary frame packet of hwSubmitFrame(): what a hwBeginScene() .. hwEndScene() bracket records, in one call.
+// layout: hwFramePacketHeader, then num_records records. a record is a hwFramePacketRecord followed by size bytes of
+// payload and padding to a multiple of 4. little endian, the buffer 4 byte aligned.
+// the whole packet is validated before any of it is applied: a malformed packet is rejected, never half recorded.
+// view records must match the packet: hwFPRecord_ViewProjection in mono packets, hwFPRecord_ViewProjectionStereo in VR.
+// instance / shader handles are not part of the validation, stale ones are skipped like in the individual calls.
+// any layout change must bump hwFramePacketVersion. must match hwi.FramePacket in C#
+
+static const uint32_t hwFramePacketMagic = 0x50465748; // "HWFP"
+static const uint32_t hwFramePacketVersion = 1;
+static const uint32_t hwFramePacketMaxRecords = 1 << 20;
+
+enum hwFramePacketFlags
+{
+    hwFramePacketFlag_VR            = 1,
+    hwFramePacketFlag_SinglePassVR  = 2,
+};
+
+enum hwFramePacketRecordType
+{
+    hwFPRecord_ViewProjection = 1,      // hwFPViewProjection
+    hwFPRecord_ViewProjectionStereo,    // hwFPViewProjectionStereo
+    hwFPRecord_Lights,                  // hwFPLights, hwLightData[num_lights]
+    hwFPRecord_Shader,                  // hwFPShader
+    hwFPRecord_Skinning,                // hwFPSkinning, hwSkinningBatchEntry[num_entries], hwMatrix[num_matrices]
+    hwFPRecord_DescriptorField,         // hwFPDescriptorField, size bytes
+    hwFPRecord_Step,                    // hwFPStep
+    hwFPRecord_Draws,                   // hwFPDraws, hwHInstance[num_instances]
+};
+
+struct hwFramePacketHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          // of the whole packet in bytes
+    uint32_t num_records;
+    uint32_t flags;         // hwFramePacketFlags
+    uint32_t reserved[3];
+};
+
+struct hwFramePacketRecord
+{
+    uint32_t type;          // hwFramePacketRecordType
+    uint32_t size;          // payload bytes, without the padding
+};
+
+struct hwFPViewProjection       { int32_t slot; float fov; hwMatrix view; hwMatrix proj; };
+struct hwFPViewProjectionStereo { float fov; int32_t single_pass; hwMatrix view; hwMatrix proj; hwMatrix view2; hwMatrix proj2; };
+struct hwFPLights               { int32_t num_lights; int32_t pad[3]; };
+struct hwFPShader               { hwHShader shader; };
+struct hwFPSkinning             { int32_t num_entries; int32_t num_matrices; };
+struct hwFPDescriptorField      { hwHInstance instance; int32_t offset; int32_t size; };
+struct hwFPStep                 { float dt; };
+struct hwFPDraws                { int32_t num_instances; int32_t shadow; }; // shadow: hwRenderShadow() instead of hwRender()
+
+// returns false and why in o_error if the packet is malformed
+bool hwFramePacketValidate(const void *data, size_t size, std::string *o_error = nullptr);
+
+// walks the records of a validated packet
+class hwFramePacketReader
+{
+public:
+    hwFramePacketReader(const void *data);
+    const hwFramePacketHeader& header() const { return *m_header; }
+    bool next(uint32_t &o_type, const char *&o_payload, uint32_t &o_size);
+
+private:
+    const hwFramePacketHeader *m_header;
+    const char *m_pos;
+    uint32_t m_index;
+};
@@ -1,13 +1,10 @@
-#pragma once
+﻿#pragma once
 #define hwImpl
 
-using namespace DirectX; // for DirectX Math
-
 #ifdef _WIN32
     #define hwWindows
+    using namespace DirectX; // for DirectX Math
 #endif
 
-void hwLogImpl(const char* fmt, ...);
-#define hwLog(...) hwLogImpl(__VA_ARGS__)
-
 #include "HairWorksIntegration.h"
+#include "hwLog.h"
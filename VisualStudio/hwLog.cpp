@@ -0,0 +1,181 @@
+#include "pch.h"
+#include "hwInternal.h"
+
+namespace {
+
+const int64_t hwLogWindow = 1000000;  // microseconds
+const size_t  hwLogMaxLength = 2048;
+
+struct hwLogRecord
+{
+    std::atomic<uint32_t> seq;
+    hwLogLevel level;
+    char text[512];
+};
+
+// bounded MPSC queue (D. Vyukov's): producers claim a slot with a CAS on head and publish it through its sequence
+// number. when full, records are dropped and counted, producers never wait
+struct hwLogRing
+{
+    static const uint32_t Capacity = 256; // must be power of two
+
+    std::atomic<uint32_t> head;
+    uint32_t tail;                        // consumer only, under g_log_drain_mutex
+    hwLogRecord records[Capacity];
+
+    hwLogRing() : head(0), tail(0)
+    {
+        for (uint32_t i = 0; i < Capacity; ++i) { records[i].seq.store(i, std::memory_order_relaxed); }
+    }
+};
+
+hwLogRing                   g_log_ring;
+std::atomic<int>            g_log_dropped(0);
+std::atomic<int>            g_log_level(hwLogLevel_Info);
+std::atomic<hwLogCallback>  g_log_callback(nullptr);
+std::atomic<hwLogSite*>     g_log_sites(nullptr);   // sites that suppressed records at least once
+std::mutex                  g_log_drain_mutex;
+
+int64_t hwLogNow()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void hwLogPush(hwLogLevel level, const char *text)
+{
+    auto &ring = g_log_ring;
+    uint32_t pos = ring.head.load(std::memory_order_relaxed);
+    hwLogRecord *r;
+    for (;;) {
+        r = &ring.records[pos & (hwLogRing::Capacity - 1)];
+        int32_t diff = (int32_t)(r->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (ring.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+        }
+        else if (diff < 0) {
+            g_log_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            pos = ring.head.load(std::memory_order_relaxed);
+        }
+    }
+    r->level = level;
+    strncpy(r->text, text, sizeof(r->text) - 1);
+    r->text[sizeof(r->text) - 1] = '\0';
+    r->seq.store(pos + 1, std::memory_order_release);
+}
+
+bool hwLogPop(char *dst, size_t size)
+{
+    auto &ring = g_log_ring;
+    auto &r = ring.records[ring.tail & (hwLogRing::Capacity - 1)];
+    if (r.seq.load(std::memory_order_acquire) != ring.tail + 1) { return false; }
+
+    strncpy(dst, r.text, size - 1);
+    dst[size - 1] = '\0';
+    r.seq.store(ring.tail + hwLogRing::Capacity, std::memory_order_release);
+    ++ring.tail;
+    return true;
+}
+
+void hwLogEmit(hwLogLevel level, const char *text)
+{
+#ifdef hwWindows
+    ::OutputDebugStringA(text);
+#else // hwWindows
+    fputs(text, stderr); // keeps stdout to the tools' output
+#endif // hwWindows
+    if (g_log_callback.load(std::memory_order_acquire)) {
+        hwLogPush(level, text);
+    }
+}
+
+void hwLogRegister(hwLogSite &site)
+{
+    if (site.registered.exchange(true, std::memory_order_relaxed)) { return; }
+    site.next = g_log_sites.load(std::memory_order_relaxed);
+    while (!g_log_sites.compare_exchange_weak(site.next, &site, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+// starts a new window if the current one is over and reports what it suppressed
+void hwLogCloseWindow(hwLogSite &site, int64_t now)
+{
+    int64_t begin = site.window_begin.load(std::memory_order_relaxed);
+    if (now - begin < hwLogWindow ||
+        !site.window_begin.compare_exchange_strong(begin, now, std::memory_order_relaxed))
+    {
+        return;
+    }
+    site.count.store(0, std::memory_order_relaxed);
+
+    int suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    if (suppressed > 0) {
+        const char *file = site.file;
+        for (const char *p = site.file; *p; ++p) {
+            if (*p == '/' || *p == '\\') { file = p + 1; }
+        }
+        char buf[256];
+        snprintf(buf, sizeof(buf), "hwLog: the last message of %s(%d) repeated %d times.\n", file, site.line, suppressed);
+        hwLogEmit(hwLogLevel_Info, buf);
+    }
+}
+
+} // namespace
+
+
+void hwLogImpl(hwLogSite &site, hwLogLevel level, const char *fmt, ...)
+{
+    if (level < g_log_level.load(std::memory_order_relaxed)) { return; }
+
+    hwLogCloseWindow(site, hwLogNow());
+    if (site.count.fetch_add(1, std::memory_order_relaxed) >= hwLogBurst) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        hwLogRegister(site);
+        return;
+    }
+
+    char buf[hwLogMaxLength];
+    va_list vl;
+    va_start(vl, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, vl);
+    va_end(vl);
+    hwLogEmit(level, buf);
+}
+
+void hwLogSetLevel(hwLogLevel level)
+{
+    g_log_level.store(level, std::memory_order_relaxed);
+}
+
+void hwLogSetCallback(hwLogCallback cb)
+{
+    g_log_callback.store(cb, std::memory_order_release);
+}
+
+// returns the number of records passed to the callback. records left while no callback was set are discarded
+int hwLogDrain()
+{
+    std::unique_lock<std::mutex> lock(g_log_drain_mutex);
+
+    // suppressed counts of sites that went quiet would otherwise wait for their next record
+    int64_t now = hwLogNow();
+    for (auto *s = g_log_sites.load(std::memory_order_acquire); s; s = s->next) {
+        if (s->suppressed.load(std::memory_order_relaxed) > 0) { hwLogCloseWindow(*s, now); }
+    }
+
+    auto cb = g_log_callback.load(std::memory_order_acquire);
+    int dropped = g_log_dropped.exchange(0, std::memory_order_relaxed);
+    int n = 0;
+    char text[sizeof(hwLogRecord::text)];
+    while (hwLogPop(text, sizeof(text))) {
+        if (cb) { cb(text); ++n; }
+    }
+    if (cb && dropped > 0) {
+        snprintf(text, sizeof(text), "hwLog: %d records dropped, hwDrainLog() was not called often enough.\n", dropped);
+        cb(text);
+        ++n;
+    }
+    return n;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// log records. hwLog() and friends can be called from any thread: the message goes to the debugger (stderr off Windows)
+// right away and, when a callback is set, into a lock-free ring that hwLogDrain() empties into the callback on the
+// caller's thread (the main thread via hwDrainLog()). the render thread never calls into managed code.
+// each call site passes at most hwLogBurst records per second. the others are counted and reported as one
+// "repeated N times" record when the site logs after the window or at the next drain.
+
+enum hwLogLevel
+{
+    hwLogLevel_Debug,
+    hwLogLevel_Info,
+    hwLogLevel_Warning,
+    hwLogLevel_Error,
+};
+
+static const int hwLogBurst = 4;
+
+// one per hwLog() call site. constant initialized, registered in the drain list only once it suppresses something
+struct hwLogSite
+{
+    const char *file;
+    int line;
+    std::atomic<int64_t> window_begin;  // microseconds
+    std::atomic<int> count;             // records in the current window
+    std::atomic<int> suppressed;
+    std::atomic<bool> registered;
+    hwLogSite *next;
+
+    constexpr hwLogSite(const char *f, int l)
+        : file(f), line(l), window_begin(INT64_MIN / 2), count(0), suppressed(0), registered(false), next(nullptr) {}
+};
+
+void hwLogImpl(hwLogSite &site, hwLogLevel level, const char *fmt, ...);
+void hwLogSetLevel(hwLogLevel level);
+void hwLogSetCallback(hwLogCallback cb);
+int  hwLogDrain();
+
+#define hwLogAt(Level, ...) do { static hwLogSite hwLogSite_(__FILE__, __LINE__); hwLogImpl(hwLogSite_, Level, __VA_ARGS__); } while (0)
+#define hwLog(...)          hwLogAt(hwLogLevel_Info, __VA_ARGS__)
+#define hwLogWarning(...)   hwLogAt(hwLogLevel_Warning, __VA_ARGS__)
+#define hwLogError(...)     hwLogAt(hwLogLevel_Error, __VA_ARGS__)
@@ -0,0 +1,115 @@
+#pragma once
+
+// small math helpers used by hwContext.
+// matrices are row-major with row vector convention (p' = p * M), same as gfsdk_float4x4 and D3D.
+
+inline const float* hwMatrixData(const hwMatrix &m) { return &m._11; }
+inline float*       hwMatrixData(hwMatrix &m)       { return &m._11; }
+
+inline hwMatrix hwMatrixMul(const hwMatrix &a_, const hwMatrix &b_)
+{
+    const float *a = hwMatrixData(a_);
+    const float *b = hwMatrixData(b_);
+    hwMatrix ret;
+    float *r = hwMatrixData(ret);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            r[i * 4 + j] = a[i * 4 + 0] * b[0 * 4 + j] + a[i * 4 + 1] * b[1 * 4 + j] + a[i * 4 + 2] * b[2 * 4 + j] + a[i * 4 + 3] * b[3 * 4 + j];
+        }
+    }
+    return ret;
+}
+
+// general 4x4 inverse (cofactors). returns false and leaves o untouched if m is singular
+inline bool hwMatrixInverse(hwMatrix &o_, const hwMatrix &m_)
+{
+    const float *m = hwMatrixData(m_);
+    float inv[16];
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+    inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+    inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+    inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0f) { return false; }
+
+    float *o = hwMatrixData(o_);
+    float rdet = 1.0f / det;
+    for (int i = 0; i < 16; ++i) { o[i] = inv[i] * rdet; }
+    return true;
+}
+
+// camera position of a view matrix (rigid transform, p * view)
+inline hwFloat3 hwViewPosition(const hwMatrix &view)
+{
+    const float *m = hwMatrixData(view);
+    // view = [R 0; t 1] -> position = -t * transpose(R)
+    hwFloat3 r;
+    r.x = -(m[12] * m[0] + m[13] * m[1] + m[14] * m[2]);
+    r.y = -(m[12] * m[4] + m[13] * m[5] + m[14] * m[6]);
+    r.z = -(m[12] * m[8] + m[13] * m[9] + m[14] * m[10]);
+    return r;
+}
+
+inline float hwDistanceSqToAABB(const hwFloat3 &p, const hwFloat3 &bmin, const hwFloat3 &bmax)
+{
+    float dx = std::max(std::max(bmin.x - p.x, p.x - bmax.x), 0.0f);
+    float dy = std::max(std::max(bmin.y - p.y, p.y - bmax.y), 0.0f);
+    float dz = std::max(std::max(bmin.z - p.z, p.z - bmax.z), 0.0f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+
+// plane: dot(xyz, p) + w >= 0 means inside
+struct hwFrustum
+{
+    hwFloat4 planes[6];
+};
+
+inline void hwFrustumFromViewProj(hwFrustum &o, const hwMatrix &view, const hwMatrix &proj)
+{
+    hwMatrix vp = hwMatrixMul(view, proj);
+    const float *m = hwMatrixData(vp);
+    auto col = [&](int c, float s, int c2) {
+        // column c + s * column c2
+        hwFloat4 r = {
+            m[0 * 4 + c] + s * m[0 * 4 + c2],
+            m[1 * 4 + c] + s * m[1 * 4 + c2],
+            m[2 * 4 + c] + s * m[2 * 4 + c2],
+            m[3 * 4 + c] + s * m[3 * 4 + c2],
+        };
+        return r;
+    };
+    o.planes[0] = col(3,  1.0f, 0); // left
+    o.planes[1] = col(3, -1.0f, 0); // right
+    o.planes[2] = col(3,  1.0f, 1); // bottom
+    o.planes[3] = col(3, -1.0f, 1); // top
+    o.planes[4] = col(2,  0.0f, 2); // near (D3D clip space: 0 <= z)
+    o.planes[5] = col(3, -1.0f, 2); // far  (z <= w)
+}
+
+inline bool hwFrustumIntersectAABB(const hwFrustum &f, const hwFloat3 &bmin, const hwFloat3 &bmax)
+{
+    for (const auto &p : f.planes) {
+        // test the corner furthest along the plane normal
+        float x = p.x >= 0.0f ? bmax.x : bmin.x;
+        float y = p.y >= 0.0f ? bmax.y : bmin.y;
+        float z = p.z >= 0.0f ? bmax.z : bmin.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+// the bits of graphics state hwContext sets itself. everything else (hair buffers, draw calls) goes through GFSDK_HairSDK.
+// hwRenderDeviceD3D11 is the real thing (Windows only). hwRenderDeviceNull records the calls instead of issuing them,
+// so the command / handle / scheduling core can run without a GPU (non-Windows builds, benchmarks).
+// create / release calls may come from any thread, the rest only from the render thread.
+
+struct hwPixelShader; // opaque. ID3D11PixelShader on the D3D11 device
+
+struct hwViewport
+{
+    float x, y, width, height;
+    float min_depth, max_depth;
+};
+
+class hwRenderDevice
+{
+public:
+    virtual ~hwRenderDevice() {}
+    virtual const char* getName() const = 0;
+
+    // handed to GFSDK_HairSDK::InitRenderResources() / SetCurrentContext(). null on the null device
+    virtual ID3D11Device*        getNativeDevice() = 0;
+    virtual ID3D11DeviceContext* getNativeContext() = 0;
+
+    virtual hwPixelShader*  createPixelShader(const void *bin, size_t size) = 0;
+    virtual void            releasePixelShader(hwPixelShader *ps) = 0;
+    virtual void            setPixelShader(hwPixelShader *ps) = 0; // null unbinds
+
+    // write-discard map of the device's dynamic constant buffer (grown to size when needed).
+    // unmapConstantBuffer() binds it to the pixel shader slot
+    virtual void*   mapConstantBuffer(size_t size) = 0;
+    virtual void    unmapConstantBuffer(int slot) = 0;
+
+    virtual void    setShaderResources(int slot, int num, hwSRV *const *srvs) = 0;
+    virtual void    setLinearClampSampler(int slot) = 0;
+    virtual void    setDepthTest() = 0; // GREATER_EQUAL (reversed z) with depth writes
+    virtual bool    getViewport(hwViewport &o) = 0;
+    virtual void    setViewport(const hwViewport &v) = 0;
+
+    virtual hwSRV*  createSRV(hwTexture *tex) = 0;
+    virtual hwRTV*  createRTV(hwTexture *tex) = 0;
+    virtual void    releaseSRV(hwSRV *srv) = 0;
+    virtual void    releaseRTV(hwRTV *rtv) = 0;
+};
+
+
+enum hwRenderOp
+{
+    hwRenderOp_CreatePixelShader,
+    hwRenderOp_ReleasePixelShader,
+    hwRenderOp_SetPixelShader,
+    hwRenderOp_SetConstantBuffer,
+    hwRenderOp_SetShaderResources,
+    hwRenderOp_SetSampler,
+    hwRenderOp_SetDepthTest,
+    hwRenderOp_SetViewport,
+    hwRenderOp_CreateView,
+    hwRenderOp_ReleaseView,
+    hwRenderOp_Count,
+};
+
+struct hwRenderOpRecord
+{
+    hwRenderOp op;
+    int slot;
+    int num;    // resource count for SetShaderResources, byte size for SetConstantBuffer / CreatePixelShader
+};
+
+class hwRenderDeviceNull : public hwRenderDevice
+{
+public:
+    hwRenderDeviceNull();
+    ~hwRenderDeviceNull() override;
+    const char* getName() const override;
+
+    ID3D11Device*        getNativeDevice() override;
+    ID3D11DeviceContext* getNativeContext() override;
+
+    hwPixelShader*  createPixelShader(const void *bin, size_t size) override;
+    void            releasePixelShader(hwPixelShader *ps) override;
+    void            setPixelShader(hwPixelShader *ps) override;
+    void*           mapConstantBuffer(size_t size) override;
+    void            unmapConstantBuffer(int slot) override;
+    void            setShaderResources(int slot, int num, hwSRV *const *srvs) override;
+    void            setLinearClampSampler(int slot) override;
+    void            setDepthTest() override;
+    bool            getViewport(hwViewport &o) override;
+    void            setViewport(const hwViewport &v) override;
+    hwSRV*          createSRV(hwTexture *tex) override;
+    hwRTV*          createRTV(hwTexture *tex) override;
+    void            releaseSRV(hwSRV *srv) override;
+    void            releaseRTV(hwRTV *rtv) override;
+
+    // per op call counts are always kept. the op log only while recording
+    void setRecording(bool v);
+    void clearRecords();
+    const std::vector<hwRenderOpRecord>& getRecords() const;
+    int64_t getCount(hwRenderOp op) const;
+    int64_t getConstantBufferBytes() const;
+    int     getNumLiveObjects() const;   // shaders and views not released yet
+
+private:
+    void record(hwRenderOp op, int slot, int num);
+
+    std::atomic<int64_t>            m_counts[hwRenderOp_Count];
+    std::atomic<int64_t>            m_cb_bytes;
+    std::atomic<int>                m_live_objects;
+    std::vector<char>               m_cb;
+    size_t                          m_cb_size;
+    hwViewport                      m_viewport;
+    bool                            m_recording;
+    std::mutex                      m_mutex_records;
+    std::vector<hwRenderOpRecord>   m_records;
+};
+
+hwRenderDevice* hwCreateRenderDeviceNull();
+#ifdef hwWindows
+hwRenderDevice* hwCreateRenderDeviceD3D11(ID3D11Device *dev);
+#endif // hwWindows
+
+// hwCreateRenderDeviceD3D11() on Windows (null when dev is null), hwCreateRenderDeviceNull() elsewhere
+hwRenderDevice* hwCreateRenderDevice(hwDevice *dev);
@@ -0,0 +1,212 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwRenderDevice.h"
+
+#ifdef hwWindows
+
+class hwRenderDeviceD3D11 : public hwRenderDevice
+{
+public:
+    hwRenderDeviceD3D11(ID3D11Device *dev);
+    ~hwRenderDeviceD3D11() override;
+    const char* getName() const override;
+
+    ID3D11Device*        getNativeDevice() override;
+    ID3D11DeviceContext* getNativeContext() override;
+
+    hwPixelShader*  createPixelShader(const void *bin, size_t size) override;
+    void            releasePixelShader(hwPixelShader *ps) override;
+    void            setPixelShader(hwPixelShader *ps) override;
+    void*           mapConstantBuffer(size_t size) override;
+    void            unmapConstantBuffer(int slot) override;
+    void            setShaderResources(int slot, int num, hwSRV *const *srvs) override;
+    void            setLinearClampSampler(int slot) override;
+    void            setDepthTest() override;
+    bool            getViewport(hwViewport &o) override;
+    void            setViewport(const hwViewport &v) override;
+    hwSRV*          createSRV(hwTexture *tex) override;
+    hwRTV*          createRTV(hwTexture *tex) override;
+    void            releaseSRV(hwSRV *srv) override;
+    void            releaseRTV(hwRTV *rtv) override;
+
+private:
+    ID3D11Device            *m_d3ddev;
+    ID3D11DeviceContext     *m_d3dctx;
+    ID3D11DepthStencilState *m_rs_enable_depth;
+    ID3D11SamplerState      *m_sampler_linear;
+    ID3D11Buffer            *m_constant_buffer;
+    UINT                    m_constant_buffer_size;
+};
+
+
+hwRenderDeviceD3D11::hwRenderDeviceD3D11(ID3D11Device *dev)
+    : m_d3ddev(dev)
+    , m_d3dctx(nullptr)
+    , m_rs_enable_depth(nullptr)
+    , m_sampler_linear(nullptr)
+    , m_constant_buffer(nullptr)
+    , m_constant_buffer_size(0)
+{
+    m_d3ddev->GetImmediateContext(&m_d3dctx);
+
+	// set the Z mode here
+	CD3D11_DEPTH_STENCIL_DESC depthDesc;
+	depthDesc.DepthEnable		= true;
+	depthDesc.DepthWriteMask	= D3D11_DEPTH_WRITE_MASK_ALL;
+	depthDesc.DepthFunc			= D3D11_COMPARISON_GREATER_EQUAL;
+	depthDesc.StencilEnable		= false;
+	m_d3ddev->CreateDepthStencilState(&depthDesc, &m_rs_enable_depth);
+
+	// texture sampler for root / tip color in the hair shader
+	D3D11_SAMPLER_DESC samplerDesc[1] = {
+		D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT,
+		D3D11_TEXTURE_ADDRESS_CLAMP,
+		D3D11_TEXTURE_ADDRESS_CLAMP,
+		D3D11_TEXTURE_ADDRESS_CLAMP,
+		0.0, 0, D3D11_COMPARISON_NEVER, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, D3D11_FLOAT32_MAX,
+	};
+	m_d3ddev->CreateSamplerState(samplerDesc, &m_sampler_linear);
+}
+
+hwRenderDeviceD3D11::~hwRenderDeviceD3D11()
+{
+    if (m_constant_buffer) { m_constant_buffer->Release(); }
+    if (m_sampler_linear) { m_sampler_linear->Release(); }
+    if (m_rs_enable_depth) { m_rs_enable_depth->Release(); }
+    if (m_d3dctx) { m_d3dctx->Release(); }
+}
+
+const char* hwRenderDeviceD3D11::getName() const { return "D3D11"; }
+
+ID3D11Device*        hwRenderDeviceD3D11::getNativeDevice()  { return m_d3ddev; }
+ID3D11DeviceContext* hwRenderDeviceD3D11::getNativeContext() { return m_d3dctx; }
+
+hwPixelShader* hwRenderDeviceD3D11::createPixelShader(const void *bin, size_t size)
+{
+    ID3D11PixelShader *ret = nullptr;
+    if (FAILED(m_d3ddev->CreatePixelShader(bin, size, nullptr, &ret))) {
+        return nullptr;
+    }
+    return (hwPixelShader*)ret;
+}
+
+void hwRenderDeviceD3D11::releasePixelShader(hwPixelShader *ps)
+{
+    if (ps) { ((ID3D11PixelShader*)ps)->Release(); }
+}
+
+void hwRenderDeviceD3D11::setPixelShader(hwPixelShader *ps)
+{
+    m_d3dctx->PSSetShader((ID3D11PixelShader*)ps, nullptr, 0);
+}
+
+void* hwRenderDeviceD3D11::mapConstantBuffer(size_t size)
+{
+    // constant buffers must be multiple of 16 bytes
+    UINT aligned = (UINT)((size + 15) & ~(size_t)15);
+    if (aligned > m_constant_buffer_size) {
+        if (m_constant_buffer) {
+            m_constant_buffer->Release();
+            m_constant_buffer = nullptr;
+        }
+
+        D3D11_BUFFER_DESC bufferDesc;
+        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        bufferDesc.ByteWidth = aligned;
+        bufferDesc.StructureByteStride = 0;
+        bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        bufferDesc.MiscFlags = 0;
+        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(m_d3ddev->CreateBuffer(&bufferDesc, 0, &m_constant_buffer))) {
+            m_constant_buffer_size = 0;
+            return nullptr;
+        }
+        m_constant_buffer_size = aligned;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(m_d3dctx->Map(m_constant_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+        return nullptr;
+    }
+    return mapped.pData;
+}
+
+void hwRenderDeviceD3D11::unmapConstantBuffer(int slot)
+{
+    m_d3dctx->Unmap(m_constant_buffer, 0);
+    m_d3dctx->PSSetConstantBuffers(slot, 1, &m_constant_buffer);
+}
+
+void hwRenderDeviceD3D11::setShaderResources(int slot, int num, hwSRV *const *srvs)
+{
+    m_d3dctx->PSSetShaderResources(slot, num, srvs);
+}
+
+void hwRenderDeviceD3D11::setLinearClampSampler(int slot)
+{
+    m_d3dctx->PSSetSamplers(slot, 1, &m_sampler_linear);
+}
+
+void hwRenderDeviceD3D11::setDepthTest()
+{
+    m_d3dctx->OMSetDepthStencilState(m_rs_enable_depth, 0);
+}
+
+bool hwRenderDeviceD3D11::getViewport(hwViewport &o)
+{
+    UINT num = 1;
+    D3D11_VIEWPORT vp;
+    m_d3dctx->RSGetViewports(&num, &vp);
+    if (num == 0) { return false; }
+
+    o = { vp.TopLeftX, vp.TopLeftY, vp.Width, vp.Height, vp.MinDepth, vp.MaxDepth };
+    return true;
+}
+
+void hwRenderDeviceD3D11::setViewport(const hwViewport &v)
+{
+    D3D11_VIEWPORT vp;
+    vp.TopLeftX = v.x;
+    vp.TopLeftY = v.y;
+    vp.Width    = v.width;
+    vp.Height   = v.height;
+    vp.MinDepth = v.min_depth;
+    vp.MaxDepth = v.max_depth;
+    m_d3dctx->RSSetViewports(1, &vp);
+}
+
+hwSRV* hwRenderDeviceD3D11::createSRV(hwTexture *tex)
+{
+    hwSRV *ret = nullptr;
+    if (FAILED(m_d3ddev->CreateShaderResourceView(tex, nullptr, &ret))) {
+        return nullptr;
+    }
+    return ret;
+}
+
+hwRTV* hwRenderDeviceD3D11::createRTV(hwTexture *tex)
+{
+    hwRTV *ret = nullptr;
+    if (FAILED(m_d3ddev->CreateRenderTargetView(tex, nullptr, &ret))) {
+        return nullptr;
+    }
+    return ret;
+}
+
+void hwRenderDeviceD3D11::releaseSRV(hwSRV *srv)
+{
+    if (srv) { srv->Release(); }
+}
+
+void hwRenderDeviceD3D11::releaseRTV(hwRTV *rtv)
+{
+    if (rtv) { rtv->Release(); }
+}
+
+
+hwRenderDevice* hwCreateRenderDeviceD3D11(ID3D11Device *dev)
+{
+    return dev ? new hwRenderDeviceD3D11(dev) : nullptr;
+}
+
+#endif // hwWindows
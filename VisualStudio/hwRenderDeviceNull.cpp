@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwRenderDevice.h"
+
+namespace {
+
+// stands in for shaders and views. only its address and lifetime matter
+struct hwNullObject
+{
+    hwRenderOp created_by;
+    hwTexture *texture;
+};
+
+} // namespace
+
+hwRenderDeviceNull::hwRenderDeviceNull()
+    : m_cb_bytes(0)
+    , m_live_objects(0)
+    , m_cb_size(0)
+    , m_recording(false)
+{
+    for (auto &c : m_counts) { c = 0; }
+    m_viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+}
+
+hwRenderDeviceNull::~hwRenderDeviceNull()
+{
+    if (m_live_objects > 0) {
+        hwLog("hwRenderDeviceNull: %d objects leaked.\n", m_live_objects.load());
+    }
+}
+
+const char* hwRenderDeviceNull::getName() const { return "Null"; }
+
+ID3D11Device*        hwRenderDeviceNull::getNativeDevice()  { return nullptr; }
+ID3D11DeviceContext* hwRenderDeviceNull::getNativeContext() { return nullptr; }
+
+void hwRenderDeviceNull::record(hwRenderOp op, int slot, int num)
+{
+    m_counts[op].fetch_add(1, std::memory_order_relaxed);
+    if (m_recording) {
+        std::unique_lock<std::mutex> lock(m_mutex_records);
+        m_records.push_back({ op, slot, num });
+    }
+}
+
+hwPixelShader* hwRenderDeviceNull::createPixelShader(const void *bin, size_t size)
+{
+    if (bin == nullptr || size == 0) { return nullptr; }
+    record(hwRenderOp_CreatePixelShader, 0, (int)size);
+    ++m_live_objects;
+    return (hwPixelShader*)new hwNullObject{ hwRenderOp_CreatePixelShader, nullptr };
+}
+
+void hwRenderDeviceNull::releasePixelShader(hwPixelShader *ps)
+{
+    if (!ps) { return; }
+    record(hwRenderOp_ReleasePixelShader, 0, 0);
+    --m_live_objects;
+    delete (hwNullObject*)ps;
+}
+
+void hwRenderDeviceNull::setPixelShader(hwPixelShader *ps)
+{
+    record(hwRenderOp_SetPixelShader, 0, ps ? 1 : 0);
+}
+
+void* hwRenderDeviceNull::mapConstantBuffer(size_t size)
+{
+    if (m_cb.size() < size) { m_cb.resize(size); }
+    m_cb_size = size;
+    return m_cb.data();
+}
+
+void hwRenderDeviceNull::unmapConstantBuffer(int slot)
+{
+    record(hwRenderOp_SetConstantBuffer, slot, (int)m_cb_size);
+    m_cb_bytes.fetch_add(m_cb_size, std::memory_order_relaxed);
+}
+
+void hwRenderDeviceNull::setShaderResources(int slot, int num, hwSRV *const * /*srvs*/)
+{
+    record(hwRenderOp_SetShaderResources, slot, num);
+}
+
+void hwRenderDeviceNull::setLinearClampSampler(int slot)
+{
+    record(hwRenderOp_SetSampler, slot, 1);
+}
+
+void hwRenderDeviceNull::setDepthTest()
+{
+    record(hwRenderOp_SetDepthTest, 0, 0);
+}
+
+bool hwRenderDeviceNull::getViewport(hwViewport &o)
+{
+    o = m_viewport;
+    return true;
+}
+
+void hwRenderDeviceNull::setViewport(const hwViewport &v)
+{
+    record(hwRenderOp_SetViewport, 0, 1);
+    m_viewport = v;
+}
+
+hwSRV* hwRenderDeviceNull::createSRV(hwTexture *tex)
+{
+    if (!tex) { return nullptr; }
+    record(hwRenderOp_CreateView, 0, 1);
+    ++m_live_objects;
+    return (hwSRV*)new hwNullObject{ hwRenderOp_CreateView, tex };
+}
+
+hwRTV* hwRenderDeviceNull::createRTV(hwTexture *tex)
+{
+    if (!tex) { return nullptr; }
+    record(hwRenderOp_CreateView, 0, 1);
+    ++m_live_objects;
+    return (hwRTV*)new hwNullObject{ hwRenderOp_CreateView, tex };
+}
+
+void hwRenderDeviceNull::releaseSRV(hwSRV *srv)
+{
+    if (!srv) { return; }
+    record(hwRenderOp_ReleaseView, 0, 1);
+    --m_live_objects;
+    delete (hwNullObject*)srv;
+}
+
+void hwRenderDeviceNull::releaseRTV(hwRTV *rtv)
+{
+    if (!rtv) { return; }
+    record(hwRenderOp_ReleaseView, 0, 1);
+    --m_live_objects;
+    delete (hwNullObject*)rtv;
+}
+
+void hwRenderDeviceNull::setRecording(bool v)
+{
+    m_recording = v;
+}
+
+void hwRenderDeviceNull::clearRecords()
+{
+    std::unique_lock<std::mutex> lock(m_mutex_records);
+    m_records.clear();
+}
+
+const std::vector<hwRenderOpRecord>& hwRenderDeviceNull::getRecords() const
+{
+    return m_records;
+}
+
+int64_t hwRenderDeviceNull::getCount(hwRenderOp op) const
+{
+    return m_counts[op].load(std::memory_order_relaxed);
+}
+
+int64_t hwRenderDeviceNull::getConstantBufferBytes() const
+{
+    return m_cb_bytes.load(std::memory_order_relaxed);
+}
+
+int hwRenderDeviceNull::getNumLiveObjects() const
+{
+    return m_live_objects;
+}
+
+hwRenderDevice* hwCreateRenderDeviceNull()
+{
+    return new hwRenderDeviceNull();
+}
@@ -0,0 +1,253 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwContext.h"
+#include "hwShading.h"
+#include <emmintrin.h>
+
+// only the cbuffer layout is needed. the shading functions in this header are HLSL only
+#define _CPP
+#include "GFSDK_HairWorks_ShaderCommon.h"
+
+static_assert(sizeof(GFSDK_Hair_ConstantBuffer) <= sizeof(GFSDK_HairShaderConstantBuffer), "hair constant buffer layout mismatch");
+
+void hwHairShadingMaterialFromConstantBuffer(hwHairShadingMaterial &o, const GFSDK_HairShaderConstantBuffer &cb)
+{
+    const auto &m = ((const GFSDK_Hair_ConstantBuffer&)cb).defaultMaterial;
+    o.specular_color    = { m.specularColor.x, m.specularColor.y, m.specularColor.z };
+    o.diffuse_blend     = m.diffuseBlend;
+    o.primary_scale     = m.specularPrimaryScale;
+    o.primary_power     = m.specularPrimaryPower;
+    o.secondary_scale   = m.specularSecondaryScale;
+    o.secondary_power   = m.specularSecondaryPower;
+    o.secondary_offset  = m.specularSecondaryOffset;
+}
+
+
+namespace {
+
+// samples [begin, end). same operations in the same order as DefaultHairShader.hlsl.
+// spot lights are not handled by the shader either (HairLight.cs sends them as point lights)
+void hwShadeHairRange(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o, int begin, int end)
+{
+    auto clamp1 = [](float v) { return std::min(std::max(v, -1.0f), 1.0f); };
+
+    for (int i = begin; i < end; ++i) {
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+        for (int li = 0; li < num_lights; ++li) {
+            const auto &l = lights[li];
+
+            float lx, ly, lz;
+            float atten = 1.0f;
+            if (l.type == hwELightType_Directional) {
+                lx = l.direction.x; ly = l.direction.y; lz = l.direction.z;
+            }
+            else if (l.type == hwELightType_Point) {
+                float range = l.position.w;
+                float dx = l.position.x - s.px[i], dy = l.position.y - s.py[i], dz = l.position.z - s.pz[i];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                float rcp = d2 > 0.0f ? 1.0f / std::sqrt(d2) : 0.0f;
+                lx = dx * rcp; ly = dy * rcp; lz = dz * rcp;
+                atten = std::max(1.0f - d2 / (range * range), 0.0f);
+            }
+            else {
+                continue;
+            }
+
+            // diffuse
+            float TdotL = clamp1(s.tx[i] * lx + s.ty[i] * ly + s.tz[i] * lz);
+            float diffuse_skin = std::max(0.0f, s.nx[i] * lx + s.ny[i] * ly + s.nz[i] * lz);
+            float diffuse_hair = std::sqrt(1.0f - TdotL * TdotL);
+            float diffuse = diffuse_hair + (diffuse_skin - diffuse_hair) * mat.diffuse_blend;
+
+            // primary specular
+            float hx = s.vx[i] + lx, hy = s.vy[i] + ly, hz = s.vz[i] + lz;
+            float h2 = hx * hx + hy * hy + hz * hz;
+            float hrcp = h2 > 0.0f ? 1.0f / std::sqrt(h2) : 0.0f;
+            float TdotH = clamp1((s.tx[i] * hx + s.ty[i] * hy + s.tz[i] * hz) * hrcp);
+            float spec_primary = std::pow(std::max(0.0f, std::sqrt(1.0f - TdotH * TdotH)), mat.primary_power);
+
+            // secondary
+            TdotH = clamp1(TdotH + mat.secondary_offset);
+            float spec_secondary = std::pow(std::max(0.0f, std::sqrt(1.0f - TdotH * TdotH)), mat.secondary_power);
+
+            float specular = mat.primary_scale * spec_primary + mat.secondary_scale * spec_secondary;
+
+            r += (diffuse * (l.color.x * s.cr[i]) + specular * (l.color.x * mat.specular_color.x)) * atten;
+            g += (diffuse * (l.color.y * s.cg[i]) + specular * (l.color.y * mat.specular_color.y)) * atten;
+            b += (diffuse * (l.color.z * s.cb[i]) + specular * (l.color.z * mat.specular_color.z)) * atten;
+        }
+        o.r[i] = r;
+        o.g[i] = g;
+        o.b[i] = b;
+    }
+}
+
+inline __m128 hwSelect(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 hwClamp1(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+// 1 / sqrt(v) with one Newton step (~23 bits), 0 where v is 0
+inline __m128 hwRsqrt(__m128 v)
+{
+    __m128 e = _mm_rsqrt_ps(v);
+    e = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), e), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(v, e), e)));
+    return _mm_and_ps(e, _mm_cmpgt_ps(v, _mm_setzero_ps()));
+}
+
+// natural log of x > 0 (Cephes logf)
+inline __m128 hwLn(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    x = _mm_max_ps(x, _mm_set1_ps(1.17549435e-38f)); // no denormals
+
+    __m128i xi = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(xi, 23), _mm_set1_epi32(126)));
+    // mantissa in [0.5, 1)
+    x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+
+    // shift to [sqrt(0.5), sqrt(2)) - 1
+    __m128 small = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+    e = _mm_sub_ps(e, _mm_and_ps(one, small));
+    x = _mm_sub_ps(_mm_add_ps(x, _mm_and_ps(x, small)), one);
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(7.0376836292e-2f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174e-1f));
+    y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    x = _mm_add_ps(x, y);
+    return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+}
+
+// e^x (Cephes expf)
+inline __m128 hwExp(__m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.3f));
+
+    // x = n * ln2 + r, |r| <= ln2 / 2
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, fx), _mm_set1_ps(1.0f))); // floor
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.0f));
+
+    // * 2^n
+    __m128i n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(n));
+}
+
+// pow(x, p) for x >= 0. pow(0, p) is 0, or 1 when p is 0.
+// results below e^-80 are flushed to 0: high specular powers underflow a lot, and denormals are very slow to compute with
+inline __m128 hwPow(__m128 x, float p)
+{
+    __m128 e = _mm_mul_ps(hwLn(x), _mm_set1_ps(p));
+    __m128 r = _mm_and_ps(hwExp(e), _mm_cmpgt_ps(e, _mm_set1_ps(-80.0f)));
+    return hwSelect(_mm_cmpgt_ps(x, _mm_setzero_ps()), r, _mm_set1_ps(p == 0.0f ? 1.0f : 0.0f));
+}
+
+} // namespace
+
+void hwShadeHairScalar(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o)
+{
+    hwShadeHairRange(s, mat, lights, num_lights, o, 0, s.num);
+}
+
+void hwShadeHairSSE(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 blend = _mm_set1_ps(mat.diffuse_blend);
+    const __m128 primary_scale = _mm_set1_ps(mat.primary_scale);
+    const __m128 secondary_scale = _mm_set1_ps(mat.secondary_scale);
+    const __m128 secondary_offset = _mm_set1_ps(mat.secondary_offset);
+
+    int num4 = s.num & ~3;
+    for (int i = 0; i < num4; i += 4) {
+        __m128 px = _mm_loadu_ps(s.px + i), py = _mm_loadu_ps(s.py + i), pz = _mm_loadu_ps(s.pz + i);
+        __m128 tx = _mm_loadu_ps(s.tx + i), ty = _mm_loadu_ps(s.ty + i), tz = _mm_loadu_ps(s.tz + i);
+        __m128 nx = _mm_loadu_ps(s.nx + i), ny = _mm_loadu_ps(s.ny + i), nz = _mm_loadu_ps(s.nz + i);
+        __m128 vx = _mm_loadu_ps(s.vx + i), vy = _mm_loadu_ps(s.vy + i), vz = _mm_loadu_ps(s.vz + i);
+        __m128 r = zero, g = zero, b = zero;
+
+        for (int li = 0; li < num_lights; ++li) {
+            const auto &l = lights[li];
+
+            __m128 lx, ly, lz;
+            __m128 atten = one;
+            if (l.type == hwELightType_Directional) {
+                lx = _mm_set1_ps(l.direction.x); ly = _mm_set1_ps(l.direction.y); lz = _mm_set1_ps(l.direction.z);
+            }
+            else if (l.type == hwELightType_Point) {
+                __m128 dx = _mm_sub_ps(_mm_set1_ps(l.position.x), px);
+                __m128 dy = _mm_sub_ps(_mm_set1_ps(l.position.y), py);
+                __m128 dz = _mm_sub_ps(_mm_set1_ps(l.position.z), pz);
+                __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 rcp = hwRsqrt(d2);
+                lx = _mm_mul_ps(dx, rcp); ly = _mm_mul_ps(dy, rcp); lz = _mm_mul_ps(dz, rcp);
+                atten = _mm_max_ps(_mm_sub_ps(one, _mm_div_ps(d2, _mm_set1_ps(l.position.w * l.position.w))), zero);
+            }
+            else {
+                continue;
+            }
+
+            // diffuse
+            __m128 TdotL = hwClamp1(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, lx), _mm_mul_ps(ty, ly)), _mm_mul_ps(tz, lz)));
+            __m128 diffuse_skin = _mm_max_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz)));
+            __m128 diffuse_hair = _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(TdotL, TdotL)));
+            __m128 diffuse = _mm_add_ps(diffuse_hair, _mm_mul_ps(_mm_sub_ps(diffuse_skin, diffuse_hair), blend));
+
+            // primary specular
+            __m128 hx = _mm_add_ps(vx, lx), hy = _mm_add_ps(vy, ly), hz = _mm_add_ps(vz, lz);
+            __m128 hrcp = hwRsqrt(_mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, hx), _mm_mul_ps(hy, hy)), _mm_mul_ps(hz, hz)));
+            __m128 TdotH = hwClamp1(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, hx), _mm_mul_ps(ty, hy)), _mm_mul_ps(tz, hz)), hrcp));
+            __m128 spec_primary = hwPow(_mm_max_ps(zero, _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(TdotH, TdotH)))), mat.primary_power);
+
+            // secondary
+            TdotH = hwClamp1(_mm_add_ps(TdotH, secondary_offset));
+            __m128 spec_secondary = hwPow(_mm_max_ps(zero, _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(TdotH, TdotH)))), mat.secondary_power);
+
+            __m128 specular = _mm_add_ps(_mm_mul_ps(primary_scale, spec_primary), _mm_mul_ps(secondary_scale, spec_secondary));
+
+            // light colour and attenuation folded into the per-channel weights
+            __m128 dw = _mm_mul_ps(diffuse, atten);
+            __m128 sw = _mm_mul_ps(specular, atten);
+            __m128 cr = _mm_set1_ps(l.color.x), cg = _mm_set1_ps(l.color.y), cbl = _mm_set1_ps(l.color.z);
+            r = _mm_add_ps(r, _mm_mul_ps(cr, _mm_add_ps(_mm_mul_ps(dw, _mm_loadu_ps(s.cr + i)), _mm_mul_ps(sw, _mm_set1_ps(mat.specular_color.x)))));
+            g = _mm_add_ps(g, _mm_mul_ps(cg, _mm_add_ps(_mm_mul_ps(dw, _mm_loadu_ps(s.cg + i)), _mm_mul_ps(sw, _mm_set1_ps(mat.specular_color.y)))));
+            b = _mm_add_ps(b, _mm_mul_ps(cbl, _mm_add_ps(_mm_mul_ps(dw, _mm_loadu_ps(s.cb + i)), _mm_mul_ps(sw, _mm_set1_ps(mat.specular_color.z)))));
+        }
+        _mm_storeu_ps(o.r + i, r);
+        _mm_storeu_ps(o.g + i, g);
+        _mm_storeu_ps(o.b + i, b);
+    }
+    hwShadeHairRange(s, mat, lights, num_lights, o, num4, s.num);
+}
+
+void hwShadeHair(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o)
+{
+    hwShadeHairSSE(s, mat, lights, num_lights, o);
+}
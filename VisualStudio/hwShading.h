@@ -0,0 +1,42 @@
+#pragma once
+
+// CPU evaluation of the hair lighting in Shaders/DefaultHairShader.hlsl: GFSDK_Hair_ComputeHairShading() summed over
+// directional and point lights. for offline baking (hair colour, lighting probes) and as a reference for shader changes.
+// samples are SoA so the SSE path shades 4 at a time. arrays need no alignment, any count works (the tail is scalar).
+// the SSE path uses polynomial log / exp for pow(). it stays within ~1e-5 relative of the scalar path.
+
+struct hwLightData;
+
+struct hwHairShadingSamples
+{
+    int num;
+    const float *px, *py, *pz;  // world position
+    const float *tx, *ty, *tz;  // world tangent
+    const float *nx, *ny, *nz;  // world normal at the root
+    const float *vx, *vy, *vz;  // view vector (towards the eye)
+    const float *cr, *cg, *cb;  // hair colour, i.e. root / tip colour as GFSDK_Hair_SampleHairColorTex() returns it
+};
+
+struct hwHairShadingOutput
+{
+    float *r, *g, *b;   // overwritten, not accumulated
+};
+
+// the GFSDK_Hair_Material fields the lighting uses
+struct hwHairShadingMaterial
+{
+    hwFloat3 specular_color;
+    float diffuse_blend;
+    float primary_scale;
+    float primary_power;
+    float secondary_scale;
+    float secondary_power;
+    float secondary_offset;
+};
+
+// defaultMaterial of the buffer filled by GFSDK_HairSDK::PrepareShaderConstantBuffer()
+void hwHairShadingMaterialFromConstantBuffer(hwHairShadingMaterial &o, const GFSDK_HairShaderConstantBuffer &cb);
+
+void hwShadeHairScalar(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o);
+void hwShadeHairSSE(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o);
+void hwShadeHair(const hwHairShadingSamples &s, const hwHairShadingMaterial &mat, const hwLightData *lights, int num_lights, const hwHairShadingOutput &o);
@@ -0,0 +1,47 @@
+#pragma once
+
+// fixed timestep accumulator for the hair simulation.
+// frame dt is accumulated and consumed in fixed_dt substeps, at most max_substeps per frame.
+// whole substeps that do not fit are dropped (and reported) instead of being carried over, so a hitch never
+// turns into a burst of catch-up steps. no SDK dependency, the result only depends on the sequence of dts fed.
+struct hwSimClock
+{
+    float   fixed_dt;       // <= 0: fixed timestep disabled. each frame is one step of the frame's dt
+    int     max_substeps;
+    double  accumulator;
+
+    hwSimClock() : fixed_dt(1.0f / 60.0f), max_substeps(4), accumulator(0.0) {}
+
+    void setTimestep(float dt, int substeps)
+    {
+        fixed_dt = dt;
+        max_substeps = std::max<int>(substeps, 1);
+        accumulator = 0.0;
+    }
+
+    // returns number of substeps to run for a frame of dt. o_step_dt is the dt of each substep,
+    // o_dropped is the simulation time thrown away by the max_substeps cap.
+    int advance(float dt, float &o_step_dt, float &o_dropped)
+    {
+        o_dropped = 0.0f;
+        if (!(dt > 0.0f)) { // also rejects NaN
+            o_step_dt = 0.0f;
+            return 0;
+        }
+        if (fixed_dt <= 0.0f) {
+            o_step_dt = dt;
+            return 1;
+        }
+
+        o_step_dt = fixed_dt;
+        accumulator += dt;
+        int n = (int)std::min<double>(std::floor(accumulator / fixed_dt), (double)max_substeps);
+        accumulator -= n * (double)fixed_dt;
+        double whole = std::floor(accumulator / fixed_dt);
+        if (whole > 0.0) {
+            o_dropped = (float)(whole * fixed_dt);
+            accumulator -= whole * fixed_dt;
+        }
+        return n;
+    }
+};
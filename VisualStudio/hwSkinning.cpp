@@ -0,0 +1,233 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwMath.h"
+#include "hwSkinning.h"
+#include <xmmintrin.h>
+
+
+void hwBuildSkinningMatricesScalar(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x)
+{
+    for (int bi = 0; bi < num; ++bi) {
+        hwMatrix w = world[bi];
+        if (mirror_x) {
+            float *r = hwMatrixData(w);
+            r[0] = -r[0]; r[1] = -r[1]; r[2] = -r[2]; r[3] = -r[3];
+        }
+        dst[bi] = inv_bindpose ? hwMatrixMul(inv_bindpose[bi], w) : w;
+    }
+}
+
+void hwBuildSkinningMatricesSSE(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x)
+{
+    const __m128 sign = _mm_set1_ps(mirror_x ? -1.0f : 1.0f);
+
+    for (int bi = 0; bi < num; ++bi) {
+        const float *w = hwMatrixData(world[bi]);
+        float *d = hwMatrixData(dst[bi]);
+
+        // rows of the mirrored world matrix
+        __m128 w0 = _mm_mul_ps(_mm_loadu_ps(w + 0), sign);
+        __m128 w1 = _mm_loadu_ps(w + 4);
+        __m128 w2 = _mm_loadu_ps(w + 8);
+        __m128 w3 = _mm_loadu_ps(w + 12);
+
+        if (!inv_bindpose) {
+            _mm_storeu_ps(d + 0, w0);
+            _mm_storeu_ps(d + 4, w1);
+            _mm_storeu_ps(d + 8, w2);
+            _mm_storeu_ps(d + 12, w3);
+            continue;
+        }
+
+        // row i of the result = sum_k ib[i][k] * w row k
+        const float *ib = hwMatrixData(inv_bindpose[bi]);
+        for (int i = 0; i < 4; ++i) {
+            __m128 a = _mm_loadu_ps(ib + i * 4);
+            __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), w0);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), w1));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), w2));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), w3));
+            _mm_storeu_ps(d + i * 4, r);
+        }
+    }
+}
+
+void hwBuildSkinningMatrices(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x)
+{
+    hwBuildSkinningMatricesSSE(dst, world, inv_bindpose, num, mirror_x);
+}
+
+namespace {
+
+// shared by both paths so they only differ in the order of evaluation.
+// m is the upper 3x3 (scale and reflection already removed), t the translation row
+inline void hwRigidToDQ(float *o, float m00, float m01, float m02, float m10, float m11, float m12, float m20, float m21, float m22,
+    float tx, float ty, float tz)
+{
+    // Shepperd's method: pick the largest of (trace, diagonal) to keep the division well conditioned
+    float tr = m00 + m11 + m22;
+    float d21 = m12 - m21, d02 = m20 - m02, d10 = m01 - m10;
+    float a01 = m01 + m10, a02 = m02 + m20, a12 = m12 + m21;
+    float x, y, z, w;
+    if (tr >= m00 && tr >= m11 && tr >= m22) {
+        float s = 2.0f * std::sqrt(std::max(1.0f + tr, 1e-30f)), inv = 1.0f / s;
+        x = d21 * inv; y = d02 * inv; z = d10 * inv; w = s * 0.25f;
+    }
+    else if (m00 >= m11 && m00 >= m22) {
+        float s = 2.0f * std::sqrt(std::max(1.0f + m00 - m11 - m22, 1e-30f)), inv = 1.0f / s;
+        x = s * 0.25f; y = a01 * inv; z = a02 * inv; w = d21 * inv;
+    }
+    else if (m11 >= m22) {
+        float s = 2.0f * std::sqrt(std::max(1.0f - m00 + m11 - m22, 1e-30f)), inv = 1.0f / s;
+        x = a01 * inv; y = s * 0.25f; z = a12 * inv; w = d02 * inv;
+    }
+    else {
+        float s = 2.0f * std::sqrt(std::max(1.0f - m00 - m11 + m22, 1e-30f)), inv = 1.0f / s;
+        x = a02 * inv; y = a12 * inv; z = s * 0.25f; w = d10 * inv;
+    }
+    // keep all bones in the same hemisphere so the SDK can blend them
+    if (w < 0.0f) { x = -x; y = -y; z = -z; w = -w; }
+
+    o[0] = x; o[1] = y; o[2] = z; o[3] = w;
+    o[4] = 0.5f * ( tx * w + ty * z - tz * y);
+    o[5] = 0.5f * (-tx * z + ty * w + tz * x);
+    o[6] = 0.5f * ( tx * y - ty * x + tz * w);
+    o[7] = -0.5f * (tx * x + ty * y + tz * z);
+}
+
+inline __m128 hwSelect(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+} // namespace
+
+void hwConvertMatricesToDQsScalar(hwDQuaternion *dst, const hwMatrix *src, int num)
+{
+    for (int bi = 0; bi < num; ++bi) {
+        const float *m = hwMatrixData(src[bi]);
+        float r[9] = { m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10] };
+        for (int i = 0; i < 3; ++i) {
+            float inv = 1.0f / std::sqrt(std::max(r[i * 3 + 0] * r[i * 3 + 0] + r[i * 3 + 1] * r[i * 3 + 1] + r[i * 3 + 2] * r[i * 3 + 2], 1e-30f));
+            r[i * 3 + 0] *= inv; r[i * 3 + 1] *= inv; r[i * 3 + 2] *= inv;
+        }
+        float det = r[0] * (r[4] * r[8] - r[5] * r[7]) - r[1] * (r[3] * r[8] - r[5] * r[6]) + r[2] * (r[3] * r[7] - r[4] * r[6]);
+        if (det < 0.0f) { r[0] = -r[0]; r[1] = -r[1]; r[2] = -r[2]; }
+
+        hwRigidToDQ(&dst[bi].q0.x, r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8], m[12], m[13], m[14]);
+    }
+}
+
+// 4 bones at a time in SoA form. all four Shepperd cases are evaluated and blended.
+void hwConvertMatricesToDQsSSE(hwDQuaternion *dst, const hwMatrix *src, int num)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 tiny = _mm_set1_ps(1e-30f);
+    const __m128 signbit = _mm_set1_ps(-0.0f);
+
+    int bi = 0;
+    for (; bi + 4 <= num; bi += 4) {
+        const float *p0 = hwMatrixData(src[bi + 0]);
+        const float *p1 = hwMatrixData(src[bi + 1]);
+        const float *p2 = hwMatrixData(src[bi + 2]);
+        const float *p3 = hwMatrixData(src[bi + 3]);
+
+        // mRC: element (R, C) of the 4 matrices
+        __m128 m00 = _mm_loadu_ps(p0 + 0), m01 = _mm_loadu_ps(p1 + 0), m02 = _mm_loadu_ps(p2 + 0), m03 = _mm_loadu_ps(p3 + 0);
+        _MM_TRANSPOSE4_PS(m00, m01, m02, m03);
+        __m128 m10 = _mm_loadu_ps(p0 + 4), m11 = _mm_loadu_ps(p1 + 4), m12 = _mm_loadu_ps(p2 + 4), m13 = _mm_loadu_ps(p3 + 4);
+        _MM_TRANSPOSE4_PS(m10, m11, m12, m13);
+        __m128 m20 = _mm_loadu_ps(p0 + 8), m21 = _mm_loadu_ps(p1 + 8), m22 = _mm_loadu_ps(p2 + 8), m23 = _mm_loadu_ps(p3 + 8);
+        _MM_TRANSPOSE4_PS(m20, m21, m22, m23);
+        __m128 tx = _mm_loadu_ps(p0 + 12), ty = _mm_loadu_ps(p1 + 12), tz = _mm_loadu_ps(p2 + 12), tw = _mm_loadu_ps(p3 + 12);
+        _MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+
+        // remove scale
+        __m128 inv;
+        inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, m00), _mm_mul_ps(m01, m01)), _mm_mul_ps(m02, m02)), tiny)));
+        m00 = _mm_mul_ps(m00, inv); m01 = _mm_mul_ps(m01, inv); m02 = _mm_mul_ps(m02, inv);
+        inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, m10), _mm_mul_ps(m11, m11)), _mm_mul_ps(m12, m12)), tiny)));
+        m10 = _mm_mul_ps(m10, inv); m11 = _mm_mul_ps(m11, inv); m12 = _mm_mul_ps(m12, inv);
+        inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, m20), _mm_mul_ps(m21, m21)), _mm_mul_ps(m22, m22)), tiny)));
+        m20 = _mm_mul_ps(m20, inv); m21 = _mm_mul_ps(m21, inv); m22 = _mm_mul_ps(m22, inv);
+
+        // remove reflection
+        __m128 det = _mm_sub_ps(_mm_add_ps(
+            _mm_mul_ps(m00, _mm_sub_ps(_mm_mul_ps(m11, m22), _mm_mul_ps(m12, m21))),
+            _mm_mul_ps(m02, _mm_sub_ps(_mm_mul_ps(m10, m21), _mm_mul_ps(m11, m20)))),
+            _mm_mul_ps(m01, _mm_sub_ps(_mm_mul_ps(m10, m22), _mm_mul_ps(m12, m20))));
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(det, _mm_setzero_ps()), signbit);
+        m00 = _mm_xor_ps(m00, flip); m01 = _mm_xor_ps(m01, flip); m02 = _mm_xor_ps(m02, flip);
+
+        __m128 tr = _mm_add_ps(_mm_add_ps(m00, m11), m22);
+        __m128 d21 = _mm_sub_ps(m12, m21), d02 = _mm_sub_ps(m20, m02), d10 = _mm_sub_ps(m01, m10);
+        __m128 a01 = _mm_add_ps(m01, m10), a02 = _mm_add_ps(m02, m20), a12 = _mm_add_ps(m12, m21);
+
+        __m128 cw = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tr, m00), _mm_cmpge_ps(tr, m11)), _mm_cmpge_ps(tr, m22));
+        __m128 cx = _mm_andnot_ps(cw, _mm_and_ps(_mm_cmpge_ps(m00, m11), _mm_cmpge_ps(m00, m22)));
+        __m128 cy = _mm_andnot_ps(_mm_or_ps(cw, cx), _mm_cmpge_ps(m11, m22));
+
+        __m128 t = hwSelect(cw, _mm_add_ps(one, tr),
+                   hwSelect(cx, _mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m00), m11), m22),
+                   hwSelect(cy, _mm_sub_ps(_mm_add_ps(_mm_sub_ps(one, m00), m11), m22),
+                                _mm_add_ps(_mm_sub_ps(_mm_sub_ps(one, m00), m11), m22))));
+        __m128 s = _mm_mul_ps(two, _mm_sqrt_ps(_mm_max_ps(t, tiny)));
+        __m128 rs = _mm_div_ps(one, s);
+        __m128 q4 = _mm_mul_ps(s, quarter);
+
+        __m128 x = hwSelect(cw, _mm_mul_ps(d21, rs), hwSelect(cx, q4, hwSelect(cy, _mm_mul_ps(a01, rs), _mm_mul_ps(a02, rs))));
+        __m128 y = hwSelect(cw, _mm_mul_ps(d02, rs), hwSelect(cx, _mm_mul_ps(a01, rs), hwSelect(cy, q4, _mm_mul_ps(a12, rs))));
+        __m128 z = hwSelect(cw, _mm_mul_ps(d10, rs), hwSelect(cx, _mm_mul_ps(a02, rs), hwSelect(cy, _mm_mul_ps(a12, rs), q4)));
+        __m128 w = hwSelect(cw, q4, hwSelect(cx, _mm_mul_ps(d21, rs), hwSelect(cy, _mm_mul_ps(d02, rs), _mm_mul_ps(d10, rs))));
+
+        __m128 hemi = _mm_and_ps(_mm_cmplt_ps(w, _mm_setzero_ps()), signbit);
+        x = _mm_xor_ps(x, hemi); y = _mm_xor_ps(y, hemi); z = _mm_xor_ps(z, hemi); w = _mm_xor_ps(w, hemi);
+
+        __m128 dx = _mm_mul_ps(half, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(tx, w), _mm_mul_ps(ty, z)), _mm_mul_ps(tz, y)));
+        __m128 dy = _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(ty, w), _mm_mul_ps(tx, z)), _mm_mul_ps(tz, x)));
+        __m128 dz = _mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(tx, y), _mm_mul_ps(ty, x)), _mm_mul_ps(tz, w)));
+        __m128 dw = _mm_xor_ps(_mm_mul_ps(half, _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, x), _mm_mul_ps(ty, y)), _mm_mul_ps(tz, z))), signbit);
+
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+        float *o = &dst[bi].q0.x;
+        _mm_storeu_ps(o + 0, x);  _mm_storeu_ps(o + 4, dx);
+        _mm_storeu_ps(o + 8, y);  _mm_storeu_ps(o + 12, dy);
+        _mm_storeu_ps(o + 16, z); _mm_storeu_ps(o + 20, dz);
+        _mm_storeu_ps(o + 24, w); _mm_storeu_ps(o + 28, dw);
+    }
+    hwConvertMatricesToDQsScalar(dst + bi, src + bi, num - bi);
+}
+
+void hwConvertMatricesToDQs(hwDQuaternion *dst, const hwMatrix *src, int num)
+{
+    hwConvertMatricesToDQsSSE(dst, src, num);
+}
+
+// four independent multiply-xor lanes so the hash keeps up with memcpy
+uint64_t hwHashPalette(const void *data, size_t size, uint64_t seed)
+{
+    const uint64_t prime = 0x100000001b3ull;
+    const uint64_t *p = (const uint64_t*)data;
+    size_t n = size / 8;
+
+    uint64_t h0 = seed ^ 0xcbf29ce484222325ull, h1 = h0 + 1, h2 = h0 + 2, h3 = h0 + 3;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        h0 = (h0 ^ p[i + 0]) * prime;
+        h1 = (h1 ^ p[i + 1]) * prime;
+        h2 = (h2 ^ p[i + 2]) * prime;
+        h3 = (h3 ^ p[i + 3]) * prime;
+    }
+    for (; i < n; ++i) { h0 = (h0 ^ p[i]) * prime; }
+
+    uint64_t h = h0 ^ (h1 * 31) ^ (h2 * 961) ^ (h3 * 29791) ^ size;
+    // final avalanche (murmur3 fmix64)
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// skinning palette builders.
+// input bone matrices are Unity's Matrix4x4.localToWorldMatrix as marshaled (i.e. the row-vector layout of hwMatrix).
+// output = inv_bindpose[i] * mirror(world[i]), where mirror() negates the x axis (Unity -> HairWorks handedness)
+// when hwSkinningFlag_MirrorX is set, and inv_bindpose is skipped when null.
+// with hwSkinningFlag_DualQuaternion the palette is then converted to dual quaternions (half the size of matrices,
+// no candy-wrapper artifacts on twisting joints). dual quaternions only represent rigid transforms: scale is removed
+// and a matrix with a reflection (negative determinant) has it factored out on the x axis before conversion.
+// the x mirror is such a reflection, so hwUpdateSkinningBatch() ignores hwSkinningFlag_DualQuaternion together with
+// hwSkinningFlag_MirrorX and uploads matrices; a dual quaternion palette would skin the unmirrored pose.
+
+enum hwSkinningFlags
+{
+    hwSkinningFlag_MirrorX          = 1,
+    hwSkinningFlag_InvBindPose      = 2,  // apply the inverse bind pose cached at asset load
+    hwSkinningFlag_DualQuaternion   = 4,  // upload with UpdateSkinningDQs() instead of UpdateSkinningMatrices(). not with MirrorX
+};
+
+// one instance of hwUpdateSkinningBatch(). must match hwi.SkinningBatchEntry in C#
+struct hwSkinningBatchEntry
+{
+    hwHInstance instance;
+    int first_bone;     // index into the packed bone matrix array
+    int num_bones;
+    int flags;          // hwSkinningFlags
+};
+
+void hwBuildSkinningMatricesScalar(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x);
+void hwBuildSkinningMatricesSSE(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x);
+void hwBuildSkinningMatrices(hwMatrix *dst, const hwMatrix *world, const hwMatrix *inv_bindpose, int num, bool mirror_x);
+
+void hwConvertMatricesToDQsScalar(hwDQuaternion *dst, const hwMatrix *src, int num);
+void hwConvertMatricesToDQsSSE(hwDQuaternion *dst, const hwMatrix *src, int num);
+void hwConvertMatricesToDQs(hwDQuaternion *dst, const hwMatrix *src, int num);
+
+// 64 bit hash of a skinning palette, used to skip uploads of unchanged poses. size must be a multiple of 8
+uint64_t hwHashPalette(const void *data, size_t size, uint64_t seed);
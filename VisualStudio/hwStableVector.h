@@ -0,0 +1,90 @@
+#pragma once
+
+// vector whose elements never move. they live in fixed size chunks allocated on demand and kept until clear(), and the
+// chunk table itself has a fixed size. the render thread can index and iterate it while the main thread appends:
+// push_back() fills the element before it publishes the new size.
+// writes are main thread only. clear() and move assignment require the render thread to be idle.
+// holds at most ChunkSize * MaxChunks elements: push_back() fails past that (in every build, callers log and return a
+// null handle).
+template<class T, size_t ChunkSize = 256, size_t MaxChunks = 4096>
+class hwStableVector
+{
+public:
+    template<class V, class C>
+    class iterator_t
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
+        iterator_t(C *c = nullptr, size_t i = 0) : m_cont(c), m_index(i) {}
+        V& operator*() const { return (*m_cont)[m_index]; }
+        V* operator->() const { return &(*m_cont)[m_index]; }
+        iterator_t& operator++() { ++m_index; return *this; }
+        iterator_t operator++(int) { auto r = *this; ++m_index; return r; }
+        bool operator==(const iterator_t &o) const { return m_index == o.m_index; }
+        bool operator!=(const iterator_t &o) const { return m_index != o.m_index; }
+
+    private:
+        C *m_cont;
+        size_t m_index;
+    };
+    typedef iterator_t<T, hwStableVector> iterator;
+    typedef iterator_t<const T, const hwStableVector> const_iterator;
+
+    hwStableVector() : m_size(0) { std::fill(m_chunks, m_chunks + MaxChunks, nullptr); }
+    ~hwStableVector() { clear(); }
+    hwStableVector(const hwStableVector&) = delete;
+    hwStableVector& operator=(const hwStableVector&) = delete;
+
+    hwStableVector& operator=(hwStableVector &&o)
+    {
+        clear();
+        std::copy(o.m_chunks, o.m_chunks + MaxChunks, m_chunks);
+        std::fill(o.m_chunks, o.m_chunks + MaxChunks, nullptr);
+        m_size.store(o.m_size.exchange(0));
+        return *this;
+    }
+
+    size_t size() const { return m_size.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    T&       operator[](size_t i)       { return m_chunks[i / ChunkSize][i % ChunkSize]; }
+    const T& operator[](size_t i) const { return m_chunks[i / ChunkSize][i % ChunkSize]; }
+    T&       back() { return (*this)[size() - 1]; }
+
+    iterator       begin()       { return iterator(this, 0); }
+    iterator       end()         { return iterator(this, size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const   { return const_iterator(this, size()); }
+
+    static size_t max_size() { return ChunkSize * MaxChunks; }
+
+    // false if full. nothing is added
+    bool push_back(const T &v)
+    {
+        size_t i = m_size.load(std::memory_order_relaxed);
+        size_t c = i / ChunkSize;
+        if (c >= MaxChunks) { return false; }
+        if (!m_chunks[c]) { m_chunks[c] = new T[ChunkSize]; }
+        m_chunks[c][i % ChunkSize] = v;
+        m_size.store(i + 1, std::memory_order_release);
+        return true;
+    }
+
+    void clear()
+    {
+        m_size.store(0, std::memory_order_release);
+        for (auto &c : m_chunks) {
+            delete[] c;
+            c = nullptr;
+        }
+    }
+
+private:
+    T *m_chunks[MaxChunks];
+    std::atomic<size_t> m_size;
+};
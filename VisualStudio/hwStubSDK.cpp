@@ -0,0 +1,698 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwStubSDK.h"
+
+namespace {
+
+struct hwStubAsset
+{
+    bool used = false;
+    int num_guide_hairs = 0;
+    int vertices_per_hair = 0;
+    float radius = 0.0f;
+    std::vector<std::string> bone_names;
+    std::vector<gfsdk_float4x4> bindposes;
+    std::vector<int> parents;
+    hwHairDescriptor desc;
+
+    int numBones() const { return (int)bone_names.size(); }
+};
+
+struct hwStubInstance
+{
+    bool used = false;
+    int asset = 0;
+    hwHairDescriptor desc;
+    std::vector<gfsdk_float4x4> skinning;
+    std::vector<gfsdk_dualquaternion> skinning_dq;
+    bool dq = false;
+    double simulated_time = 0.0;    // StepSimulation() time while desc.m_simulate was set
+    ID3D11ShaderResourceView *textures[GFSDK_HAIR_NUM_TEXTURES] = {};
+};
+
+gfsdk_float4x4 hwStubIdentity()
+{
+    gfsdk_float4x4 r;
+    std::memset(&r, 0, sizeof(r));
+    r._11 = r._22 = r._33 = r._44 = 1.0f;
+    return r;
+}
+
+class hwStubSDK final : public GFSDK_HairSDK
+{
+public:
+    hwStubSDK(const hwStubSDKSettings &settings) : m_settings(settings) {}
+
+    void getCounters(hwStubSDKCounters &o) const
+    {
+        o.assets_loaded         = m_assets_loaded;
+        o.instances_created     = m_instances_created;
+        o.descriptor_updates    = m_descriptor_updates;
+        o.skinning_updates      = m_skinning_updates;
+        o.skinning_bones        = m_skinning_bones;
+        o.simulation_steps      = m_simulation_steps;
+        o.render_calls          = m_render_calls;
+        o.stale_id_calls        = m_stale_id_calls;
+        o.assets_freed_in_use   = m_assets_freed_in_use;
+    }
+
+    // p transformed by bone of the last skinning upload, matrices or dual quaternions
+    bool skinPoint(GFSDK_HairInstanceID iid, int bone, const gfsdk_float3 &p, gfsdk_float3 &o)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(iid);
+        if (!inst || bone < 0) { return false; }
+        if (inst->dq) {
+            if (bone >= (int)inst->skinning_dq.size()) { return false; }
+            const auto &q = inst->skinning_dq[bone].q0;
+            const auto &d = inst->skinning_dq[bone].q1;
+            // p + 2w (u x p) + 2 u x (u x p), then the translation 2 * (dual * conjugate(real))
+            float cx = q.y * p.z - q.z * p.y, cy = q.z * p.x - q.x * p.z, cz = q.x * p.y - q.y * p.x;
+            float ccx = q.y * cz - q.z * cy, ccy = q.z * cx - q.x * cz, ccz = q.x * cy - q.y * cx;
+            o.x = p.x + 2.0f * (q.w * cx + ccx) + 2.0f * (-d.w * q.x + d.x * q.w - d.y * q.z + d.z * q.y);
+            o.y = p.y + 2.0f * (q.w * cy + ccy) + 2.0f * (-d.w * q.y + d.x * q.z + d.y * q.w - d.z * q.x);
+            o.z = p.z + 2.0f * (q.w * cz + ccz) + 2.0f * (-d.w * q.z - d.x * q.y + d.y * q.x + d.z * q.w);
+        }
+        else {
+            if (bone >= (int)inst->skinning.size()) { return false; }
+            const auto &m = inst->skinning[bone];
+            o.x = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+            o.y = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+            o.z = p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43;
+        }
+        return true;
+    }
+
+    bool simulatedTime(GFSDK_HairInstanceID iid, double &o)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(iid);
+        if (!inst) { return false; }
+        o = inst->simulated_time;
+        return true;
+    }
+
+    void getViewProjection(gfsdk_float4x4 &view, gfsdk_float4x4 &proj)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        view = m_view;
+        proj = m_proj;
+    }
+
+    void Release(void) override { delete this; }
+
+    GFSDK_HAIR_RETURNCODES CreateHairAsset(const GFSDK_HairAssetDescriptor& assetDesc, GFSDK_HairAssetID *assetID) override
+    {
+        if (!assetID) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto &a = newAsset(assetID);
+        a.num_guide_hairs = assetDesc.m_NumGuideHairs;
+        a.vertices_per_hair = assetDesc.m_NumGuideHairs ? assetDesc.m_NumVertices / assetDesc.m_NumGuideHairs : 0;
+        a.radius = m_settings.radius;
+        for (gfsdk_U32 i = 0; i < assetDesc.m_NumBones; ++i) {
+            char name[GFSDK_HAIR_MAX_STRING];
+            if (assetDesc.m_pBoneNames) {
+                std::strncpy(name, assetDesc.m_pBoneNames + GFSDK_HAIR_MAX_STRING * i, GFSDK_HAIR_MAX_STRING - 1);
+                name[GFSDK_HAIR_MAX_STRING - 1] = '\0';
+            }
+            else {
+                snprintf(name, sizeof(name), "bone%u", i);
+            }
+            a.bone_names.push_back(name);
+            a.bindposes.push_back(assetDesc.m_pBindPoses ? assetDesc.m_pBindPoses[i] : hwStubIdentity());
+            a.parents.push_back(assetDesc.m_pBoneParents ? assetDesc.m_pBoneParents[i] : -1);
+        }
+        ++m_assets_loaded;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES FreeHairAsset(const GFSDK_HairAssetID assetID) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *a = hwStubAsset();
+        for (auto &i : m_instances) {
+            if (i.used && i.asset == (int)assetID) { ++m_assets_freed_in_use; break; }
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES LoadHairAssetFromFile(gfsdk_cstr filename, GFSDK_HairAssetID* assetID, GFSDK_HairWorksInfo* /*info*/, const GFSDK_HairConversionSettings* /*pSettings*/) override
+    {
+        if (!filename || !*filename) { return GFSDK_HAIR_RETURN_OPEN_FAILED; }
+        if (!assetID) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        int num_guide_hairs = 0, vertices_per_hair = 0;
+        if (FILE *f = fopen(filename, "rb")) {
+            if (fscanf(f, "hwStubSDK asset %d %d", &num_guide_hairs, &vertices_per_hair) != 2) { num_guide_hairs = 0; }
+            fclose(f);
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto &a = newAsset(assetID);
+        makeProceduralAsset(a);
+        if (num_guide_hairs > 0 && vertices_per_hair > 0) {
+            a.num_guide_hairs = num_guide_hairs;
+            a.vertices_per_hair = vertices_per_hair;
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES LoadHairAssetFromMemory(const void* pMemoryBuffer, gfsdk_U32 /*memoryBufferSizeBytes*/, GFSDK_HairAssetID* assetID, GFSDK_HairWorksInfo* /*info*/, const GFSDK_HairConversionSettings* /*pSettings*/) override
+    {
+        if (!pMemoryBuffer || !assetID) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        makeProceduralAsset(newAsset(assetID));
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    // only what LoadHairAssetFromFile() reads back
+    GFSDK_HAIR_RETURNCODES SaveHairAssetToFile(gfsdk_cstr filename, const GFSDK_HairAssetID assetID, const GFSDK_HairInstanceDescriptor* /*pInstanceDescriptor*/, const GFSDK_HairWorksInfo* /*pInfo*/, const gfsdk_cstr* /*pTextureNames*/) override
+    {
+        if (!filename) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        FILE *f = fopen(filename, "wb");
+        if (!f) { return GFSDK_HAIR_RETURN_OPEN_FAILED; }
+        fprintf(f, "hwStubSDK asset %d %d\n", a->num_guide_hairs, a->vertices_per_hair);
+        fclose(f);
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES SaveHairInstanceToFile(gfsdk_cstr /*filename*/, const GFSDK_HairInstanceID /*instanceID*/, const GFSDK_HairWorksInfo* /*pInfo*/, const gfsdk_cstr* /*pTextureNames*/) override
+    {
+        return GFSDK_HAIR_RETURN_FAIL;
+    }
+
+    GFSDK_HAIR_RETURNCODES CopyAsset(const GFSDK_HairAssetID fromAssetID, const GFSDK_HairAssetID toAssetID, GFSDK_HairAssetCopySettings /*settings*/) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *from = findAsset(fromAssetID);
+        auto *to = findAsset(toAssetID);
+        if (!from || !to) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *to = *from;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES CopyInstanceDescriptorFromAsset(const GFSDK_HairAssetID hairAssetID, GFSDK_HairInstanceDescriptor& descriptor) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(hairAssetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        descriptor = a->desc;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES ResampleGuideHairs(const GFSDK_HairAssetID assetID, gfsdk_U16 targetNbPointsPerHair) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        a->vertices_per_hair = targetNbPointsPerHair;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES ClearShaderCache() override { return GFSDK_HAIR_RETURN_OK; }
+    GFSDK_HAIR_RETURNCODES AddToShaderCache(const GFSDK_HairShaderCacheSettings& /*settings*/) override { return GFSDK_HAIR_RETURN_OK; }
+
+    GFSDK_HAIR_RETURNCODES SaveShaderCacheToMemory(void** ppMemoryBuffer, size_t& memoryBufferSizeBytes) override
+    {
+        if (ppMemoryBuffer) { *ppMemoryBuffer = nullptr; }
+        memoryBufferSizeBytes = 0;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES InitRenderResources(ID3D11Device* /*pd3dDevice*/, ID3D11DeviceContext* /*pd3dContext*/) override { return GFSDK_HAIR_RETURN_OK; }
+    GFSDK_HAIR_RETURNCODES LoadShaderCacheFromMemory(const void* /*pMemoryBuffer*/) override { return GFSDK_HAIR_RETURN_OK; }
+    void FreeRenderResources() override {}
+    GFSDK_HAIR_RETURNCODES SetCurrentContext(ID3D11DeviceContext* /*pd3dContext*/) override { return GFSDK_HAIR_RETURN_OK; }
+
+    GFSDK_HAIR_RETURNCODES CreateHairInstance(const GFSDK_HairAssetID hairAssetID, GFSDK_HairInstanceID* newInstanceID) override
+    {
+        if (!newInstanceID) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(hairAssetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+
+        auto i = std::find_if(m_instances.begin(), m_instances.end(), [](const hwStubInstance &v) { return !v.used; });
+        if (i == m_instances.end()) {
+            m_instances.emplace_back();
+            i = m_instances.end() - 1;
+        }
+        auto &inst = *i;
+        inst = hwStubInstance();
+        inst.used = true;
+        inst.asset = (int)hairAssetID;
+        inst.desc = a->desc;
+        inst.skinning.assign(a->numBones(), hwStubIdentity());
+        *newInstanceID = (GFSDK_HairInstanceID)(i - m_instances.begin());
+        ++m_instances_created;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES FreeHairInstance(const GFSDK_HairInstanceID hairInstanceID) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *inst = hwStubInstance();
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES CopyCurrentInstanceDescriptor(const GFSDK_HairInstanceID hairInstanceID, GFSDK_HairInstanceDescriptor& descriptor) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        descriptor = inst->desc;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES UpdateInstanceDescriptor(const GFSDK_HairInstanceID hairInstanceID, const GFSDK_HairInstanceDescriptor& descriptor) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        inst->desc = descriptor;
+        ++m_descriptor_updates;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES SetTextureSRV(const GFSDK_HairInstanceID hairInstanceID, const GFSDK_HAIR_TEXTURE_TYPE textureType, ID3D11ShaderResourceView* pResource) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst || textureType < 0 || textureType >= GFSDK_HAIR_NUM_TEXTURES) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        inst->textures[textureType] = pResource;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetTextureSRV(const GFSDK_HairInstanceID hairInstanceID, const GFSDK_HAIR_TEXTURE_TYPE textureType, ID3D11ShaderResourceView** ppResource) override
+    {
+        if (!ppResource) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst || textureType < 0 || textureType >= GFSDK_HAIR_NUM_TEXTURES) {
+            *ppResource = nullptr;
+            return GFSDK_HAIR_RETURN_INVALID_PARAMETERS;
+        }
+        *ppResource = inst->textures[textureType];
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetShaderResources(const GFSDK_HairInstanceID /*hairInstanceID*/, ID3D11ShaderResourceView** ppResources) override
+    {
+        if (!ppResources) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::fill(ppResources, ppResources + GFSDK_HAIR_NUM_SHADER_RESOUCES, nullptr);
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetShaderSRV(const GFSDK_HairInstanceID /*hairInstanceID*/, const GFSDK_HAIR_SHADER_RESOURCE_TYPE /*resourceType*/, ID3D11ShaderResourceView** ppResource) override
+    {
+        if (!ppResource) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *ppResource = nullptr;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES UpdateSkinningMatrices(const GFSDK_HairInstanceID hairInstanceID, const gfsdk_U32 numBones, const gfsdk_float4x4* pSkinningMatrices, GFSDK_HAIR_TELEPORT_MODE /*teleportMode*/) override
+    {
+        if (!pSkinningMatrices) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        size_t n = std::min<size_t>(numBones, inst->skinning.size());
+        std::copy(pSkinningMatrices, pSkinningMatrices + n, inst->skinning.begin());
+        inst->dq = false;
+        ++m_skinning_updates;
+        m_skinning_bones += numBones;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES UpdateSkinningDQs(const GFSDK_HairInstanceID hairInstanceID, const gfsdk_U32 numBones, const gfsdk_dualquaternion *pDQs, GFSDK_HAIR_TELEPORT_MODE /*teleportMode*/) override
+    {
+        if (!pDQs) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        inst->skinning_dq.assign(pDQs, pDQs + std::min<size_t>(numBones, inst->skinning.size()));
+        inst->dq = true;
+        ++m_skinning_updates;
+        m_skinning_bones += numBones;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES StepSimulation(gfsdk_F32 timeStepSize, const gfsdk_float4x4* /*worldReference*/) override
+    {
+        ++m_simulation_steps;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (auto &inst : m_instances) {
+            if (inst.used && inst.desc.m_simulate) { inst.simulated_time += timeStepSize; }
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetBounds(const GFSDK_HairInstanceID hairInstanceID, gfsdk_float3* bbMin, gfsdk_float3* bbMax, bool /*growthMeshOnly*/) override
+    {
+        if (!bbMin || !bbMax) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(hairInstanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+
+        // box around the root bone. with dual quaternions the translation is 2 * (dual * conjugate(real))
+        gfsdk_float3 c = { 0.0f, 0.0f, 0.0f };
+        if (inst->dq && !inst->skinning_dq.empty()) {
+            const auto &q = inst->skinning_dq[0].q0;
+            const auto &d = inst->skinning_dq[0].q1;
+            c.x = 2.0f * (-d.w * q.x + d.x * q.w - d.y * q.z + d.z * q.y);
+            c.y = 2.0f * (-d.w * q.y + d.x * q.z + d.y * q.w - d.z * q.x);
+            c.z = 2.0f * (-d.w * q.z - d.x * q.y + d.y * q.x + d.z * q.w);
+        }
+        else if (!inst->dq && !inst->skinning.empty()) {
+            const auto &m = inst->skinning[0];
+            c = { m._41, m._42, m._43 };
+        }
+        float r = m_assets[inst->asset].radius;
+        *bbMin = { c.x - r, c.y - r, c.z - r };
+        *bbMax = { c.x + r, c.y + r, c.z + r };
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES SetViewProjection(const gfsdk_float4x4* view, const gfsdk_float4x4* proj, GFSDK_HAIR_HANDEDNESS_HINT /*handedness*/, float /*FOV*/) override
+    {
+        if (!view || !proj) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_view = *view;
+        m_proj = *proj;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES PrepareShaderConstantBuffer(const GFSDK_HairInstanceID /*hairInstanceID*/, GFSDK_HairShaderConstantBuffer* pConstantBuffer) override
+    {
+        if (!pConstantBuffer) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::memset(pConstantBuffer, 0, sizeof(*pConstantBuffer));
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES RenderHairs(const GFSDK_HairInstanceID /*hairInstanceID*/, const GFSDK_HairShaderSettings* /*pShaderSettings*/) override
+    {
+        ++m_render_calls;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES RenderVisualization(const GFSDK_HairInstanceID /*hairInstanceId*/) override { return GFSDK_HAIR_RETURN_OK; }
+
+    gfsdk_cstr GetBuildString() override { return "hwStubSDK"; }
+
+    GFSDK_HAIR_RETURNCODES GetNumGuideHairs(const GFSDK_HairAssetID assetID, gfsdk_U32* pNumGuideHairs) override
+    {
+        return getAssetValue(assetID, pNumGuideHairs, [](const hwStubAsset &a) { return (gfsdk_U32)a.num_guide_hairs; });
+    }
+
+    GFSDK_HAIR_RETURNCODES GetNumHairVertices(const GFSDK_HairAssetID assetID, gfsdk_U32* pNumVertices) override
+    {
+        return getAssetValue(assetID, pNumVertices, [](const hwStubAsset &a) { return (gfsdk_U32)(a.num_guide_hairs * a.vertices_per_hair); });
+    }
+
+    GFSDK_HAIR_RETURNCODES GetNumFaces(const GFSDK_HairAssetID assetID, gfsdk_U32* pNumFaces) override
+    {
+        return getAssetValue(assetID, pNumFaces, [this](const hwStubAsset &a) { return (gfsdk_U32)numFaces(a); });
+    }
+
+    // guide hairs are straight strands on a grid in the xz plane, growing along +y
+    GFSDK_HAIR_RETURNCODES GetHairVertices(const GFSDK_HairAssetID assetID, gfsdk_float3* pVertices) override
+    {
+        if (!pVertices) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        for (int h = 0; h < a->num_guide_hairs; ++h) {
+            gfsdk_float3 root = rootPosition(*a, h);
+            for (int v = 0; v < a->vertices_per_hair; ++v) {
+                *pVertices++ = { root.x, root.y + a->radius * v / std::max(a->vertices_per_hair - 1, 1), root.z };
+            }
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetRootVertices(const GFSDK_HairAssetID assetID, gfsdk_float3* pVertices) override
+    {
+        if (!pVertices) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        for (int h = 0; h < a->num_guide_hairs; ++h) {
+            pVertices[h] = rootPosition(*a, h);
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetEndIndices(const GFSDK_HairAssetID assetID, gfsdk_U32* pIndices) override
+    {
+        if (!pIndices) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        for (int h = 0; h < a->num_guide_hairs; ++h) {
+            pIndices[h] = (h + 1) * a->vertices_per_hair - 1;
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetFaceIndices(const GFSDK_HairAssetID assetID, gfsdk_U32* /*pIndices*/) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return findAsset(assetID) ? GFSDK_HAIR_RETURN_OK : GFSDK_HAIR_RETURN_INVALID_PARAMETERS;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetFaceUVs(const GFSDK_HairAssetID assetID, gfsdk_float2* /*pUVs*/) override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return findAsset(assetID) ? GFSDK_HAIR_RETURN_OK : GFSDK_HAIR_RETURN_INVALID_PARAMETERS;
+    }
+
+    // reorders the bones to the given names. names the asset does not have get an identity bind pose
+    GFSDK_HAIR_RETURNCODES SetBoneRemapping(const GFSDK_HairAssetID assetID, const gfsdk_char** ppBoneNames, gfsdk_U32 numBones) override
+    {
+        if (!ppBoneNames) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+
+        hwStubAsset remapped = *a;
+        remapped.bone_names.clear();
+        remapped.bindposes.clear();
+        remapped.parents.clear();
+        for (gfsdk_U32 i = 0; i < numBones; ++i) {
+            auto it = std::find(a->bone_names.begin(), a->bone_names.end(), ppBoneNames[i] ? ppBoneNames[i] : "");
+            size_t src = it - a->bone_names.begin();
+            remapped.bone_names.push_back(ppBoneNames[i] ? ppBoneNames[i] : "");
+            remapped.bindposes.push_back(it != a->bone_names.end() ? a->bindposes[src] : hwStubIdentity());
+            remapped.parents.push_back(-1);
+        }
+        *a = remapped;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetNumBones(const GFSDK_HairAssetID assetID, gfsdk_U32* numBones) override
+    {
+        return getAssetValue(assetID, numBones, [](const hwStubAsset &a) { return (gfsdk_U32)a.numBones(); });
+    }
+
+    GFSDK_HAIR_RETURNCODES GetBoneName(const GFSDK_HairAssetID assetID, const gfsdk_U32 boneID, gfsdk_char* pBoneName) override
+    {
+        if (!pBoneName) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a || boneID >= (gfsdk_U32)a->numBones()) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::strncpy(pBoneName, a->bone_names[boneID].c_str(), GFSDK_HAIR_MAX_STRING - 1);
+        pBoneName[GFSDK_HAIR_MAX_STRING - 1] = '\0';
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetBindPose(const GFSDK_HairAssetID assetID, const gfsdk_U32 boneID, gfsdk_float4x4* pBindPose) override
+    {
+        if (!pBindPose) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a || boneID >= (gfsdk_U32)a->numBones()) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *pBindPose = a->bindposes[boneID];
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    // each guide hair is fully bound to one bone, round robin
+    GFSDK_HAIR_RETURNCODES GetBoneIndices(const GFSDK_HairAssetID assetID, gfsdk_float4* pBoneIndices) override
+    {
+        if (!pBoneIndices) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        int nb = std::max(a->numBones(), 1);
+        for (int h = 0; h < a->num_guide_hairs; ++h) {
+            pBoneIndices[h] = { (float)(h % nb), 0.0f, 0.0f, 0.0f };
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetBoneWeights(const GFSDK_HairAssetID assetID, gfsdk_float4* pBoneWeights) override
+    {
+        if (!pBoneWeights) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(assetID);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        for (int h = 0; h < a->num_guide_hairs; ++h) {
+            pBoneWeights[h] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        }
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES GetTextureName(const GFSDK_HairAssetID assetID, const GFSDK_HAIR_TEXTURE_TYPE /*textureID*/, gfsdk_char* pTextureName) override
+    {
+        if (!pTextureName) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!findAsset(assetID)) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        pTextureName[0] = '\0';
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    GFSDK_HAIR_RETURNCODES ComputeStats(const GFSDK_HairInstanceID instanceID, GFSDK_HairStats* pStats) override
+    {
+        if (!pStats) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *inst = findInstance(instanceID);
+        if (!inst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        // the SDK grows 64 hairs per growth mesh triangle at density 1
+        const auto &a = m_assets[inst->asset];
+        *pStats = GFSDK_HairStats();
+        pStats->m_numFaces = numFaces(a);
+        pStats->m_averageDensity = inst->desc.m_density;
+        pStats->m_averageHairsPerFace = 64.0f * inst->desc.m_density;
+        pStats->m_numHairs = (int)(pStats->m_numFaces * pStats->m_averageHairsPerFace);
+        pStats->m_averageCV = (float)a.vertices_per_hair;
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+private:
+    hwStubAsset& newAsset(GFSDK_HairAssetID *assetID)
+    {
+        auto i = std::find_if(m_assets.begin(), m_assets.end(), [](const hwStubAsset &v) { return !v.used; });
+        if (i == m_assets.end()) {
+            m_assets.emplace_back();
+            i = m_assets.end() - 1;
+        }
+        *i = hwStubAsset();
+        i->used = true;
+        *assetID = (GFSDK_HairAssetID)(i - m_assets.begin());
+        return *i;
+    }
+
+    void makeProceduralAsset(hwStubAsset &a)
+    {
+        a.num_guide_hairs = m_settings.num_guide_hairs;
+        a.vertices_per_hair = m_settings.vertices_per_hair;
+        a.radius = m_settings.radius;
+        for (int i = 0; i < m_settings.num_bones; ++i) {
+            char name[GFSDK_HAIR_MAX_STRING];
+            snprintf(name, sizeof(name), "bone%d", i);
+            a.bone_names.push_back(name);
+            a.bindposes.push_back(hwStubIdentity());
+            a.parents.push_back(i - 1);
+        }
+        ++m_assets_loaded;
+    }
+
+    gfsdk_float3 rootPosition(const hwStubAsset &a, int h) const
+    {
+        int side = std::max((int)std::ceil(std::sqrt((float)a.num_guide_hairs)), 1);
+        float step = 2.0f * a.radius / side;
+        return { -a.radius + step * (h % side), 0.0f, -a.radius + step * (h / side) };
+    }
+
+    // the roots form a side x rows grid, two triangles per cell
+    int numFaces(const hwStubAsset &a) const
+    {
+        int side = std::max((int)std::ceil(std::sqrt((float)a.num_guide_hairs)), 1);
+        int rows = (a.num_guide_hairs + side - 1) / side;
+        return 2 * std::max(side - 1, 0) * std::max(rows - 1, 0);
+    }
+
+    // an ID of a freed slot is a use after free on the real SDK
+    hwStubAsset* findAsset(GFSDK_HairAssetID aid)
+    {
+        size_t i = (size_t)aid;
+        if (i >= m_assets.size()) { return nullptr; }
+        if (!m_assets[i].used) { ++m_stale_id_calls; return nullptr; }
+        return &m_assets[i];
+    }
+
+    hwStubInstance* findInstance(GFSDK_HairInstanceID iid)
+    {
+        size_t i = (size_t)iid;
+        if (i >= m_instances.size()) { return nullptr; }
+        if (!m_instances[i].used) { ++m_stale_id_calls; return nullptr; }
+        return &m_instances[i];
+    }
+
+    template<class F>
+    GFSDK_HAIR_RETURNCODES getAssetValue(GFSDK_HairAssetID aid, gfsdk_U32 *dst, const F &f)
+    {
+        if (!dst) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto *a = findAsset(aid);
+        if (!a) { return GFSDK_HAIR_RETURN_INVALID_PARAMETERS; }
+        *dst = f(*a);
+        return GFSDK_HAIR_RETURN_OK;
+    }
+
+    hwStubSDKSettings           m_settings;
+    std::mutex                  m_mutex; // hwContext loads / creates on the main thread while the render thread skins and draws
+    std::vector<hwStubAsset>    m_assets;
+    std::vector<hwStubInstance> m_instances;
+    gfsdk_float4x4              m_view = {};    // last SetViewProjection()
+    gfsdk_float4x4              m_proj = {};
+
+    std::atomic<int64_t> m_assets_loaded { 0 };
+    std::atomic<int64_t> m_instances_created { 0 };
+    std::atomic<int64_t> m_descriptor_updates { 0 };
+    std::atomic<int64_t> m_skinning_updates { 0 };
+    std::atomic<int64_t> m_skinning_bones { 0 };
+    std::atomic<int64_t> m_simulation_steps { 0 };
+    std::atomic<int64_t> m_render_calls { 0 };
+    std::atomic<int64_t> m_stale_id_calls { 0 };
+    std::atomic<int64_t> m_assets_freed_in_use { 0 };
+};
+
+} // namespace
+
+hwSDK* hwCreateStubSDK(const hwStubSDKSettings &settings)
+{
+    return new hwStubSDK(settings);
+}
+
+bool hwStubSDKGetCounters(hwSDK *sdk, hwStubSDKCounters &o)
+{
+    auto *stub = dynamic_cast<hwStubSDK*>(sdk);
+    if (!stub) { return false; }
+    stub->getCounters(o);
+    return true;
+}
+
+bool hwStubSDKSkinPoint(hwSDK *sdk, hwInstanceID iid, int bone, const hwFloat3 &p, hwFloat3 &o)
+{
+    auto *stub = dynamic_cast<hwStubSDK*>(sdk);
+    return stub && stub->skinPoint(iid, bone, p, o);
+}
+
+bool hwStubSDKSimulatedTime(hwSDK *sdk, hwInstanceID iid, double &o)
+{
+    auto *stub = dynamic_cast<hwStubSDK*>(sdk);
+    return stub && stub->simulatedTime(iid, o);
+}
+
+bool hwStubSDKGetViewProjection(hwSDK *sdk, hwMatrix &view, hwMatrix &proj)
+{
+    auto *stub = dynamic_cast<hwStubSDK*>(sdk);
+    if (!stub) { return false; }
+    stub->getViewProjection(view, proj);
+    return true;
+}
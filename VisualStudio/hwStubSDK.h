@@ -0,0 +1,39 @@
+#pragma once
+
+// GFSDK_HairSDK implementation that keeps the bookkeeping (assets, instances, bones, skinning palettes, bounds)
+// and does no hair work. lets hwContext run where GFSDK_HairWorks.win*.dll is not available.
+// asset files are not parsed: every load succeeds and produces the same procedural asset described by hwStubSDKSettings,
+// except for files written by the stub's SaveHairAssetToFile(), which keep their guide hair and control vertex counts.
+
+struct hwStubSDKSettings
+{
+    int     num_bones           = 32;
+    int     num_guide_hairs     = 1024;
+    int     vertices_per_hair   = 16;
+    float   radius              = 0.5f;     // bounds half extent around bone 0
+};
+
+struct hwStubSDKCounters
+{
+    int64_t assets_loaded           = 0;
+    int64_t instances_created       = 0;
+    int64_t descriptor_updates      = 0;
+    int64_t skinning_updates        = 0;    // UpdateSkinningMatrices() + UpdateSkinningDQs()
+    int64_t skinning_bones          = 0;
+    int64_t simulation_steps        = 0;
+    int64_t render_calls            = 0;
+    int64_t stale_id_calls          = 0;    // calls with the ID of a freed asset or instance
+    int64_t assets_freed_in_use     = 0;    // FreeHairAsset() while instances created from the asset are alive
+};
+
+hwSDK* hwCreateStubSDK(const hwStubSDKSettings &settings = hwStubSDKSettings());
+
+// false if sdk was not created by hwCreateStubSDK()
+bool hwStubSDKGetCounters(hwSDK *sdk, hwStubSDKCounters &o);
+// o = p skinned by bone of the instance's last UpdateSkinningMatrices() / UpdateSkinningDQs().
+// instance IDs are slot indices, so a process that creates n instances first gets 0 .. n-1
+bool hwStubSDKSkinPoint(hwSDK *sdk, hwInstanceID iid, int bone, const hwFloat3 &p, hwFloat3 &o);
+// o = total time the instance was stepped by StepSimulation() with m_simulate set
+bool hwStubSDKSimulatedTime(hwSDK *sdk, hwInstanceID iid, double &o);
+// matrices of the last SetViewProjection()
+bool hwStubSDKGetViewProjection(hwSDK *sdk, hwMatrix &view, hwMatrix &proj);
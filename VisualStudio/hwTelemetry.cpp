@@ -0,0 +1,202 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwTelemetry.h"
+#ifdef hwWindows
+#include <windows.h>
+#else // hwWindows
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif // hwWindows
+
+namespace {
+
+struct hwTelemetryMapping
+{
+    std::string name;
+    size_t size;
+    bool owner;     // created by this process: the segment is removed when unmapped
+#ifdef hwWindows
+    HANDLE handle;
+#endif // hwWindows
+};
+
+std::mutex                                      g_telemetry_mutex;
+std::map<const void*, hwTelemetryMapping>       g_telemetry_mappings;
+
+// POSIX shared memory names start with a slash and have no other
+std::string hwTelemetrySegmentName(const char *name)
+{
+    std::string r = name && name[0] ? name : hwTelemetryDefaultName;
+#ifndef hwWindows
+    if (r[0] != '/') { r.insert(r.begin(), '/'); }
+#endif // hwWindows
+    return r;
+}
+
+// pid 0: the writer has not filled the header yet
+bool hwTelemetryOwnerAlive(uint32_t pid)
+{
+    if (pid == 0) { return true; }
+#ifdef hwWindows
+    HANDLE process = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    if (!process) { return ::GetLastError() == ERROR_ACCESS_DENIED; }
+    DWORD code = 0;
+    bool alive = ::GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+    ::CloseHandle(process);
+    return alive;
+#else // hwWindows
+    return ::kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+#endif // hwWindows
+}
+
+#ifndef hwWindows
+// a segment whose writer is gone (crashed without hwTelemetryUnmap()). anything unreadable is left alone
+bool hwTelemetryIsStale(const std::string &name)
+{
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) { return false; }
+    struct stat st;
+    bool stale = false;
+    if (::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(hwTelemetryHeader)) {
+        void *p = ::mmap(nullptr, sizeof(hwTelemetryHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            stale = !hwTelemetryOwnerAlive(((const hwTelemetryHeader*)p)->pid);
+            ::munmap(p, sizeof(hwTelemetryHeader));
+        }
+    }
+    ::close(fd);
+    return stale;
+}
+#endif // hwWindows
+
+} // namespace
+
+
+hwTelemetryHeader* hwTelemetryCreate(const char *name_, int max_instances)
+{
+    max_instances = std::max(max_instances, 0);
+    std::string name = hwTelemetrySegmentName(name_);
+    size_t size = hwTelemetryBlockSize((uint32_t)max_instances);
+    hwTelemetryMapping m;
+    m.name = name;
+    m.size = size;
+    m.owner = true;
+
+#ifdef hwWindows
+    m.handle = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size, name.c_str());
+    if (!m.handle) {
+        hwLogError("hwTelemetryCreate(): CreateFileMapping(%s) failed.\n", name.c_str());
+        return nullptr;
+    }
+    bool existed = ::GetLastError() == ERROR_ALREADY_EXISTS;
+    void *p = ::MapViewOfFile(m.handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!p) {
+        hwLogError("hwTelemetryCreate(): MapViewOfFile(%s) failed.\n", name.c_str());
+        ::CloseHandle(m.handle);
+        return nullptr;
+    }
+    // kept alive by a reader after its writer crashed: reused. another session's: left alone
+    if (existed && hwTelemetryOwnerAlive(((hwTelemetryHeader*)p)->pid)) {
+        hwLogError("hwTelemetryCreate(): %s is in use by process %u.\n", name.c_str(), ((hwTelemetryHeader*)p)->pid);
+        ::UnmapViewOfFile(p);
+        ::CloseHandle(m.handle);
+        return nullptr;
+    }
+    uint32_t pid = (uint32_t)::GetCurrentProcessId();
+#else // hwWindows
+    // a segment left by a crashed session is replaced, one of a running session is not
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    bool exists = fd < 0 && errno == EEXIST;
+    if (exists && hwTelemetryIsStale(name)) {
+        ::shm_unlink(name.c_str());
+        fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        exists = fd < 0 && errno == EEXIST;
+    }
+    if (fd < 0) {
+        hwLogError("hwTelemetryCreate(): shm_open(%s) failed%s.\n", name.c_str(), exists ? ", in use by another session" : "");
+        return nullptr;
+    }
+    void *p = ::ftruncate(fd, (off_t)size) == 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        hwLogError("hwTelemetryCreate(): failed to map %s.\n", name.c_str());
+        ::shm_unlink(name.c_str());
+        return nullptr;
+    }
+    uint32_t pid = (uint32_t)::getpid();
+#endif // hwWindows
+
+    // magic goes last: a reader attaching meanwhile sees an empty block until the rest is valid
+    auto *block = (hwTelemetryHeader*)p;
+    memset(p, 0, size);
+    block->version = hwTelemetryVersion;
+    block->size = (uint32_t)size;
+    block->max_instances = (uint32_t)max_instances;
+    block->pid = pid;
+    std::atomic_thread_fence(std::memory_order_release);
+    block->magic = hwTelemetryMagic;
+
+    std::unique_lock<std::mutex> lock(g_telemetry_mutex);
+    g_telemetry_mappings[p] = m;
+    return block;
+}
+
+const hwTelemetryHeader* hwTelemetryAttach(const char *name_)
+{
+    std::string name = hwTelemetrySegmentName(name_);
+    hwTelemetryMapping m;
+    m.name = name;
+    m.owner = false;
+
+#ifdef hwWindows
+    m.handle = ::OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!m.handle) { return nullptr; }
+    void *p = ::MapViewOfFile(m.handle, FILE_MAP_READ, 0, 0, 0);
+    if (!p) {
+        ::CloseHandle(m.handle);
+        return nullptr;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    m.size = ::VirtualQuery(p, &info, sizeof(info)) ? (size_t)info.RegionSize : 0;
+#else // hwWindows
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) { return nullptr; }
+    struct stat st;
+    m.size = ::fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    void *p = m.size >= sizeof(hwTelemetryHeader) ? ::mmap(nullptr, m.size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) { return nullptr; }
+#endif // hwWindows
+
+    std::unique_lock<std::mutex> lock(g_telemetry_mutex);
+    g_telemetry_mappings[p] = m;
+    return (const hwTelemetryHeader*)p;
+}
+
+void hwTelemetryUnmap(const hwTelemetryHeader *block)
+{
+    if (!block) { return; }
+
+    hwTelemetryMapping m;
+    {
+        std::unique_lock<std::mutex> lock(g_telemetry_mutex);
+        auto i = g_telemetry_mappings.find(block);
+        if (i == g_telemetry_mappings.end()) { return; }
+        m = i->second;
+        g_telemetry_mappings.erase(i);
+    }
+
+#ifdef hwWindows
+    // the mapping goes away with its last handle, readers keep theirs
+    if (m.owner) { ((hwTelemetryHeader*)block)->magic = 0; }
+    ::UnmapViewOfFile(block);
+    ::CloseHandle(m.handle);
+#else // hwWindows
+    if (m.owner) { ((hwTelemetryHeader*)block)->magic = 0; } // readers still attached see the session ended
+    ::munmap((void*)block, m.size);
+    if (m.owner) { ::shm_unlink(m.name.c_str()); }
+#endif // hwWindows
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// telemetry block published in a named shared memory segment for external profilers and dashboards.
+// the render thread rewrites it once per frame under a seqlock: seq is odd while a write is in progress and bumped
+// again when done. readers copy the block and retry if seq was odd or changed meanwhile (hwTelemetryRead()), so they
+// never block the writer and the writer never waits for them.
+// this header is the layout contract. it only depends on the standard library so profilers can include it as is.
+// any change of the structs below must bump hwTelemetryVersion.
+
+static const uint32_t hwTelemetryMagic = 0x4d545748; // "HWTM"
+static const uint32_t hwTelemetryVersion = 1;
+static const char     hwTelemetryDefaultName[] = "hwTelemetry";
+
+// one frame of the render thread. times are in milliseconds
+struct hwTelemetryFrame
+{
+    uint64_t frame;                 // frames published since hwTelemetryOpen()
+    uint64_t timestamp;             // nanoseconds, steady clock of the writer at publication
+    float frame_time;               // since the previous frame
+    float flush_time;               // all flushes of the frame, simulation included
+    float simulation_time;
+    float simulation_time_dropped;  // by the max substeps cap
+    int num_substeps;
+    int num_view_flushes;
+    int num_shadow_flushes;
+    int num_instances;              // live instances. may be more than hwTelemetryHeader::num_instances
+    int num_sleeping_instances;
+    int num_throttled_instances;
+    // queue depths
+    int frame_commands;             // frame segment (skinning + simulation) replayed
+    int view_commands;              // view segments replayed, all views
+    int vr_commands;
+    int lod_requests;               // instanceSetLOD() requests applied at the start of the frame
+};
+
+// one instance. hair counts and LOD factors come from GFSDK_HairSDK::ComputeStats(), which is refreshed for a few
+// instances per frame: stats_frame tells how old they are
+struct hwTelemetryInstance
+{
+    int handle;
+    int asset;
+    int lod;                        // guide hair LOD level (instanceSetLOD())
+    int sleep_state;                // 0: awake, 1: sleeping, 2: waking
+    int simulating;                 // m_simulate as last sent to the SDK
+    int sim_divisor;                // simulated every sim_divisor frames by the simulation budget
+    int invisible_frames;
+    int num_hairs;
+    float average_cvs;
+    float distance_lod_factor;
+    float detail_lod_factor;
+    float camera_distance;
+    uint64_t stats_frame;           // hwTelemetryFrame::frame of the last ComputeStats(). 0: not yet
+};
+
+struct hwTelemetryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // of the whole block in bytes
+    uint32_t max_instances;
+    uint32_t pid;                   // of the writer
+    std::atomic<uint32_t> seq;
+    hwTelemetryFrame frame;
+    uint32_t num_instances;         // entries of instances() in use
+    uint32_t pad;
+
+    hwTelemetryInstance*       instances()       { return (hwTelemetryInstance*)(this + 1); }
+    const hwTelemetryInstance* instances() const { return (const hwTelemetryInstance*)(this + 1); }
+};
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the seqlock must be lock-free to work across processes");
+
+inline size_t hwTelemetryBlockSize(uint32_t max_instances)
+{
+    return sizeof(hwTelemetryHeader) + sizeof(hwTelemetryInstance) * max_instances;
+}
+
+// copies a consistent snapshot of the block to dst (at most size bytes). returns false if the writer kept it busy
+// for max_retries attempts or the block is not a telemetry block of this version
+inline bool hwTelemetryRead(const hwTelemetryHeader *src, void *dst, size_t size, int max_retries = 1000)
+{
+    if (src->magic != hwTelemetryMagic || src->version != hwTelemetryVersion) { return false; }
+    if (size > src->size) { size = src->size; }
+    for (int i = 0; i < max_retries; ++i) {
+        uint32_t begin = src->seq.load(std::memory_order_acquire);
+        if (begin & 1) { continue; }
+        memcpy(dst, src, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (src->seq.load(std::memory_order_relaxed) == begin) { return true; }
+    }
+    return false;
+}
+
+
+// shared memory segments (hwTelemetry.cpp): shm_open() on POSIX, a named file mapping on Windows.
+// hwTelemetryCreate() is the writer's, hwTelemetryAttach() maps an existing block read only.
+// hwTelemetryCreate() fails if the name is taken by a running writer and replaces the block of one that is gone
+hwTelemetryHeader*          hwTelemetryCreate(const char *name, int max_instances);
+const hwTelemetryHeader*    hwTelemetryAttach(const char *name);
+void                        hwTelemetryUnmap(const hwTelemetryHeader *block);
+
+// writer side of the seqlock
+inline void hwTelemetryBeginWrite(hwTelemetryHeader *block)
+{
+    block->seq.store(block->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline void hwTelemetryEndWrite(hwTelemetryHeader *block)
+{
+    block->seq.store(block->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "hwInternal.h"
+#include "hwTrace.h"
+
+std::atomic<bool> g_hw_trace_enabled(false);
+
+namespace {
+
+struct hwTraceEvent
+{
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// single producer (the owning thread), read by hwTraceWriteJSON().
+// when full, the oldest events are overwritten.
+// only the producer writes head: hwTraceStart() bumps g_trace_generation and each ring rewinds itself on its next
+// record, so a reset can't race a write in progress.
+struct hwTraceRing
+{
+    static const uint32_t Capacity = 8192; // must be power of two
+
+    int tid;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> head;
+    hwTraceEvent events[Capacity];
+
+    hwTraceRing(int t) : tid(t), generation(0), head(0) {}
+};
+
+std::mutex                                  g_trace_mutex; // guards g_trace_rings. only taken once per thread and when dumping
+std::vector<std::unique_ptr<hwTraceRing>>   g_trace_rings;
+std::atomic<uint32_t>                       g_trace_generation(0);
+uint64_t                                    g_trace_start;
+thread_local hwTraceRing                    *g_trace_ring = nullptr;
+
+// rings are owned by g_trace_rings and outlive their thread, so events of finished threads can still be dumped
+hwTraceRing* hwTraceGetRing()
+{
+    if (!g_trace_ring) {
+        std::unique_lock<std::mutex> lock(g_trace_mutex);
+        g_trace_rings.emplace_back(new hwTraceRing((int)g_trace_rings.size() + 1));
+        g_trace_ring = g_trace_rings.back().get();
+    }
+    return g_trace_ring;
+}
+
+} // namespace
+
+
+uint64_t hwTraceNow()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void hwTraceRecord(const char *name, uint64_t begin, uint64_t end)
+{
+    auto *ring = hwTraceGetRing();
+    uint32_t gen = g_trace_generation.load(std::memory_order_relaxed);
+    if (ring->generation.load(std::memory_order_relaxed) != gen) {
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->generation.store(gen, std::memory_order_release);
+    }
+    uint32_t h = ring->head.load(std::memory_order_relaxed);
+    auto &e = ring->events[h & (hwTraceRing::Capacity - 1)];
+    e.name = name;
+    e.begin = begin;
+    e.end = end;
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+void hwTraceStart()
+{
+    {
+        std::unique_lock<std::mutex> lock(g_trace_mutex);
+        g_trace_generation.fetch_add(1, std::memory_order_relaxed);
+        g_trace_start = hwTraceNow();
+    }
+    g_hw_trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+void hwTraceStop()
+{
+    g_hw_trace_enabled.store(false, std::memory_order_relaxed);
+}
+
+// should be called after hwTraceStop(). events being written while dumping may come out torn.
+bool hwTraceWriteJSON(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        hwLogError("hwTraceWriteJSON(): failed to open %s\n", path);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(g_trace_mutex);
+    fputs("{\"traceEvents\":[\n", f);
+    bool first = true;
+    uint32_t gen = g_trace_generation.load(std::memory_order_relaxed);
+    for (auto &r : g_trace_rings) {
+        // rings that haven't recorded since hwTraceStart() still hold the previous capture
+        if (r->generation.load(std::memory_order_acquire) != gen) { continue; }
+        uint32_t head = r->head.load(std::memory_order_acquire);
+        uint32_t begin = head > hwTraceRing::Capacity ? head - hwTraceRing::Capacity : 0;
+        for (uint32_t i = begin; i != head; ++i) {
+            const auto &e = r->events[i & (hwTraceRing::Capacity - 1)];
+            if (e.begin < g_trace_start) { continue; }
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"hw\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", e.name, r->tid, double(e.begin - g_trace_start) * 1e-3, double(e.end - e.begin) * 1e-3);
+            first = false;
+        }
+    }
+    fputs("\n]}\n", f);
+    fclose(f);
+    return true;
+}
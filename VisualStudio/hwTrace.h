@@ -0,0 +1,42 @@
+#pragma once
+
+// lightweight CPU trace markers.
+// events are written into per-thread ring buffers (no locks on the hot path) and dumped as Chrome trace-event JSON
+// that can be opened with chrome://tracing or ui.perfetto.dev.
+// while tracing is off a marker costs one relaxed load and a branch.
+
+extern std::atomic<bool> g_hw_trace_enabled;
+
+uint64_t hwTraceNow(); // nanoseconds
+void     hwTraceRecord(const char *name, uint64_t begin, uint64_t end);
+void     hwTraceStart();
+void     hwTraceStop();
+bool     hwTraceWriteJSON(const char *path);
+
+class hwTraceScope
+{
+public:
+    // name must be a string literal (only the pointer is stored)
+    hwTraceScope(const char *name) : m_name(nullptr), m_begin(0)
+    {
+        if (g_hw_trace_enabled.load(std::memory_order_relaxed)) {
+            m_name = name;
+            m_begin = hwTraceNow();
+        }
+    }
+
+    ~hwTraceScope()
+    {
+        if (m_name) {
+            hwTraceRecord(m_name, m_begin, hwTraceNow());
+        }
+    }
+
+private:
+    const char *m_name;
+    uint64_t m_begin;
+};
+
+#define hwTraceConcat2(a, b) a##b
+#define hwTraceConcat(a, b) hwTraceConcat2(a, b)
+#define hwTraceScoped(name) hwTraceScope hwTraceConcat(hw_trace_, __LINE__)(name)
@@ -1,16 +1,30 @@
 ﻿#include <algorithm>
 #include <map>
+#include <set>
 #include <vector>
 #include <memory>
 #include <functional>
 #include <fstream>
 #include <cstdint>
 #include <array>
+#include <cmath>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <cassert>
+#include <sys/stat.h>
 
-#include <d3d11.h>
+#include <d3d11.h> // Externals/Headless/d3d11.h on non-Windows builds
+#ifdef _WIN32
 #include <directXMath.h>
+#endif
 #include <GFSDK_HairWorks.h>
 #include <IUnityGraphics.h>
+#ifdef _WIN32
 #include <IUnityGraphicsD3D11.h>
+#endif